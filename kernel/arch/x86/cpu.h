@@ -0,0 +1,93 @@
+#ifndef KERNEL_CPU_H
+#define KERNEL_CPU_H
+
+#include <stdint.h>
+
+/* EFLAGS bits */
+#define EFLAGS_IF (1 << 9)  /* Interrupt enable flag */
+#define EFLAGS_ID (1 << 21) /* CPUID available if this bit can be toggled */
+
+/* CR0 bits */
+#define CR0_MP (1 << 1)     /* Monitor coprocessor (WAIT honours TS) */
+#define CR0_EM (1 << 2)     /* Emulate x87: every FPU/SSE instruction traps */
+#define CR0_TS (1 << 3)     /* Task switched: next FPU/SSE instruction traps */
+#define CR0_NE (1 << 5)     /* Native x87 error reporting */
+
+/* CR4 bits */
+#define CR4_OSFXSR     (1 << 9)   /* OS supports FXSAVE/FXRSTOR, enables SSE */
+#define CR4_OSXMMEXCPT (1 << 10)  /* OS handles SIMD floating-point exceptions */
+
+/* Model-specific registers */
+#define MSR_IA32_APIC_BASE 0x1B
+
+/* Model-specific register access */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return (uint64_t)high << 32 | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+/* Control register access */
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    asm volatile ("movl %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    asm volatile ("movl %0, %%cr0" : : "r"(value) : "memory");
+}
+
+/* Linear address of the last page fault */
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    asm volatile ("movl %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    asm volatile ("movl %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    asm volatile ("movl %0, %%cr4" : : "r"(value) : "memory");
+}
+
+/* Disable interrupts and return the previous EFLAGS
+ * Pair with irq_restore() to build sections that an interrupt
+ * handler must not observe half-done. Nesting is fine. */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/* Re-enable interrupts if they were enabled when irq_save() ran */
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        asm volatile ("sti" : : : "memory");
+    }
+}
+
+/* Let interrupts in briefly while waiting for one, up to a TSC deadline
+ * Called and returns with interrupts disabled; callers re-check what they
+ * wait for after each return. hlt would only wake for an interrupt, and
+ * nothing is sure to raise one (IRQ0 is masked, a device may never
+ * answer), so this spins with pause instead: sti holds interrupts off for
+ * one more instruction, and any that are pending are taken between the
+ * pause and the cli.
+ * Returns: 1 once the TSC has reached deadline, 0 before */
+static inline int cpu_wait_for_interrupt(uint64_t deadline) {
+    uint32_t low, high;
+    asm volatile ("sti; pause; cli" : : : "memory");
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32 | low) >= deadline;
+}
+
+#endif // KERNEL_CPU_H
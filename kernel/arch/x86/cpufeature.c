@@ -0,0 +1,105 @@
+#include "cpufeature.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+
+/* CPUID leaf 1 EDX bits */
+#define CPUID_1_EDX_TSC   (1u << 4)
+#define CPUID_1_EDX_MSR   (1u << 5)
+#define CPUID_1_EDX_APIC  (1u << 9)
+#define CPUID_1_EDX_FXSR  (1u << 24)
+#define CPUID_1_EDX_SSE   (1u << 25)
+#define CPUID_1_EDX_SSE2  (1u << 26)
+
+/* CPUID leaf 7 subleaf 0 EBX bits */
+#define CPUID_7_EBX_ERMSB (1u << 9)
+
+/* CPUID leaf 0x80000007 EDX bits */
+#define CPUID_80000007_EDX_INVARIANT_TSC (1u << 8)
+
+/* Detected features */
+static uint32_t cpu_feature_flags = 0;
+static char cpu_vendor_string[13] = "unknown";
+
+/* Check if CPUID exists by trying to toggle EFLAGS.ID */
+static int cpuid_supported(void) {
+    uint32_t before, after;
+    asm volatile ("pushfl\n\t"
+                  "popl %0\n\t"
+                  "movl %0, %1\n\t"
+                  "xorl %2, %1\n\t"
+                  "pushl %1\n\t"
+                  "popfl\n\t"
+                  "pushfl\n\t"
+                  "popl %1\n\t"
+                  "pushl %0\n\t"
+                  "popfl"
+                  : "=&r"(before), "=&r"(after)
+                  : "i"(EFLAGS_ID));
+    return ((before ^ after) & EFLAGS_ID) != 0;
+}
+
+/* Detect CPU features */
+void cpu_features_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (!cpuid_supported()) {
+        printf("CPU: no CPUID, using generic code paths\n");
+        return;
+    }
+    cpu_feature_flags |= CPU_FEATURE_CPUID;
+
+    /* Leaf 0: highest standard leaf and vendor string (EBX, EDX, ECX) */
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t max_leaf = eax;
+    memcpy(cpu_vendor_string, &ebx, 4);
+    memcpy(cpu_vendor_string + 4, &edx, 4);
+    memcpy(cpu_vendor_string + 8, &ecx, 4);
+    cpu_vendor_string[12] = '\0';
+
+    if (max_leaf >= 1) {
+        cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+        if (edx & CPUID_1_EDX_TSC) cpu_feature_flags |= CPU_FEATURE_TSC;
+        if (edx & CPUID_1_EDX_MSR) cpu_feature_flags |= CPU_FEATURE_MSR;
+        if (edx & CPUID_1_EDX_APIC) cpu_feature_flags |= CPU_FEATURE_APIC;
+        if (edx & CPUID_1_EDX_FXSR) cpu_feature_flags |= CPU_FEATURE_FXSR;
+        if (edx & CPUID_1_EDX_SSE) cpu_feature_flags |= CPU_FEATURE_SSE;
+        if (edx & CPUID_1_EDX_SSE2) cpu_feature_flags |= CPU_FEATURE_SSE2;
+    }
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx & CPUID_7_EBX_ERMSB) cpu_feature_flags |= CPU_FEATURE_ERMSB;
+    }
+
+    /* Extended leaves: highest one first */
+    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        if (edx & CPUID_80000007_EDX_INVARIANT_TSC) cpu_feature_flags |= CPU_FEATURE_INVARIANT_TSC;
+    }
+
+    /* SSE can only be switched on together with FXSAVE support (see fpu.c) */
+    if (!(cpu_feature_flags & CPU_FEATURE_FXSR)) {
+        cpu_feature_flags &= ~(CPU_FEATURE_SSE | CPU_FEATURE_SSE2);
+    }
+
+    printf("CPU: %s,%s%s%s%s%s%s\n", cpu_vendor_string,
+           (cpu_feature_flags & CPU_FEATURE_TSC) ? " tsc" : "",
+           (cpu_feature_flags & CPU_FEATURE_INVARIANT_TSC) ? " invtsc" : "",
+           (cpu_feature_flags & CPU_FEATURE_APIC) ? " apic" : "",
+           (cpu_feature_flags & CPU_FEATURE_SSE) ? " sse" : "",
+           (cpu_feature_flags & CPU_FEATURE_SSE2) ? " sse2" : "",
+           (cpu_feature_flags & CPU_FEATURE_ERMSB) ? " erms" : "");
+}
+
+/* Check for a CPU_FEATURE_* flag */
+int cpu_has_feature(uint32_t feature) {
+    return (cpu_feature_flags & feature) == feature;
+}
+
+/* Get the CPU vendor string */
+const char* cpu_vendor(void) {
+    return cpu_vendor_string;
+}
@@ -0,0 +1,39 @@
+#ifndef KERNEL_CPUFEATURE_H
+#define KERNEL_CPUFEATURE_H
+
+#include <stdint.h>
+
+/* CPU feature flags (our own numbering, filled in from CPUID) */
+#define CPU_FEATURE_CPUID  (1u << 0)   /* CPUID instruction itself */
+#define CPU_FEATURE_TSC    (1u << 1)   /* Time-stamp counter */
+#define CPU_FEATURE_FXSR   (1u << 2)   /* FXSAVE/FXRSTOR */
+#define CPU_FEATURE_SSE    (1u << 3)
+#define CPU_FEATURE_SSE2   (1u << 4)
+#define CPU_FEATURE_ERMSB  (1u << 5)   /* Enhanced REP MOVSB/STOSB */
+#define CPU_FEATURE_APIC   (1u << 6)   /* On-chip local APIC */
+#define CPU_FEATURE_MSR    (1u << 7)   /* RDMSR/WRMSR */
+#define CPU_FEATURE_INVARIANT_TSC (1u << 8) /* TSC rate independent of power states */
+
+/* Execute CPUID for a leaf and subleaf */
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid"
+                  : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                  : "a"(leaf), "c"(subleaf));
+}
+
+/* Detect CPU features
+ * Call once, early in boot. SSE instructions raise #UD until
+ * fpu_init() has enabled them.
+ */
+void cpu_features_init(void);
+
+/* Check for a CPU_FEATURE_* flag
+ * Returns: 1 if present (and enabled), 0 otherwise
+ */
+int cpu_has_feature(uint32_t feature);
+
+/* Get the CPU vendor string ("GenuineIntel", ...) */
+const char* cpu_vendor(void);
+
+#endif // KERNEL_CPUFEATURE_H
@@ -0,0 +1,135 @@
+#include "fpu.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+#include "cpufeature.h"
+
+/* MXCSR after reset: all SIMD exceptions masked, round to nearest */
+#define MXCSR_DEFAULT 0x1F80
+
+static int fpu_ready = 0;
+static int fpu_use_fxsr = 0;
+static int fpu_ts_set = 0;              /* Cached CR0.TS */
+
+static fpu_state_t fpu_initial_state;   /* Clean state captured by fpu_init() */
+static fpu_state_t fpu_boot_state;      /* The boot thread (kernel_main) */
+static fpu_state_t fpu_irq_state;       /* Interrupt handlers (they don't nest) */
+
+static fpu_state_t* fpu_current = &fpu_boot_state;  /* Context that is running */
+static fpu_state_t* fpu_owner = &fpu_boot_state;    /* Context whose state is loaded */
+
+/* Store the FPU registers into state */
+static void fpu_save(fpu_state_t* state) {
+    if (fpu_use_fxsr) {
+        asm volatile ("fxsave %0" : "=m"(*state));
+    } else {
+        asm volatile ("fnsave %0; fwait" : "=m"(*state));
+    }
+}
+
+/* Load the FPU registers from state */
+static void fpu_restore(fpu_state_t* state) {
+    if (fpu_use_fxsr) {
+        asm volatile ("fxrstor %0" : : "m"(*state));
+    } else {
+        asm volatile ("frstor %0" : : "m"(*state));
+    }
+}
+
+/* Make the next FPU instruction trap */
+static void fpu_set_ts(void) {
+    if (!fpu_ts_set) {
+        write_cr0(read_cr0() | CR0_TS);
+        fpu_ts_set = 1;
+    }
+}
+
+/* Let FPU instructions run */
+static void fpu_clear_ts(void) {
+    if (fpu_ts_set) {
+        asm volatile ("clts");
+        fpu_ts_set = 0;
+    }
+}
+
+/* Initialize the x87 FPU and SSE and set up the boot context */
+void fpu_init(void) {
+    /* Native FPU (no emulation), WAIT honours TS, native error reporting */
+    uint32_t cr0 = read_cr0();
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+    fpu_ts_set = 0;
+
+    /* SSE needs the OS to declare FXSAVE and SIMD exception support */
+    fpu_use_fxsr = cpu_has_feature(CPU_FEATURE_FXSR);
+    if (fpu_use_fxsr) {
+        write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    }
+
+    asm volatile ("fninit");
+    if (cpu_has_feature(CPU_FEATURE_SSE)) {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        asm volatile ("ldmxcsr %0" : : "m"(mxcsr));
+    }
+
+    /* Every context starts from this image */
+    fpu_save(&fpu_initial_state);
+    fpu_restore(&fpu_initial_state);
+    fpu_context_init(&fpu_irq_state);
+
+    fpu_current = &fpu_boot_state;
+    fpu_owner = &fpu_boot_state;
+    fpu_ready = 1;
+
+    printf("FPU: lazy switching with %s\n", fpu_use_fxsr ? "fxsave" : "fnsave");
+}
+
+/* Give a context the clean state fpu_init() started with */
+void fpu_context_init(fpu_state_t* state) {
+    memcpy(state, &fpu_initial_state, sizeof(*state));
+}
+
+/* Make state the running context's FPU state */
+void fpu_switch(fpu_state_t* state) {
+    fpu_current = state;
+
+    /* Switching back to the context whose registers are still loaded
+     * (the common case on interrupt exit) needs no trap at all */
+    if (fpu_owner == state) {
+        fpu_clear_ts();
+    } else {
+        fpu_set_ts();
+    }
+}
+
+/* Get the running context's FPU state */
+fpu_state_t* fpu_current_context(void) {
+    return fpu_current;
+}
+
+/* Switch to the interrupt context's FPU state on interrupt entry */
+fpu_state_t* fpu_enter_interrupt(void) {
+    fpu_state_t* interrupted = fpu_current;
+    if (fpu_ready) fpu_switch(&fpu_irq_state);
+    return interrupted;
+}
+
+/* Switch back to the interrupted context on interrupt exit */
+void fpu_leave_interrupt(fpu_state_t* interrupted) {
+    if (fpu_ready) fpu_switch(interrupted);
+}
+
+/* Handle the #NM trap: load the running context's state */
+int fpu_handle_device_not_available(void) {
+    if (!fpu_ready || !fpu_ts_set) return 0;
+
+    fpu_clear_ts();
+    if (fpu_owner != fpu_current) {
+        fpu_save(fpu_owner);
+        fpu_restore(fpu_current);
+        fpu_owner = fpu_current;
+    }
+    return 1;
+}
@@ -0,0 +1,55 @@
+#ifndef KERNEL_FPU_H
+#define KERNEL_FPU_H
+
+#include <stdint.h>
+
+/* Lazy x87/SSE context switching
+ *
+ * Each execution context owns an fpu_state_t. Switching contexts with
+ * fpu_switch() only sets CR0.TS; the registers are saved and restored
+ * by the #NM (device not available) trap the first time the new context
+ * actually executes an FPU or SSE instruction. Contexts that never touch
+ * the FPU never pay for the 512-byte save/restore.
+ *
+ * Today the contexts are the boot thread and interrupt handlers: the
+ * interrupt entry path switches to a dedicated state, so SIMD code
+ * (memcpy, checksums) is safe to use from interrupt handlers too. A
+ * scheduler embeds an fpu_state_t per thread, initializes it with
+ * fpu_context_init() and calls fpu_switch() when it switches stacks.
+ */
+
+/* FXSAVE area (also holds the smaller FNSAVE image on CPUs without FXSR) */
+typedef struct {
+    uint8_t data[512];
+} __attribute__((aligned(16))) fpu_state_t;
+
+/* Initialize the x87 FPU and SSE and set up the boot context
+ * Call after cpu_features_init() and before any SIMD code runs.
+ */
+void fpu_init(void);
+
+/* Give a context the clean state fpu_init() started with */
+void fpu_context_init(fpu_state_t* state);
+
+/* Make state the running context's FPU state
+ * Cheap: no registers are touched until the context uses the FPU.
+ */
+void fpu_switch(fpu_state_t* state);
+
+/* Get the running context's FPU state */
+fpu_state_t* fpu_current_context(void);
+
+/* Switch to the interrupt context's FPU state on interrupt entry
+ * Returns: the interrupted context, to pass to fpu_leave_interrupt()
+ */
+fpu_state_t* fpu_enter_interrupt(void);
+
+/* Switch back to the interrupted context on interrupt exit */
+void fpu_leave_interrupt(fpu_state_t* interrupted);
+
+/* Handle the #NM trap (vector 7)
+ * Returns: 1 if the trap was a lazy FPU switch, 0 if it is a real error
+ */
+int fpu_handle_device_not_available(void);
+
+#endif // KERNEL_FPU_H
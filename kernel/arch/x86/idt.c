@@ -7,6 +7,8 @@
 #include "../../util.h"
 #include "io.h"
 #include "pic.h"
+#include "../../profile.h"
+#include "../../init.h"
 
 /* The IDT entries */
 static idt_entry_t idt_entries[256];
@@ -14,10 +16,10 @@ static idt_entry_t idt_entries[256];
 /* The IDTR pointer */
 static idtr_t idtr;
 
-/* Handle timer interrupts without printing debug messages */
+/* Handle timer interrupts without printing debug messages;
+ * the only user of IRQ0 so far is the sampling profiler */
 void timer_handler(registers_t* regs) {
-    (void)regs; /* Avoid unused parameter warning */
-    /* We don't need to do anything here, just acknowledge the interrupt */
+    profile_sample(regs);
 }
 
 /* External references to our ISR handlers defined in assembly */
@@ -70,6 +72,12 @@ extern void isr45(void);
 extern void isr46(void);
 extern void isr47(void);
 
+/* Stubs of the dynamically allocated vectors 48-255 */
+extern const uint32_t isr_dynamic_table[IDT_ENTRIES - IDT_DYNAMIC_FIRST];
+
+/* Dynamic vectors in use, one bit per vector */
+static uint32_t idt_vectors_used[IDT_ENTRIES / 32];
+
 /* External handler array defined in isr.c */
 extern isr_handler_t interrupt_handlers[256];
 
@@ -153,6 +161,11 @@ void idt_init(void) {
     idt_set_gate(46, (uint32_t)isr46, 0x08, 0x8E);
     idt_set_gate(47, (uint32_t)isr47, 0x08, 0x8E);
 
+    /* Vectors for idt_alloc_vectors() and the local APIC's spurious vector */
+    for (int vector = IDT_DYNAMIC_FIRST; vector < IDT_ENTRIES; vector++) {
+        idt_set_gate(vector, isr_dynamic_table[vector - IDT_DYNAMIC_FIRST], 0x08, 0x8E);
+    }
+
     /* Load the IDT */
     idt_load((uint32_t)&idtr);
     
@@ -163,4 +176,49 @@ void idt_init(void) {
     pic_enable_irq(1);
     
     printf("IDT initialized\n");
-} 
\ No newline at end of file
+}
+
+/* Check whether a vector is allocated */
+static int idt_vector_used(uint32_t vector) {
+    return (idt_vectors_used[vector / 32] >> (vector % 32)) & 1;
+}
+
+/* Allocate an aligned block of dynamic vectors */
+int idt_alloc_vectors(uint32_t count) {
+    if (count == 0 || (count & (count - 1)) != 0) {
+        return -1;
+    }
+
+    uint32_t first = (IDT_DYNAMIC_FIRST + count - 1) & ~(count - 1);
+    for (; first + count - 1 <= IDT_DYNAMIC_LAST; first += count) {
+        uint32_t i = 0;
+        while (i < count && !idt_vector_used(first + i)) {
+            i++;
+        }
+        if (i < count) {
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            idt_vectors_used[(first + i) / 32] |= 1u << ((first + i) % 32);
+        }
+        return (int)first;
+    }
+    return -1;
+}
+
+/* Release dynamic vectors */
+void idt_free_vectors(uint8_t first, uint32_t count) {
+    for (uint32_t vector = first; vector < (uint32_t)first + count && vector <= IDT_DYNAMIC_LAST; vector++) {
+        if (vector < IDT_DYNAMIC_FIRST) {
+            continue;
+        }
+        interrupt_handlers[vector] = 0;
+        idt_vectors_used[vector / 32] &= ~(1u << (vector % 32));
+    }
+}
+
+static int idt_initcall(void) {
+    idt_init();
+    return 0;
+}
+INITCALL(idt, idt_initcall, "");
@@ -13,6 +13,11 @@
 /* Number of ISRs in our IDT */
 #define IDT_ENTRIES 256
 
+/* Vectors handed out at run time, above the PIC's 32-47; the last one
+ * is the local APIC's spurious vector (lapic.h) and never handed out */
+#define IDT_DYNAMIC_FIRST 48
+#define IDT_DYNAMIC_LAST  254
+
 /* Define the structure of an IDT entry */
 typedef struct {
     uint16_t base_low;     /* Lower 16 bits of handler address */
@@ -34,6 +39,16 @@ void idt_init(void);
 /* Set an entry in the IDT */
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags);
 
+/* Allocate count consecutive vectors from the dynamic range, with the
+ * first one a multiple of count (as multi-message MSI needs)
+ * count must be a power of two.
+ * Returns: the first vector, or -1 if no such block is free
+ */
+int idt_alloc_vectors(uint32_t count);
+
+/* Release vectors from idt_alloc_vectors() and their handlers */
+void idt_free_vectors(uint8_t first, uint32_t count);
+
 /* External assembly function to load the IDT register */
 extern void idt_load(uint32_t idt_ptr);
 
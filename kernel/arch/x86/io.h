@@ -39,4 +39,9 @@ static inline uint32_t inl(uint16_t port) {
     return ret;
 }
 
+// Read count words from an I/O port into a buffer
+static inline void insw(uint16_t port, void* buffer, uint32_t count) {
+    asm volatile ("rep insw" : "+D"(buffer), "+c"(count) : "d"(port) : "memory");
+}
+
 #endif // KERNEL_IO_H 
\ No newline at end of file
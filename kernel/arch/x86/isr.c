@@ -4,6 +4,11 @@
 #include "../../drivers/serial.h"
 #include "../../drivers/vga.h"
 #include "pic.h"
+#include "lapic.h"
+#include "fpu.h"
+#include "cpu.h"
+#include "../../klog.h"
+#include "../../trace.h"
 
 /* Array of function pointers to custom interrupt handlers */
 isr_handler_t interrupt_handlers[IDT_ENTRIES];
@@ -52,12 +57,22 @@ void register_interrupt_handler(uint8_t n, isr_handler_t handler) {
 /* Main interrupt service routine handler
  * This gets called from our assembly interrupt handler stub */
 void isr_handler(registers_t regs) {
+    TRACE(IRQ_ENTRY, regs.int_no, regs.err_code, regs.eip);
+
+    /* Device not available is how lazy FPU switching loads a context's
+     * registers; the faulting instruction is simply restarted */
+    if (regs.int_no == 7 && fpu_handle_device_not_available()) {
+        TRACE(IRQ_EXIT, regs.int_no, 0, 0);
+        return;
+    }
+    
     /* If it's an exception (0-31), print more detail */
     if (regs.int_no < 32) {
         printf("\033[1;31mEXCEPTION: %s (INT %d)\033[0m\n", exception_messages[regs.int_no], regs.int_no);
         
         /* For some exceptions, print the error code too */
         if (regs.int_no == 14) { /* Page fault */
+            TRACE(PAGE_FAULT, read_cr2(), regs.err_code, regs.eip);
             printf("Error Code: %x\n", regs.err_code);
             printf("Fault was caused by a %s\n", (regs.err_code & 0x1) ? "page-level protection violation" : "non-present page");
             printf("Access type: %s\n", (regs.err_code & 0x2) ? "write" : "read");
@@ -66,17 +81,31 @@ void isr_handler(registers_t regs) {
         
         /* Serious error - halt the system */
         printf("\033[1;31mSystem Halted!\033[0m\n");
+        
+        /* The idle loop will never drain the log again, so do it now */
+        klog_panic_flush();
+        trace_dump();
         for(;;); /* Infinite loop */
     }
     
+    /* Handlers get their own FPU state, loaded only if they use it */
+    fpu_state_t* interrupted = fpu_enter_interrupt();
+    
     /* Check if we have a custom handler for this interrupt */
     if (interrupt_handlers[regs.int_no] != 0) {
         isr_handler_t handler = interrupt_handlers[regs.int_no];
         handler(&regs);
     }
     
-    /* Send EOI if this was an IRQ (32-47) */
+    /* Send EOI if this was an IRQ (32-47) through the PIC, or a
+     * message signalled interrupt through the local APIC. Spurious
+     * interrupts are not acknowledged. */
     if (regs.int_no >= 32 && regs.int_no < 48) {
         pic_send_eoi(regs.int_no - 32);
+    } else if (regs.int_no >= IDT_DYNAMIC_FIRST && regs.int_no != LAPIC_SPURIOUS_VECTOR) {
+        lapic_eoi();
     }
+    
+    fpu_leave_interrupt(interrupted);
+    TRACE(IRQ_EXIT, regs.int_no, 0, 0);
 } 
\ No newline at end of file
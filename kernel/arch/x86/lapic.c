@@ -0,0 +1,77 @@
+#include "lapic.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cpufeature.h"
+#include "paging.h"
+#include "../../init.h"
+
+/* Register window, identity mapped (NULL until lapic_init() succeeds) */
+static volatile uint32_t* lapic_registers = NULL;
+
+/* APIC ID of the boot processor */
+static uint8_t lapic_boot_id = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic_registers[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_registers[reg / 4] = value;
+}
+
+/* Map and software-enable the local APIC */
+int lapic_init(void) {
+    if (!cpu_has_feature(CPU_FEATURE_APIC) || !cpu_has_feature(CPU_FEATURE_MSR)) {
+        printf("LAPIC: not present\n");
+        return -1;
+    }
+
+    /* Firmware leaves it globally enabled at the default base; keep that base */
+    uint64_t base_msr = rdmsr(MSR_IA32_APIC_BASE);
+    uint32_t base = (uint32_t)base_msr & LAPIC_BASE_ADDRESS_MASK;
+    if ((base_msr >> 32) != 0 || paging_map_region(base, PAGE_SIZE, PDE_CACHE_DISABLE) != 0) {
+        printf("LAPIC: cannot map registers at %08llx\n", (unsigned long long)base_msr);
+        return -1;
+    }
+    if (!(base_msr & LAPIC_BASE_ENABLE)) {
+        wrmsr(MSR_IA32_APIC_BASE, base_msr | LAPIC_BASE_ENABLE);
+    }
+    lapic_registers = (volatile uint32_t*)base;
+
+    /* Accept every priority and set the software enable bit; LINT0 stays
+     * as the firmware programmed it (ExtINT), so the PIC keeps working */
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_boot_id = (uint8_t)(lapic_read(LAPIC_REG_ID) >> 24);
+
+    printf("LAPIC: id %u, version %02x, registers at %08x\n", lapic_boot_id,
+           lapic_read(LAPIC_REG_VERSION) & 0xFF, base);
+    return 0;
+}
+
+int lapic_present(void) {
+    return lapic_registers != NULL;
+}
+
+/* Signal end of interrupt */
+void lapic_eoi(void) {
+    if (lapic_registers) {
+        lapic_write(LAPIC_REG_EOI, 0);
+    }
+}
+
+/* APIC ID for a CPU number */
+int lapic_cpu_apic_id(uint32_t cpu) {
+    if (cpu >= LAPIC_MAX_CPUS || !lapic_registers) {
+        return -1;
+    }
+    return lapic_boot_id;
+}
+
+/* A CPU without a local APIC still boots, with legacy interrupts only */
+static int lapic_initcall(void) {
+    lapic_init();
+    return 0;
+}
+INITCALL(lapic, lapic_initcall, "idt");
@@ -0,0 +1,56 @@
+#ifndef KERNEL_LAPIC_H
+#define KERNEL_LAPIC_H
+
+#include <stdint.h>
+
+/* Local APIC
+ *
+ * Legacy device interrupts still come through the 8259 PIC (virtual
+ * wire mode); the local APIC is enabled so that message signalled
+ * interrupts (MSI and MSI-X), which are writes to its address window,
+ * reach the CPU. Vectors taken through it are acknowledged with
+ * lapic_eoi() instead of the PIC's port I/O.
+ */
+
+/* Default physical base of the register window */
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+
+/* Register offsets */
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_VERSION       0x030
+#define LAPIC_REG_TPR           0x080   /* Task priority */
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0   /* Spurious interrupt vector */
+
+/* IA32_APIC_BASE MSR bits */
+#define LAPIC_BASE_ENABLE       (1u << 11)
+#define LAPIC_BASE_ADDRESS_MASK 0xFFFFF000u
+
+/* SVR bits */
+#define LAPIC_SVR_ENABLE        (1u << 8)
+
+/* Vector the local APIC uses for spurious interrupts; never acknowledged */
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+
+/* Only the boot processor runs kernel code for now */
+#define LAPIC_MAX_CPUS          1
+
+/* Map and software-enable the local APIC
+ * Returns: 0 on success, -1 if the CPU has none or it cannot be mapped
+ */
+int lapic_init(void);
+
+/* Check whether lapic_init() succeeded
+ * Returns: 1 if the local APIC is enabled, 0 otherwise
+ */
+int lapic_present(void);
+
+/* Signal end of interrupt for a vector delivered by the local APIC */
+void lapic_eoi(void);
+
+/* Get the APIC ID that message signalled interrupts use to target a CPU
+ * Returns: the APIC ID, or -1 if cpu is not running
+ */
+int lapic_cpu_apic_id(uint32_t cpu);
+
+#endif // KERNEL_LAPIC_H
@@ -0,0 +1,66 @@
+#include "memops.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpufeature.h"
+
+/* Implementation sets, slowest first */
+static const mem_ops_t mem_ops_rep = {
+    "rep movsd", memcpy_rep_movsd, memmove_rep, memset_rep_stosd, memcmp_generic
+};
+
+static const mem_ops_t mem_ops_erms = {
+    "rep movsb", memcpy_erms, memmove_rep, memset_erms, memcmp_generic
+};
+
+static const mem_ops_t mem_ops_sse2 = {
+    "sse2", memcpy_sse2, memmove_rep, memset_sse2, memcmp_sse2
+};
+
+static const str_ops_t str_ops_sse2 = {
+    "sse2", strlen_sse2, strnlen_sse2, strchr_sse2, strrchr_sse2,
+    strcmp_sse2, strspn_table, strcspn_table
+};
+
+/* Sets usable on this CPU, filled in by memops_init() */
+static const mem_ops_t* mem_variants[4];
+static size_t mem_variant_count = 0;
+static const str_ops_t* str_variants[2];
+static size_t str_variant_count = 0;
+
+/* Select and install the memory functions for this CPU */
+void memops_init(void) {
+    mem_variant_count = 0;
+    str_variant_count = 0;
+    mem_variants[mem_variant_count++] = &mem_ops_generic;
+    str_variants[str_variant_count++] = &str_ops_swar;
+    mem_variants[mem_variant_count++] = &mem_ops_rep;
+    if (cpu_has_feature(CPU_FEATURE_ERMSB)) {
+        mem_variants[mem_variant_count++] = &mem_ops_erms;
+    }
+    if (cpu_has_feature(CPU_FEATURE_SSE2)) {
+        mem_variants[mem_variant_count++] = &mem_ops_sse2;
+        str_variants[str_variant_count++] = &str_ops_sse2;
+    }
+
+    /* The last usable set is the preferred one */
+    const mem_ops_t* selected = mem_variants[mem_variant_count - 1];
+    mem_ops_install(selected);
+    printf("Memory functions: %s\n", selected->name);
+
+    const str_ops_t* selected_str = str_variants[str_variant_count - 1];
+    str_ops_install(selected_str);
+    printf("String functions: %s\n", selected_str->name);
+}
+
+/* Get the index-th implementation set usable on this CPU */
+const mem_ops_t* memops_variant(size_t index) {
+    if (index >= mem_variant_count) return NULL;
+    return mem_variants[index];
+}
+
+/* Get the index-th string implementation set usable on this CPU */
+const str_ops_t* strops_variant(size_t index) {
+    if (index >= str_variant_count) return NULL;
+    return str_variants[index];
+}
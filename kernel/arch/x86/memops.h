@@ -0,0 +1,46 @@
+#ifndef KERNEL_MEMOPS_H
+#define KERNEL_MEMOPS_H
+
+#include <stddef.h>
+#include <string.h>
+
+/* CPU-specific memory and string function implementations (memops_impl.S)
+ *
+ * memops_init() picks the fastest set this CPU supports and installs it
+ * with mem_ops_install() and str_ops_install(), so memcpy(), strlen()
+ * and friends dispatch through one function pointer from then on. The
+ * variants stay callable directly for benchmarking.
+ */
+
+void* memcpy_rep_movsd(void* dest, const void* src, size_t n);
+void* memcpy_erms(void* dest, const void* src, size_t n);
+void* memcpy_sse2(void* dest, const void* src, size_t n);
+void* memmove_rep(void* dest, const void* src, size_t n);
+void* memset_rep_stosd(void* s, int c, size_t n);
+void* memset_erms(void* s, int c, size_t n);
+void* memset_sse2(void* s, int c, size_t n);
+int memcmp_sse2(const void* s1, const void* s2, size_t n);
+size_t strlen_sse2(const char* str);
+size_t strnlen_sse2(const char* str, size_t maxlen);
+char* strchr_sse2(const char* str, int c);
+char* strrchr_sse2(const char* str, int c);
+int strcmp_sse2(const char* s1, const char* s2);
+
+/* Select and install the memory and string functions for this CPU
+ * Call after cpu_features_init().
+ */
+void memops_init(void);
+
+/* Get the index-th implementation set usable on this CPU
+ * Index 0 is the portable C set.
+ * Returns: the set, or NULL past the last one
+ */
+const mem_ops_t* memops_variant(size_t index);
+
+/* Get the index-th string implementation set usable on this CPU
+ * Index 0 is the portable word-at-a-time set.
+ * Returns: the set, or NULL past the last one
+ */
+const str_ops_t* strops_variant(size_t index);
+
+#endif // KERNEL_MEMOPS_H
@@ -1,5 +1,6 @@
 #include "paging.h"
 #include <string.h>
+#include "../../trace.h"
 
 // Declare the page directory and the first page table.
 // These need to be page-aligned (4KB).
@@ -39,10 +40,42 @@ void paging_init() {
     uint32_t page_directory_addr = (uint32_t)&kernel_page_directory;
     load_page_directory(page_directory_addr);
 
+    // Allow 4MB pages, used by paging_map_region() for device memory
+    enable_pse();
+
     // Enable paging by setting the PG bit in CR0
     enable_paging();
     
     // Paging is now enabled! Virtual addresses are now active.
     // Since we identity mapped, addresses 0x00000000 to 0x003FFFFF 
     // map to the same physical addresses.
+}
+
+// Identity map a physical region using 4MB pages
+int paging_map_region(uint32_t phys_addr, uint32_t size, uint32_t flags) {
+    if (size == 0) return 0;
+    TRACE(PAGE_MAP, phys_addr, size, flags);
+
+    // Round out to whole 4MB pages
+    uint32_t first = phys_addr / PAGE_DIRECTORY_SPAN;
+    uint32_t last = (phys_addr + size - 1) / PAGE_DIRECTORY_SPAN;
+
+    for (uint32_t index = first; index <= last; index++) {
+        page_directory_entry_t entry = (index * PAGE_DIRECTORY_SPAN) |
+                                       PDE_PRESENT | PDE_READ_WRITE | PDE_SIZE_4MB | flags;
+        page_directory_entry_t current = kernel_page_directory.entries[index];
+
+        // Already mapped by an earlier call (e.g. two BARs in the same 4MB);
+        // ignore the accessed/dirty bits the CPU may have set since
+        if ((current & ~(PDE_ACCESSED | PDE_DIRTY)) == entry) continue;
+        if (current & PDE_PRESENT) {
+            TRACE(PAGE_CONFLICT, index * PAGE_DIRECTORY_SPAN, current, 0);
+            return -1;
+        }
+
+        kernel_page_directory.entries[index] = entry;
+    }
+
+    flush_tlb();
+    return 0;
 } 
\ No newline at end of file
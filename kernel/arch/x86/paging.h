@@ -46,11 +46,21 @@ typedef struct {
     page_directory_entry_t entries[1024];
 } __attribute__((aligned(PAGE_SIZE))) page_directory_t;
 
+// Size of the region covered by one page directory entry
+#define PAGE_DIRECTORY_SPAN (4 * 1024 * 1024)
+
 // Function to initialize basic paging
 void paging_init();
 
+// Identity map a physical region above the first 4MB, such as device MMIO,
+// using 4MB pages. flags are extra PDE bits (e.g. PDE_CACHE_DISABLE).
+// Returns 0 on success, -1 if part of the region is already mapped differently.
+int paging_map_region(uint32_t phys_addr, uint32_t size, uint32_t flags);
+
 // External assembly functions (defined in paging_enable.S)
 extern void load_page_directory(uint32_t page_directory_addr);
 extern void enable_paging();
+extern void enable_pse();
+extern void flush_tlb();
 
 #endif // KERNEL_PAGING_H 
\ No newline at end of file
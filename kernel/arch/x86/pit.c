@@ -0,0 +1,56 @@
+#include "pit.h"
+#include <stdint.h>
+#include "io.h"
+#include "../../clocksource.h"
+#include "../../init.h"
+
+/* Port B gates channel 2 and connects it to the PC speaker */
+#define PIT_SPEAKER_PORT    0x61
+
+#define SPEAKER_GATE2       0x01    /* Gate input of channel 2 */
+#define SPEAKER_DATA        0x02    /* Speaker enable */
+
+/* Program channel 0 as a rate generator at roughly hz */
+uint32_t pit_set_frequency(uint32_t hz) {
+    uint32_t divisor = 65536;
+    if (hz > PIT_DEFAULT_HZ) {
+        divisor = (PIT_FREQUENCY_HZ + hz / 2) / hz;
+        if (divisor < 2) divisor = 2;
+    }
+
+    /* Channel 0, lobyte/hibyte access, mode 2 (rate generator);
+     * a divisor of 65536 is written as 0 */
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0_DATA, divisor & 0xFF);
+    outb(PIT_CHANNEL0_DATA, (divisor >> 8) & 0xFF);
+
+    return PIT_FREQUENCY_HZ / divisor;
+}
+
+/* Channel 2 counts down from 65536; latch it and flip the count */
+uint64_t pit_clocksource_read(void) {
+    outb(PIT_COMMAND, 0x80);    /* Latch channel 2 */
+    uint8_t low = inb(PIT_CHANNEL2_DATA);
+    uint8_t high = inb(PIT_CHANNEL2_DATA);
+    return (uint16_t)-(uint16_t)(low | high << 8);
+}
+
+static clocksource_t pit_clocksource = {
+    "pit", CLOCKSOURCE_RATING_PIT, pit_clocksource_read, 0xFFFF, PIT_FREQUENCY_HZ, 0
+};
+
+/* Channel 0 belongs to the profiler, so the clocksource is channel 2 */
+static int pit_initcall(void) {
+    /* Gate on, speaker off */
+    uint8_t speaker = inb(PIT_SPEAKER_PORT);
+    outb(PIT_SPEAKER_PORT, (speaker & ~SPEAKER_DATA) | SPEAKER_GATE2);
+
+    /* Channel 2, lobyte/hibyte access, mode 2 (rate generator), divisor 65536 */
+    outb(PIT_COMMAND, 0xB4);
+    outb(PIT_CHANNEL2_DATA, 0);
+    outb(PIT_CHANNEL2_DATA, 0);
+
+    clocksource_register(&pit_clocksource);
+    return 0;
+}
+INITCALL(pit_clocksource, pit_initcall, "");
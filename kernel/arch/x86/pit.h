@@ -0,0 +1,27 @@
+#ifndef KERNEL_PIT_H
+#define KERNEL_PIT_H
+
+#include <stdint.h>
+
+/* 8253/8254 programmable interval timer */
+#define PIT_FREQUENCY_HZ    1193182
+#define PIT_CHANNEL0_DATA   0x40
+#define PIT_CHANNEL2_DATA   0x42
+#define PIT_COMMAND         0x43
+
+/* Rate the BIOS leaves channel 0 at (divisor 65536) */
+#define PIT_DEFAULT_HZ      18
+
+/* Program channel 0 (IRQ0) as a periodic rate generator at roughly hz.
+ * Rates at or below PIT_DEFAULT_HZ restore the BIOS rate.
+ * Returns: the rate actually programmed, in Hz
+ */
+uint32_t pit_set_frequency(uint32_t hz);
+
+/* Read PIT channel 2 as an up-counter at PIT_FREQUENCY_HZ, 16 bits wide
+ * The "pit" clocksource: its initcall leaves channel 2 free running
+ * once tsc_init() no longer needs it for calibration.
+ */
+uint64_t pit_clocksource_read(void);
+
+#endif // KERNEL_PIT_H
@@ -0,0 +1,19 @@
+#ifndef KERNEL_QEMU_H
+#define KERNEL_QEMU_H
+
+#include <stdint.h>
+#include "io.h"
+
+/* QEMU isa-debug-exit device
+ * With -device isa-debug-exit,iobase=0xf4,iosize=0x04, a write to the
+ * port ends QEMU with exit status (code << 1) | 1. Without the device
+ * the write is ignored and the call returns.
+ */
+#define QEMU_DEBUG_EXIT_PORT 0xF4
+
+/* Exit QEMU with status (code << 1) | 1 */
+static inline void qemu_exit(uint32_t code) {
+    outl(QEMU_DEBUG_EXIT_PORT, code);
+}
+
+#endif // KERNEL_QEMU_H
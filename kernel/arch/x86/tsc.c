@@ -0,0 +1,119 @@
+#include "tsc.h"
+#include <stdint.h>
+#include "io.h"
+#include "pit.h"
+#include "cpufeature.h"
+#include "../../clocksource.h"
+#include "../../init.h"
+
+/* PIT channel 2 is wired to the PC speaker gate, which lets us poll
+ * its output pin through port 0x61 without needing interrupts. */
+#define PIT_SPEAKER_PORT    0x61
+
+#define SPEAKER_GATE2       0x01    /* Gate input of channel 2 */
+#define SPEAKER_DATA        0x02    /* Speaker enable */
+#define SPEAKER_OUT2        0x20    /* Output pin of channel 2 */
+
+/* Calibration window length */
+#define TSC_CALIBRATE_MS    10
+
+/* Window of tsc_calibrate(): the reference reads bound the error, not the PIT's gate */
+#define TSC_RECALIBRATE_MS  5
+
+/* Calibrated frequency */
+static uint32_t tsc_frequency_khz = 0;
+
+/* Calibrate the TSC against PIT channel 2 in one-shot mode */
+void tsc_init(void) {
+    uint16_t count = (uint16_t)(PIT_FREQUENCY_HZ * TSC_CALIBRATE_MS / 1000);
+
+    /* Enable the channel 2 gate, keep the speaker silent */
+    uint8_t speaker = inb(PIT_SPEAKER_PORT);
+    outb(PIT_SPEAKER_PORT, (speaker & ~SPEAKER_DATA) | SPEAKER_GATE2);
+
+    /* Channel 2, lobyte/hibyte access, mode 0 (interrupt on terminal count) */
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2_DATA, count & 0xFF);
+    outb(PIT_CHANNEL2_DATA, count >> 8);
+
+    /* Pulse the gate low then high to restart the count */
+    speaker = inb(PIT_SPEAKER_PORT) & ~SPEAKER_DATA;
+    outb(PIT_SPEAKER_PORT, speaker & ~SPEAKER_GATE2);
+    outb(PIT_SPEAKER_PORT, speaker | SPEAKER_GATE2);
+
+    uint64_t start = tsc_read();
+    while (!(inb(PIT_SPEAKER_PORT) & SPEAKER_OUT2)) {
+        /* Spin until the counter reaches zero */
+    }
+    uint64_t end = tsc_read();
+
+    tsc_frequency_khz = (uint32_t)((end - start) / TSC_CALIBRATE_MS);
+}
+
+static uint64_t tsc_clocksource_read(void) {
+    return tsc_read();
+}
+
+static clocksource_t tsc_clocksource = {
+    "tsc", CLOCKSOURCE_RATING_TSC, tsc_clocksource_read, UINT64_MAX, 0, 0
+};
+
+/* Recalibrate the TSC against a clocksource */
+uint32_t tsc_calibrate(const clocksource_t* reference) {
+    uint64_t window = reference->frequency_hz * TSC_RECALIBRATE_MS / 1000;
+    if (window == 0 || window > reference->mask / 2) return 0;
+
+    /* Each reference read happened between the two TSC reads around it */
+    uint64_t start_before = tsc_read();
+    uint64_t start_count = reference->read();
+    uint64_t start_after = tsc_read();
+
+    uint64_t end_before, end_count, end_after, ticks;
+    do {
+        end_before = tsc_read();
+        end_count = reference->read();
+        end_after = tsc_read();
+        ticks = (end_count - start_count) & reference->mask;
+    } while (ticks < window);
+
+    uint64_t cycles = (end_before + end_after) / 2 - (start_before + start_after) / 2;
+    uint32_t khz = (uint32_t)(cycles * reference->frequency_hz / (ticks * 1000));
+    if (khz == 0) return 0;
+
+    tsc_frequency_khz = khz;
+    tsc_clocksource.frequency_hz = (uint64_t)khz * 1000;
+    return khz;
+}
+
+/* Get the calibrated TSC frequency in kHz */
+uint32_t tsc_khz(void) {
+    return tsc_frequency_khz;
+}
+
+/* Convert a TSC cycle count to microseconds */
+uint64_t tsc_to_us(uint64_t cycles) {
+    if (tsc_frequency_khz == 0) return cycles;
+    /* Split into whole milliseconds and remainder so the multiply can't overflow */
+    uint64_t ms = cycles / tsc_frequency_khz;
+    uint64_t rest = cycles % tsc_frequency_khz;
+    return ms * 1000 + rest * 1000 / tsc_frequency_khz;
+}
+
+/* Convert a TSC cycle count to nanoseconds */
+uint64_t tsc_to_ns(uint64_t cycles) {
+    if (tsc_frequency_khz == 0) return cycles;
+    uint64_t ms = cycles / tsc_frequency_khz;
+    uint64_t rest = cycles % tsc_frequency_khz;
+    return ms * 1000000 + rest * 1000000 / tsc_frequency_khz;
+}
+
+/* Only a TSC that keeps its rate through power state changes is rated above the others */
+static int tsc_initcall(void) {
+    if (cpu_has_feature(CPU_FEATURE_INVARIANT_TSC)) {
+        tsc_clocksource.rating = CLOCKSOURCE_RATING_TSC_INVARIANT;
+    }
+    tsc_clocksource.frequency_hz = (uint64_t)tsc_frequency_khz * 1000;
+    clocksource_register(&tsc_clocksource);
+    return 0;
+}
+INITCALL(tsc_clocksource, tsc_initcall, "");
@@ -0,0 +1,38 @@
+#ifndef KERNEL_TSC_H
+#define KERNEL_TSC_H
+
+#include <stdint.h>
+
+/* Read the CPU time-stamp counter */
+static inline uint64_t tsc_read(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/* Calibrate the TSC against the PIT
+ * Takes roughly 10ms. Until this has run, tsc_khz() returns 0
+ * and the conversion helpers return raw cycle counts.
+ */
+void tsc_init(void);
+
+struct clocksource;
+
+/* Recalibrate the TSC against a better reference than the PIT
+ * Counts TSC cycles over TSC_RECALIBRATE_MS of the reference, each
+ * reference read bracketed by two TSC reads. Updates tsc_khz() and the
+ * "tsc" clocksource.
+ * Returns: the new frequency in kHz, or 0 if the reference is unusable
+ */
+uint32_t tsc_calibrate(const struct clocksource* reference);
+
+/* Get the calibrated TSC frequency in kHz (0 if not calibrated) */
+uint32_t tsc_khz(void);
+
+/* Convert a TSC cycle count to microseconds */
+uint64_t tsc_to_us(uint64_t cycles);
+
+/* Convert a TSC cycle count to nanoseconds */
+uint64_t tsc_to_ns(uint64_t cycles);
+
+#endif // KERNEL_TSC_H
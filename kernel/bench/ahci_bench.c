@@ -0,0 +1,64 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../drivers/ahci.h"
+
+/* Registered cases: random 4 KiB reads on disk 0 with 1, 8 and 32
+ * requests kept in flight by a bench_ring_t. make bench attaches a
+ * scratch image to an AHCI port for these. */
+#define AHCI_BENCH_IO_SECTORS   8       /* 4 KiB */
+#define AHCI_BENCH_MAX_DEPTH    32
+
+static ahci_request_t ahci_bench_requests[AHCI_BENCH_MAX_DEPTH];
+static uint8_t ahci_bench_buffers[AHCI_BENCH_MAX_DEPTH][AHCI_BENCH_IO_SECTORS * AHCI_SECTOR_SIZE]
+    __attribute__((aligned(4096)));
+static uint32_t ahci_bench_span = 0;    /* Sectors usable */
+
+static int submit(uint32_t index) {
+    ahci_request_t* request = &ahci_bench_requests[index];
+    request->disk = 0;
+    request->lba = bench_disk_random(ahci_bench_span, AHCI_BENCH_IO_SECTORS);
+    request->count = AHCI_BENCH_IO_SECTORS;
+    request->buffer = ahci_bench_buffers[index];
+    request->write = 0;
+    request->done = NULL;
+    return ahci_submit(request);
+}
+
+static void wait(uint32_t index) {
+    ahci_wait(&ahci_bench_requests[index]);
+}
+
+static bench_ring_t ahci_bench_ring = { submit, wait, 0, 0 };
+
+static int setup_depth(uint32_t depth) {
+    const ahci_disk_t* disk = ahci_get_disk(0);
+    ahci_bench_span = disk ? bench_disk_span(disk->sectors, AHCI_BENCH_IO_SECTORS) : 0;
+    if (!ahci_bench_span) return -1;
+    bench_seed(1);
+    return bench_ring_fill(&ahci_bench_ring, depth);
+}
+
+static int setup_qd1(void) {
+    return setup_depth(1);
+}
+
+static int setup_qd8(void) {
+    return setup_depth(8);
+}
+
+static int setup_qd32(void) {
+    return setup_depth(32);
+}
+
+static void run_rand_read(void) {
+    bench_ring_step(&ahci_bench_ring);
+}
+
+const bench_case_t ahci_bench_cases[] = {
+    { "ahci_rand_read_4k_qd1", setup_qd1, run_rand_read, 2000, 32 },
+    { "ahci_rand_read_4k_qd8", setup_qd8, run_rand_read, 4000, 64 },
+    { "ahci_rand_read_4k_qd32", setup_qd32, run_rand_read, 8000, 128 },
+    { NULL, NULL, NULL, 0, 0 }
+};
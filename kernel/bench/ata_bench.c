@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../drivers/ata.h"
+
+/* Registered cases: sequential 64 KiB and random 4 KiB transfers on
+ * drive 0, reads and writes; bytes per iteration over ns_per_iter is
+ * the throughput. make bench attaches a scratch image as the primary
+ * master; the write cases check it for BENCH_DISK_MAGIC. */
+#define ATA_BENCH_SEQ_SECTORS   128     /* 64 KiB */
+#define ATA_BENCH_RAND_SECTORS  8       /* 4 KiB */
+
+static uint8_t ata_bench_buffer[ATA_BENCH_SEQ_SECTORS * ATA_SECTOR_SIZE] __attribute__((aligned(4096)));
+static uint32_t ata_bench_span = 0;     /* Sectors usable, a multiple of ATA_BENCH_SEQ_SECTORS */
+static uint32_t ata_bench_next = 0;     /* Next sequential offset */
+
+static int setup_read(void) {
+    const ata_drive_t* drive = ata_get_drive(0);
+    ata_bench_span = drive ? bench_disk_span(drive->sectors, ATA_BENCH_SEQ_SECTORS) : 0;
+    if (!ata_bench_span) return -1;
+    ata_bench_next = 0;
+    bench_seed(1);
+    return 0;
+}
+
+static int setup_write(void) {
+    if (setup_read() != 0 || ata_read(0, 0, 1, ata_bench_buffer) != 0) return -1;
+    return memcmp(ata_bench_buffer, BENCH_DISK_MAGIC, sizeof(BENCH_DISK_MAGIC) - 1) == 0 ? 0 : -1;
+}
+
+/* Next sequential chunk, wrapping at the end of the span */
+static uint64_t next_sequential(void) {
+    uint64_t lba = BENCH_DISK_FIRST_SECTOR + ata_bench_next;
+    ata_bench_next = (ata_bench_next + ATA_BENCH_SEQ_SECTORS) % ata_bench_span;
+    return lba;
+}
+
+static void run_seq_read(void) {
+    ata_read(0, next_sequential(), ATA_BENCH_SEQ_SECTORS, ata_bench_buffer);
+}
+
+static void run_seq_write(void) {
+    ata_write(0, next_sequential(), ATA_BENCH_SEQ_SECTORS, ata_bench_buffer);
+}
+
+static void run_rand_read(void) {
+    ata_read(0, bench_disk_random(ata_bench_span, ATA_BENCH_RAND_SECTORS), ATA_BENCH_RAND_SECTORS, ata_bench_buffer);
+}
+
+static void run_rand_write(void) {
+    ata_write(0, bench_disk_random(ata_bench_span, ATA_BENCH_RAND_SECTORS), ATA_BENCH_RAND_SECTORS, ata_bench_buffer);
+}
+
+const bench_case_t ata_bench_cases[] = {
+    { "ata_seq_read_64k", setup_read, run_seq_read, 256, 8 },
+    { "ata_seq_write_64k", setup_write, run_seq_write, 256, 8 },
+    { "ata_rand_read_4k", setup_read, run_rand_read, 1000, 16 },
+    { "ata_rand_write_4k", setup_write, run_rand_write, 1000, 16 },
+    { NULL, NULL, NULL, 0, 0 }
+};
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+#include "../drivers/serial.h"
+
+/* All case tables, in the order they run */
+static const bench_case_t* const bench_tables[] = {
+    mem_bench_cases,
+    string_bench_cases,
+    printf_bench_cases,
+    vga_bench_cases,
+    pci_bench_cases,
+    irq_bench_cases,
+    clock_bench_cases,
+    ata_bench_cases,
+    ahci_bench_cases,
+    virtio_blk_bench_cases,
+    block_bench_cases,
+    page_cache_bench_cases,
+};
+
+static uint32_t bench_lcg = 1;
+
+uint32_t bench_disk_span(uint64_t sectors, uint32_t chunk) {
+    if (sectors < BENCH_DISK_FIRST_SECTOR + chunk) return 0;
+    uint64_t span = sectors - BENCH_DISK_FIRST_SECTOR;
+    if (span > BENCH_DISK_SPAN_SECTORS) span = BENCH_DISK_SPAN_SECTORS;
+    return (uint32_t)span / chunk * chunk;
+}
+
+uint64_t bench_disk_random(uint32_t span, uint32_t chunk) {
+    return BENCH_DISK_FIRST_SECTOR + (uint64_t)(bench_random() % (span / chunk)) * chunk;
+}
+
+void bench_seed(uint32_t seed) {
+    bench_lcg = seed;
+}
+
+uint32_t bench_random(void) {
+    bench_lcg = bench_lcg * 1664525u + 1013904223u;
+    return bench_lcg >> 8;
+}
+
+int bench_ring_fill(bench_ring_t* ring, uint32_t depth) {
+    for (uint32_t i = 0; i < ring->depth; i++) {
+        ring->wait(i);
+    }
+    ring->depth = 0;
+    ring->oldest = 0;
+
+    for (uint32_t i = 0; i < depth; i++) {
+        if (ring->submit(i) != 0) return -1;
+        ring->depth = i + 1;
+    }
+    return 0;
+}
+
+void bench_ring_step(bench_ring_t* ring) {
+    ring->wait(ring->oldest);
+    ring->submit(ring->oldest);
+    ring->oldest = (ring->oldest + 1) % ring->depth;
+}
+
+/* Check if a case name starts with one of the comma-separated prefixes */
+static int bench_selected(const char* name, const char* filter) {
+    if (!filter || !*filter || strcmp(filter, "all") == 0) return 1;
+
+    while (*filter) {
+        size_t length = strcspn(filter, ",");
+        if (length > 0 && strncmp(name, filter, length) == 0) return 1;
+        filter += length;
+        if (*filter == ',') filter++;
+    }
+    return 0;
+}
+
+/* Run one case and write its result line */
+static void bench_run_case(const bench_case_t* bench) {
+    char line[160];
+
+    if (bench->setup && bench->setup() != 0) {
+        snprintf(line, sizeof(line), "{\"bench\":\"%s\",\"skipped\":true}\n", bench->name);
+        serial_write_string(line);
+        return;
+    }
+
+    for (uint32_t i = 0; i < bench->warmup; i++) {
+        bench->body();
+    }
+
+    uint64_t start = tsc_read();
+    for (uint32_t i = 0; i < bench->iterations; i++) {
+        bench->body();
+    }
+    uint64_t cycles = tsc_read() - start;
+
+    /* Per-iteration figures in hundredths, printed as decimals */
+    uint32_t iterations = bench->iterations ? bench->iterations : 1;
+    uint64_t centi_cycles = cycles * 100 / iterations;
+    uint64_t centi_ns = tsc_to_ns(cycles) * 100 / iterations;
+    snprintf(line, sizeof(line),
+             "{\"bench\":\"%s\",\"iterations\":%u,\"cycles\":%llu,"
+             "\"cycles_per_iter\":%llu.%02u,\"ns_per_iter\":%llu.%02u}\n",
+             bench->name, bench->iterations, cycles,
+             centi_cycles / 100, (uint32_t)(centi_cycles % 100),
+             centi_ns / 100, (uint32_t)(centi_ns % 100));
+    serial_write_string(line);
+}
+
+/* Run the registered cases selected by filter */
+size_t bench_run(const char* filter) {
+    char line[128];
+    size_t count = 0;
+
+    snprintf(line, sizeof(line), "{\"bench_start\":true,\"tsc_khz\":%u,\"mem_ops\":\"%s\",\"str_ops\":\"%s\"}\n",
+             tsc_khz(), mem_ops_current()->name, str_ops_current()->name);
+    serial_write_string(line);
+
+    for (size_t t = 0; t < sizeof(bench_tables) / sizeof(bench_tables[0]); t++) {
+        for (const bench_case_t* bench = bench_tables[t]; bench->name; bench++) {
+            if (!bench_selected(bench->name, filter)) continue;
+            bench_run_case(bench);
+            count++;
+        }
+    }
+
+    snprintf(line, sizeof(line), "{\"bench_done\":true,\"count\":%u}\n", count);
+    serial_write_string(line);
+    return count;
+}
@@ -0,0 +1,110 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* In-kernel benchmarks
+ * Only built into the kernel with `make BENCH=1`. The report functions
+ * below print tables through the kernel log; the registered cases are
+ * run headless by `make bench` (see bench_run()).
+ */
+
+/* A registered benchmark case
+ * setup runs once (a nonzero return skips the case), then body runs
+ * warmup times untimed and iterations times between two TSC reads.
+ */
+typedef struct {
+    const char* name;
+    int (*setup)(void);             /* Optional */
+    void (*body)(void);
+    uint32_t iterations;
+    uint32_t warmup;
+} bench_case_t;
+
+/* Case tables of the benchmark files, each ended by a NULL name */
+extern const bench_case_t mem_bench_cases[];
+extern const bench_case_t string_bench_cases[];
+extern const bench_case_t printf_bench_cases[];
+extern const bench_case_t vga_bench_cases[];
+extern const bench_case_t pci_bench_cases[];
+extern const bench_case_t irq_bench_cases[];
+extern const bench_case_t clock_bench_cases[];
+extern const bench_case_t ata_bench_cases[];
+extern const bench_case_t ahci_bench_cases[];
+extern const bench_case_t virtio_blk_bench_cases[];
+extern const bench_case_t block_bench_cases[];
+extern const bench_case_t page_cache_bench_cases[];
+
+/* Disk cases: make bench attaches scratch images and stamps their first
+ * sector with BENCH_DISK_MAGIC (keep it in step with the Makefile); cases
+ * that write refuse any disk without it. Transfers stay inside the first
+ * BENCH_DISK_SPAN_SECTORS after BENCH_DISK_FIRST_SECTOR. */
+#define BENCH_DISK_MAGIC            "VIBEOS BENCH SCRATCH DISK"
+#define BENCH_DISK_FIRST_SECTOR     8
+#define BENCH_DISK_SPAN_SECTORS     (32u * 1024 * 1024 / 512)
+
+/* Get the sectors usable on a disk of sectors, in whole chunks
+ * Returns: a multiple of chunk, 0 if not even one chunk fits */
+uint32_t bench_disk_span(uint64_t sectors, uint32_t chunk);
+
+/* Get a random chunk-aligned sector inside a span from bench_disk_span() */
+uint64_t bench_disk_random(uint32_t span, uint32_t chunk);
+
+/* Pseudo-random numbers, the same sequence after every bench_seed()
+ * (LCG from Numerical Recipes; only the upper 24 bits are returned) */
+void bench_seed(uint32_t seed);
+uint32_t bench_random(void);
+
+/* A ring of requests kept depth deep, for queue depth cases
+ * Each bench_ring_step() waits for the oldest request and submits it
+ * again, so the queue never drains: ns_per_iter is the time per
+ * completed I/O (IOPS = 1e9 / ns_per_iter) and, by Little's law, the
+ * mean latency is depth * ns_per_iter. The driver's submit and wait
+ * take the request's index in the ring.
+ */
+typedef struct {
+    int (*submit)(uint32_t index);  /* Returns: 0 if queued */
+    void (*wait)(uint32_t index);
+    uint32_t depth;                 /* Requests in flight */
+    uint32_t oldest;
+} bench_ring_t;
+
+/* Wait for what the previous case left in the ring, then submit depth requests
+ * Returns: 0 on success, -1 if a submit failed */
+int bench_ring_fill(bench_ring_t* ring, uint32_t depth);
+
+/* Wait for the oldest request and submit it again */
+void bench_ring_step(bench_ring_t* ring);
+
+/* Run the registered cases selected by filter and write one JSON
+ * object per case to COM1:
+ *   {"bench":"memcpy_4k","iterations":20000,"cycles":4123456,
+ *    "cycles_per_iter":206.17,"ns_per_iter":68.72}
+ * filter is a comma-separated list of name prefixes; "all" or an
+ * empty filter selects every case.
+ * Returns: the number of cases run
+ */
+size_t bench_run(const char* filter);
+
+/* Print lines to the VGA console and report lines per second,
+ * once per character (old unbatched path) and once per line */
+void bench_vga_console(void);
+
+/* Print full screens through the framebuffer console and
+ * report characters per second (needs make FBCON=1) */
+void bench_fbcon(void);
+
+/* Sweep memcpy/memset/memcmp sizes from 8 B to 4 MiB and report
+ * GB/s for every implementation this CPU supports */
+void bench_memops(void);
+
+/* Compare integer conversion with the old per-digit loop and
+ * measure snprintf() throughput on a log-style line */
+void bench_printf(void);
+
+/* Check the string functions at every alignment and next to an
+ * unmapped page, then report strlen/strchr/strcmp GB/s per length */
+void bench_strings(void);
+
+#endif /* BENCH_H */
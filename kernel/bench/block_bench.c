@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../block.h"
+
+/* Registered cases against the first block device (whichever disk
+ * registered first): a random 4 KiB read completed by the interrupt in
+ * block_wait() against the same read reaped with block_poll(), which
+ * shows the interrupt's wakeup cost (so the wait case needs a device
+ * with an interrupt), and 64 KiB read as sixteen adjacent 4 KiB
+ * bios with and without a plug around them. Plugged, the bios merge
+ * into one request before the driver sees any of them; the setup
+ * checks that they do. */
+#define BLOCK_BENCH_BIO_SECTORS     8       /* 4 KiB */
+#define BLOCK_BENCH_BATCH           16      /* 64 KiB */
+
+static uint8_t block_bench_buffer[BLOCK_BENCH_BATCH * BLOCK_BENCH_BIO_SECTORS * BLOCK_SECTOR_SIZE]
+    __attribute__((aligned(4096)));
+static block_segment_t block_bench_segments[BLOCK_BENCH_BATCH];
+static bio_t block_bench_bios[BLOCK_BENCH_BATCH];
+static block_device_t* block_bench_device = NULL;
+static uint32_t block_bench_span = 0;   /* Sectors usable, in whole batches */
+
+/* Random batch-aligned offset */
+static uint64_t next_sector(void) {
+    return bench_disk_random(block_bench_span, BLOCK_BENCH_BATCH * BLOCK_BENCH_BIO_SECTORS);
+}
+
+/* Point bio i of a batch at its 4 KiB of the buffer and the disk */
+static void prepare(uint32_t i, uint64_t sector) {
+    block_segment_t* segment = &block_bench_segments[i];
+    segment->addr = block_bench_buffer + i * BLOCK_BENCH_BIO_SECTORS * BLOCK_SECTOR_SIZE;
+    segment->len = BLOCK_BENCH_BIO_SECTORS * BLOCK_SECTOR_SIZE;
+
+    bio_t* bio = &block_bench_bios[i];
+    bio->device = block_bench_device;
+    bio->sector = sector + i * BLOCK_BENCH_BIO_SECTORS;
+    bio->segments = segment;
+    bio->segment_count = 1;
+    bio->write = 0;
+    bio->done = NULL;
+}
+
+/* Submit a batch of count adjacent bios, plugged or not, and wait for all
+ * Returns: 0 on success, -1 on failure */
+static int read_batch(uint32_t count, int plug) {
+    uint64_t sector = next_sector();
+    if (plug) block_plug(block_bench_device);
+    int result = 0;
+    uint32_t submitted = 0;
+    for (; submitted < count; submitted++) {
+        prepare(submitted, sector);
+        if (block_submit(&block_bench_bios[submitted]) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    if (plug) block_unplug(block_bench_device);
+    for (uint32_t i = 0; i < submitted; i++) {
+        if (block_wait(&block_bench_bios[i]) != BIO_DONE) result = -1;
+    }
+    return result;
+}
+
+static int setup_device(void) {
+    block_bench_device = block_get_device(0);
+    block_bench_span = block_bench_device
+                       ? bench_disk_span(block_bench_device->sectors, BLOCK_BENCH_BATCH * BLOCK_BENCH_BIO_SECTORS)
+                       : 0;
+    if (!block_bench_span) return -1;
+    bench_seed(1);
+    return 0;
+}
+
+/* block_wait() only polls a device without an interrupt */
+static int setup_wait(void) {
+    if (setup_device() != 0) return -1;
+    return block_bench_device->polled ? -1 : 0;
+}
+
+/* Also check that a plugged batch really becomes one request */
+static int setup_plugged(void) {
+    if (setup_device() != 0) return -1;
+    if (block_bench_device->max_sectors < BLOCK_BENCH_BATCH * BLOCK_BENCH_BIO_SECTORS) return -1;
+    uint64_t merges = block_bench_device->stats.merges;
+    if (read_batch(BLOCK_BENCH_BATCH, 1) != 0) return -1;
+    return block_bench_device->stats.merges - merges == BLOCK_BENCH_BATCH - 1 ? 0 : -1;
+}
+
+static void run_wait(void) {
+    read_batch(1, 0);
+}
+
+static void run_poll(void) {
+    prepare(0, next_sector());
+    bio_t* bio = &block_bench_bios[0];
+    if (block_submit(bio) != 0) return;
+    while (bio->status == BIO_PENDING) {
+        block_poll(block_bench_device);
+    }
+}
+
+static void run_plugged(void) {
+    read_batch(BLOCK_BENCH_BATCH, 1);
+}
+
+static void run_unplugged(void) {
+    read_batch(BLOCK_BENCH_BATCH, 0);
+}
+
+const bench_case_t block_bench_cases[] = {
+    { "block_read_4k_wait", setup_wait, run_wait, 4000, 64 },
+    { "block_read_4k_poll", setup_device, run_poll, 4000, 64 },
+    { "block_read_64k_plugged", setup_plugged, run_plugged, 1000, 16 },
+    { "block_read_64k_unplugged", setup_device, run_unplugged, 1000, 16 },
+    { NULL, NULL, NULL, 0, 0 }
+};
@@ -0,0 +1,34 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../clocksource.h"
+
+/* Registered cases: one read of each clocksource (the same cost
+ * clocksource_select() ranks them by, measured the bench's way) and
+ * a clock_ns() call on the selected one. Sources the machine does not
+ * have are skipped. */
+static const clocksource_t* bench_clocksource = NULL;
+
+static int setup_source(const char* name) {
+    bench_clocksource = clocksource_find(name);
+    return bench_clocksource ? 0 : -1;
+}
+
+static int setup_tsc(void) { return setup_source("tsc"); }
+static int setup_hpet(void) { return setup_source("hpet"); }
+static int setup_acpi_pm(void) { return setup_source("acpi_pm"); }
+static int setup_pit(void) { return setup_source("pit"); }
+static int setup_clock(void) { return clocksource_current() ? 0 : -1; }
+
+static void run_read(void) { bench_clocksource->read(); }
+static void run_clock_ns(void) { clock_ns(); }
+
+const bench_case_t clock_bench_cases[] = {
+    { "clock_read_tsc", setup_tsc, run_read, 100000, 1000 },
+    { "clock_read_hpet", setup_hpet, run_read, 10000, 100 },
+    { "clock_read_acpi_pm", setup_acpi_pm, run_read, 10000, 100 },
+    { "clock_read_pit", setup_pit, run_read, 10000, 100 },
+    { "clock_ns", setup_clock, run_clock_ns, 10000, 100 },
+    { NULL, NULL, NULL, 0, 0 }
+};
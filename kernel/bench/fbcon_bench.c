@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+#include "../drivers/vga.h"
+#include "../drivers/fbcon.h"
+
+/* Number of full screens printed */
+#define FBCON_BENCH_SCREENS 200
+
+/* One screen row of text */
+static char bench_row[VGA_WIDTH + 1];
+
+/* Print screens of text to the framebuffer console and report
+ * characters per second (run with QEMU -vga std and make FBCON=1) */
+void bench_fbcon(void) {
+    if (!fbcon_active()) {
+        printf("Framebuffer console benchmark skipped: fbcon not active\n");
+        return;
+    }
+
+    /* A full row (VGA_WIDTH - 1 characters and a newline) */
+    for (size_t i = 0; i < VGA_WIDTH - 1; i++) {
+        bench_row[i] = (char)('!' + i % ('~' - '!' + 1));
+    }
+    bench_row[VGA_WIDTH - 1] = '\n';
+    bench_row[VGA_WIDTH] = '\0';
+
+    uint32_t lines = FBCON_BENCH_SCREENS * VGA_HEIGHT;
+    uint64_t start = tsc_read();
+    for (uint32_t line = 0; line < lines; line++) {
+        terminal_write(bench_row);
+    }
+    uint64_t cycles = tsc_read() - start;
+    terminal_clear();
+
+    uint32_t chars = lines * VGA_WIDTH;
+    uint32_t chars_per_second = 0;
+    if (cycles != 0 && tsc_khz() != 0) {
+        chars_per_second = (uint32_t)((uint64_t)chars * tsc_khz() * 1000 / cycles);
+    }
+
+    printf("Framebuffer console benchmark (%u lines of %u chars):\n",
+           lines, VGA_WIDTH);
+    printf("  %u chars/s, %u cycles/char\n",
+           chars_per_second, (uint32_t)(cycles / chars));
+}
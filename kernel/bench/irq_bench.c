@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../arch/x86/pic.h"
+#include "../arch/x86/lapic.h"
+#include "../arch/x86/idt.h"
+
+/* Registered cases: the end-of-interrupt cost of a legacy IRQ on the
+ * master and on the slave PIC (one and two port writes) against the
+ * local APIC's memory-mapped EOI that MSI vectors use, and a dynamic
+ * vector allocation. With nothing in service every EOI is a no-op. */
+static int setup_lapic(void) { return lapic_present() ? 0 : -1; }
+
+static void run_eoi_pic(void) { pic_send_eoi(0); }
+static void run_eoi_pic_slave(void) { pic_send_eoi(8); }
+static void run_eoi_lapic(void) { lapic_eoi(); }
+
+static void run_vector_alloc(void) {
+    int vector = idt_alloc_vectors(4);
+    if (vector >= 0) {
+        idt_free_vectors((uint8_t)vector, 4);
+    }
+}
+
+const bench_case_t irq_bench_cases[] = {
+    { "irq_eoi_pic", NULL, run_eoi_pic, 100000, 1000 },
+    { "irq_eoi_pic_slave", NULL, run_eoi_pic_slave, 100000, 1000 },
+    { "irq_eoi_lapic", setup_lapic, run_eoi_lapic, 100000, 1000 },
+    { "irq_vector_alloc", NULL, run_vector_alloc, 100000, 1000 },
+    { NULL, NULL, NULL, 0, 0 }
+};
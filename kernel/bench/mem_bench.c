@@ -0,0 +1,158 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+#include "../arch/x86/paging.h"
+#include "../arch/x86/memops.h"
+#include "../klog.h"
+
+/* Scratch buffers above the 4 MiB identity map (QEMU gives us 128 MiB) */
+#define MEM_BENCH_BASE      0x00800000
+#define MEM_BENCH_MAX_SIZE  (4 * 1024 * 1024)
+#define MEM_BENCH_MIN_SIZE  8
+
+/* Bytes processed per measurement, so small sizes get enough iterations */
+#define MEM_BENCH_BYTES     (16 * 1024 * 1024)
+
+/* Operations being measured */
+typedef enum {
+    MEM_BENCH_COPY,
+    MEM_BENCH_SET,
+    MEM_BENCH_COMPARE
+} mem_bench_op_t;
+
+static const char* const op_names[] = { "memcpy", "memset", "memcmp" };
+
+static uint8_t* bench_src;
+static uint8_t* bench_dst;
+
+/* Run one operation iterations times and return the elapsed cycles */
+static uint64_t run_op(const mem_ops_t* ops, mem_bench_op_t op, size_t size, uint32_t iterations) {
+    volatile int sink = 0;
+    uint64_t start = tsc_read();
+    for (uint32_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case MEM_BENCH_COPY:    ops->copy(bench_dst, bench_src, size); break;
+            case MEM_BENCH_SET:     ops->set(bench_dst, (int)i, size); break;
+            case MEM_BENCH_COMPARE: sink += ops->compare(bench_dst, bench_src, size); break;
+        }
+    }
+    (void)sink;
+    return tsc_read() - start;
+}
+
+/* Check a variant against the portable version for one size */
+static int check_op(const mem_ops_t* ops, mem_bench_op_t op, size_t size) {
+    switch (op) {
+        case MEM_BENCH_COPY:
+            memset_generic(bench_dst, 0, size + 1);
+            ops->copy(bench_dst, bench_src, size);
+            return memcmp_generic(bench_dst, bench_src, size) == 0 && bench_dst[size] == 0;
+        case MEM_BENCH_SET:
+            memset_generic(bench_dst, 0, size + 1);
+            ops->set(bench_dst, 0xA5, size);
+            return bench_dst[0] == 0xA5 && bench_dst[size - 1] == 0xA5 && bench_dst[size] == 0;
+        case MEM_BENCH_COMPARE:
+            memcpy_generic(bench_dst, bench_src, size);
+            if (ops->compare(bench_dst, bench_src, size) != 0) return 0;
+            bench_dst[size - 1]++;
+            return (ops->compare(bench_dst, bench_src, size) > 0) ==
+                   (memcmp_generic(bench_dst, bench_src, size) > 0);
+    }
+    return 0;
+}
+
+/* Print one size row of a table: GB/s for every variant */
+static void bench_row(mem_bench_op_t op, size_t size) {
+    char line[128];
+    size_t length = snprintf(line, sizeof(line), "  %7u", size);
+    uint32_t iterations = MEM_BENCH_BYTES / size;
+    if (iterations < 4) iterations = 4;
+
+    const mem_ops_t* ops;
+    for (size_t v = 0; (ops = memops_variant(v)) != NULL; v++) {
+        if (!check_op(ops, op, size)) {
+            length += snprintf(line + length, sizeof(line) - length, "  %9s", "BAD");
+            continue;
+        }
+
+        /* Equal buffers make memcmp scan the whole size; warm up once */
+        memcpy_generic(bench_dst, bench_src, size);
+        run_op(ops, op, size, 1);
+        uint64_t cycles = run_op(ops, op, size, iterations);
+
+        /* Hundredths of GB/s */
+        uint64_t bytes = (uint64_t)size * iterations;
+        uint32_t centi_gbps = cycles ? (uint32_t)(bytes * tsc_khz() / (cycles * 10000)) : 0;
+        length += snprintf(line + length, sizeof(line) - length, "  %6u.%02u",
+                           centi_gbps / 100, centi_gbps % 100);
+    }
+    printf("%s\n", line);
+}
+
+/* Map and fill the scratch buffers
+ * Returns: 0 on success, -1 if they cannot be mapped */
+static int setup_buffers(void) {
+    if (paging_map_region(MEM_BENCH_BASE, 2 * MEM_BENCH_MAX_SIZE + 8192, 0) != 0) {
+        return -1;
+    }
+    bench_src = (uint8_t*)MEM_BENCH_BASE;
+    bench_dst = bench_src + MEM_BENCH_MAX_SIZE + 4096;
+    for (size_t i = 0; i < MEM_BENCH_MAX_SIZE; i++) {
+        bench_src[i] = (uint8_t)(i * 131 + 7);
+    }
+    return 0;
+}
+
+/* Sweep sizes from 8 B to 4 MiB for memcpy, memset and memcmp,
+ * reporting GB/s for every implementation usable on this CPU */
+void bench_memops(void) {
+    if (setup_buffers() != 0) {
+        printf("Memory benchmark skipped: cannot map scratch buffers\n");
+        return;
+    }
+
+    for (int op = MEM_BENCH_COPY; op <= MEM_BENCH_COMPARE; op++) {
+        char header[128];
+        size_t length = snprintf(header, sizeof(header), "%s GB/s:\n     size", op_names[op]);
+        const mem_ops_t* ops;
+        for (size_t v = 0; (ops = memops_variant(v)) != NULL; v++) {
+            length += snprintf(header + length, sizeof(header) - length, "  %9s", ops->name);
+        }
+        printf("%s\n", header);
+
+        for (size_t size = MEM_BENCH_MIN_SIZE; size <= MEM_BENCH_MAX_SIZE; size *= 2) {
+            bench_row((mem_bench_op_t)op, size);
+            klog_drain();
+        }
+    }
+}
+
+/* Registered cases: the installed memcpy()/memset()/memcmp() */
+static int setup_equal_buffers(void) {
+    if (setup_buffers() != 0) return -1;
+    memcpy(bench_dst, bench_src, MEM_BENCH_MAX_SIZE);
+    return 0;
+}
+
+static void run_memcpy_64(void) { memcpy(bench_dst, bench_src, 64); }
+static void run_memcpy_4k(void) { memcpy(bench_dst, bench_src, 4096); }
+static void run_memcpy_1m(void) { memcpy(bench_dst, bench_src, 1024 * 1024); }
+static void run_memset_64(void) { memset(bench_dst, 0x5A, 64); }
+static void run_memset_4k(void) { memset(bench_dst, 0x5A, 4096); }
+static void run_memset_1m(void) { memset(bench_dst, 0x5A, 1024 * 1024); }
+static void run_memcmp_4k(void) { memcmp(bench_dst, bench_src, 4096); }
+
+const bench_case_t mem_bench_cases[] = {
+    { "memcpy_64", setup_buffers, run_memcpy_64, 200000, 1000 },
+    { "memcpy_4k", setup_buffers, run_memcpy_4k, 20000, 100 },
+    { "memcpy_1m", setup_buffers, run_memcpy_1m, 100, 2 },
+    { "memset_64", setup_buffers, run_memset_64, 200000, 1000 },
+    { "memset_4k", setup_buffers, run_memset_4k, 20000, 100 },
+    { "memset_1m", setup_buffers, run_memset_1m, 100, 2 },
+    { "memcmp_4k", setup_equal_buffers, run_memcmp_4k, 20000, 100 },
+    { NULL, NULL, NULL, 0, 0 }
+};
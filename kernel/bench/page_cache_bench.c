@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../page_cache.h"
+
+/* Registered cases against the whole of the first block device: a 4 KiB
+ * read served from a resident working set, a 4 KiB read of a page the
+ * cache has not seen (the disk read plus the insertion, to hold against
+ * block_read_4k_wait; the span is smaller than the cache and is
+ * forgotten whenever it wraps, so no eviction is counted), and 4 KiB
+ * whole-page writes with the dirty pages synced every 64, so the
+ * writeback cost is spread over the pages of one plugged batch. Page 0
+ * holds the scratch disk's magic and is left alone; the writes refuse a
+ * disk without it. */
+#define PC_BENCH_FIRST_PAGE     (BENCH_DISK_FIRST_SECTOR / PAGE_CACHE_PAGE_SECTORS)
+#define PC_BENCH_SPAN_PAGES     (32u * 1024 * 1024 / PAGE_CACHE_PAGE_SIZE)
+#define PC_BENCH_HOT_PAGES      64
+#define PC_BENCH_SYNC_PAGES     64
+
+static uint8_t pc_bench_buffer[PAGE_CACHE_PAGE_SIZE] __attribute__((aligned(4096)));
+static page_mapping_t* pc_bench_mapping = NULL;
+static uint32_t pc_bench_span = 0;      /* Pages usable */
+static uint32_t pc_bench_next = 0;
+
+static int setup_mapping(void) {
+    pc_bench_mapping = page_cache_device(block_get_device(0));
+    if (!pc_bench_mapping || page_cache_capacity() < PC_BENCH_HOT_PAGES) return -1;
+    uint64_t pages = pc_bench_mapping->size / PAGE_CACHE_PAGE_SIZE;
+    if (pages < PC_BENCH_FIRST_PAGE + PC_BENCH_HOT_PAGES) return -1;
+    pages -= PC_BENCH_FIRST_PAGE;
+    pc_bench_span = pages > PC_BENCH_SPAN_PAGES ? PC_BENCH_SPAN_PAGES : (uint32_t)pages;
+    pc_bench_next = 0;
+    return 0;
+}
+
+static uint64_t page_offset(uint32_t page) {
+    return (uint64_t)(PC_BENCH_FIRST_PAGE + page) * PAGE_CACHE_PAGE_SIZE;
+}
+
+/* Read the hot set in, then check that reading it again hits */
+static int setup_hot(void) {
+    if (setup_mapping() != 0) return -1;
+    for (uint32_t i = 0; i < PC_BENCH_HOT_PAGES; i++) {
+        if (page_cache_read(pc_bench_mapping, page_offset(i), pc_bench_buffer, PAGE_CACHE_PAGE_SIZE) < 0) {
+            return -1;
+        }
+    }
+    uint64_t hits = page_cache_get_stats()->hits;
+    page_cache_read(pc_bench_mapping, page_offset(0), pc_bench_buffer, PAGE_CACHE_PAGE_SIZE);
+    return page_cache_get_stats()->hits == hits + 1 ? 0 : -1;
+}
+
+/* Only write to the scratch disk */
+static int setup_write(void) {
+    if (setup_mapping() != 0 ||
+        page_cache_read(pc_bench_mapping, 0, pc_bench_buffer, PAGE_CACHE_PAGE_SIZE) != PAGE_CACHE_PAGE_SIZE) {
+        return -1;
+    }
+    return memcmp(pc_bench_buffer, BENCH_DISK_MAGIC, sizeof(BENCH_DISK_MAGIC) - 1) == 0 ? 0 : -1;
+}
+
+/* Start from an empty cache so every page read misses */
+static int setup_cold(void) {
+    if (setup_mapping() != 0) return -1;
+    page_cache_sync(pc_bench_mapping);
+    page_cache_invalidate(pc_bench_mapping);
+    return 0;
+}
+
+static void run_hot(void) {
+    page_cache_read(pc_bench_mapping, page_offset(pc_bench_next), pc_bench_buffer, PAGE_CACHE_PAGE_SIZE);
+    pc_bench_next = (pc_bench_next + 1) % PC_BENCH_HOT_PAGES;
+}
+
+static void run_cold(void) {
+    page_cache_read(pc_bench_mapping, page_offset(pc_bench_next), pc_bench_buffer, PAGE_CACHE_PAGE_SIZE);
+    if (++pc_bench_next == pc_bench_span) {
+        /* Wrapped: forget the span so it misses again */
+        pc_bench_next = 0;
+        page_cache_invalidate(pc_bench_mapping);
+    }
+}
+
+static void run_write(void) {
+    pc_bench_buffer[0] = (uint8_t)pc_bench_next;
+    page_cache_write(pc_bench_mapping, page_offset(pc_bench_next), pc_bench_buffer, PAGE_CACHE_PAGE_SIZE);
+    pc_bench_next = (pc_bench_next + 1) % pc_bench_span;
+    if (pc_bench_next % PC_BENCH_SYNC_PAGES == 0) {
+        page_cache_sync(pc_bench_mapping);
+    }
+}
+
+const bench_case_t page_cache_bench_cases[] = {
+    { "page_cache_read_4k_hit", setup_hot, run_hot, 20000, 256 },
+    { "page_cache_read_4k_miss", setup_cold, run_cold, 4000, 64 },
+    { "page_cache_write_4k_sync64", setup_write, run_write, 4096, 64 },
+    { NULL, NULL, NULL, 0, 0 }
+};
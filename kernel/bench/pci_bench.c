@@ -0,0 +1,41 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../drivers/pci.h"
+#include "../drivers/pci_db.h"
+#include "../drivers/pci_driver.h"
+
+/* Registered cases: a full hierarchy rescan (BARs keep the sizes from
+ * the first scan); a vendor/device lookup that misses the cached table;
+ * one config read (QEMU_MACHINE=q35 has ECAM); the PCI ID database
+ * lookups of one listing line; and every function matched against the
+ * driver index. */
+static void run_pci_scan(void) { pci_scan(); }
+static void run_pci_lookup(void) { pci_lookup(0xFFFF, 0xFFFF); }
+
+/* One config read, through ECAM or ports 0xCF8/0xCFC */
+static void run_pci_config_read(void) { pci_read_config_dword(0, 0, 0, PCI_VENDOR_ID_OFFSET); }
+
+/* Names for the PIIX3 IDE controller, as printed by the device listing */
+static void run_pci_names(void) {
+    pci_vendor_name(0x8086);
+    pci_device_name(0x8086, 0x7010);
+    pci_class_name(0x01, 0x01);
+}
+
+static void run_pci_match(void) {
+    size_t count = pci_device_count();
+    for (size_t i = 0; i < count; i++) {
+        pci_driver_match(pci_get_device(i), NULL);
+    }
+}
+
+const bench_case_t pci_bench_cases[] = {
+    { "pci_scan", NULL, run_pci_scan, 50, 2 },
+    { "pci_lookup", NULL, run_pci_lookup, 100000, 1000 },
+    { "pci_config_read", NULL, run_pci_config_read, 100000, 1000 },
+    { "pci_names", NULL, run_pci_names, 100000, 1000 },
+    { "pci_match", NULL, run_pci_match, 10000, 100 },
+    { NULL, NULL, NULL, 0, 0 }
+};
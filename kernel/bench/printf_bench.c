@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+
+/* Number of conversions per measurement */
+#define PRINTF_BENCH_ITERATIONS 200000
+
+/* The previous utoa(): one division per digit, then a reversal pass */
+static size_t legacy_utoa(uint32_t value, char* str, int base) {
+    size_t i = 0;
+    if (value == 0) {
+        str[i++] = '0';
+        str[i] = '\0';
+        return i;
+    }
+    while (value != 0) {
+        int remainder = value % base;
+        str[i++] = (remainder < 10) ? remainder + '0' : remainder + 'a' - 10;
+        value /= base;
+    }
+    str[i] = '\0';
+    reverse_str(str, &str[i - 1]);
+    return i;
+}
+
+/* Spread values over all digit counts */
+static uint32_t bench_value(uint32_t i) {
+    return (i * 2654435761u) >> (i & 31);
+}
+
+/* Convert a cycle count to operations per second */
+static uint32_t ops_per_second(uint32_t ops, uint64_t cycles) {
+    if (cycles == 0 || tsc_khz() == 0) return 0;
+    return (uint32_t)((uint64_t)ops * tsc_khz() * 1000 / cycles);
+}
+
+/* Time PRINTF_BENCH_ITERATIONS conversions with one utoa-style function */
+static uint64_t time_conversion(size_t (*convert)(uint32_t, char*, int), int base) {
+    char buffer[16];
+    uint64_t start = tsc_read();
+    for (uint32_t i = 0; i < PRINTF_BENCH_ITERATIONS; i++) {
+        convert(bench_value(i), buffer, base);
+    }
+    return tsc_read() - start;
+}
+
+/* Compare the digit-pair/hex conversions with the old per-digit loop,
+ * and measure snprintf() on a typical log line with 64-bit values */
+void bench_printf(void) {
+    char line[128];
+
+    /* Both implementations must agree before timing them */
+    for (uint32_t i = 0; i < 1000; i++) {
+        char expected[16], actual[16];
+        for (int base = 10; base <= 16; base += 6) {
+            legacy_utoa(bench_value(i), expected, base);
+            utoa(bench_value(i), actual, base);
+            if (strcmp(expected, actual) != 0) {
+                printf("printf benchmark: utoa(%u, %d) gave %s, expected %s\n",
+                       bench_value(i), base, actual, expected);
+                return;
+            }
+        }
+    }
+
+    uint64_t old_dec = time_conversion(legacy_utoa, 10);
+    uint64_t new_dec = time_conversion(utoa, 10);
+    uint64_t old_hex = time_conversion(legacy_utoa, 16);
+    uint64_t new_hex = time_conversion(utoa, 16);
+
+    uint64_t start = tsc_read();
+    for (uint32_t i = 0; i < PRINTF_BENCH_ITERATIONS; i++) {
+        uint64_t timestamp = tsc_read();
+        snprintf(line, sizeof(line), "[%5u.%06u] cpu%u %-6s tsc=%llu (%#llx) len=%zu\n",
+                 i / 1000, (i % 1000) * 1000, 0, "info", timestamp, timestamp, sizeof(line));
+    }
+    uint64_t log_lines = tsc_read() - start;
+
+    printf("Integer formatting benchmark (%u conversions each):\n", PRINTF_BENCH_ITERATIONS);
+    printf("  decimal: old %u/s, new %u/s\n",
+           ops_per_second(PRINTF_BENCH_ITERATIONS, old_dec),
+           ops_per_second(PRINTF_BENCH_ITERATIONS, new_dec));
+    printf("  hex:     old %u/s, new %u/s\n",
+           ops_per_second(PRINTF_BENCH_ITERATIONS, old_hex),
+           ops_per_second(PRINTF_BENCH_ITERATIONS, new_hex));
+    printf("  snprintf log line with 64-bit TSC: %u lines/s\n",
+           ops_per_second(PRINTF_BENCH_ITERATIONS, log_lines));
+}
+
+/* Registered cases: conversions and a log line through snprintf() */
+static char case_buffer[128];
+static uint32_t case_counter;
+
+static void run_utoa_dec(void) { utoa(bench_value(case_counter++), case_buffer, 10); }
+static void run_utoa_hex(void) { utoa(bench_value(case_counter++), case_buffer, 16); }
+
+static void run_snprintf_log(void) {
+    uint32_t i = case_counter++;
+    uint64_t timestamp = (uint64_t)bench_value(i) << 12;
+    snprintf(case_buffer, sizeof(case_buffer), "[%5u.%06u] cpu%u %-6s tsc=%llu (%#llx) len=%zu\n",
+             i / 1000, (i % 1000) * 1000, 0, "info", timestamp, timestamp, sizeof(case_buffer));
+}
+
+const bench_case_t printf_bench_cases[] = {
+    { "utoa_dec", NULL, run_utoa_dec, 200000, 1000 },
+    { "utoa_hex", NULL, run_utoa_hex, 200000, 1000 },
+    { "snprintf_log", NULL, run_snprintf_log, 100000, 1000 },
+    { NULL, NULL, NULL, 0, 0 }
+};
@@ -0,0 +1,308 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+#include "../arch/x86/paging.h"
+#include "../arch/x86/memops.h"
+#include "../klog.h"
+
+/* Scratch area: one 4 MiB page above the memory benchmark's buffers.
+ * Nothing maps the 4 MiB after it, so a string ending at the top of
+ * the area is followed by an unmapped page and any read past the
+ * terminator into it faults. */
+#define STR_BENCH_BASE      0x01800000
+#define STR_BENCH_AREA      (4 * 1024 * 1024)
+#define STR_BENCH_MAX_LEN   16384
+
+/* Bytes scanned per measurement, so short strings get enough calls */
+#define STR_BENCH_BYTES     (8 * 1024 * 1024)
+
+/* Lengths covered by the correctness checks */
+#define STR_CHECK_MAX_LEN   80
+
+/* Operations being measured */
+typedef enum {
+    STR_BENCH_LENGTH,
+    STR_BENCH_FIND,
+    STR_BENCH_COMPARE
+} str_bench_op_t;
+
+static const char* const op_names[] = { "strlen", "strchr", "strcmp" };
+
+/* The previous byte-at-a-time routines, as the baseline */
+static size_t legacy_strlen(const char* str) {
+    const char* s = str;
+    while (*s) s++;
+    return s - str;
+}
+
+static size_t legacy_strnlen(const char* str, size_t maxlen) {
+    const char* s = str;
+    while (maxlen > 0 && *s) {
+        s++;
+        maxlen--;
+    }
+    return s - str;
+}
+
+static char* legacy_strchr(const char* str, int c) {
+    const unsigned char ch = (unsigned char)c;
+    const unsigned char* s = (const unsigned char*)str;
+    while (*s != ch) {
+        if (!*s) return NULL;
+        s++;
+    }
+    return (char*)s;
+}
+
+static char* legacy_strrchr(const char* str, int c) {
+    const unsigned char ch = (unsigned char)c;
+    const unsigned char* s = (const unsigned char*)str;
+    const unsigned char* last = NULL;
+    while (*s) {
+        if (*s == ch) last = s;
+        s++;
+    }
+    if (*s == ch) last = s;
+    return (char*)last;
+}
+
+static int legacy_strcmp(const char* s1, const char* s2) {
+    const unsigned char* p1 = (const unsigned char*)s1;
+    const unsigned char* p2 = (const unsigned char*)s2;
+    while (*p1 && *p1 == *p2) {
+        p1++;
+        p2++;
+    }
+    return *p1 - *p2;
+}
+
+static size_t legacy_strspn(const char* str, const char* accept) {
+    const char* s = str;
+    for (; *s; s++) {
+        const char* a = accept;
+        while (*a && *a != *s) a++;
+        if (!*a) break;
+    }
+    return s - str;
+}
+
+static size_t legacy_strcspn(const char* str, const char* reject) {
+    const char* s = str;
+    for (; *s; s++) {
+        const char* r = reject;
+        while (*r && *r != *s) r++;
+        if (*r) break;
+    }
+    return s - str;
+}
+
+static const str_ops_t str_ops_bytewise = {
+    "bytewise", legacy_strlen, legacy_strnlen, legacy_strchr, legacy_strrchr,
+    legacy_strcmp, legacy_strspn, legacy_strcspn
+};
+
+/* Baseline first, then every set usable on this CPU */
+static const str_ops_t* bench_variant(size_t index) {
+    if (index == 0) return &str_ops_bytewise;
+    return strops_variant(index - 1);
+}
+
+static char* bench_str;
+static char* bench_other;
+
+static int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+/* Fill len bytes of varied text (including bytes >= 0x80) and terminate */
+static void fill_string(char* str, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint8_t byte = 'a' + (seed >> 16) % 4;
+        if (((seed >> 8) & 7) == 0) byte |= 0x80;
+        str[i] = (char)byte;
+    }
+    str[len] = '\0';
+}
+
+/* Check every function of a set against the baseline on one string;
+ * other is a scratch copy placed wherever the caller wants */
+static int check_string(const str_ops_t* ops, const char* str, char* other) {
+    const str_ops_t* ref = &str_ops_bytewise;
+    size_t len = ref->length(str);
+
+    if (ops->length(str) != len) return 0;
+    for (size_t max = 0; max <= len + 1; max++) {
+        if (ops->length_max(str, max) != ref->length_max(str, max)) return 0;
+    }
+    if (ops->length_max(str, (size_t)-1) != len) return 0;
+
+    static const int chars[] = { 'a', 'b', 'd', 'z', 0xE1, 0x100 + 'c', 0 };
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); i++) {
+        if (ops->find(str, chars[i]) != ref->find(str, chars[i])) return 0;
+        if (ops->find_last(str, chars[i]) != ref->find_last(str, chars[i])) return 0;
+    }
+    if (ops->span(str, "ab") != ref->span(str, "ab")) return 0;
+    if (ops->complement_span(str, "d\xE3") != ref->complement_span(str, "d\xE3")) return 0;
+    if (ops->complement_span(str, "c") != ref->complement_span(str, "c")) return 0;
+
+    /* Equal, then differing at one position, then cut short there */
+    memcpy_generic(other, str, len + 1);
+    if (ops->compare(str, other) != 0) return 0;
+    if (len > 0) {
+        size_t pos = len / 2;
+        char saved = other[pos];
+        other[pos] = (char)(saved + 0x61);
+        if (sign(ops->compare(str, other)) != sign(ref->compare(str, other))) return 0;
+        if (sign(ops->compare(other, str)) != sign(ref->compare(other, str))) return 0;
+        other[pos] = '\0';
+        if (sign(ops->compare(str, other)) != sign(ref->compare(str, other))) return 0;
+        if (sign(ops->compare(other, str)) != sign(ref->compare(other, str))) return 0;
+        other[pos] = saved;
+    }
+    return 1;
+}
+
+/* Check a set at every start alignment, and with strings (and the
+ * strcmp operand) ending right below the unmapped page, at every
+ * offset within the last page */
+static int check_variant(const str_ops_t* ops) {
+    char* top = (char*)STR_BENCH_BASE + STR_BENCH_AREA;
+
+    for (size_t len = 0; len <= STR_CHECK_MAX_LEN; len++) {
+        for (size_t align = 0; align < 16; align++) {
+            char* str = bench_str + align;
+            fill_string(str, len, len * 16 + align);
+            if (!check_string(ops, str, bench_other + (15 - align))) return 0;
+        }
+
+        /* Terminator in the last byte before the unmapped page */
+        char* str = top - len - 1;
+        fill_string(str, len, len);
+        if (!check_string(ops, str, bench_other + len % 16)) return 0;
+        memcpy_generic(bench_str + 1, str, len + 1);
+        if (!check_string(ops, bench_str + 1, str)) return 0;
+    }
+
+    /* Longer strings starting at each offset of the last page */
+    for (size_t offset = 0; offset < PAGE_SIZE; offset += 61) {
+        char* str = top - PAGE_SIZE + offset;
+        fill_string(str, PAGE_SIZE - offset - 1, offset);
+        if (!check_string(ops, str, bench_other + offset % 16)) return 0;
+    }
+    return 1;
+}
+
+/* Run one operation iterations times and return the elapsed cycles */
+static uint64_t run_op(const str_ops_t* ops, str_bench_op_t op, uint32_t iterations) {
+    volatile size_t sink = 0;
+    uint64_t start = tsc_read();
+    for (uint32_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case STR_BENCH_LENGTH:  sink += ops->length(bench_str); break;
+            case STR_BENCH_FIND:    sink += (size_t)ops->find(bench_str, 'z'); break;
+            case STR_BENCH_COMPARE: sink += ops->compare(bench_str, bench_other); break;
+        }
+    }
+    (void)sink;
+    return tsc_read() - start;
+}
+
+/* Print one length row of a table: GB/s for every variant */
+static void bench_row(str_bench_op_t op, size_t len) {
+    char line[128];
+    size_t length = snprintf(line, sizeof(line), "  %7u", len);
+    uint32_t iterations = STR_BENCH_BYTES / len;
+
+    /* No 'z' in the string: strchr scans to the terminator;
+     * the copy is misaligned so strcmp loads straddle words */
+    fill_string(bench_str, len, len);
+    memcpy_generic(bench_other, bench_str, len + 1);
+
+    const str_ops_t* ops;
+    for (size_t v = 0; (ops = bench_variant(v)) != NULL; v++) {
+        run_op(ops, op, 1);
+        uint64_t cycles = run_op(ops, op, iterations);
+
+        /* Hundredths of GB/s */
+        uint64_t bytes = (uint64_t)len * iterations;
+        uint32_t centi_gbps = cycles ? (uint32_t)(bytes * tsc_khz() / (cycles * 10000)) : 0;
+        length += snprintf(line + length, sizeof(line) - length, "  %6u.%02u",
+                           centi_gbps / 100, centi_gbps % 100);
+    }
+    printf("%s\n", line);
+}
+
+/* Map the scratch area
+ * Returns: 0 on success, -1 if it cannot be mapped */
+static int setup_area(void) {
+    if (paging_map_region(STR_BENCH_BASE, STR_BENCH_AREA, 0) != 0) {
+        return -1;
+    }
+    bench_str = (char*)STR_BENCH_BASE;
+    bench_other = bench_str + STR_BENCH_MAX_LEN + 4096 + 1;
+    return 0;
+}
+
+/* Check the string functions at every alignment and next to an
+ * unmapped page, then report GB/s per string length */
+void bench_strings(void) {
+    if (setup_area() != 0) {
+        printf("String benchmark skipped: cannot map scratch area\n");
+        return;
+    }
+
+    const str_ops_t* ops;
+    for (size_t v = 1; (ops = bench_variant(v)) != NULL; v++) {
+        printf("String functions %s: %s\n", ops->name, check_variant(ops) ? "OK" : "BAD");
+    }
+    klog_drain();
+
+    for (int op = STR_BENCH_LENGTH; op <= STR_BENCH_COMPARE; op++) {
+        char header[128];
+        size_t length = snprintf(header, sizeof(header), "%s GB/s:\n   length", op_names[op]);
+        for (size_t v = 0; (ops = bench_variant(v)) != NULL; v++) {
+            length += snprintf(header + length, sizeof(header) - length, "  %9s", ops->name);
+        }
+        printf("%s\n", header);
+
+        for (size_t len = 1; len <= STR_BENCH_MAX_LEN; len *= 4) {
+            bench_row((str_bench_op_t)op, len);
+            klog_drain();
+        }
+    }
+}
+
+/* Registered cases: the installed functions on a 64 byte and a
+ * 4 KiB string, with a misaligned equal copy for strcmp() */
+static int setup_short(void) {
+    if (setup_area() != 0) return -1;
+    fill_string(bench_str, 64, 64);
+    memcpy(bench_other, bench_str, 65);
+    return 0;
+}
+
+static int setup_long(void) {
+    if (setup_area() != 0) return -1;
+    fill_string(bench_str, 4096, 4096);
+    memcpy(bench_other, bench_str, 4097);
+    return 0;
+}
+
+static void run_strlen(void) { strlen(bench_str); }
+static void run_strchr(void) { strchr(bench_str, 'z'); }
+static void run_strcmp(void) { strcmp(bench_str, bench_other); }
+
+const bench_case_t string_bench_cases[] = {
+    { "strlen_64", setup_short, run_strlen, 200000, 1000 },
+    { "strlen_4k", setup_long, run_strlen, 20000, 100 },
+    { "strchr_64", setup_short, run_strchr, 200000, 1000 },
+    { "strchr_4k", setup_long, run_strchr, 20000, 100 },
+    { "strcmp_64", setup_short, run_strcmp, 200000, 1000 },
+    { "strcmp_4k", setup_long, run_strcmp, 20000, 100 },
+    { NULL, NULL, NULL, 0, 0 }
+};
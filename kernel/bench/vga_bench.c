@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "../arch/x86/tsc.h"
+#include "../drivers/vga.h"
+
+/* Number of lines printed by each variant */
+#define VGA_BENCH_LINES 100000
+
+/* A typical log-sized line */
+static const char bench_line[] =
+    "vga bench: the quick brown fox jumps over the lazy dog 0123456789\n";
+
+/* Convert a line count and elapsed TSC cycles to lines per second */
+static uint32_t lines_per_second(uint32_t lines, uint64_t cycles) {
+    if (cycles == 0 || tsc_khz() == 0) return 0;
+    return (uint32_t)((uint64_t)lines * tsc_khz() * 1000 / cycles);
+}
+
+/* One character per call: every byte flushes its row and moves the
+ * hardware cursor, which is what every byte used to cost */
+static uint64_t bench_per_char(void) {
+    uint64_t start = tsc_read();
+    for (uint32_t line = 0; line < VGA_BENCH_LINES; line++) {
+        for (const char* c = bench_line; *c; c++) {
+            terminal_putchar(*c);
+        }
+    }
+    return tsc_read() - start;
+}
+
+/* One terminal_write() per line: rows are flushed and the cursor
+ * is moved once per call */
+static uint64_t bench_per_line(void) {
+    uint64_t start = tsc_read();
+    for (uint32_t line = 0; line < VGA_BENCH_LINES; line++) {
+        terminal_write(bench_line);
+    }
+    return tsc_read() - start;
+}
+
+/* Print lines to the VGA console and report lines per second */
+void bench_vga_console(void) {
+    uint64_t per_char = bench_per_char();
+    uint64_t per_line = bench_per_line();
+    terminal_clear();
+
+    printf("VGA console benchmark (%u lines of %u chars):\n",
+           VGA_BENCH_LINES, sizeof(bench_line) - 1);
+    printf("  per character (unbatched): %u lines/s\n",
+           lines_per_second(VGA_BENCH_LINES, per_char));
+    printf("  per line (batched flush):  %u lines/s\n",
+           lines_per_second(VGA_BENCH_LINES, per_line));
+}
+
+/* Registered case: one log-sized line through the console */
+static void run_vga_line(void) {
+    terminal_write(bench_line);
+}
+
+const bench_case_t vga_bench_cases[] = {
+    { "vga_line", NULL, run_vga_line, 20000, 100 },
+    { NULL, NULL, NULL, 0, 0 }
+};
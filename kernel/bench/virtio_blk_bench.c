@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bench.h"
+#include "../drivers/virtio_blk.h"
+
+/* Registered cases, modelled on fio jobs against disk 0: random 4 KiB
+ * reads at iodepth 1 and 32, sequential 1 MiB reads at iodepth 4, each
+ * kept at depth by a bench_ring_t (bandwidth is request bytes over
+ * ns_per_iter). make bench attaches a scratch image as a virtio-blk-pci
+ * device for these. */
+#define VBLK_BENCH_RAND_SECTORS 8       /* 4 KiB */
+#define VBLK_BENCH_SEQ_SECTORS  2048    /* 1 MiB */
+#define VBLK_BENCH_MAX_DEPTH    32
+
+/* Random reads each get their own 4 KiB of the buffer; the sequential
+ * ones all land in the whole of it, which is fine for reads */
+static uint8_t vblk_bench_buffer[VBLK_BENCH_SEQ_SECTORS * VIRTIO_BLK_SECTOR_SIZE] __attribute__((aligned(4096)));
+static virtio_blk_request_t vblk_bench_requests[VBLK_BENCH_MAX_DEPTH];
+static uint32_t vblk_bench_sectors = 0; /* Per request */
+static uint32_t vblk_bench_span = 0;    /* Sectors usable, a multiple of VBLK_BENCH_SEQ_SECTORS */
+static uint32_t vblk_bench_next = 0;    /* Next sequential offset */
+
+/* Next offset: sequential wrapping at the end of the span, or a random aligned chunk */
+static uint64_t next_lba(void) {
+    if (vblk_bench_sectors == VBLK_BENCH_SEQ_SECTORS) {
+        uint64_t lba = BENCH_DISK_FIRST_SECTOR + vblk_bench_next;
+        vblk_bench_next = (vblk_bench_next + VBLK_BENCH_SEQ_SECTORS) % vblk_bench_span;
+        return lba;
+    }
+    return bench_disk_random(vblk_bench_span, vblk_bench_sectors);
+}
+
+static int submit(uint32_t index) {
+    virtio_blk_request_t* request = &vblk_bench_requests[index];
+    request->disk = 0;
+    request->lba = next_lba();
+    request->count = vblk_bench_sectors;
+    request->buffer = vblk_bench_sectors == VBLK_BENCH_SEQ_SECTORS
+                      ? vblk_bench_buffer
+                      : vblk_bench_buffer + index * VBLK_BENCH_RAND_SECTORS * VIRTIO_BLK_SECTOR_SIZE;
+    request->write = 0;
+    request->done = NULL;
+    return virtio_blk_submit(request);
+}
+
+static void wait(uint32_t index) {
+    virtio_blk_wait(&vblk_bench_requests[index]);
+}
+
+static bench_ring_t vblk_bench_ring = { submit, wait, 0, 0 };
+
+static int setup_ring(uint32_t depth, uint32_t sectors) {
+    const virtio_blk_disk_t* disk = virtio_blk_get_disk(0);
+    vblk_bench_span = disk ? bench_disk_span(disk->sectors, VBLK_BENCH_SEQ_SECTORS) : 0;
+    if (!vblk_bench_span) return -1;
+    vblk_bench_sectors = sectors;
+    vblk_bench_next = 0;
+    bench_seed(1);
+    return bench_ring_fill(&vblk_bench_ring, depth);
+}
+
+static int setup_rand_qd1(void) {
+    return setup_ring(1, VBLK_BENCH_RAND_SECTORS);
+}
+
+static int setup_rand_qd32(void) {
+    return setup_ring(32, VBLK_BENCH_RAND_SECTORS);
+}
+
+static int setup_seq_qd4(void) {
+    return setup_ring(4, VBLK_BENCH_SEQ_SECTORS);
+}
+
+static void run_ring(void) {
+    bench_ring_step(&vblk_bench_ring);
+}
+
+const bench_case_t virtio_blk_bench_cases[] = {
+    { "virtio_blk_rand_read_4k_qd1", setup_rand_qd1, run_ring, 4000, 64 },
+    { "virtio_blk_rand_read_4k_qd32", setup_rand_qd32, run_ring, 16000, 256 },
+    { "virtio_blk_seq_read_1m_qd4", setup_seq_qd4, run_ring, 256, 8 },
+    { NULL, NULL, NULL, 0, 0 }
+};
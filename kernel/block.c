@@ -0,0 +1,346 @@
+#include "block.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "arch/x86/cpu.h"
+#include "arch/x86/tsc.h"
+
+/* Registered devices, in registration order */
+static block_device_t* block_devices[BLOCK_MAX_DEVICES];
+static uint32_t block_device_total = 0;
+
+/* Register a disk */
+int block_register(block_device_t* dev) {
+    if (block_device_total == BLOCK_MAX_DEVICES) {
+        printf("Block: table full, %s dropped\n", dev->name);
+        return -1;
+    }
+    if (!dev->ops || !dev->ops->start || dev->max_sectors == 0 || dev->queue_depth == 0 ||
+        dev->max_segments == 0 || dev->max_segments > BLOCK_MAX_SEGMENTS) {
+        printf("Block: %s has invalid limits\n", dev->name);
+        return -1;
+    }
+
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->free_list = NULL;
+    for (uint32_t i = BLOCK_QUEUE_REQUESTS; i-- > 0;) {
+        block_request_t* request = &dev->requests[i];
+        request->device = dev;
+        request->tag = i;
+        request->next = dev->free_list;
+        dev->free_list = request;
+    }
+    dev->head = NULL;
+    dev->tail = NULL;
+    dev->plugged = 0;
+    dev->completed = 0;
+
+    block_devices[block_device_total++] = dev;
+    printf("Block: %s, %llu MiB, %u sectors x %u segments per request, depth %u\n", dev->name,
+           (unsigned long long)(dev->sectors / (1024 * 1024 / BLOCK_SECTOR_SIZE)),
+           dev->max_sectors, dev->max_segments, dev->queue_depth);
+    return 0;
+}
+
+uint32_t block_device_count(void) {
+    return block_device_total;
+}
+
+block_device_t* block_get_device(uint32_t index) {
+    return index < block_device_total ? block_devices[index] : NULL;
+}
+
+/* Find a device by name */
+block_device_t* block_find(const char* name) {
+    for (uint32_t i = 0; i < block_device_total; i++) {
+        if (strcmp(block_devices[i]->name, name) == 0) return block_devices[i];
+    }
+    return NULL;
+}
+
+/* Start waiting requests while the device has room (interrupts disabled) */
+static void block_dispatch(block_device_t* dev) {
+    while (!dev->plugged && dev->head && dev->stats.in_flight < dev->queue_depth) {
+        block_request_t* request = dev->head;
+        dev->head = request->next;
+        if (!dev->head) dev->tail = NULL;
+        request->next = NULL;
+        dev->stats.waiting--;
+        dev->stats.in_flight++;
+
+        if (dev->ops->start(dev, request) != 0) {
+            /* No room after all: back to the front until a completion */
+            dev->stats.in_flight--;
+            dev->stats.waiting++;
+            request->next = dev->head;
+            dev->head = request;
+            if (!dev->tail) dev->tail = request;
+            return;
+        }
+    }
+}
+
+/* Segments a request would have with a bio's appended (back) or
+ * prepended, one fewer when the pieces meet in memory */
+static uint32_t block_merged_segments(const block_request_t* request, const bio_t* bio, int back) {
+    const block_segment_t* first = back ? &request->segments[request->segment_count - 1]
+                                        : &bio->segments[bio->segment_count - 1];
+    const block_segment_t* second = back ? &bio->segments[0] : &request->segments[0];
+    int touching = (uint8_t*)first->addr + first->len == (uint8_t*)second->addr;
+    return request->segment_count + bio->segment_count - (touching ? 1 : 0);
+}
+
+/* Copy a bio's segments in front of or behind a request's */
+static void block_add_segments(block_request_t* request, const bio_t* bio, int back) {
+    uint32_t count = bio->segment_count;
+    if (back) {
+        uint32_t next = request->segment_count;
+        const block_segment_t* last = &request->segments[next - 1];
+        uint32_t skip = 0;
+        if ((uint8_t*)last->addr + last->len == (uint8_t*)bio->segments[0].addr) {
+            request->segments[next - 1].len += bio->segments[0].len;
+            skip = 1;
+        }
+        for (uint32_t i = skip; i < count; i++) {
+            request->segments[next++] = bio->segments[i];
+        }
+        request->segment_count = next;
+        return;
+    }
+
+    const block_segment_t* end = &bio->segments[count - 1];
+    if ((uint8_t*)end->addr + end->len == (uint8_t*)request->segments[0].addr) {
+        request->segments[0].addr = end->addr;
+        request->segments[0].len += end->len;
+        count--;
+    }
+    memmove(&request->segments[count], request->segments, request->segment_count * sizeof(block_segment_t));
+    memcpy(request->segments, bio->segments, count * sizeof(block_segment_t));
+    request->segment_count += count;
+}
+
+/* Fold a bio into a waiting request that it continues or precedes
+ * Returns: 1 if merged, 0 otherwise (interrupts disabled) */
+static int block_try_merge(block_device_t* dev, bio_t* bio) {
+    for (block_request_t* request = dev->head; request; request = request->next) {
+        if (request->write != bio->write ||
+            request->sectors + bio->sectors > dev->max_sectors) {
+            continue;
+        }
+
+        int back = request->sector + request->sectors == bio->sector;
+        int front = bio->sector + bio->sectors == request->sector;
+        if (!back && !front) continue;
+        if (block_merged_segments(request, bio, back) > dev->max_segments) continue;
+
+        block_add_segments(request, bio, back);
+        if (back) {
+            request->bio_tail->next = bio;
+            request->bio_tail = bio;
+        } else {
+            bio->next = request->bio_head;
+            request->bio_head = bio;
+            request->sector = bio->sector;
+        }
+        request->sectors += bio->sectors;
+        dev->stats.merges++;
+        return 1;
+    }
+    return 0;
+}
+
+/* Whether waits on a device have to poll rather than take its interrupt */
+static int block_must_poll(const block_device_t* dev, uint32_t flags) {
+    return dev->polled || !(flags & EFLAGS_IF);
+}
+
+/* TSC deadline for the next poll while the interrupt is awaited */
+static uint64_t block_poll_deadline(void) {
+    return tsc_read() + (uint64_t)BLOCK_POLL_INTERVAL_MS * tsc_khz();
+}
+
+/* Wait until a request of the device frees up (interrupts disabled) */
+static void block_wait_request(block_device_t* dev, uint32_t flags) {
+    /* Whatever is plugged has to go, or nothing may ever complete */
+    uint32_t plugged = dev->plugged;
+    dev->plugged = 0;
+    block_dispatch(dev);
+
+    while (!dev->free_list) {
+        if (dev->ops->poll) dev->ops->poll(dev);
+        if (dev->free_list || block_must_poll(dev, flags)) continue;
+
+        /* The interrupt frees the request; poll again once the interval is up */
+        uint64_t deadline = block_poll_deadline();
+        while (!dev->free_list && !cpu_wait_for_interrupt(deadline)) {
+        }
+    }
+    dev->plugged = plugged;
+}
+
+/* Queue a bio, merging it with a waiting request where possible */
+int block_submit(bio_t* bio) {
+    block_device_t* dev = bio->device;
+    if (!dev || bio->segment_count == 0 || bio->segment_count > dev->max_segments) return -1;
+
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < bio->segment_count; i++) {
+        const block_segment_t* segment = &bio->segments[i];
+        if (segment->len == 0 || (segment->len % BLOCK_SECTOR_SIZE) || ((uint32_t)segment->addr & 1)) {
+            return -1;
+        }
+        bytes += segment->len;
+    }
+    bio->sectors = bytes / BLOCK_SECTOR_SIZE;
+    if (bio->sectors > dev->max_sectors || bio->sector + bio->sectors > dev->sectors) return -1;
+
+    bio->status = BIO_PENDING;
+    bio->next = NULL;
+
+    uint32_t flags = irq_save();
+    dev->stats.bios++;
+    if (!block_try_merge(dev, bio)) {
+        if (!dev->free_list) {
+            block_wait_request(dev, flags);
+        }
+        block_request_t* request = dev->free_list;
+        dev->free_list = request->next;
+
+        request->sector = bio->sector;
+        request->sectors = bio->sectors;
+        request->write = bio->write;
+        memcpy(request->segments, bio->segments, bio->segment_count * sizeof(block_segment_t));
+        request->segment_count = bio->segment_count;
+        request->bio_head = bio;
+        request->bio_tail = bio;
+        request->queued = tsc_read();
+        request->next = NULL;
+
+        if (dev->tail) {
+            dev->tail->next = request;
+        } else {
+            dev->head = request;
+        }
+        dev->tail = request;
+        dev->stats.waiting++;
+    }
+    block_dispatch(dev);
+    irq_restore(flags);
+    return 0;
+}
+
+void block_plug(block_device_t* dev) {
+    uint32_t flags = irq_save();
+    dev->plugged++;
+    irq_restore(flags);
+}
+
+void block_unplug(block_device_t* dev) {
+    uint32_t flags = irq_save();
+    if (dev->plugged) dev->plugged--;
+    block_dispatch(dev);
+    irq_restore(flags);
+}
+
+/* Finish a started request and its bios */
+void block_complete(block_request_t* request, int error) {
+    block_device_t* dev = request->device;
+
+    uint64_t us = tsc_to_us(tsc_read() - request->queued);
+    uint32_t bucket = 0;
+    while (us && bucket < BLOCK_LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    dev->stats.latency[request->write ? 1 : 0][bucket]++;
+    dev->stats.in_flight--;
+    if (error) {
+        dev->stats.errors++;
+    } else if (request->write) {
+        dev->stats.writes++;
+        dev->stats.write_sectors += request->sectors;
+    } else {
+        dev->stats.reads++;
+        dev->stats.read_sectors += request->sectors;
+    }
+
+    /* Back to the pool first: a callback may submit again */
+    bio_t* bio = request->bio_head;
+    request->bio_head = NULL;
+    request->bio_tail = NULL;
+    request->next = dev->free_list;
+    dev->free_list = request;
+    dev->completed++;
+
+    while (bio) {
+        bio_t* next = bio->next;
+        bio->next = NULL;
+        bio->status = error ? BIO_ERROR : BIO_DONE;
+        if (bio->done) {
+            bio->done(bio);
+        }
+        bio = next;
+    }
+    block_dispatch(dev);
+}
+
+/* Wait until a submitted bio completes */
+int block_wait(bio_t* bio) {
+    block_device_t* dev = bio->device;
+
+    uint32_t flags = irq_save();
+    while (bio->status == BIO_PENDING) {
+        /* Polling reaps what finished unannounced and times commands out */
+        if (dev->ops->poll) {
+            dev->ops->poll(dev);
+        }
+        if (bio->status != BIO_PENDING || block_must_poll(dev, flags)) {
+            continue;
+        }
+
+        /* The interrupt completes the bio; poll again once the interval is up */
+        uint64_t deadline = block_poll_deadline();
+        while (bio->status == BIO_PENDING && !cpu_wait_for_interrupt(deadline)) {
+        }
+    }
+    irq_restore(flags);
+    return bio->status;
+}
+
+/* Reap completions from the hardware without waiting for its interrupt */
+uint32_t block_poll(block_device_t* dev) {
+    uint32_t flags = irq_save();
+    uint32_t before = dev->completed;
+    if (dev->ops->poll) {
+        dev->ops->poll(dev);
+    }
+    uint32_t completed = dev->completed - before;
+    irq_restore(flags);
+    return completed;
+}
+
+/* Print a device's counters and latency histograms */
+void block_print_stats(const block_device_t* dev) {
+    const block_stats_t* stats = &dev->stats;
+    printf("%s: %llu bios, %llu merged; %llu reads (%llu sectors), %llu writes (%llu sectors), "
+           "%llu errors; %u in flight, %u waiting\n", dev->name,
+           (unsigned long long)stats->bios, (unsigned long long)stats->merges,
+           (unsigned long long)stats->reads, (unsigned long long)stats->read_sectors,
+           (unsigned long long)stats->writes, (unsigned long long)stats->write_sectors,
+           (unsigned long long)stats->errors, stats->in_flight, stats->waiting);
+
+    static const char* const directions[2] = { "read", "write" };
+    for (int d = 0; d < 2; d++) {
+        printf("  %s latency (us, count):", directions[d]);
+        for (uint32_t b = 0; b < BLOCK_LATENCY_BUCKETS; b++) {
+            if (!stats->latency[d][b]) continue;
+            if (b == BLOCK_LATENCY_BUCKETS - 1) {
+                printf(" >=%u:%u", 1u << (b - 1), stats->latency[d][b]);
+            } else {
+                printf(" <%u:%u", 1u << b, stats->latency[d][b]);
+            }
+        }
+        printf("\n");
+    }
+}
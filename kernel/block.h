@@ -0,0 +1,212 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Generic block layer
+ *
+ * Disk drivers register a block_device_t with the limits of one
+ * request and a start() operation. Users submit bios: a run of sectors
+ * with a scatter-gather list of memory segments. block_submit() merges
+ * a bio into a request still waiting in the device's queue when it
+ * continues or precedes it on the disk, and otherwise takes a new
+ * request from the device's pool. Requests start in order as long as
+ * fewer than queue_depth are in flight; the driver finishes each with
+ * block_complete(), usually from its interrupt.
+ *
+ * Plugging holds requests back so a batch of bios can merge before any
+ * of them reaches the disk:
+ *
+ *   block_plug(dev);
+ *   for (...) block_submit(&bios[i]);     // adjacent bios become one request
+ *   block_unplug(dev);
+ *
+ * A bio completes through its done callback (from the interrupt) or is
+ * waited for: block_wait() lets the driver's interrupt complete it,
+ * block_poll() reaps completions from the hardware directly, for callers
+ * that would rather spin than take the interrupt's latency.
+ *
+ * Segments are handed to the controller by address, so they must be
+ * identity mapped (all kernel memory is).
+ */
+
+#define BLOCK_SECTOR_SIZE       512
+
+/* Limits */
+#define BLOCK_MAX_DEVICES       16
+#define BLOCK_NAME_MAX          16
+#define BLOCK_QUEUE_REQUESTS    32      /* Per device, waiting or in flight */
+#define BLOCK_MAX_SEGMENTS      16      /* Per request, after merging */
+
+/* Waiting for an interrupt, poll the driver this often for its timeouts */
+#define BLOCK_POLL_INTERVAL_MS  10
+
+/* Latency histogram: bucket 0 is under 1 us, bucket i covers
+ * [2^(i-1), 2^i) us and the last one everything above */
+#define BLOCK_LATENCY_BUCKETS   24
+
+/* Bio status */
+#define BIO_PENDING             1
+#define BIO_DONE                0
+#define BIO_ERROR               -1
+
+/* One contiguous piece of memory */
+typedef struct {
+    void* addr;                 /* 2-byte aligned */
+    uint32_t len;               /* A multiple of BLOCK_SECTOR_SIZE */
+} block_segment_t;
+
+/* Check a segment list for drivers: every piece 2-byte aligned and a
+ * whole number of sectors, bytes in all
+ * Returns: 1 if usable, 0 otherwise
+ */
+static inline int block_segments_valid(const block_segment_t* segments, uint32_t count, uint32_t bytes) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (segments[i].len == 0 || (segments[i].len % BLOCK_SECTOR_SIZE) ||
+            ((uint32_t)segments[i].addr & 1)) {
+            return 0;
+        }
+        total += segments[i].len;
+    }
+    return count > 0 && total == bytes;
+}
+
+struct block_device;
+struct block_request;
+
+/* A transfer as submitted; owned by the block layer until status leaves PENDING */
+typedef struct bio {
+    struct block_device* device;
+    uint64_t sector;            /* First sector */
+    const block_segment_t* segments;
+    uint32_t segment_count;
+    int write;                  /* 1 to write the segments to the disk */
+
+    volatile int status;        /* BIO_* */
+
+    /* Called from the interrupt on completion (may be NULL) */
+    void (*done)(struct bio* bio);
+    void* context;              /* For the callback */
+
+    uint32_t sectors;           /* Set by block_submit() */
+    struct bio* next;           /* Link in its request */
+} bio_t;
+
+/* One or more merged bios, as handed to the driver */
+typedef struct block_request {
+    struct block_device* device;
+    uint64_t sector;
+    uint32_t sectors;
+    int write;
+    block_segment_t segments[BLOCK_MAX_SEGMENTS];
+    uint32_t segment_count;
+    uint32_t tag;               /* Index in the device's pool, for per-request driver state */
+
+    bio_t* bio_head;
+    bio_t* bio_tail;
+    uint64_t queued;            /* TSC when the first bio arrived */
+    struct block_request* next; /* Queue or free list link */
+} block_request_t;
+
+typedef struct block_device_ops {
+    /* Hand a request to the hardware (interrupts disabled); the driver
+     * calls block_complete() once it is done, failed or invalid
+     * Returns: 0 if taken, -1 to retry after the next completion */
+    int (*start)(struct block_device* dev, block_request_t* request);
+
+    /* Complete what the hardware has finished without waiting for its
+     * interrupt, and fail commands that have timed out (interrupts disabled) */
+    void (*poll)(struct block_device* dev);
+} block_device_ops_t;
+
+/* Per-device counters */
+typedef struct {
+    uint64_t bios;              /* Submitted */
+    uint64_t merges;            /* Bios merged into a waiting request */
+    uint64_t reads;             /* Requests completed */
+    uint64_t writes;
+    uint64_t read_sectors;
+    uint64_t write_sectors;
+    uint64_t errors;            /* Requests failed */
+    uint32_t in_flight;         /* Started and not completed */
+    uint32_t waiting;           /* Queued, not started */
+    uint32_t latency[2][BLOCK_LATENCY_BUCKETS];    /* Reads, writes: queued to completed */
+} block_stats_t;
+
+/* A disk; the driver fills the fields up to driver_data and registers it */
+typedef struct block_device {
+    char name[BLOCK_NAME_MAX];
+    uint64_t sectors;           /* Capacity */
+    uint32_t max_sectors;       /* Per request */
+    uint32_t max_segments;      /* Per request, at most BLOCK_MAX_SEGMENTS */
+    uint32_t queue_depth;       /* Requests in flight at once */
+    uint8_t polled;             /* No interrupt: waits poll every round */
+    const block_device_ops_t* ops;
+    void* driver_data;
+
+    block_stats_t stats;
+
+    /* Queue */
+    block_request_t requests[BLOCK_QUEUE_REQUESTS];
+    block_request_t* free_list;
+    block_request_t* head;      /* Waiting to start, in order */
+    block_request_t* tail;
+    uint32_t plugged;           /* Nesting depth of block_plug() */
+    uint32_t completed;         /* Requests completed, for block_poll() */
+} block_device_t;
+
+/* Register a disk; the structure must stay valid
+ * Returns: 0 on success, -1 if the table is full or the limits are invalid
+ */
+int block_register(block_device_t* dev);
+
+/* Get the number of registered devices */
+uint32_t block_device_count(void);
+
+/* Get a device by index
+ * Returns: the device, or NULL if index is out of range
+ */
+block_device_t* block_get_device(uint32_t index);
+
+/* Find a device by name
+ * Returns: the device, or NULL if there is none
+ */
+block_device_t* block_find(const char* name);
+
+/* Queue a bio, merging it with a waiting request where possible
+ * Waits as block_wait() does until a request frees up if all of them are in use.
+ * Returns: 0 if queued, -1 if the bio is invalid or exceeds the device's limits
+ */
+int block_submit(bio_t* bio);
+
+/* Hold the device's requests back until the matching block_unplug() */
+void block_plug(block_device_t* dev);
+
+/* Release plugged requests to the driver */
+void block_unplug(block_device_t* dev);
+
+/* Wait until a submitted bio completes
+ * Polls the driver once, then leaves the bio to its interrupt, polling
+ * again every BLOCK_POLL_INTERVAL_MS so the driver's timeouts keep
+ * running. With interrupts disabled or a polled device it polls every
+ * round instead.
+ * Returns: the bio's final status
+ */
+int block_wait(bio_t* bio);
+
+/* Reap completions from the hardware without waiting for its interrupt
+ * Returns: the number of requests completed
+ */
+uint32_t block_poll(block_device_t* dev);
+
+/* Finish a started request and its bios (drivers, interrupts disabled)
+ * error is 0 on success
+ */
+void block_complete(block_request_t* request, int error);
+
+/* Print a device's counters and latency histograms */
+void block_print_stats(const block_device_t* dev);
+
+#endif /* BLOCK_H */
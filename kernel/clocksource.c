@@ -0,0 +1,193 @@
+#include "clocksource.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "init.h"
+#include "arch/x86/cpu.h"
+#include "arch/x86/tsc.h"
+
+/* Registered sources, in registration order */
+static clocksource_t* clocksources[CLOCKSOURCE_MAX];
+static size_t clocksource_count = 0;
+
+/* Selected source and the count clock_ns() has accumulated from it */
+static const clocksource_t* clocksource_selected = NULL;
+static uint64_t clock_last_count = 0;
+static uint64_t clock_last_tsc = 0;
+static uint64_t clock_total_counts = 0;
+
+/* Best registered clockevent */
+static clockevent_t* clockevent_best = NULL;
+
+/* Median TSC cycles one read of cs takes, without the cost of rdtsc itself */
+static uint32_t clocksource_measure(const clocksource_t* cs) {
+    uint32_t samples[CLOCKSOURCE_COST_READS];
+    uint32_t overhead = UINT32_MAX;
+
+    for (size_t i = 0; i < CLOCKSOURCE_COST_READS; i++) {
+        uint64_t start = tsc_read();
+        uint64_t end = tsc_read();
+        if (end - start < overhead) overhead = (uint32_t)(end - start);
+    }
+
+    for (size_t i = 0; i < CLOCKSOURCE_COST_READS; i++) {
+        uint64_t start = tsc_read();
+        cs->read();
+        uint64_t cycles = tsc_read() - start;
+        uint32_t sample = cycles > overhead ? (uint32_t)(cycles - overhead) : 0;
+
+        /* Insertion sort; an interrupt only disturbs one sample */
+        size_t pos = i;
+        while (pos > 0 && samples[pos - 1] > sample) {
+            samples[pos] = samples[pos - 1];
+            pos--;
+        }
+        samples[pos] = sample;
+    }
+    return samples[CLOCKSOURCE_COST_READS / 2];
+}
+
+/* Register a clocksource and time its read */
+void clocksource_register(clocksource_t* cs) {
+    if (clocksource_count == CLOCKSOURCE_MAX) {
+        printf("Clocksource: table full, %s dropped\n", cs->name);
+        return;
+    }
+    cs->read_cycles = clocksource_measure(cs);
+    clocksources[clocksource_count++] = cs;
+}
+
+/* Cheapest stable source, else the best rated one */
+static const clocksource_t* clocksource_best(int exclude_tsc) {
+    const clocksource_t* best = NULL;
+
+    for (size_t i = 0; i < clocksource_count; i++) {
+        const clocksource_t* cs = clocksources[i];
+        if (exclude_tsc && strcmp(cs->name, "tsc") == 0) continue;
+        if (!best) {
+            best = cs;
+            continue;
+        }
+
+        int stable = cs->rating >= CLOCKSOURCE_RATING_STABLE;
+        int best_stable = best->rating >= CLOCKSOURCE_RATING_STABLE;
+        if (stable != best_stable) {
+            if (stable) best = cs;
+        } else if (stable ? cs->read_cycles < best->read_cycles
+                          : cs->rating > best->rating) {
+            best = cs;
+        }
+    }
+    return best;
+}
+
+/* Pick the clocksource clock_ns() uses and recalibrate the TSC */
+const clocksource_t* clocksource_select(void) {
+    /* Calibrate first: the TSC source's frequency comes from it */
+    const clocksource_t* reference = clocksource_best(1);
+    if (reference) {
+        uint32_t previous = tsc_khz();
+        uint32_t khz = tsc_calibrate(reference);
+        if (khz) {
+            printf("TSC: %u kHz against %s (was %u kHz)\n", khz, reference->name, previous);
+        }
+    }
+
+    const clocksource_t* selected = clocksource_best(0);
+    uint32_t flags = irq_save();
+    clocksource_selected = selected;
+    clock_last_count = selected ? selected->read() : 0;
+    clock_last_tsc = tsc_read();
+    clock_total_counts = 0;
+    irq_restore(flags);
+
+    printf("Clocksource:");
+    for (size_t i = 0; i < clocksource_count; i++) {
+        printf(" %s %d (%u cycles)", clocksources[i]->name, clocksources[i]->rating,
+               clocksources[i]->read_cycles);
+    }
+    printf(", using %s\n", selected ? selected->name : "none");
+    return selected;
+}
+
+const clocksource_t* clocksource_current(void) {
+    return clocksource_selected;
+}
+
+/* Find a registered clocksource by name */
+const clocksource_t* clocksource_find(const char* name) {
+    for (size_t i = 0; i < clocksource_count; i++) {
+        if (strcmp(clocksources[i]->name, name) == 0) return clocksources[i];
+    }
+    return NULL;
+}
+
+/* Convert a count of a clocksource to nanoseconds */
+uint64_t clocksource_to_ns(const clocksource_t* cs, uint64_t count) {
+    if (cs->frequency_hz == 0) return count;
+    /* Whole seconds and remainder so the multiply can't overflow */
+    uint64_t seconds = count / cs->frequency_hz;
+    uint64_t rest = count % cs->frequency_hz;
+    return seconds * 1000000000ull + rest * 1000000000ull / cs->frequency_hz;
+}
+
+/* Get nanoseconds since clocksource_select() */
+uint64_t clock_ns(void) {
+    const clocksource_t* cs = clocksource_selected;
+    if (!cs) return tsc_to_ns(tsc_read());
+
+    uint32_t flags = irq_save();
+    uint64_t count = cs->read();
+    uint64_t now = tsc_read();
+    uint64_t delta = (count - clock_last_count) & cs->mask;
+
+    /* The counter may have wrapped several times since the last call
+     * (nothing calls this periodically); the TSC's elapsed time says how often */
+    if (cs->mask != UINT64_MAX && cs->frequency_hz) {
+        uint64_t ns = tsc_to_ns(now - clock_last_tsc);
+        uint64_t expected = ns / 1000000000ull * cs->frequency_hz +
+                            ns % 1000000000ull * cs->frequency_hz / 1000000000ull;
+        uint64_t period = cs->mask + 1;
+        if (expected > delta + period / 2) {
+            delta += (expected - delta + period / 2) / period * period;
+        }
+    }
+    clock_total_counts += delta;
+    clock_last_count = count;
+    clock_last_tsc = now;
+    uint64_t total = clock_total_counts;
+    irq_restore(flags);
+
+    return clocksource_to_ns(cs, total);
+}
+
+/* Register a clockevent; the best rated one is used */
+void clockevent_register(clockevent_t* ce) {
+    if (!clockevent_best || ce->rating > clockevent_best->rating) {
+        clockevent_best = ce;
+    }
+    printf("Clockevent: %s, %llu ns to %llu ms\n", ce->name,
+           (unsigned long long)ce->min_delta_ns,
+           (unsigned long long)(ce->max_delta_ns / 1000000));
+}
+
+clockevent_t* clockevent_get(void) {
+    return clockevent_best;
+}
+
+/* Call handler once, delta_ns from now */
+int clockevent_oneshot(uint64_t delta_ns, void (*handler)(void)) {
+    clockevent_t* ce = clockevent_best;
+    if (!ce || delta_ns < ce->min_delta_ns || delta_ns > ce->max_delta_ns) {
+        return -1;
+    }
+    ce->handler = handler;
+    return ce->program(delta_ns);
+}
+
+/* Runs once every driver that provides a clocksource has registered it */
+static int clocksource_initcall(void) {
+    return clocksource_select() ? 0 : -1;
+}
+INITCALL(clocksource, clocksource_initcall, "tsc_clocksource,pit_clocksource,hpet,acpi_pm");
@@ -0,0 +1,110 @@
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <stdint.h>
+
+/* Clocksources and clockevents
+ *
+ * A clocksource is a free-running counter: the TSC, the HPET main
+ * counter, the ACPI PM timer or PIT channel 2. Each driver registers
+ * one with a rating for how trustworthy it is:
+ *
+ *   400  TSC with a constant rate (invariant TSC)
+ *   300  HPET
+ *   200  ACPI PM timer
+ *   100  PIT channel 2, TSC whose rate may change
+ *
+ * clocksource_register() times a batch of reads of the new source.
+ * clocksource_select() then keeps the cheapest source rated at least
+ * CLOCKSOURCE_RATING_STABLE, or the best rated one if none is, and
+ * recalibrates the TSC against the best source that is not the TSC.
+ * clock_ns() reads the selected source.
+ *
+ * A clockevent is a timer that can be armed for one interrupt; the HPET
+ * comparators provide one where no local APIC timer is usable.
+ */
+
+/* Ratings */
+#define CLOCKSOURCE_RATING_TSC_INVARIANT  400
+#define CLOCKSOURCE_RATING_HPET           300
+#define CLOCKSOURCE_RATING_PM_TIMER       200
+#define CLOCKSOURCE_RATING_PIT            100
+#define CLOCKSOURCE_RATING_TSC            100
+
+/* Lowest rating selected on read cost alone */
+#define CLOCKSOURCE_RATING_STABLE         200
+
+/* Registered sources */
+#define CLOCKSOURCE_MAX                   8
+
+/* Reads timed per source at registration */
+#define CLOCKSOURCE_COST_READS            64
+
+/* A free-running counter */
+typedef struct clocksource {
+    const char* name;
+    int rating;                 /* CLOCKSOURCE_RATING_* */
+    uint64_t (*read)(void);     /* Current count, wrapping at mask */
+    uint64_t mask;              /* Counter width: 2^bits - 1 */
+    uint64_t frequency_hz;      /* Counts per second */
+    uint32_t read_cycles;       /* Median TSC cycles per read, set on registration */
+} clocksource_t;
+
+/* A timer that raises one interrupt when armed */
+typedef struct clockevent {
+    const char* name;
+    int rating;
+    uint64_t min_delta_ns;      /* Shortest delay program() accepts */
+    uint64_t max_delta_ns;      /* Longest delay program() accepts */
+
+    /* Arm the timer to call handler once, delta_ns from now
+     * Returns: 0 on success, -1 if delta_ns is out of range */
+    int (*program)(uint64_t delta_ns);
+
+    /* Called from the interrupt once the delay has passed */
+    void (*handler)(void);
+} clockevent_t;
+
+/* Register a clocksource and time its read
+ * The structure must stay valid; registering more than
+ * CLOCKSOURCE_MAX sources drops the extra ones.
+ */
+void clocksource_register(clocksource_t* cs);
+
+/* Pick the clocksource clock_ns() uses and recalibrate the TSC
+ * Returns: the selected source, or NULL if none is registered
+ */
+const clocksource_t* clocksource_select(void);
+
+/* Get the selected clocksource (NULL before clocksource_select()) */
+const clocksource_t* clocksource_current(void);
+
+/* Find a registered clocksource by name
+ * Returns: the source, or NULL if there is none by that name
+ */
+const clocksource_t* clocksource_find(const char* name);
+
+/* Get nanoseconds since clocksource_select()
+ * Nothing needs to call this periodically: when calls are further apart
+ * than a wrap of the selected counter (55 ms for the PIT, 4.7 s for a
+ * 24-bit PM timer, about 5 minutes for a 32-bit HPET), the whole wraps
+ * are counted from the TSC's elapsed time, which only has to be right
+ * to within half a wrap.
+ */
+uint64_t clock_ns(void);
+
+/* Convert a count of a clocksource to nanoseconds */
+uint64_t clocksource_to_ns(const clocksource_t* cs, uint64_t count);
+
+/* Register a clockevent; the best rated one is used */
+void clockevent_register(clockevent_t* ce);
+
+/* Get the best registered clockevent (NULL if there is none) */
+clockevent_t* clockevent_get(void);
+
+/* Call handler once, delta_ns from now, through the best clockevent
+ * Returns: 0 on success, -1 without a clockevent or if delta_ns is out of range
+ */
+int clockevent_oneshot(uint64_t delta_ns, void (*handler)(void));
+
+#endif /* CLOCKSOURCE_H */
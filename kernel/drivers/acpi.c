@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "acpi.h"
+#include "../arch/x86/paging.h"
+#include "../arch/x86/io.h"
+
+/* BIOS areas searched for the RSDP */
+#define ACPI_EBDA_POINTER   0x40E       /* Real-mode segment of the EBDA */
+#define ACPI_EBDA_SEARCH    1024
+#define ACPI_BIOS_START     0x000E0000
+#define ACPI_BIOS_END       0x00100000
+
+/* paging_init() maps the first 4 MiB with a page table of its own */
+#define ACPI_IDENTITY_LIMIT PAGE_DIRECTORY_SPAN
+
+/* Tables remembered from the single walk of the XSDT/RSDT */
+#define ACPI_MAX_TABLES     32
+
+static const acpi_rsdp_t* acpi_rsdp = NULL;
+static int acpi_searched = 0;
+
+static const acpi_sdt_header_t* acpi_tables[ACPI_MAX_TABLES];
+static size_t acpi_table_count = 0;
+static int acpi_tables_ready = 0;
+
+static acpi_platform_t acpi_platform_info;
+static int acpi_platform_ready = 0;
+
+/* Check that length bytes sum to zero */
+static int acpi_checksum_ok(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/* Make a physical range readable
+ * Returns: 0 on success, -1 if it cannot be mapped */
+static int acpi_map(uint64_t phys_addr, uint32_t length) {
+    if (phys_addr + length > 0x100000000ull) return -1;
+    uint32_t start = (uint32_t)phys_addr;
+    uint32_t end = start + length;
+
+    if (end <= ACPI_IDENTITY_LIMIT) return 0;
+    if (start < ACPI_IDENTITY_LIMIT) start = ACPI_IDENTITY_LIMIT;
+    return paging_map_region(start, end - start, 0);
+}
+
+/* Look for a valid RSDP on 16-byte boundaries in [start, end) */
+static const acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + 20 <= end; addr += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) != 0) continue;
+        if (!acpi_checksum_ok(rsdp, 20)) continue;
+        if (rsdp->revision >= 2 &&
+            (rsdp->length < sizeof(acpi_rsdp_t) || !acpi_checksum_ok(rsdp, rsdp->length))) {
+            continue;
+        }
+        return rsdp;
+    }
+    return NULL;
+}
+
+/* Find the RSDP: first KiB of the EBDA, then the BIOS ROM area */
+static const acpi_rsdp_t* acpi_find_rsdp(void) {
+    if (!acpi_searched) {
+        acpi_searched = 1;
+        uint32_t ebda = (uint32_t)*(const uint16_t*)ACPI_EBDA_POINTER << 4;
+        if (ebda >= 0x80000 && ebda < 0xA0000) {
+            acpi_rsdp = acpi_scan_rsdp(ebda, ebda + ACPI_EBDA_SEARCH);
+        }
+        if (!acpi_rsdp) {
+            acpi_rsdp = acpi_scan_rsdp(ACPI_BIOS_START, ACPI_BIOS_END);
+        }
+    }
+    return acpi_rsdp;
+}
+
+/* Map a table and check its checksum
+ * Returns: the table, or NULL if it is unusable */
+static const acpi_sdt_header_t* acpi_map_table(uint64_t phys_addr) {
+    if (phys_addr == 0 || acpi_map(phys_addr, sizeof(acpi_sdt_header_t)) != 0) return NULL;
+
+    const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)(uint32_t)phys_addr;
+    if (table->length < sizeof(acpi_sdt_header_t)) return NULL;
+    if (acpi_map(phys_addr, table->length) != 0) return NULL;
+    if (!acpi_checksum_ok(table, table->length)) return NULL;
+    return table;
+}
+
+/* Walk the XSDT or RSDT once, keeping every valid table */
+static void acpi_load_tables(void) {
+    acpi_tables_ready = 1;
+    const acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) return;
+
+    /* The XSDT holds 64-bit pointers, the RSDT 32-bit ones */
+    int extended = rsdp->revision >= 2 && rsdp->xsdt_address != 0;
+    const acpi_sdt_header_t* root = acpi_map_table(extended ? rsdp->xsdt_address
+                                                            : rsdp->rsdt_address);
+    if (!root) return;
+
+    size_t entry_size = extended ? 8 : 4;
+    size_t count = (root->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    const uint8_t* entries = (const uint8_t*)(root + 1);
+
+    for (size_t i = 0; i < count && acpi_table_count < ACPI_MAX_TABLES; i++) {
+        uint64_t address;
+        if (extended) {
+            memcpy(&address, entries + i * 8, 8);
+        } else {
+            uint32_t address32;
+            memcpy(&address32, entries + i * 4, 4);
+            address = address32;
+        }
+
+        const acpi_sdt_header_t* table = acpi_map_table(address);
+        if (table) {
+            acpi_tables[acpi_table_count++] = table;
+        }
+    }
+}
+
+/* Find a table by signature among the ones the root table lists */
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!acpi_tables_ready) {
+        acpi_load_tables();
+    }
+    for (size_t i = 0; i < acpi_table_count; i++) {
+        if (memcmp(acpi_tables[i]->signature, signature, 4) == 0) {
+            return acpi_tables[i];
+        }
+    }
+    return NULL;
+}
+
+/* Check that a table is long enough to contain field */
+#define ACPI_HAS_FIELD(table, type, field) \
+    ((table)->header.length >= offsetof(type, field) + sizeof(((type*)0)->field))
+
+/* Collect CPUs, I/O APICs and ISA interrupt overrides from the MADT */
+static void acpi_parse_madt(acpi_platform_t* platform) {
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (!madt || madt->header.length < sizeof(acpi_madt_t)) return;
+
+    platform->local_apic_address = madt->local_apic_address;
+    platform->pic_present = (madt->flags & ACPI_MADT_PCAT_COMPAT) != 0;
+
+    const uint8_t* record = madt->entries;
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while (record + sizeof(acpi_madt_record_t) <= end) {
+        const acpi_madt_record_t* header = (const acpi_madt_record_t*)record;
+        if (header->length < sizeof(acpi_madt_record_t) || record + header->length > end) break;
+
+        switch (header->type) {
+            case ACPI_MADT_LOCAL_APIC: {
+                const acpi_madt_local_apic_t* cpu = (const acpi_madt_local_apic_t*)record;
+                if ((cpu->flags & (ACPI_MADT_CPU_ENABLED | ACPI_MADT_CPU_ONLINE_CAPABLE)) &&
+                    platform->cpu_count < ACPI_MAX_CPUS) {
+                    platform->cpus[platform->cpu_count].processor_id = cpu->processor_id;
+                    platform->cpus[platform->cpu_count].apic_id = cpu->apic_id;
+                    platform->cpu_count++;
+                }
+                break;
+            }
+            case ACPI_MADT_IO_APIC: {
+                const acpi_madt_io_apic_t* io_apic = (const acpi_madt_io_apic_t*)record;
+                if (platform->io_apic_count < ACPI_MAX_IO_APICS) {
+                    platform->io_apics[platform->io_apic_count].id = io_apic->id;
+                    platform->io_apics[platform->io_apic_count].address = io_apic->address;
+                    platform->io_apics[platform->io_apic_count].gsi_base = io_apic->gsi_base;
+                    platform->io_apic_count++;
+                }
+                break;
+            }
+            case ACPI_MADT_IRQ_OVERRIDE: {
+                const acpi_madt_irq_override_t* irq = (const acpi_madt_irq_override_t*)record;
+                if (irq->bus == 0 && platform->irq_override_count < ACPI_MAX_IRQ_OVERRIDES) {
+                    platform->irq_overrides[platform->irq_override_count].source = irq->source;
+                    platform->irq_overrides[platform->irq_override_count].gsi = irq->gsi;
+                    platform->irq_overrides[platform->irq_override_count].flags = irq->flags;
+                    platform->irq_override_count++;
+                }
+                break;
+            }
+            case ACPI_MADT_LAPIC_OVERRIDE: {
+                const acpi_madt_lapic_override_t* lapic = (const acpi_madt_lapic_override_t*)record;
+                if (lapic->address < 0x100000000ull) {
+                    platform->local_apic_address = (uint32_t)lapic->address;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        record += header->length;
+    }
+}
+
+/* Copy the ECAM windows out of the MCFG */
+static void acpi_parse_mcfg(acpi_platform_t* platform) {
+    const acpi_mcfg_t* mcfg = (const acpi_mcfg_t*)acpi_find_table("MCFG");
+    if (!mcfg || mcfg->header.length < sizeof(acpi_mcfg_t)) return;
+
+    size_t count = (mcfg->header.length - sizeof(acpi_mcfg_t)) / sizeof(acpi_mcfg_entry_t);
+    for (size_t i = 0; i < count && platform->ecam_count < ACPI_MAX_ECAM_REGIONS; i++) {
+        platform->ecam[platform->ecam_count++] = mcfg->entries[i];
+    }
+}
+
+/* Find the HPET register block */
+static void acpi_parse_hpet(acpi_platform_t* platform) {
+    const acpi_hpet_t* hpet = (const acpi_hpet_t*)acpi_find_table("HPET");
+    if (!hpet || hpet->header.length < sizeof(acpi_hpet_t)) return;
+    if (hpet->base_address.space_id != ACPI_SPACE_MEMORY) return;
+
+    platform->hpet_address = hpet->base_address.address;
+    platform->hpet_number = hpet->hpet_number;
+    platform->hpet_minimum_tick = hpet->minimum_tick;
+}
+
+/* Find the PM timer and the reset register in the FADT */
+static void acpi_parse_fadt(acpi_platform_t* platform) {
+    const acpi_fadt_t* fadt = (const acpi_fadt_t*)acpi_find_table("FACP");
+    if (!fadt || !ACPI_HAS_FIELD(fadt, acpi_fadt_t, pm_timer_length)) return;
+
+    platform->sci_irq = fadt->sci_interrupt;
+
+    /* Prefer the extended block when it is in I/O space; the timer is
+     * always read as a 32-bit port */
+    uint32_t port = fadt->pm_timer_length == 4 ? fadt->pm_timer_block : 0;
+    if (ACPI_HAS_FIELD(fadt, acpi_fadt_t, x_pm_timer_block) &&
+        fadt->x_pm_timer_block.space_id == ACPI_SPACE_IO &&
+        fadt->x_pm_timer_block.address != 0) {
+        port = (uint32_t)fadt->x_pm_timer_block.address;
+    }
+    if (port != 0 && port <= 0xFFFF) {
+        platform->pm_timer_port = (uint16_t)port;
+    }
+
+    if (ACPI_HAS_FIELD(fadt, acpi_fadt_t, flags)) {
+        platform->pm_timer_32bit = (fadt->flags & ACPI_FADT_TIMER_32BIT) != 0;
+    }
+    if (ACPI_HAS_FIELD(fadt, acpi_fadt_t, reset_value) &&
+        (fadt->flags & ACPI_FADT_RESET_SUPPORTED)) {
+        platform->reset_supported = 1;
+        platform->reset_register = fadt->reset_register;
+        platform->reset_value = fadt->reset_value;
+    }
+}
+
+/* Parse the tables into the platform description, once */
+const acpi_platform_t* acpi_platform(void) {
+    if (acpi_platform_ready) {
+        return &acpi_platform_info;
+    }
+    acpi_platform_ready = 1;
+
+    acpi_platform_t* platform = &acpi_platform_info;
+    const acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        printf("ACPI: no RSDP found\n");
+        return platform;
+    }
+
+    platform->present = 1;
+    platform->revision = rsdp->revision;
+    memcpy(platform->oem_id, rsdp->oem_id, 6);
+    platform->oem_id[6] = '\0';
+
+    acpi_parse_madt(platform);
+    acpi_parse_mcfg(platform);
+    acpi_parse_hpet(platform);
+    acpi_parse_fadt(platform);
+
+    printf("ACPI: revision %u (%s), %u tables, %u CPU%s, %u I/O APIC%s, %u IRQ override%s\n",
+           platform->revision, platform->oem_id, acpi_table_count,
+           platform->cpu_count, platform->cpu_count == 1 ? "" : "s",
+           platform->io_apic_count, platform->io_apic_count == 1 ? "" : "s",
+           platform->irq_override_count, platform->irq_override_count == 1 ? "" : "s");
+    printf("ACPI: ECAM regions %u, HPET %08llx, PM timer %04x (%u-bit), reset %s\n",
+           platform->ecam_count, (unsigned long long)platform->hpet_address,
+           platform->pm_timer_port, platform->pm_timer_32bit ? 32 : 24,
+           platform->reset_supported ? "supported" : "not supported");
+    return platform;
+}
+
+/* Follow the MADT's ISA interrupt overrides */
+uint32_t acpi_isa_irq_to_gsi(uint8_t irq) {
+    const acpi_platform_t* platform = acpi_platform();
+    for (uint32_t i = 0; i < platform->irq_override_count; i++) {
+        if (platform->irq_overrides[i].source == irq) {
+            return platform->irq_overrides[i].gsi;
+        }
+    }
+    return irq;
+}
+
+/* Write the reset value to the reset register */
+int acpi_reboot(void) {
+    const acpi_platform_t* platform = acpi_platform();
+    if (!platform->reset_supported) return -1;
+
+    const acpi_generic_address_t* reg = &platform->reset_register;
+    if (reg->space_id == ACPI_SPACE_IO && reg->address <= 0xFFFF) {
+        outb((uint16_t)reg->address, platform->reset_value);
+    } else if (reg->space_id == ACPI_SPACE_MEMORY && acpi_map(reg->address, 1) == 0) {
+        *(volatile uint8_t*)(uint32_t)reg->address = platform->reset_value;
+    } else {
+        return -1;
+    }
+
+    /* The reset takes effect asynchronously on some chipsets */
+    for (volatile int spin = 0; spin < 1000000; spin++) {
+    }
+    return -1;
+}
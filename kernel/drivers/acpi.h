@@ -0,0 +1,275 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ACPI system description tables
+ *
+ * Finds the RSDP in the BIOS areas, then walks the XSDT (or the RSDT on
+ * ACPI 1.0 firmware) once and remembers every table in it. Tables
+ * usually sit at the top of RAM, above the identity-mapped first 4 MiB;
+ * they are mapped with paging_map_region() as they are found, so
+ * returned pointers can be dereferenced directly. Every table's
+ * checksum is verified before it is handed out.
+ *
+ * acpi_platform() digests the tables the kernel needs (MADT, MCFG,
+ * HPET, FADT) into one structure. Nothing is parsed until the first
+ * caller asks, and nothing is parsed twice. That first caller is
+ * pci_config_init(): from fbcon_init() in kernel_main() when the
+ * framebuffer console is built in, before any initcall, and from the
+ * PCI initcall otherwise. Parsing needs only paging and printf, so
+ * either is early enough.
+ */
+
+/* Root System Description Pointer (ACPI 2.0 layout) */
+typedef struct {
+    char     signature[8];      /* "RSD PTR " */
+    uint8_t  checksum;          /* Covers the first 20 bytes */
+    char     oem_id[6];
+    uint8_t  revision;          /* 0 for ACPI 1.0, 2 for 2.0 and later */
+    uint32_t rsdt_address;
+    uint32_t length;            /* 2.0+: size of this structure */
+    uint64_t xsdt_address;      /* 2.0+ */
+    uint8_t  extended_checksum; /* 2.0+: covers length bytes */
+    uint8_t  reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+/* Header shared by every system description table */
+typedef struct {
+    char     signature[4];
+    uint32_t length;            /* Whole table, header included */
+    uint8_t  revision;
+    uint8_t  checksum;          /* All bytes of the table sum to 0 */
+    char     oem_id[6];
+    char     oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/* MCFG: PCI Express memory-mapped configuration space (ECAM) */
+typedef struct {
+    uint64_t base_address;      /* ECAM base for bus 0 of the segment */
+    uint16_t segment;           /* PCI segment group */
+    uint8_t  start_bus;
+    uint8_t  end_bus;
+    uint32_t reserved;
+} __attribute__((packed)) acpi_mcfg_entry_t;
+
+typedef struct {
+    acpi_sdt_header_t header;   /* "MCFG" */
+    uint64_t reserved;
+    acpi_mcfg_entry_t entries[];
+} __attribute__((packed)) acpi_mcfg_t;
+
+/* Generic address structure: a register in memory, I/O or config space */
+typedef struct {
+    uint8_t  space_id;          /* ACPI_SPACE_* */
+    uint8_t  bit_width;
+    uint8_t  bit_offset;
+    uint8_t  access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_generic_address_t;
+
+#define ACPI_SPACE_MEMORY   0
+#define ACPI_SPACE_IO       1
+#define ACPI_SPACE_PCI      2
+
+/* MADT: interrupt controllers ("APIC") */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t local_apic_address;
+    uint32_t flags;             /* ACPI_MADT_PCAT_COMPAT */
+    uint8_t  entries[];         /* Variable-length records */
+} __attribute__((packed)) acpi_madt_t;
+
+#define ACPI_MADT_PCAT_COMPAT       0x1     /* Dual 8259s are present too */
+
+/* MADT record types and their layouts */
+#define ACPI_MADT_LOCAL_APIC        0
+#define ACPI_MADT_IO_APIC           1
+#define ACPI_MADT_IRQ_OVERRIDE      2
+#define ACPI_MADT_LOCAL_APIC_NMI    4
+#define ACPI_MADT_LAPIC_OVERRIDE    5
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_record_t;
+
+typedef struct {
+    acpi_madt_record_t record;
+    uint8_t  processor_id;
+    uint8_t  apic_id;
+    uint32_t flags;             /* ACPI_MADT_CPU_* */
+} __attribute__((packed)) acpi_madt_local_apic_t;
+
+#define ACPI_MADT_CPU_ENABLED       0x1
+#define ACPI_MADT_CPU_ONLINE_CAPABLE 0x2
+
+typedef struct {
+    acpi_madt_record_t record;
+    uint8_t  id;
+    uint8_t  reserved;
+    uint32_t address;
+    uint32_t gsi_base;          /* First global system interrupt it handles */
+} __attribute__((packed)) acpi_madt_io_apic_t;
+
+typedef struct {
+    acpi_madt_record_t record;
+    uint8_t  bus;               /* 0: ISA */
+    uint8_t  source;            /* ISA IRQ */
+    uint32_t gsi;               /* Global system interrupt it is wired to */
+    uint16_t flags;             /* Polarity and trigger mode (MPS INTI flags) */
+} __attribute__((packed)) acpi_madt_irq_override_t;
+
+typedef struct {
+    acpi_madt_record_t record;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed)) acpi_madt_lapic_override_t;
+
+/* HPET: high precision event timer */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    acpi_generic_address_t base_address;
+    uint8_t  hpet_number;
+    uint16_t minimum_tick;      /* Smallest periodic tick without lost interrupts */
+    uint8_t  page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+/* FADT: fixed hardware ("FACP"); only the fields in use are named,
+ * fields past the end of older (shorter) tables are absent */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t firmware_ctrl;
+    uint32_t dsdt;
+    uint8_t  reserved1;
+    uint8_t  preferred_pm_profile;
+    uint16_t sci_interrupt;
+    uint32_t smi_command;
+    uint8_t  acpi_enable;
+    uint8_t  acpi_disable;
+    uint8_t  s4bios_request;
+    uint8_t  pstate_control;
+    uint32_t pm1a_event_block;
+    uint32_t pm1b_event_block;
+    uint32_t pm1a_control_block;
+    uint32_t pm1b_control_block;
+    uint32_t pm2_control_block;
+    uint32_t pm_timer_block;    /* I/O port of the PM timer */
+    uint32_t gpe0_block;
+    uint32_t gpe1_block;
+    uint8_t  pm1_event_length;
+    uint8_t  pm1_control_length;
+    uint8_t  pm2_control_length;
+    uint8_t  pm_timer_length;   /* 4 if there is a PM timer */
+    uint8_t  gpe0_length;
+    uint8_t  gpe1_length;
+    uint8_t  gpe1_base;
+    uint8_t  cstate_control;
+    uint16_t c2_latency;
+    uint16_t c3_latency;
+    uint16_t flush_size;
+    uint16_t flush_stride;
+    uint8_t  duty_offset;
+    uint8_t  duty_width;
+    uint8_t  day_alarm;
+    uint8_t  month_alarm;
+    uint8_t  century;
+    uint16_t boot_architecture; /* IA-PC boot flags (ACPI 2.0+) */
+    uint8_t  reserved2;
+    uint32_t flags;             /* ACPI_FADT_* */
+    acpi_generic_address_t reset_register;      /* ACPI 2.0+ */
+    uint8_t  reset_value;
+    uint16_t arm_boot_architecture;
+    uint8_t  minor_version;
+    uint64_t x_firmware_ctrl;
+    uint64_t x_dsdt;
+    acpi_generic_address_t x_pm1a_event_block;
+    acpi_generic_address_t x_pm1b_event_block;
+    acpi_generic_address_t x_pm1a_control_block;
+    acpi_generic_address_t x_pm1b_control_block;
+    acpi_generic_address_t x_pm2_control_block;
+    acpi_generic_address_t x_pm_timer_block;
+} __attribute__((packed)) acpi_fadt_t;
+
+#define ACPI_FADT_TIMER_32BIT       (1u << 8)   /* TMR_VAL_EXT: 32-bit PM timer */
+#define ACPI_FADT_RESET_SUPPORTED   (1u << 10)  /* RESET_REG_SUP */
+
+/* Limits of acpi_platform_t */
+#define ACPI_MAX_CPUS               16
+#define ACPI_MAX_IO_APICS           4
+#define ACPI_MAX_IRQ_OVERRIDES      16
+#define ACPI_MAX_ECAM_REGIONS       4
+
+/* Platform description gathered from the tables */
+typedef struct {
+    int present;                /* 0 if no RSDP was found; everything else is empty */
+    uint8_t revision;           /* RSDP revision: 0 for ACPI 1.0 */
+    char oem_id[7];
+
+    /* MADT */
+    uint32_t local_apic_address;
+    int pic_present;            /* Legacy 8259s next to the APICs */
+    uint32_t cpu_count;         /* Usable processors (enabled or online capable) */
+    struct {
+        uint8_t processor_id;
+        uint8_t apic_id;
+    } cpus[ACPI_MAX_CPUS];
+    uint32_t io_apic_count;
+    struct {
+        uint8_t id;
+        uint32_t address;
+        uint32_t gsi_base;
+    } io_apics[ACPI_MAX_IO_APICS];
+    uint32_t irq_override_count;
+    struct {
+        uint8_t source;         /* ISA IRQ */
+        uint32_t gsi;
+        uint16_t flags;
+    } irq_overrides[ACPI_MAX_IRQ_OVERRIDES];
+
+    /* MCFG */
+    uint32_t ecam_count;
+    acpi_mcfg_entry_t ecam[ACPI_MAX_ECAM_REGIONS];
+
+    /* HPET (hpet_address is 0 without one) */
+    uint64_t hpet_address;
+    uint8_t hpet_number;
+    uint16_t hpet_minimum_tick;
+
+    /* FADT */
+    uint16_t sci_irq;
+    uint16_t pm_timer_port;     /* 0 without a PM timer */
+    int pm_timer_32bit;         /* Otherwise the counter is 24 bits wide */
+    int reset_supported;
+    acpi_generic_address_t reset_register;
+    uint8_t reset_value;
+} acpi_platform_t;
+
+/* Get the platform description, parsing the tables on the first call
+ * Returns: the cached description (present is 0 without ACPI)
+ */
+const acpi_platform_t* acpi_platform(void);
+
+/* Map an ISA IRQ to the global system interrupt it is wired to
+ * Returns: the GSI, which is irq itself unless the MADT overrides it
+ */
+uint32_t acpi_isa_irq_to_gsi(uint8_t irq);
+
+/* Reset the machine through the FADT reset register
+ * Returns: -1 if the firmware has no usable reset register (on success
+ * it does not return)
+ */
+int acpi_reboot(void);
+
+/* Find a table by its four-character signature (e.g. "MCFG")
+ * Returns: the mapped, checksummed table, or NULL if the firmware has
+ * none (or no ACPI at all)
+ */
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+#endif /* ACPI_H */
@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "acpi_pm.h"
+#include "acpi.h"
+#include "../arch/x86/io.h"
+#include "../clocksource.h"
+#include "../init.h"
+
+/* I/O port of the counter (0 until acpi_pm_init() succeeds) */
+static uint16_t acpi_pm_port = 0;
+
+/* Read the counter; the bits above its width read as zero */
+uint64_t acpi_pm_read(void) {
+    return acpi_pm_port ? inl(acpi_pm_port) : 0;
+}
+
+static clocksource_t acpi_pm_clocksource = {
+    "acpi_pm", CLOCKSOURCE_RATING_PM_TIMER, acpi_pm_read, 0xFFFFFF, ACPI_PM_TIMER_HZ, 0
+};
+
+/* Register the clocksource if the FADT describes a PM timer */
+int acpi_pm_init(void) {
+    const acpi_platform_t* platform = acpi_platform();
+    if (!platform->pm_timer_port) {
+        return -1;
+    }
+
+    acpi_pm_port = platform->pm_timer_port;
+    if (platform->pm_timer_32bit) {
+        acpi_pm_clocksource.mask = 0xFFFFFFFF;
+    }
+
+    /* A timer that firmware left disabled reads a constant */
+    uint32_t first = (uint32_t)acpi_pm_read();
+    int moving = 0;
+    for (int i = 0; i < 1000 && !moving; i++) {
+        moving = (uint32_t)acpi_pm_read() != first;
+    }
+    if (!moving) {
+        printf("ACPI PM timer: port %04x does not count\n", acpi_pm_port);
+        acpi_pm_port = 0;
+        return -1;
+    }
+
+    printf("ACPI PM timer: port %04x, %u bits\n", acpi_pm_port,
+           platform->pm_timer_32bit ? 32 : 24);
+    clocksource_register(&acpi_pm_clocksource);
+    return 0;
+}
+
+/* Optional hardware: its absence is not a failure */
+static int acpi_pm_initcall(void) {
+    acpi_pm_init();
+    return 0;
+}
+INITCALL(acpi_pm, acpi_pm_initcall, "");
@@ -0,0 +1,26 @@
+#ifndef ACPI_PM_H
+#define ACPI_PM_H
+
+#include <stdint.h>
+
+/* ACPI power management timer
+ *
+ * A free-running counter in the chipset's PM I/O block, ticking at
+ * 3.579545 MHz whatever the CPU's power state. The FADT gives its port
+ * and width: 24 bits (wrapping every 4.7 s) or 32 bits. One inl() reads
+ * it, which is cheap next to the PIT's latch-and-two-reads but still a
+ * bus cycle, so it usually loses to the HPET and the TSC.
+ */
+
+/* Counter frequency */
+#define ACPI_PM_TIMER_HZ    3579545
+
+/* Register the "acpi_pm" clocksource if the FADT describes a PM timer
+ * Returns: 0 on success, -1 without a PM timer
+ */
+int acpi_pm_init(void);
+
+/* Read the counter (0 before acpi_pm_init() succeeded) */
+uint64_t acpi_pm_read(void);
+
+#endif /* ACPI_PM_H */
@@ -0,0 +1,685 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "ahci.h"
+#include "pci.h"
+#include "pci_driver.h"
+#include "pci_msi.h"
+#include "../arch/x86/cpu.h"
+#include "../arch/x86/paging.h"
+#include "../arch/x86/tsc.h"
+#include "../trace.h"
+
+/* Controller registers */
+#define AHCI_CAP                0x00
+#define AHCI_GHC                0x04
+#define AHCI_IS                 0x08    /* One bit per port with an interrupt pending */
+#define AHCI_PI                 0x0C    /* Ports implemented */
+#define AHCI_VS                 0x10
+
+#define AHCI_CAP_SLOTS_SHIFT    8       /* Command slots - 1 */
+#define AHCI_CAP_SLOTS_MASK     0x1F
+#define AHCI_CAP_NCQ            (1u << 30)
+
+#define AHCI_GHC_IE             (1u << 1)
+#define AHCI_GHC_AE             (1u << 31)  /* AHCI mode, as opposed to legacy IDE */
+
+/* Port registers, from AHCI_PORT_BASE + port * AHCI_PORT_SIZE */
+#define AHCI_PORT_BASE          0x100
+#define AHCI_PORT_SIZE          0x80
+#define AHCI_PxCLB              0x00    /* Command list, 1 KiB aligned */
+#define AHCI_PxCLBU             0x04
+#define AHCI_PxFB               0x08    /* Received FIS area, 256 bytes aligned */
+#define AHCI_PxFBU              0x0C
+#define AHCI_PxIS               0x10
+#define AHCI_PxIE               0x14
+#define AHCI_PxCMD              0x18
+#define AHCI_PxTFD              0x20    /* Status in bits 0-7, error in bits 8-15 */
+#define AHCI_PxSIG              0x24
+#define AHCI_PxSSTS             0x28
+#define AHCI_PxSCTL             0x2C
+#define AHCI_PxSERR             0x30
+#define AHCI_PxSACT             0x34    /* Queued commands not yet completed */
+#define AHCI_PxCI               0x38    /* Commands issued */
+
+#define AHCI_PxCMD_ST           (1u << 0)   /* Process the command list */
+#define AHCI_PxCMD_SUD          (1u << 1)   /* Spin up */
+#define AHCI_PxCMD_POD          (1u << 2)   /* Power on */
+#define AHCI_PxCMD_FRE          (1u << 4)   /* Accept received FISes */
+#define AHCI_PxCMD_FR           (1u << 14)
+#define AHCI_PxCMD_CR           (1u << 15)
+
+/* Port interrupts: completions and the errors that stop the port */
+#define AHCI_PxIS_DHRS          (1u << 0)   /* Device to host register FIS */
+#define AHCI_PxIS_PSS           (1u << 1)   /* PIO setup FIS */
+#define AHCI_PxIS_DSS           (1u << 2)   /* DMA setup FIS */
+#define AHCI_PxIS_SDBS          (1u << 3)   /* Set device bits FIS: NCQ completions */
+#define AHCI_PxIS_IFS           (1u << 27)  /* Interface fatal error */
+#define AHCI_PxIS_HBDS          (1u << 28)  /* Host bus data error */
+#define AHCI_PxIS_HBFS          (1u << 29)  /* Host bus fatal error */
+#define AHCI_PxIS_TFES          (1u << 30)  /* Task file error */
+#define AHCI_PxIS_ERRORS        (AHCI_PxIS_IFS | AHCI_PxIS_HBDS | AHCI_PxIS_HBFS | AHCI_PxIS_TFES)
+#define AHCI_PxIE_DEFAULT       (AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_DSS | \
+                                 AHCI_PxIS_SDBS | AHCI_PxIS_ERRORS)
+
+#define AHCI_PxSSTS_DET_MASK    0x0F
+#define AHCI_PxSSTS_DET_PRESENT 0x03    /* Device present, link up */
+#define AHCI_PxSCTL_DET_RESET   0x01    /* COMRESET while set */
+
+#define AHCI_SIG_ATA            0x00000101
+
+/* Task file status bits */
+#define AHCI_TFD_ERR            0x01
+#define AHCI_TFD_DRQ            0x08
+#define AHCI_TFD_BSY            0x80
+
+/* ATA commands */
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_READ_FPDMA      0x60
+#define ATA_CMD_WRITE_FPDMA     0x61
+#define ATA_CMD_IDENTIFY        0xEC
+
+#define ATA_DEVICE_LBA          0x40
+
+/* IDENTIFY DEVICE words */
+#define ATA_ID_MODEL            27
+#define ATA_ID_QUEUE_DEPTH      75      /* Depth - 1 in bits 0-4 */
+#define ATA_ID_SATA_CAP         76
+#define ATA_ID_COMMAND_SET_2    83
+#define ATA_ID_SECTORS_28       60
+#define ATA_ID_SECTORS_48       100
+
+#define ATA_ID_SATA_NCQ         (1u << 8)
+#define ATA_ID_CMD_LBA48        (1u << 10)
+
+/* 28-bit commands move at most 256 sectors below this */
+#define ATA_LBA28_LIMIT         (1ull << 28)
+#define ATA_LBA28_MAX_SECTORS   256
+
+/* Register FIS, host to device */
+#define FIS_TYPE_REG_H2D        0x27
+#define FIS_H2D_COMMAND         0x80    /* The FIS carries a command */
+#define FIS_H2D_LENGTH          5       /* Dwords */
+
+/* Command header flags */
+#define AHCI_HEADER_WRITE       (1u << 6)
+
+/* A PRD entry moves at most 4 MiB */
+#define AHCI_PRD_MAX_BYTES      (4u * 1024 * 1024)
+
+/* Controllers bound */
+#define AHCI_MAX_CONTROLLERS    2
+
+/* Waits during port setup and recovery */
+#define AHCI_PORT_TIMEOUT_MS    1000
+
+typedef struct {
+    uint16_t flags;             /* FIS length in dwords, AHCI_HEADER_* */
+    uint16_t prd_count;
+    volatile uint32_t bytes_transferred;
+    uint32_t table_low;         /* Command table, 128 bytes aligned */
+    uint32_t table_high;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_command_header_t;
+
+typedef struct {
+    uint32_t address_low;
+    uint32_t address_high;
+    uint32_t reserved;
+    uint32_t byte_count;        /* Bytes - 1; bit 31 asks for an interrupt */
+} __attribute__((packed)) ahci_prd_t;
+
+typedef struct {
+    uint8_t fis[64];
+    uint8_t atapi_command[16];
+    uint8_t reserved[48];
+    ahci_prd_t prd[AHCI_PRD_ENTRIES];
+} __attribute__((packed, aligned(128))) ahci_command_table_t;
+
+/* Everything the controller reads and writes for one port */
+typedef struct {
+    ahci_command_header_t headers[AHCI_MAX_SLOTS];
+    ahci_command_table_t tables[AHCI_MAX_SLOTS];
+    uint8_t received_fis[256];
+} __attribute__((aligned(1024))) ahci_port_memory_t;
+
+typedef struct {
+    volatile uint32_t* hba;     /* Controller registers */
+    volatile uint32_t* regs;    /* This port's registers */
+    ahci_port_memory_t* memory;
+    ahci_request_t* slots[AHCI_MAX_SLOTS];
+    uint32_t issued;            /* Slots in flight */
+    uint32_t slot_mask;         /* Slots the disk's queue depth allows */
+    ahci_request_t* head;       /* Waiting for a slot */
+    ahci_request_t* tail;
+    uint64_t progress;          /* TSC of the last issue into an idle port or completion */
+    uint8_t recover;            /* The interrupt saw an error; the waiter restarts the port */
+    uint8_t polled;             /* The controller got no interrupt vector */
+} ahci_port_t;
+
+static ahci_port_memory_t ahci_memory[AHCI_MAX_PORTS];
+static ahci_port_t ahci_ports[AHCI_MAX_PORTS];
+static ahci_disk_t ahci_disks[AHCI_MAX_PORTS];
+static uint32_t ahci_disk_total = 0;
+
+/* Block layer view of the disks; one port request per block request */
+static block_device_t ahci_block_devices[AHCI_MAX_PORTS];
+static ahci_request_t ahci_block_requests[AHCI_MAX_PORTS][BLOCK_QUEUE_REQUESTS];
+
+static volatile uint32_t* ahci_controllers[AHCI_MAX_CONTROLLERS];
+static uint32_t ahci_controller_count = 0;
+
+static inline uint32_t ahci_read_reg(volatile uint32_t* base, uint32_t reg) {
+    return base[reg / 4];
+}
+
+static inline void ahci_write_reg(volatile uint32_t* base, uint32_t reg, uint32_t value) {
+    base[reg / 4] = value;
+}
+
+/* Poll until (register & mask) == value
+ * Returns: 0, or -1 on timeout */
+static int ahci_poll(volatile uint32_t* base, uint32_t reg, uint32_t mask, uint32_t value) {
+    uint64_t start = tsc_read();
+    while ((ahci_read_reg(base, reg) & mask) != value) {
+        if (tsc_to_us(tsc_read() - start) > (uint64_t)AHCI_PORT_TIMEOUT_MS * 1000) return -1;
+    }
+    return 0;
+}
+
+/* Stop command processing and FIS reception */
+static int ahci_port_stop(ahci_port_t* port) {
+    uint32_t cmd = ahci_read_reg(port->regs, AHCI_PxCMD);
+    ahci_write_reg(port->regs, AHCI_PxCMD, cmd & ~AHCI_PxCMD_ST);
+    if (ahci_poll(port->regs, AHCI_PxCMD, AHCI_PxCMD_CR, 0) != 0) return -1;
+    cmd = ahci_read_reg(port->regs, AHCI_PxCMD);
+    ahci_write_reg(port->regs, AHCI_PxCMD, cmd & ~AHCI_PxCMD_FRE);
+    return ahci_poll(port->regs, AHCI_PxCMD, AHCI_PxCMD_FR, 0);
+}
+
+/* Clear errors and start the port once the device is idle */
+static int ahci_port_run(ahci_port_t* port) {
+    ahci_write_reg(port->regs, AHCI_PxSERR, 0xFFFFFFFF);
+    ahci_write_reg(port->regs, AHCI_PxIS, 0xFFFFFFFF);
+
+    uint32_t cmd = ahci_read_reg(port->regs, AHCI_PxCMD);
+    ahci_write_reg(port->regs, AHCI_PxCMD, cmd | AHCI_PxCMD_SUD | AHCI_PxCMD_POD | AHCI_PxCMD_FRE);
+    if (ahci_poll(port->regs, AHCI_PxTFD, AHCI_TFD_BSY | AHCI_TFD_DRQ, 0) != 0) return -1;
+
+    cmd = ahci_read_reg(port->regs, AHCI_PxCMD);
+    ahci_write_reg(port->regs, AHCI_PxCMD, cmd | AHCI_PxCMD_ST);
+    return 0;
+}
+
+/* Fill a slot's command FIS and PRDs
+ * Returns: 0, or -1 if the memory needs more than AHCI_PRD_ENTRIES */
+static int ahci_build_command(ahci_port_t* port, uint32_t slot, uint8_t command, uint64_t lba,
+                              uint16_t count, uint16_t features, uint8_t device,
+                              const block_segment_t* segments, uint32_t segment_count, int write) {
+    ahci_command_table_t* table = &port->memory->tables[slot];
+    ahci_command_header_t* header = &port->memory->headers[slot];
+
+    uint8_t* fis = table->fis;
+    memset(fis, 0, 20);
+    fis[0] = FIS_TYPE_REG_H2D;
+    fis[1] = FIS_H2D_COMMAND;
+    fis[2] = command;
+    fis[3] = (uint8_t)features;
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba >> 8);
+    fis[6] = (uint8_t)(lba >> 16);
+    fis[7] = device;
+    fis[8] = (uint8_t)(lba >> 24);
+    fis[9] = (uint8_t)(lba >> 32);
+    fis[10] = (uint8_t)(lba >> 40);
+    fis[11] = (uint8_t)(features >> 8);
+    fis[12] = (uint8_t)count;
+    fis[13] = (uint8_t)(count >> 8);
+
+    uint16_t entries = 0;
+    for (uint32_t s = 0; s < segment_count; s++) {
+        uint32_t address = (uint32_t)segments[s].addr;
+        uint32_t bytes = segments[s].len;
+        while (bytes > 0) {
+            if (entries == AHCI_PRD_ENTRIES) return -1;
+            uint32_t length = bytes < AHCI_PRD_MAX_BYTES ? bytes : AHCI_PRD_MAX_BYTES;
+            table->prd[entries].address_low = address;
+            table->prd[entries].address_high = 0;
+            table->prd[entries].reserved = 0;
+            table->prd[entries].byte_count = length - 1;
+            entries++;
+            address += length;
+            bytes -= length;
+        }
+    }
+
+    header->flags = FIS_H2D_LENGTH | (write ? AHCI_HEADER_WRITE : 0);
+    header->prd_count = entries;
+    header->bytes_transferred = 0;
+    header->table_low = (uint32_t)table;
+    header->table_high = 0;
+    return 0;
+}
+
+/* Hand a slot's request back to its owner */
+static void ahci_complete(ahci_port_t* port, uint32_t slot, int status, uint8_t error) {
+    ahci_request_t* request = port->slots[slot];
+    port->slots[slot] = NULL;
+    port->issued &= ~(1u << slot);
+
+    TRACE(AHCI_COMPLETE, request->disk, slot, (uint32_t)status);
+    request->error = error;
+    request->status = status;
+    if (request->done) {
+        request->done(request);
+    }
+}
+
+/* Move waiting requests into free slots (interrupts disabled) */
+static void ahci_port_start(ahci_port_t* port) {
+    uint32_t disk_index = (uint32_t)(port - ahci_ports);
+    const ahci_disk_t* disk = &ahci_disks[disk_index];
+    if (port->recover) return;
+
+    while (port->head) {
+        uint32_t free = port->slot_mask & ~port->issued;
+        if (!free) return;
+        uint32_t slot = (uint32_t)__builtin_ctz(free);
+
+        ahci_request_t* request = port->head;
+        port->head = request->next;
+        if (!port->head) port->tail = NULL;
+        request->next = NULL;
+
+        uint8_t command;
+        uint16_t count, features;
+        uint8_t device = ATA_DEVICE_LBA;
+        if (disk->ncq) {
+            /* Queued: the count moves to the features field, the tag goes in count */
+            command = request->write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+            features = (uint16_t)request->count;
+            count = (uint16_t)(slot << 3);
+        } else if (disk->lba48) {
+            command = request->write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+            features = 0;
+            count = (uint16_t)request->count;
+        } else {
+            command = request->write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+            features = 0;
+            count = (uint16_t)request->count;
+            device |= (uint8_t)((request->lba >> 24) & 0x0F);
+        }
+
+        block_segment_t whole = { request->buffer, request->count * AHCI_SECTOR_SIZE };
+        port->slots[slot] = request;
+        port->issued |= 1u << slot;
+        if (ahci_build_command(port, slot, command, request->lba, count, features, device,
+                               request->segment_count ? request->segments : &whole,
+                               request->segment_count ? request->segment_count : 1,
+                               request->write) != 0) {
+            ahci_complete(port, slot, AHCI_REQUEST_ERROR, 0);
+            continue;
+        }
+
+        if (port->issued == (1u << slot)) {
+            port->progress = tsc_read();
+        }
+        TRACE(AHCI_ISSUE, disk_index, slot, (uint32_t)request->lba);
+        if (disk->ncq) {
+            ahci_write_reg(port->regs, AHCI_PxSACT, 1u << slot);
+        }
+        ahci_write_reg(port->regs, AHCI_PxCI, 1u << slot);
+    }
+}
+
+/* Fail everything in flight and restart the port; a COMRESET clears a
+ * device that stays busy. NCQ errors abort every queued command, so no
+ * attempt is made to find the one that failed. */
+static void ahci_port_recover(ahci_port_t* port, int status) {
+    port->recover = 0;
+    uint8_t error = (uint8_t)(ahci_read_reg(port->regs, AHCI_PxTFD) >> 8);
+    ahci_port_stop(port);
+
+    if (ahci_read_reg(port->regs, AHCI_PxTFD) & (AHCI_TFD_BSY | AHCI_TFD_DRQ)) {
+        uint32_t sctl = ahci_read_reg(port->regs, AHCI_PxSCTL);
+        ahci_write_reg(port->regs, AHCI_PxSCTL, (sctl & ~0x0Fu) | AHCI_PxSCTL_DET_RESET);
+        uint64_t start = tsc_read();
+        while (tsc_to_us(tsc_read() - start) < 1000) {
+            /* COMRESET must be held for at least 1 ms */
+        }
+        ahci_write_reg(port->regs, AHCI_PxSCTL, sctl & ~0x0Fu);
+        ahci_poll(port->regs, AHCI_PxSSTS, AHCI_PxSSTS_DET_MASK, AHCI_PxSSTS_DET_PRESENT);
+    }
+    ahci_port_run(port);
+
+    printf("AHCI: disk %u %s, port restarted\n", (uint32_t)(port - ahci_ports),
+           status == AHCI_REQUEST_TIMEOUT ? "timed out" : "reported an error");
+    while (port->issued) {
+        ahci_complete(port, (uint32_t)__builtin_ctz(port->issued), status, error);
+    }
+    ahci_port_start(port);
+}
+
+/* Complete what the device finished and refill the slots (interrupts disabled)
+ * Runs in the interrupt handler too, so an error only marks the port for
+ * ahci_port_poll() to recover: a COMRESET waits for up to seconds. */
+static void ahci_port_service(ahci_port_t* port) {
+    uint32_t status = ahci_read_reg(port->regs, AHCI_PxIS);
+    ahci_write_reg(port->regs, AHCI_PxIS, status);
+    if (status & AHCI_PxIS_ERRORS) {
+        port->recover = 1;
+    }
+    if (port->recover) return;
+
+    /* A queued command is done when the device clears its SACT bit */
+    uint32_t active = ahci_read_reg(port->regs, AHCI_PxSACT) | ahci_read_reg(port->regs, AHCI_PxCI);
+    uint32_t done = port->issued & ~active;
+    if (done) {
+        port->progress = tsc_read();
+    }
+    while (done) {
+        uint32_t slot = (uint32_t)__builtin_ctz(done);
+        done &= done - 1;
+        ahci_complete(port, slot, AHCI_REQUEST_DONE, 0);
+    }
+    ahci_port_start(port);
+}
+
+static void ahci_interrupt(registers_t* regs) {
+    (void)regs;
+    for (uint32_t c = 0; c < ahci_controller_count; c++) {
+        volatile uint32_t* hba = ahci_controllers[c];
+        uint32_t pending = ahci_read_reg(hba, AHCI_IS);
+        if (!pending) continue;
+
+        for (uint32_t d = 0; d < ahci_disk_total; d++) {
+            if (ahci_ports[d].hba == hba && (pending & (1u << ahci_disks[d].port))) {
+                ahci_port_service(&ahci_ports[d]);
+            }
+        }
+        ahci_write_reg(hba, AHCI_IS, pending);
+    }
+}
+
+/* Service a port from thread context, restarting it after an error or
+ * when commands have made no progress for AHCI_TIMEOUT_MS (interrupts disabled) */
+static void ahci_port_poll(ahci_port_t* port) {
+    ahci_port_service(port);
+    if (port->recover) {
+        ahci_port_recover(port, AHCI_REQUEST_ERROR);
+    } else if (port->issued && tsc_to_us(tsc_read() - port->progress) > (uint64_t)AHCI_TIMEOUT_MS * 1000) {
+        ahci_port_recover(port, AHCI_REQUEST_TIMEOUT);
+    }
+}
+
+/* Queue a request on its disk's port */
+int ahci_submit(ahci_request_t* request) {
+    if (request->disk >= ahci_disk_total || request->count == 0) return -1;
+    if (request->segment_count ? !block_segments_valid(request->segments, request->segment_count,
+                                                       request->count * AHCI_SECTOR_SIZE)
+                               : ((uint32_t)request->buffer & 1)) {
+        return -1;
+    }
+    const ahci_disk_t* disk = &ahci_disks[request->disk];
+    uint64_t end = request->lba + request->count;
+    if (end > disk->sectors || request->count > AHCI_MAX_SECTORS ||
+        (!disk->lba48 && (end > ATA_LBA28_LIMIT || request->count > ATA_LBA28_MAX_SECTORS))) {
+        return -1;
+    }
+
+    ahci_port_t* port = &ahci_ports[request->disk];
+    request->status = AHCI_REQUEST_PENDING;
+    request->error = 0;
+    request->next = NULL;
+
+    uint32_t flags = irq_save();
+    if (port->tail) {
+        port->tail->next = request;
+    } else {
+        port->head = request;
+    }
+    port->tail = request;
+    ahci_port_start(port);
+    irq_restore(flags);
+    return 0;
+}
+
+/* Wait until a submitted request completes */
+int ahci_wait(ahci_request_t* request) {
+    ahci_port_t* port = &ahci_ports[request->disk];
+
+    while (request->status == AHCI_REQUEST_PENDING) {
+        uint32_t flags = irq_save();
+        ahci_port_poll(port);
+        if (request->status == AHCI_REQUEST_PENDING && (flags & EFLAGS_IF) && !port->polled) {
+            cpu_wait_for_interrupt(port->progress + (uint64_t)AHCI_TIMEOUT_MS * tsc_khz());
+        }
+        irq_restore(flags);
+    }
+    return request->status;
+}
+
+/* Split a transfer into requests of at most AHCI_MAX_SECTORS and run them in turn */
+static int ahci_transfer(uint32_t disk, uint64_t lba, uint32_t count, void* buffer, int write) {
+    uint8_t* bytes = (uint8_t*)buffer;
+    uint32_t limit = AHCI_MAX_SECTORS;
+    if (disk < ahci_disk_total && !ahci_disks[disk].lba48) {
+        limit = ATA_LBA28_MAX_SECTORS;
+    }
+
+    while (count > 0) {
+        uint32_t chunk = count < limit ? count : limit;
+        ahci_request_t request = { disk, lba, chunk, bytes, NULL, 0, write, 0, 0, NULL, NULL, NULL };
+        if (ahci_submit(&request) != 0) return -1;
+        int status = ahci_wait(&request);
+        if (status != AHCI_REQUEST_DONE) return status;
+
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * AHCI_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+int ahci_read(uint32_t disk, uint64_t lba, uint32_t count, void* buffer) {
+    return ahci_transfer(disk, lba, count, buffer, 0);
+}
+
+int ahci_write(uint32_t disk, uint64_t lba, uint32_t count, const void* buffer) {
+    return ahci_transfer(disk, lba, count, (void*)buffer, 1);
+}
+
+uint32_t ahci_disk_count(void) {
+    return ahci_disk_total;
+}
+
+const ahci_disk_t* ahci_get_disk(uint32_t index) {
+    return index < ahci_disk_total ? &ahci_disks[index] : NULL;
+}
+
+static void ahci_block_done(ahci_request_t* native) {
+    block_complete((block_request_t*)native->context, native->status != AHCI_REQUEST_DONE);
+}
+
+/* Turn a block request into a port request */
+static int ahci_block_start(block_device_t* dev, block_request_t* request) {
+    uint32_t disk = (uint32_t)(dev - ahci_block_devices);
+    ahci_request_t* native = &ahci_block_requests[disk][request->tag];
+    native->disk = disk;
+    native->lba = request->sector;
+    native->count = request->sectors;
+    native->buffer = NULL;
+    native->segments = request->segments;
+    native->segment_count = request->segment_count;
+    native->write = request->write;
+    native->done = ahci_block_done;
+    native->context = request;
+    if (ahci_submit(native) != 0) {
+        block_complete(request, -1);
+    }
+    return 0;
+}
+
+static void ahci_block_poll(block_device_t* dev) {
+    ahci_port_poll(&ahci_ports[dev - ahci_block_devices]);
+}
+
+static const block_device_ops_t ahci_block_ops = { ahci_block_start, ahci_block_poll };
+
+/* Run IDENTIFY DEVICE in slot 0 and poll for it (port interrupts still off) */
+static int ahci_identify(ahci_port_t* port, uint16_t* id) {
+    block_segment_t segment = { id, 512 };
+    if (ahci_build_command(port, 0, ATA_CMD_IDENTIFY, 0, 0, 0, 0, &segment, 1, 0) != 0) return -1;
+    ahci_write_reg(port->regs, AHCI_PxCI, 1);
+    if (ahci_poll(port->regs, AHCI_PxCI, 1, 0) != 0) return -1;
+    if (ahci_read_reg(port->regs, AHCI_PxTFD) & AHCI_TFD_ERR) return -1;
+    ahci_write_reg(port->regs, AHCI_PxIS, 0xFFFFFFFF);
+    return 0;
+}
+
+/* Bring up one port with an ATA disk behind it */
+static void ahci_port_init(volatile uint32_t* hba, uint32_t number, uint32_t hba_slots, int hba_ncq) {
+    volatile uint32_t* regs = hba + (AHCI_PORT_BASE + number * AHCI_PORT_SIZE) / 4;
+    if ((ahci_read_reg(regs, AHCI_PxSSTS) & AHCI_PxSSTS_DET_MASK) != AHCI_PxSSTS_DET_PRESENT ||
+        ahci_read_reg(regs, AHCI_PxSIG) != AHCI_SIG_ATA) {
+        return;     /* Empty port, or a packet device */
+    }
+    if (ahci_disk_total == AHCI_MAX_PORTS) {
+        printf("AHCI: port %u ignored, %u disks at most\n", number, AHCI_MAX_PORTS);
+        return;
+    }
+
+    uint32_t index = ahci_disk_total;
+    ahci_port_t* port = &ahci_ports[index];
+    port->hba = hba;
+    port->regs = regs;
+    port->memory = &ahci_memory[index];
+    memset(port->memory, 0, sizeof(*port->memory));
+
+    if (ahci_port_stop(port) != 0) {
+        printf("AHCI: port %u does not stop\n", number);
+        return;
+    }
+    ahci_write_reg(regs, AHCI_PxCLB, (uint32_t)port->memory->headers);
+    ahci_write_reg(regs, AHCI_PxCLBU, 0);
+    ahci_write_reg(regs, AHCI_PxFB, (uint32_t)port->memory->received_fis);
+    ahci_write_reg(regs, AHCI_PxFBU, 0);
+    ahci_write_reg(regs, AHCI_PxIE, 0);
+    if (ahci_port_run(port) != 0) {
+        printf("AHCI: port %u stays busy\n", number);
+        return;
+    }
+
+    static uint16_t id[256];
+    if (ahci_identify(port, id) != 0) {
+        printf("AHCI: port %u does not identify\n", number);
+        ahci_port_stop(port);
+        return;
+    }
+
+    ahci_disk_t* disk = &ahci_disks[index];
+    disk->port = (uint8_t)number;
+    disk->lba48 = (id[ATA_ID_COMMAND_SET_2] & ATA_ID_CMD_LBA48) != 0;
+    if (disk->lba48) {
+        disk->sectors = (uint64_t)id[ATA_ID_SECTORS_48] |
+                        (uint64_t)id[ATA_ID_SECTORS_48 + 1] << 16 |
+                        (uint64_t)id[ATA_ID_SECTORS_48 + 2] << 32 |
+                        (uint64_t)id[ATA_ID_SECTORS_48 + 3] << 48;
+    } else {
+        disk->sectors = (uint32_t)id[ATA_ID_SECTORS_28] | (uint32_t)id[ATA_ID_SECTORS_28 + 1] << 16;
+    }
+    for (int i = 0; i < 20; i++) {
+        disk->model[2 * i] = (char)(id[ATA_ID_MODEL + i] >> 8);
+        disk->model[2 * i + 1] = (char)(id[ATA_ID_MODEL + i] & 0xFF);
+    }
+    int length = 40;
+    while (length > 0 && disk->model[length - 1] == ' ') length--;
+    disk->model[length] = '\0';
+
+    /* Queue as deep as both the controller and the drive allow */
+    uint32_t depth = 1;
+    disk->ncq = hba_ncq && (id[ATA_ID_SATA_CAP] & ATA_ID_SATA_NCQ) && disk->lba48;
+    if (disk->ncq) {
+        depth = (id[ATA_ID_QUEUE_DEPTH] & 0x1F) + 1u;
+        if (depth > hba_slots) depth = hba_slots;
+    }
+    disk->queue_depth = (uint8_t)depth;
+    port->slot_mask = depth == 32 ? 0xFFFFFFFF : (1u << depth) - 1;
+
+    ahci_write_reg(regs, AHCI_PxIE, AHCI_PxIE_DEFAULT);
+    ahci_disk_total++;
+
+    block_device_t* block = &ahci_block_devices[index];
+    snprintf(block->name, sizeof(block->name), "ahci%u", index);
+    block->sectors = disk->sectors;
+    block->max_sectors = disk->lba48 ? AHCI_MAX_SECTORS : ATA_LBA28_MAX_SECTORS;
+    block->max_segments = AHCI_PRD_ENTRIES;
+    block->queue_depth = depth;
+    block->ops = &ahci_block_ops;
+
+    printf("AHCI: disk %u on port %u: %s, %llu MiB, %s depth %u\n", index, number, disk->model,
+           (unsigned long long)(disk->sectors / (1024 * 1024 / AHCI_SECTOR_SIZE)),
+           disk->ncq ? "NCQ" : "DMA", depth);
+    block_register(block);
+}
+
+static int ahci_probe(const pci_device_t* dev, const pci_device_id_t* id) {
+    (void)id;
+    const pci_bar_t* bar = &dev->bars[5];
+    if (bar->io || !bar->base || (bar->base >> 32)) {
+        printf("AHCI: %02x:%02x.%x has no usable ABAR\n", dev->bus, dev->device, dev->func);
+        return -1;
+    }
+    if (ahci_controller_count == AHCI_MAX_CONTROLLERS) return -1;
+    if (paging_map_region((uint32_t)bar->base, (uint32_t)bar->size, PDE_CACHE_DISABLE) != 0) {
+        printf("AHCI: cannot map ABAR at %08x\n", (uint32_t)bar->base);
+        return -1;
+    }
+    volatile uint32_t* hba = (volatile uint32_t*)(uint32_t)bar->base;
+    ahci_controllers[ahci_controller_count++] = hba;
+
+    pci_enable_device(dev, PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER);
+    ahci_write_reg(hba, AHCI_GHC, ahci_read_reg(hba, AHCI_GHC) | AHCI_GHC_AE);
+
+    uint32_t cap = ahci_read_reg(hba, AHCI_CAP);
+    uint32_t slots = ((cap >> AHCI_CAP_SLOTS_SHIFT) & AHCI_CAP_SLOTS_MASK) + 1;
+    uint32_t implemented = ahci_read_reg(hba, AHCI_PI);
+    uint32_t version = ahci_read_reg(hba, AHCI_VS);
+    printf("AHCI: %02x:%02x.%x version %u.%u, %u slots%s, ports %08x\n",
+           dev->bus, dev->device, dev->func, version >> 16, (version >> 8) & 0xFF,
+           slots, (cap & AHCI_CAP_NCQ) ? ", NCQ" : "", implemented);
+
+    uint32_t first_disk = ahci_disk_total;
+    for (uint32_t number = 0; number < 32; number++) {
+        if (implemented & (1u << number)) {
+            ahci_port_init(hba, number, slots, (cap & AHCI_CAP_NCQ) != 0);
+        }
+    }
+    if (ahci_disk_total == first_disk) {
+        return 0;
+    }
+
+    /* One vector for the whole controller; the handler checks every port */
+    if (pci_irq_alloc(dev, 1, 1, PCI_IRQ_ALL_TYPES) > 0) {
+        pci_irq_set_handler(dev, 0, ahci_interrupt);
+        ahci_write_reg(hba, AHCI_IS, 0xFFFFFFFF);
+        ahci_write_reg(hba, AHCI_GHC, ahci_read_reg(hba, AHCI_GHC) | AHCI_GHC_IE);
+    } else {
+        printf("AHCI: no interrupt, completions are polled\n");
+        for (uint32_t d = first_disk; d < ahci_disk_total; d++) {
+            ahci_ports[d].polled = 1;
+            ahci_block_devices[d].polled = 1;
+        }
+    }
+    return 0;
+}
+
+static const pci_device_id_t ahci_ids[] = {
+    { PCI_ANY_ID, PCI_ANY_ID, 0x010601, 0xFFFFFF },     /* SATA, AHCI 1.0 interface */
+    { 0 }
+};
+PCI_DRIVER(ahci) = { "ahci", ahci_ids, ahci_probe, NULL, 0 };
@@ -0,0 +1,111 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../block.h"
+
+/* AHCI SATA host controllers (QEMU -device ahci, the q35 chipset's ICH9)
+ *
+ * The controller's registers are memory mapped (ABAR, BAR5). Each port
+ * has a command list of 32 slots and an area the device writes received
+ * FISes to; a slot points at a command table holding the command FIS
+ * and the PRD list of the buffer. Software fills a slot and sets its
+ * bit in the port's command issue register.
+ *
+ * Disks that support Native Command Queuing get READ/WRITE FPDMA QUEUED
+ * commands, up to the smaller of the controller's slots and the drive's
+ * queue depth (at most 32) in flight at once, completed in whatever
+ * order the drive finishes them. Other disks get one DMA command at a
+ * time. Requests beyond the free slots wait in a per-port queue.
+ *
+ * Completions arrive on one interrupt for the controller, MSI when the
+ * PCI layer can set it up (see pci_msi.h), INTx otherwise:
+ *
+ *   ahci_request_t request = { .disk = 0, .lba = 0, .count = 8, .buffer = page };
+ *   if (ahci_submit(&request) == 0 && ahci_wait(&request) == AHCI_REQUEST_DONE) { ... }
+ *
+ * Buffers must be identity mapped (all kernel memory is) and 2-byte aligned.
+ */
+
+#define AHCI_SECTOR_SIZE        512
+
+/* Limits */
+#define AHCI_MAX_PORTS          4       /* Disks handled; further ports are ignored */
+#define AHCI_MAX_SLOTS          32
+#define AHCI_MAX_SECTORS        8192    /* Per request: 4 MiB, one PRD entry */
+#define AHCI_PRD_ENTRIES        8       /* Fills the command table to 256 bytes */
+
+/* Time a command may take before the port is restarted */
+#define AHCI_TIMEOUT_MS         5000
+
+/* Request status */
+#define AHCI_REQUEST_PENDING    1       /* Queued or in flight */
+#define AHCI_REQUEST_DONE       0
+#define AHCI_REQUEST_ERROR      -1      /* Device or transport error; see error */
+#define AHCI_REQUEST_TIMEOUT    -2
+
+/* One transfer; owned by the driver from ahci_submit() until status leaves PENDING */
+typedef struct ahci_request {
+    uint32_t disk;              /* Index for ahci_get_disk() */
+    uint64_t lba;               /* First sector */
+    uint32_t count;             /* Sectors, 1 to AHCI_MAX_SECTORS */
+    void* buffer;               /* count * AHCI_SECTOR_SIZE bytes */
+    /* Scatter-gather list used instead of buffer when segment_count is set */
+    const block_segment_t* segments;
+    uint32_t segment_count;
+    int write;                  /* 1 to write the buffer to the disk */
+
+    volatile int status;        /* AHCI_REQUEST_* */
+    uint8_t error;              /* ATA error register after a failure */
+
+    /* Called from the interrupt on completion (may be NULL) */
+    void (*done)(struct ahci_request* request);
+    void* context;              /* For the callback */
+
+    struct ahci_request* next;  /* Port queue link */
+} ahci_request_t;
+
+/* A disk found during the probe */
+typedef struct {
+    uint8_t port;               /* HBA port number */
+    uint8_t ncq;                /* Commands are queued (NCQ) */
+    uint8_t queue_depth;        /* Commands in flight at most */
+    uint8_t lba48;
+    uint64_t sectors;           /* Capacity */
+    char model[41];
+} ahci_disk_t;
+
+/* Queue a request on its disk's port
+ * Returns: 0 if queued, -1 if the request is invalid
+ */
+int ahci_submit(ahci_request_t* request);
+
+/* Wait until a submitted request completes
+ * Lets the completion interrupt in when interrupts are enabled and the
+ * controller has one, and polls the port otherwise. Commands still in
+ * flight after AHCI_TIMEOUT_MS fail and the port is restarted, as it is
+ * after an error.
+ * Returns: the request's final status
+ */
+int ahci_wait(ahci_request_t* request);
+
+/* Read count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int ahci_read(uint32_t disk, uint64_t lba, uint32_t count, void* buffer);
+
+/* Write count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int ahci_write(uint32_t disk, uint64_t lba, uint32_t count, const void* buffer);
+
+/* Get the number of disks found */
+uint32_t ahci_disk_count(void);
+
+/* Get a disk by index
+ * Returns: the disk, or NULL if index is out of range
+ */
+const ahci_disk_t* ahci_get_disk(uint32_t index);
+
+#endif /* AHCI_H */
@@ -0,0 +1,575 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "ata.h"
+#include "pci.h"
+#include "pci_driver.h"
+#include "../arch/x86/cpu.h"
+#include "../arch/x86/idt.h"
+#include "../arch/x86/io.h"
+#include "../arch/x86/pic.h"
+#include "../arch/x86/tsc.h"
+#include "../trace.h"
+
+/* Task file registers, from the command block base */
+#define ATA_REG_DATA            0
+#define ATA_REG_ERROR           1
+#define ATA_REG_SECTOR_COUNT    2
+#define ATA_REG_LBA_LOW         3
+#define ATA_REG_LBA_MID         4
+#define ATA_REG_LBA_HIGH        5
+#define ATA_REG_DEVICE          6
+#define ATA_REG_STATUS          7       /* Reading it acknowledges the interrupt */
+#define ATA_REG_COMMAND         7
+
+/* Control block: alternate status on read, device control on write */
+#define ATA_REG_ALT_STATUS      0
+#define ATA_REG_DEVICE_CONTROL  0
+
+/* Status bits */
+#define ATA_STATUS_ERR          0x01
+#define ATA_STATUS_DRQ          0x08
+#define ATA_STATUS_DF           0x20    /* Device fault */
+#define ATA_STATUS_BSY          0x80
+
+/* Device control bits */
+#define ATA_CONTROL_NIEN        0x02    /* Interrupts off */
+#define ATA_CONTROL_SRST        0x04    /* Software reset of both drives */
+
+/* Device register: LBA addressing, bit 4 selects the slave */
+#define ATA_DEVICE_LBA          0x40
+#define ATA_DEVICE_LEGACY       0xA0    /* Obsolete bits, set for old drives */
+#define ATA_DEVICE_SLAVE        0x10
+
+/* Commands */
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_IDENTIFY        0xEC
+
+/* IDENTIFY DEVICE words */
+#define ATA_ID_SERIAL           10      /* 10 words */
+#define ATA_ID_MODEL            27      /* 20 words */
+#define ATA_ID_CAPABILITIES     49
+#define ATA_ID_SECTORS_28       60      /* 2 words */
+#define ATA_ID_COMMAND_SET_2    83
+#define ATA_ID_SECTORS_48       100     /* 4 words */
+
+#define ATA_ID_CAP_DMA          (1u << 8)
+#define ATA_ID_CMD_LBA48        (1u << 10)
+
+/* 28-bit commands reach sectors below this */
+#define ATA_LBA28_LIMIT         (1ull << 28)
+
+/* Bus master registers, from the channel's base in BAR4 */
+#define ATA_BM_COMMAND          0
+#define ATA_BM_STATUS           2       /* Error and interrupt bits are cleared by writing 1 */
+#define ATA_BM_PRDT             4
+
+#define ATA_BM_CMD_START        0x01
+#define ATA_BM_CMD_READ         0x08    /* Device to memory */
+
+#define ATA_BM_STATUS_ACTIVE    0x01
+#define ATA_BM_STATUS_ERROR     0x02
+#define ATA_BM_STATUS_IRQ       0x04
+
+/* Second channel's bus master registers */
+#define ATA_BM_CHANNEL_STRIDE   8
+
+/* Compatibility mode resources */
+#define ATA_PRIMARY_BASE        0x1F0
+#define ATA_PRIMARY_CONTROL     0x3F6
+#define ATA_PRIMARY_IRQ         14
+#define ATA_SECONDARY_BASE      0x170
+#define ATA_SECONDARY_CONTROL   0x376
+#define ATA_SECONDARY_IRQ       15
+
+/* Programming interface: channel in native PCI mode (BARs and INTx) */
+#define ATA_PROG_IF_NATIVE(ch)  ((ch) ? 0x04 : 0x01)
+
+/* PIIX IDE timing registers; bit 15 enables decoding of the channel's ports */
+#define PIIX_IDETIM(ch)         ((ch) ? 0x42 : 0x40)
+#define PIIX_IDETIM_DECODE      0x8000
+
+/* PIO waits during identification and reset */
+#define ATA_IDENTIFY_TIMEOUT_MS 1000
+
+/* Physical region descriptor: one contiguous piece of the buffer */
+typedef struct {
+    uint32_t address;
+    uint16_t byte_count;        /* 0 means 64 KiB */
+    uint16_t flags;
+} __attribute__((packed)) ata_prd_t;
+
+#define ATA_PRD_END             0x8000  /* Last entry of the table */
+#define ATA_PRD_BOUNDARY        0x10000 /* An entry may not cross 64 KiB */
+
+typedef struct {
+    uint16_t base;              /* Command block */
+    uint16_t control;           /* Control block */
+    uint16_t bus_master;
+    uint8_t irq;
+    uint8_t drives;             /* Drives found on the channel */
+
+    ata_prd_t* prd;
+    ata_request_t* head;        /* In flight if busy, then queued requests */
+    ata_request_t* tail;
+    int busy;
+    uint64_t started;           /* TSC when the command in flight was issued */
+} ata_channel_t;
+
+/* PRD tables (256 bytes each); aligning to their size keeps each inside one 64 KiB region */
+static ata_prd_t ata_prd_tables[2][ATA_PRD_ENTRIES] __attribute__((aligned(256)));
+
+static ata_channel_t ata_channels[2];
+
+/* Block layer view of the drives; one channel request per block request */
+static block_device_t ata_block_devices[ATA_MAX_DRIVES];
+static ata_request_t ata_block_requests[ATA_MAX_DRIVES][BLOCK_QUEUE_REQUESTS];
+static ata_drive_t ata_drives[ATA_MAX_DRIVES];
+static uint32_t ata_drive_total = 0;
+static int ata_controller_bound = 0;
+
+/* Wait about 400 ns: four reads of the alternate status */
+static void ata_delay(const ata_channel_t* ch) {
+    for (int i = 0; i < 4; i++) {
+        inb(ch->control + ATA_REG_ALT_STATUS);
+    }
+}
+
+/* Poll until (status & mask) == value
+ * Returns: the last status, or -1 on timeout */
+static int ata_poll(const ata_channel_t* ch, uint8_t mask, uint8_t value, uint32_t timeout_ms) {
+    uint64_t start = tsc_read();
+    for (;;) {
+        uint8_t status = inb(ch->control + ATA_REG_ALT_STATUS);
+        if ((status & mask) == value) return status;
+        if (tsc_to_us(tsc_read() - start) > (uint64_t)timeout_ms * 1000) return -1;
+    }
+}
+
+/* Copy an IDENTIFY string (two characters per word, high byte first) and trim it */
+static void ata_id_string(char* out, const uint16_t* words, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[2 * i] = (char)(words[i] >> 8);
+        out[2 * i + 1] = (char)(words[i] & 0xFF);
+    }
+    size_t length = count * 2;
+    while (length > 0 && (out[length - 1] == ' ' || out[length - 1] == '\0')) {
+        length--;
+    }
+    out[length] = '\0';
+}
+
+/* Identify one drive with PIO; ATAPI and absent drives fail */
+static int ata_identify(const ata_channel_t* ch, uint8_t slave, uint16_t* id) {
+    outb(ch->base + ATA_REG_DEVICE, ATA_DEVICE_LEGACY | (slave ? ATA_DEVICE_SLAVE : 0));
+    ata_delay(ch);
+
+    outb(ch->base + ATA_REG_SECTOR_COUNT, 0);
+    outb(ch->base + ATA_REG_LBA_LOW, 0);
+    outb(ch->base + ATA_REG_LBA_MID, 0);
+    outb(ch->base + ATA_REG_LBA_HIGH, 0);
+    outb(ch->base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay(ch);
+
+    /* Nothing there: status reads 0, or floats high without a drive */
+    uint8_t status = inb(ch->base + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF) return -1;
+
+    if (ata_poll(ch, ATA_STATUS_BSY, 0, ATA_IDENTIFY_TIMEOUT_MS) < 0) return -1;
+
+    /* Packet devices abort IDENTIFY and leave their signature in the LBA registers */
+    if (inb(ch->base + ATA_REG_LBA_MID) || inb(ch->base + ATA_REG_LBA_HIGH)) return -1;
+
+    int ready = ata_poll(ch, ATA_STATUS_DRQ | ATA_STATUS_ERR, ATA_STATUS_DRQ, ATA_IDENTIFY_TIMEOUT_MS);
+    if (ready < 0) return -1;
+
+    insw(ch->base + ATA_REG_DATA, id, 256);
+    return 0;
+}
+
+/* Describe the PRDs of a request's buffer or segments; entries split at 64 KiB boundaries
+ * Returns: 0, or -1 if the memory needs more than ATA_PRD_ENTRIES */
+static int ata_build_prd(ata_prd_t* prd, const ata_request_t* request) {
+    block_segment_t whole = { request->buffer, request->count * ATA_SECTOR_SIZE };
+    const block_segment_t* segments = request->segment_count ? request->segments : &whole;
+    uint32_t segment_count = request->segment_count ? request->segment_count : 1;
+
+    uint32_t n = 0;
+    for (uint32_t s = 0; s < segment_count; s++) {
+        uint32_t address = (uint32_t)segments[s].addr;
+        uint32_t size = segments[s].len;
+        while (size > 0) {
+            if (n == ATA_PRD_ENTRIES) return -1;
+            uint32_t room = ATA_PRD_BOUNDARY - (address & (ATA_PRD_BOUNDARY - 1));
+            uint32_t length = size < room ? size : room;
+
+            prd[n].address = address;
+            prd[n].byte_count = (uint16_t)length;   /* 65536 wraps to 0, as the controller wants */
+            prd[n].flags = 0;
+            n++;
+            address += length;
+            size -= length;
+        }
+    }
+    prd[n - 1].flags = ATA_PRD_END;
+    return 0;
+}
+
+static void ata_start(ata_channel_t* ch);
+
+/* Take the request in flight off the channel and issue the next one */
+static void ata_finish(ata_channel_t* ch, int status, uint8_t error) {
+    ata_request_t* request = ch->head;
+    ch->head = request->next;
+    if (!ch->head) ch->tail = NULL;
+    ch->busy = 0;
+
+    TRACE(ATA_COMPLETE, request->drive, (uint32_t)status, error);
+    request->next = NULL;
+    request->error = error;
+    request->status = status;
+    if (request->done) {
+        request->done(request);
+    }
+    ata_start(ch);
+}
+
+/* Issue the request at the head of the queue (interrupts disabled) */
+static void ata_start(ata_channel_t* ch) {
+    ata_request_t* request = ch->head;
+    if (!request || ch->busy) return;
+
+    const ata_drive_t* drive = &ata_drives[request->drive];
+    if (ata_build_prd(ch->prd, request) != 0) {
+        ata_finish(ch, ATA_REQUEST_ERROR, 0);
+        return;
+    }
+    ch->busy = 1;
+
+    /* Stop the engine, load the table, set the direction, clear old status */
+    outb(ch->bus_master + ATA_BM_COMMAND, 0);
+    outl(ch->bus_master + ATA_BM_PRDT, (uint32_t)ch->prd);
+    uint8_t direction = request->write ? 0 : ATA_BM_CMD_READ;
+    outb(ch->bus_master + ATA_BM_COMMAND, direction);
+    outb(ch->bus_master + ATA_BM_STATUS,
+         inb(ch->bus_master + ATA_BM_STATUS) | ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+
+    uint64_t lba = request->lba;
+    uint8_t slave = drive->slave ? ATA_DEVICE_SLAVE : 0;
+    uint8_t command;
+    if (lba + request->count > ATA_LBA28_LIMIT) {
+        /* 48-bit: the high bytes go in first, each register is a two-deep FIFO */
+        outb(ch->base + ATA_REG_DEVICE, ATA_DEVICE_LBA | slave);
+        ata_delay(ch);
+        outb(ch->base + ATA_REG_SECTOR_COUNT, (uint8_t)(request->count >> 8));
+        outb(ch->base + ATA_REG_LBA_LOW, (uint8_t)(lba >> 24));
+        outb(ch->base + ATA_REG_LBA_MID, (uint8_t)(lba >> 32));
+        outb(ch->base + ATA_REG_LBA_HIGH, (uint8_t)(lba >> 40));
+        command = request->write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+    } else {
+        /* 28-bit: LBA bits 24-27 in the device register; a count of 256 is written as 0 */
+        outb(ch->base + ATA_REG_DEVICE,
+             ATA_DEVICE_LEGACY | ATA_DEVICE_LBA | slave | (uint8_t)((lba >> 24) & 0x0F));
+        ata_delay(ch);
+        command = request->write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+    }
+    outb(ch->base + ATA_REG_SECTOR_COUNT, (uint8_t)request->count);
+    outb(ch->base + ATA_REG_LBA_LOW, (uint8_t)lba);
+    outb(ch->base + ATA_REG_LBA_MID, (uint8_t)(lba >> 8));
+    outb(ch->base + ATA_REG_LBA_HIGH, (uint8_t)(lba >> 16));
+    outb(ch->base + ATA_REG_COMMAND, command);
+
+    outb(ch->bus_master + ATA_BM_COMMAND, direction | ATA_BM_CMD_START);
+    ch->started = tsc_read();
+    TRACE(ATA_ISSUE, request->drive, (uint32_t)lba, request->count);
+}
+
+/* Complete the command in flight if the channel raised its interrupt
+ * (interrupts disabled); the line may be shared, so anything else is ignored */
+static void ata_channel_service(ata_channel_t* ch) {
+    uint8_t bm_status = inb(ch->bus_master + ATA_BM_STATUS);
+    if (!(bm_status & ATA_BM_STATUS_IRQ)) return;
+
+    outb(ch->bus_master + ATA_BM_COMMAND, 0);
+    uint8_t status = inb(ch->base + ATA_REG_STATUS);
+    outb(ch->bus_master + ATA_BM_STATUS, bm_status | ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+    if (!ch->busy) return;
+
+    if ((status & (ATA_STATUS_ERR | ATA_STATUS_DF)) || (bm_status & ATA_BM_STATUS_ERROR)) {
+        ata_finish(ch, ATA_REQUEST_ERROR, inb(ch->base + ATA_REG_ERROR));
+    } else {
+        ata_finish(ch, ATA_REQUEST_DONE, 0);
+    }
+}
+
+static void ata_interrupt(registers_t* regs) {
+    for (int c = 0; c < 2; c++) {
+        if (ata_channels[c].drives && regs->int_no == 32u + ata_channels[c].irq) {
+            ata_channel_service(&ata_channels[c]);
+        }
+    }
+}
+
+/* Give up on the command in flight: stop the engine and reset both drives */
+static void ata_channel_timeout(ata_channel_t* ch) {
+    outb(ch->bus_master + ATA_BM_COMMAND, 0);
+    outb(ch->control + ATA_REG_DEVICE_CONTROL, ATA_CONTROL_SRST);
+    ata_delay(ch);
+    outb(ch->control + ATA_REG_DEVICE_CONTROL, 0);
+    ata_poll(ch, ATA_STATUS_BSY, 0, ATA_IDENTIFY_TIMEOUT_MS);
+    inb(ch->base + ATA_REG_STATUS);
+    outb(ch->bus_master + ATA_BM_STATUS,
+         inb(ch->bus_master + ATA_BM_STATUS) | ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+
+    printf("ATA: channel %u timed out, reset\n", (uint32_t)(ch - ata_channels));
+    ata_finish(ch, ATA_REQUEST_TIMEOUT, 0);
+}
+
+/* Queue a request on its drive's channel */
+int ata_submit(ata_request_t* request) {
+    if (request->drive >= ata_drive_total || request->count == 0 ||
+        request->count > ATA_MAX_SECTORS ||
+        request->lba + request->count > ata_drives[request->drive].sectors) {
+        return -1;
+    }
+    const ata_drive_t* drive = &ata_drives[request->drive];
+    if (!drive->lba48 && request->lba + request->count > ATA_LBA28_LIMIT) {
+        return -1;
+    }
+    if (request->segment_count ? !block_segments_valid(request->segments, request->segment_count,
+                                                       request->count * ATA_SECTOR_SIZE)
+                               : ((uint32_t)request->buffer & 1)) {
+        return -1;
+    }
+
+    ata_channel_t* ch = &ata_channels[drive->channel];
+    request->status = ATA_REQUEST_PENDING;
+    request->error = 0;
+    request->next = NULL;
+
+    uint32_t flags = irq_save();
+    if (ch->tail) {
+        ch->tail->next = request;
+    } else {
+        ch->head = request;
+    }
+    ch->tail = request;
+    ata_start(ch);
+    irq_restore(flags);
+    return 0;
+}
+
+/* Wait until a submitted request completes */
+int ata_wait(ata_request_t* request) {
+    ata_channel_t* ch = &ata_channels[ata_drives[request->drive].channel];
+
+    while (request->status == ATA_REQUEST_PENDING) {
+        uint32_t flags = irq_save();
+        if (request->status == ATA_REQUEST_PENDING) {
+            if (flags & EFLAGS_IF) {
+                cpu_wait_for_interrupt(ch->started + (uint64_t)ATA_TIMEOUT_MS * tsc_khz());
+            } else {
+                ata_channel_service(ch);
+            }
+        }
+        if (ch->busy && tsc_to_us(tsc_read() - ch->started) > (uint64_t)ATA_TIMEOUT_MS * 1000) {
+            ata_channel_timeout(ch);
+        }
+        irq_restore(flags);
+    }
+    return request->status;
+}
+
+/* Split a transfer into requests of at most ATA_MAX_SECTORS and run them in turn */
+static int ata_transfer(uint32_t drive, uint64_t lba, uint32_t count, void* buffer, int write) {
+    uint8_t* bytes = (uint8_t*)buffer;
+    while (count > 0) {
+        uint32_t chunk = count < ATA_MAX_SECTORS ? count : ATA_MAX_SECTORS;
+        ata_request_t request = { drive, lba, chunk, bytes, NULL, 0, write, 0, 0, NULL, NULL, NULL };
+        if (ata_submit(&request) != 0) return -1;
+        int status = ata_wait(&request);
+        if (status != ATA_REQUEST_DONE) return status;
+
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * ATA_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+int ata_read(uint32_t drive, uint64_t lba, uint32_t count, void* buffer) {
+    return ata_transfer(drive, lba, count, buffer, 0);
+}
+
+int ata_write(uint32_t drive, uint64_t lba, uint32_t count, const void* buffer) {
+    return ata_transfer(drive, lba, count, (void*)buffer, 1);
+}
+
+uint32_t ata_drive_count(void) {
+    return ata_drive_total;
+}
+
+const ata_drive_t* ata_get_drive(uint32_t index) {
+    return index < ata_drive_total ? &ata_drives[index] : NULL;
+}
+
+static void ata_block_done(ata_request_t* native) {
+    block_complete((block_request_t*)native->context, native->status != ATA_REQUEST_DONE);
+}
+
+/* Turn a block request into a channel request */
+static int ata_block_start(block_device_t* dev, block_request_t* request) {
+    uint32_t drive = (uint32_t)(dev - ata_block_devices);
+    ata_request_t* native = &ata_block_requests[drive][request->tag];
+    native->drive = drive;
+    native->lba = request->sector;
+    native->count = request->sectors;
+    native->buffer = NULL;
+    native->segments = request->segments;
+    native->segment_count = request->segment_count;
+    native->write = request->write;
+    native->done = ata_block_done;
+    native->context = request;
+    if (ata_submit(native) != 0) {
+        block_complete(request, -1);
+    }
+    return 0;
+}
+
+static void ata_block_poll(block_device_t* dev) {
+    ata_channel_t* ch = &ata_channels[ata_drives[dev - ata_block_devices].channel];
+    ata_channel_service(ch);
+    if (ch->busy && tsc_to_us(tsc_read() - ch->started) > (uint64_t)ATA_TIMEOUT_MS * 1000) {
+        ata_channel_timeout(ch);
+    }
+}
+
+static const block_device_ops_t ata_block_ops = { ata_block_start, ata_block_poll };
+
+/* Find the drives on one channel and route its interrupt */
+static void ata_channel_init(uint8_t c, const pci_device_t* dev) {
+    ata_channel_t* ch = &ata_channels[c];
+    ch->prd = ata_prd_tables[c];
+    ch->bus_master = (uint16_t)(dev->bars[4].base + c * ATA_BM_CHANNEL_STRIDE);
+
+    if (dev->prog_if & ATA_PROG_IF_NATIVE(c)) {
+        const pci_bar_t* command = &dev->bars[c * 2];
+        const pci_bar_t* control = &dev->bars[c * 2 + 1];
+        if (!command->io || !control->io || dev->irq_line >= 16) return;
+        ch->base = (uint16_t)command->base;
+        ch->control = (uint16_t)control->base + 2;
+        ch->irq = dev->irq_line;
+    } else {
+        ch->base = c ? ATA_SECONDARY_BASE : ATA_PRIMARY_BASE;
+        ch->control = c ? ATA_SECONDARY_CONTROL : ATA_PRIMARY_CONTROL;
+        ch->irq = c ? ATA_SECONDARY_IRQ : ATA_PRIMARY_IRQ;
+    }
+
+    /* Nothing answers on a channel without drives */
+    if (inb(ch->base + ATA_REG_STATUS) == 0xFF) return;
+
+    /* No interrupts while identifying */
+    outb(ch->control + ATA_REG_DEVICE_CONTROL, ATA_CONTROL_NIEN);
+
+    static uint16_t id[256];
+    for (uint8_t slave = 0; slave < 2; slave++) {
+        if (ata_identify(ch, slave, id) != 0) continue;
+
+        char model[41];
+        ata_id_string(model, &id[ATA_ID_MODEL], 20);
+        if (!(id[ATA_ID_CAPABILITIES] & ATA_ID_CAP_DMA)) {
+            printf("ATA: %u:%u %s has no DMA, skipped\n", c, slave, model);
+            continue;
+        }
+
+        ata_drive_t* drive = &ata_drives[ata_drive_total++];
+        drive->channel = c;
+        drive->slave = slave;
+        drive->lba48 = (id[ATA_ID_COMMAND_SET_2] & ATA_ID_CMD_LBA48) != 0;
+        if (drive->lba48) {
+            drive->sectors = (uint64_t)id[ATA_ID_SECTORS_48] |
+                             (uint64_t)id[ATA_ID_SECTORS_48 + 1] << 16 |
+                             (uint64_t)id[ATA_ID_SECTORS_48 + 2] << 32 |
+                             (uint64_t)id[ATA_ID_SECTORS_48 + 3] << 48;
+        } else {
+            drive->sectors = (uint32_t)id[ATA_ID_SECTORS_28] | (uint32_t)id[ATA_ID_SECTORS_28 + 1] << 16;
+        }
+        memcpy(drive->model, model, sizeof(model));
+        ata_id_string(drive->serial, &id[ATA_ID_SERIAL], 10);
+        ch->drives++;
+
+        printf("ATA: drive %u at %u:%u: %s, %llu MiB, %s\n", ata_drive_total - 1, c, slave,
+               drive->model, (unsigned long long)(drive->sectors / (1024 * 1024 / ATA_SECTOR_SIZE)),
+               drive->lba48 ? "LBA48" : "LBA28");
+    }
+
+    if (ch->drives) {
+        register_interrupt_handler(32 + ch->irq, ata_interrupt);
+        if (ch->irq >= 8) {
+            pic_enable_irq(2);  /* Cascade from the slave PIC */
+        }
+        pic_enable_irq(ch->irq);
+        outb(ch->control + ATA_REG_DEVICE_CONTROL, 0);
+    }
+}
+
+/* Register each drive with the block layer */
+static void ata_block_register(void) {
+    for (uint32_t i = 0; i < ata_drive_total; i++) {
+        block_device_t* dev = &ata_block_devices[i];
+        snprintf(dev->name, sizeof(dev->name), "ata%u", i);
+        dev->sectors = ata_drives[i].sectors;
+        dev->max_sectors = ATA_MAX_SECTORS;
+        /* Segments may lie anywhere, so each can take two PRDs for a 64 KiB
+         * boundary of its own, plus the boundaries its length spans: at most
+         * 2 * segments + ATA_MAX_SECTORS * ATA_SECTOR_SIZE / 64 KiB in all */
+        dev->max_segments = (ATA_PRD_ENTRIES - ATA_MAX_SECTORS * ATA_SECTOR_SIZE / ATA_PRD_BOUNDARY) / 2;
+        if (dev->max_segments > BLOCK_MAX_SEGMENTS) dev->max_segments = BLOCK_MAX_SEGMENTS;
+        /* One command per channel; a second one queued starts from the interrupt */
+        dev->queue_depth = 2;
+        dev->ops = &ata_block_ops;
+        block_register(dev);
+    }
+}
+
+static int ata_probe(const pci_device_t* dev, const pci_device_id_t* id) {
+    (void)id;
+
+    /* Both channels' ports are fixed in compatibility mode, so one controller at most */
+    if (ata_controller_bound) return -1;
+    if (!dev->bars[4].io || !dev->bars[4].base) {
+        printf("ATA: %02x:%02x.%x has no bus master registers\n", dev->bus, dev->device, dev->func);
+        return -1;
+    }
+    ata_controller_bound = 1;
+
+    pci_enable_device(dev, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    if (dev->vendor_id == 0x8086) {
+        for (uint8_t c = 0; c < 2; c++) {
+            uint16_t timing = pci_read_config_word(dev->bus, dev->device, dev->func, PIIX_IDETIM(c));
+            pci_write_config_word(dev->bus, dev->device, dev->func, PIIX_IDETIM(c),
+                                  timing | PIIX_IDETIM_DECODE);
+        }
+    }
+
+    for (uint8_t c = 0; c < 2; c++) {
+        ata_channel_init(c, dev);
+    }
+    printf("ATA: %u drives, bus master registers at %04x\n", ata_drive_total,
+           (uint32_t)dev->bars[4].base);
+    ata_block_register();
+    return 0;
+}
+
+static const pci_device_id_t ata_ids[] = {
+    { PCI_DEVICE(0x8086, 0x1230) },     /* PIIX */
+    { PCI_DEVICE(0x8086, 0x7010) },     /* PIIX3 */
+    { PCI_DEVICE(0x8086, 0x7111) },     /* PIIX4 */
+    { PCI_DEVICE_CLASS(0x01, 0x01) },   /* Any IDE controller with bus mastering */
+    { 0 }
+};
+PCI_DRIVER(ata) = { "ata-piix", ata_ids, ata_probe, NULL, 0 };
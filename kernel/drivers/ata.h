@@ -0,0 +1,107 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../block.h"
+
+/* ATA disks on a bus-master IDE controller (PIIX and compatibles)
+ *
+ * The controller has two channels, each with up to two drives. Drives
+ * are identified with PIO; data moves by bus-master DMA: the channel
+ * walks a table of physical regions (PRDs) and raises its IRQ (14 or
+ * 15 in compatibility mode) when the transfer is done. Commands use
+ * 48-bit LBAs when the drive supports them and the request needs them.
+ *
+ * A channel runs one command at a time. ata_submit() queues a request
+ * on its drive's channel and returns; the interrupt completes it,
+ * calls its done callback and issues the next one. ata_read() and
+ * ata_write() wrap that for callers that wait.
+ *
+ *   static uint8_t sector[ATA_SECTOR_SIZE];
+ *   if (ata_read(0, 0, 1, sector) == 0) { ... }
+ *
+ * Buffers are handed to the controller by address, so they must be
+ * identity mapped (all kernel memory is) and 2-byte aligned.
+ */
+
+#define ATA_SECTOR_SIZE         512
+
+/* Limits */
+#define ATA_MAX_DRIVES          4       /* Two channels, master and slave */
+#define ATA_MAX_SECTORS         256     /* Per request: 128 KiB */
+#define ATA_PRD_ENTRIES         32      /* 256 bytes; sets the block layer's segment limit */
+
+/* Time a command may take before the channel is reset */
+#define ATA_TIMEOUT_MS          5000
+
+/* Request status */
+#define ATA_REQUEST_PENDING     1       /* Queued or in flight */
+#define ATA_REQUEST_DONE        0
+#define ATA_REQUEST_ERROR       -1      /* Device or DMA error; see error */
+#define ATA_REQUEST_TIMEOUT     -2
+
+/* One transfer; owned by the driver from ata_submit() until status leaves PENDING */
+typedef struct ata_request {
+    uint32_t drive;             /* Index for ata_get_drive() */
+    uint64_t lba;               /* First sector */
+    uint32_t count;             /* Sectors, 1 to ATA_MAX_SECTORS */
+    void* buffer;               /* count * ATA_SECTOR_SIZE bytes */
+    /* Scatter-gather list used instead of buffer when segment_count is set */
+    const block_segment_t* segments;
+    uint32_t segment_count;
+    int write;                  /* 1 to write the buffer to the disk */
+
+    volatile int status;        /* ATA_REQUEST_* */
+    uint8_t error;              /* ATA error register after a failure */
+
+    /* Called from the interrupt on completion (may be NULL) */
+    void (*done)(struct ata_request* request);
+    void* context;              /* For the callback */
+
+    struct ata_request* next;   /* Channel queue link */
+} ata_request_t;
+
+/* A drive found during the probe */
+typedef struct {
+    uint8_t channel;            /* 0 primary, 1 secondary */
+    uint8_t slave;              /* 0 master, 1 slave */
+    uint8_t lba48;              /* Supports 48-bit commands */
+    uint64_t sectors;           /* Capacity */
+    char model[41];
+    char serial[21];
+} ata_drive_t;
+
+/* Queue a request on its drive's channel
+ * Returns: 0 if queued, -1 if the request is invalid
+ */
+int ata_submit(ata_request_t* request);
+
+/* Wait until a submitted request completes
+ * Lets the completion interrupt in when interrupts are enabled and
+ * polls the channel otherwise, so it also works during boot. A request
+ * that does not complete within ATA_TIMEOUT_MS is failed and its channel
+ * reset.
+ * Returns: the request's final status
+ */
+int ata_wait(ata_request_t* request);
+
+/* Read count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int ata_read(uint32_t drive, uint64_t lba, uint32_t count, void* buffer);
+
+/* Write count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int ata_write(uint32_t drive, uint64_t lba, uint32_t count, const void* buffer);
+
+/* Get the number of drives found */
+uint32_t ata_drive_count(void);
+
+/* Get a drive by index
+ * Returns: the drive, or NULL if index is out of range
+ */
+const ata_drive_t* ata_get_drive(uint32_t index);
+
+#endif /* ATA_H */
@@ -0,0 +1,241 @@
+#include "fbcon.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "../arch/x86/io.h"
+#include "../arch/x86/paging.h"
+#include "font8x8.h"
+#include "pci.h"
+#include "vga.h"
+
+/* Bochs VBE dispi interface */
+#define VBE_DISPI_IOPORT_INDEX      0x01CE
+#define VBE_DISPI_IOPORT_DATA       0x01CF
+
+#define VBE_DISPI_INDEX_ID          0x0
+#define VBE_DISPI_INDEX_XRES        0x1
+#define VBE_DISPI_INDEX_YRES        0x2
+#define VBE_DISPI_INDEX_BPP         0x3
+#define VBE_DISPI_INDEX_ENABLE      0x4
+#define VBE_DISPI_INDEX_VIRT_WIDTH  0x6
+#define VBE_DISPI_INDEX_VIRT_HEIGHT 0x7
+#define VBE_DISPI_INDEX_X_OFFSET    0x8
+#define VBE_DISPI_INDEX_Y_OFFSET    0x9
+#define VBE_DISPI_INDEX_VIDEO_MEMORY_64K 0xA
+
+#define VBE_DISPI_ID0               0xB0C0
+#define VBE_DISPI_ID4               0xB0C4  /* First version with 8bpp + virtual height */
+#define VBE_DISPI_ID5               0xB0C5  /* Reports the video memory size */
+
+#define VBE_DISPI_DISABLED          0x00
+#define VBE_DISPI_ENABLED           0x01
+#define VBE_DISPI_LFB_ENABLED       0x40
+
+/* PCI identity of the Bochs/QEMU standard VGA */
+#define BOCHS_VGA_VENDOR_ID         0x1234
+#define BOCHS_VGA_DEVICE_ID         0x1111
+
+/* VGA DAC ports for programming the palette */
+#define VGA_DAC_WRITE_INDEX         0x3C8
+#define VGA_DAC_DATA                0x3C9
+
+/* Mode: one cell per text console position, 8 bits per pixel */
+#define FBCON_XRES (VGA_WIDTH * FBCON_CELL_WIDTH)
+#define FBCON_YRES (VGA_HEIGHT * FBCON_CELL_HEIGHT)
+#define FBCON_BPP  8
+
+/* Upper bound on the scrollable framebuffer height (in cell rows) */
+#define FBCON_MAX_WINDOW_ROWS 400
+
+/* Bytes per cell row of the framebuffer */
+#define FBCON_ROW_BYTES (FBCON_XRES * FBCON_CELL_HEIGHT)
+
+/* Framebuffer state */
+static int fbcon_enabled = 0;
+static uint8_t* framebuffer = NULL;
+static size_t window_rows = 0;
+static size_t cursor_pos = FBCON_CURSOR_HIDDEN;
+
+/* Per-glyph row masks
+ * For every glyph row, two 32-bit masks cover its 8 pixels (4 per word):
+ * each byte is 0xFF where the font has a foreground pixel. A glyph row is
+ * drawn with two word stores: bg ^ ((fg ^ bg) & mask).
+ */
+static uint32_t glyph_masks[FONT8X8_GLYPHS][FONT8X8_HEIGHT][2];
+
+/* The 16 VGA text colors as 6-bit DAC values (red, green, blue) */
+static const uint8_t vga_palette[16][3] = {
+    { 0,  0,  0}, { 0,  0, 42}, { 0, 42,  0}, { 0, 42, 42},
+    {42,  0,  0}, {42,  0, 42}, {42, 21,  0}, {42, 42, 42},
+    {21, 21, 21}, {21, 21, 63}, {21, 63, 21}, {21, 63, 63},
+    {63, 21, 21}, {63, 21, 63}, {63, 63, 21}, {63, 63, 63}
+};
+
+/* Write a dispi register */
+static void dispi_write(uint16_t index, uint16_t value) {
+    outw(VBE_DISPI_IOPORT_INDEX, index);
+    outw(VBE_DISPI_IOPORT_DATA, value);
+}
+
+/* Read a dispi register */
+static uint16_t dispi_read(uint16_t index) {
+    outw(VBE_DISPI_IOPORT_INDEX, index);
+    return inw(VBE_DISPI_IOPORT_DATA);
+}
+
+/* Expand the font into per-row pixel masks */
+static void build_glyph_masks(void) {
+    for (size_t glyph = 0; glyph < FONT8X8_GLYPHS; glyph++) {
+        for (size_t row = 0; row < FONT8X8_HEIGHT; row++) {
+            uint8_t bits = font8x8_basic[glyph][row];
+            uint32_t low = 0;
+            uint32_t high = 0;
+            for (int bit = 0; bit < 4; bit++) {
+                if (bits & (1 << bit)) low |= 0xFFu << (bit * 8);
+                if (bits & (1 << (bit + 4))) high |= 0xFFu << (bit * 8);
+            }
+            glyph_masks[glyph][row][0] = low;
+            glyph_masks[glyph][row][1] = high;
+        }
+    }
+}
+
+/* Load the VGA text colors into the first 16 palette entries */
+static void load_palette(void) {
+    outb(VGA_DAC_WRITE_INDEX, 0);
+    for (size_t i = 0; i < 16; i++) {
+        outb(VGA_DAC_DATA, vga_palette[i][0]);
+        outb(VGA_DAC_DATA, vga_palette[i][1]);
+        outb(VGA_DAC_DATA, vga_palette[i][2]);
+    }
+}
+
+/* Switch the display to graphics mode and take over console rendering */
+fbcon_status_t fbcon_init(void) {
+    const pci_device_t* vga = pci_lookup(BOCHS_VGA_VENDOR_ID, BOCHS_VGA_DEVICE_ID);
+    if (!vga) {
+        return FBCON_ERROR_NO_DEVICE;
+    }
+
+    uint16_t version = dispi_read(VBE_DISPI_INDEX_ID);
+    if (version < VBE_DISPI_ID4 || version > VBE_DISPI_ID0 + 0xF) {
+        return FBCON_ERROR_UNSUPPORTED;
+    }
+
+    /* BAR0 is the linear framebuffer */
+    uint32_t lfb = (uint32_t)vga->bars[0].base;
+
+    /* Use as many cell rows as video memory allows, for hardware scrolling */
+    uint32_t vram = 4 * 1024 * 1024;
+    if (version >= VBE_DISPI_ID5) {
+        vram = (uint32_t)dispi_read(VBE_DISPI_INDEX_VIDEO_MEMORY_64K) * 64 * 1024;
+    }
+    window_rows = vram / FBCON_ROW_BYTES;
+    if (window_rows > FBCON_MAX_WINDOW_ROWS) window_rows = FBCON_MAX_WINDOW_ROWS;
+    if (window_rows <= VGA_HEIGHT) {
+        return FBCON_ERROR_UNSUPPORTED;
+    }
+
+    if (paging_map_region(lfb, window_rows * FBCON_ROW_BYTES, 0) != 0) {
+        return FBCON_ERROR_MAP_FAILED;
+    }
+    framebuffer = (uint8_t*)lfb;
+
+    /* Program the mode */
+    dispi_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
+    dispi_write(VBE_DISPI_INDEX_XRES, FBCON_XRES);
+    dispi_write(VBE_DISPI_INDEX_YRES, FBCON_YRES);
+    dispi_write(VBE_DISPI_INDEX_BPP, FBCON_BPP);
+    dispi_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED);
+    dispi_write(VBE_DISPI_INDEX_VIRT_WIDTH, FBCON_XRES);
+    dispi_write(VBE_DISPI_INDEX_VIRT_HEIGHT, (uint16_t)(window_rows * FBCON_CELL_HEIGHT));
+    dispi_write(VBE_DISPI_INDEX_X_OFFSET, 0);
+    dispi_write(VBE_DISPI_INDEX_Y_OFFSET, 0);
+
+    load_palette();
+    build_glyph_masks();
+
+    cursor_pos = FBCON_CURSOR_HIDDEN;
+    fbcon_enabled = 1;
+
+    /* Re-render the console into the framebuffer */
+    terminal_redraw();
+
+    printf("Framebuffer console: %ux%ux%u at %p, %u rows of scrollback in VRAM\n",
+           FBCON_XRES, FBCON_YRES, FBCON_BPP, framebuffer, window_rows);
+    return FBCON_SUCCESS;
+}
+
+/* Check if the framebuffer console is rendering the terminal */
+int fbcon_active(void) {
+    return fbcon_enabled;
+}
+
+/* Get the number of cell rows in the framebuffer */
+size_t fbcon_window_rows(void) {
+    return window_rows;
+}
+
+/* Draw one row of VGA text cells */
+void fbcon_draw_row(size_t window_row, const uint16_t* cells, size_t count) {
+    uint8_t* row_base = framebuffer + window_row * FBCON_ROW_BYTES;
+
+    for (size_t column = 0; column < count; column++) {
+        uint16_t cell = cells[column];
+        uint8_t ch = cell & 0xFF;
+        uint8_t attr = cell >> 8;
+        if (ch >= FONT8X8_GLYPHS) ch = '?';
+
+        /* Replicate the palette indices into every byte of a word */
+        uint32_t bg = (attr >> 4) * 0x01010101u;
+        uint32_t diff = ((attr & 0x0F) * 0x01010101u) ^ bg;
+
+        uint32_t* dest = (uint32_t*)(row_base + column * FBCON_CELL_WIDTH);
+        const uint32_t (*masks)[2] = glyph_masks[ch];
+
+        /* Each font row covers two scanlines */
+        for (size_t row = 0; row < FONT8X8_HEIGHT; row++) {
+            uint32_t low = bg ^ (diff & masks[row][0]);
+            uint32_t high = bg ^ (diff & masks[row][1]);
+            dest[0] = low;
+            dest[1] = high;
+            dest += FBCON_XRES / sizeof(uint32_t);
+            dest[0] = low;
+            dest[1] = high;
+            dest += FBCON_XRES / sizeof(uint32_t);
+        }
+    }
+}
+
+/* Show the framebuffer starting at cell row window_row */
+void fbcon_set_origin(size_t window_row) {
+    dispi_write(VBE_DISPI_INDEX_Y_OFFSET, (uint16_t)(window_row * FBCON_CELL_HEIGHT));
+}
+
+/* Invert the bottom two scanlines of a cell (drawing it twice restores it) */
+static void toggle_cursor(size_t pos) {
+    size_t row = pos / VGA_WIDTH;
+    size_t column = pos % VGA_WIDTH;
+    uint8_t* line = framebuffer + row * FBCON_ROW_BYTES +
+                    (FBCON_CELL_HEIGHT - 2) * FBCON_XRES +
+                    column * FBCON_CELL_WIDTH;
+
+    for (int scanline = 0; scanline < 2; scanline++) {
+        uint32_t* pixels = (uint32_t*)line;
+        pixels[0] ^= 0x0F0F0F0Fu;
+        pixels[1] ^= 0x0F0F0F0Fu;
+        line += FBCON_XRES;
+    }
+}
+
+/* Move or hide the cursor */
+void fbcon_set_cursor(size_t pos) {
+    if (pos == cursor_pos) return;
+    if (pos != FBCON_CURSOR_HIDDEN && pos / VGA_WIDTH >= window_rows) {
+        pos = FBCON_CURSOR_HIDDEN;
+    }
+
+    if (cursor_pos != FBCON_CURSOR_HIDDEN) toggle_cursor(cursor_pos);
+    if (pos != FBCON_CURSOR_HIDDEN) toggle_cursor(pos);
+    cursor_pos = pos;
+}
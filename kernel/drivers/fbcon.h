@@ -0,0 +1,62 @@
+#ifndef FBCON_H
+#define FBCON_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Linear framebuffer console
+ *
+ * Renders the VGA console's character cells as glyphs on a Bochs/QEMU
+ * display adapter (PCI 1234:1111, QEMU -vga std), programmed through the
+ * Bochs VBE "dispi" registers. The terminal_* API in vga.h is unchanged:
+ * once fbcon_init() succeeds, terminal_flush() draws dirty rows here
+ * instead of into text mode memory.
+ *
+ * Cells are 8x16 pixels (the built-in 8x8 font, rows doubled) in an
+ * 8 bits-per-pixel mode whose first 16 palette entries are the VGA text
+ * colors, so a cell's attribute byte is used as pixel values directly.
+ * The framebuffer is taller than the screen and scrolling moves the
+ * display Y offset, the same way the text console uses the CRTC start
+ * address.
+ */
+
+/* Cell geometry in pixels */
+#define FBCON_CELL_WIDTH  8
+#define FBCON_CELL_HEIGHT 16
+
+/* Cursor position meaning "no cursor" */
+#define FBCON_CURSOR_HIDDEN ((size_t)-1)
+
+/* Framebuffer console status codes */
+typedef enum {
+    FBCON_SUCCESS = 0,
+    FBCON_ERROR_NO_DEVICE = -1,
+    FBCON_ERROR_UNSUPPORTED = -2,
+    FBCON_ERROR_MAP_FAILED = -3
+} fbcon_status_t;
+
+/* Switch the display to graphics mode and take over console rendering
+ * Returns: FBCON_SUCCESS on success, error code otherwise (text mode stays)
+ */
+fbcon_status_t fbcon_init(void);
+
+/* Check if the framebuffer console is rendering the terminal
+ * Returns: 1 if active, 0 otherwise
+ */
+int fbcon_active(void);
+
+/* Get the number of cell rows in the (scrollable) framebuffer */
+size_t fbcon_window_rows(void);
+
+/* Draw one row of VGA text cells (character | attribute << 8)
+ * at cell row window_row of the framebuffer */
+void fbcon_draw_row(size_t window_row, const uint16_t* cells, size_t count);
+
+/* Show the framebuffer starting at cell row window_row */
+void fbcon_set_origin(size_t window_row);
+
+/* Move the cursor to cell index pos (window_row * width + column)
+ * or hide it with FBCON_CURSOR_HIDDEN */
+void fbcon_set_cursor(size_t pos);
+
+#endif /* FBCON_H */
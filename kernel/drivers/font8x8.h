@@ -0,0 +1,14 @@
+#ifndef FONT8X8_H
+#define FONT8X8_H
+
+#include <stdint.h>
+
+/* Built-in 8x8 bitmap font (ASCII only) */
+#define FONT8X8_GLYPHS 128
+#define FONT8X8_WIDTH  8
+#define FONT8X8_HEIGHT 8
+
+/* Glyph bitmaps: one byte per row, bit 0 is the leftmost pixel */
+extern const uint8_t font8x8_basic[FONT8X8_GLYPHS][FONT8X8_HEIGHT];
+
+#endif /* FONT8X8_H */
@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "hpet.h"
+#include "acpi.h"
+#include "pci_msi.h"
+#include "../arch/x86/idt.h"
+#include "../arch/x86/lapic.h"
+#include "../arch/x86/paging.h"
+#include "../clocksource.h"
+#include "../init.h"
+
+/* Register block, identity mapped (NULL until hpet_init() succeeds) */
+static volatile uint32_t* hpet_registers = NULL;
+
+/* Counter period in femtoseconds */
+static uint32_t hpet_period_fs = 0;
+
+/* Comparator used as the clockevent, and its vector */
+static uint32_t hpet_event_timer = 0;
+static uint8_t hpet_event_vector = 0;
+
+static inline uint32_t hpet_reg_read(uint32_t reg) {
+    return hpet_registers[reg / 4];
+}
+
+static inline void hpet_reg_write(uint32_t reg, uint32_t value) {
+    hpet_registers[reg / 4] = value;
+}
+
+/* Read the low half of the main counter */
+uint64_t hpet_read(void) {
+    return hpet_registers ? hpet_reg_read(HPET_REG_COUNTER) : 0;
+}
+
+static clocksource_t hpet_clocksource = {
+    "hpet", CLOCKSOURCE_RATING_HPET, hpet_read, 0xFFFFFFFF, 0, 0
+};
+
+static int hpet_program(uint64_t delta_ns);
+
+static clockevent_t hpet_clockevent = {
+    "hpet", CLOCKSOURCE_RATING_HPET, HPET_MIN_DELTA_NS, 0, hpet_program, NULL
+};
+
+/* Comparator match: one-shot, so hand the handler over only once */
+static void hpet_interrupt(registers_t* regs) {
+    (void)regs;
+    void (*handler)(void) = hpet_clockevent.handler;
+    hpet_clockevent.handler = NULL;
+    if (handler) {
+        handler();
+    }
+}
+
+/* Arm the comparator delta_ns from now */
+static int hpet_program(uint64_t delta_ns) {
+    if (delta_ns < hpet_clockevent.min_delta_ns || delta_ns > hpet_clockevent.max_delta_ns) {
+        return -1;
+    }
+    uint32_t ticks = (uint32_t)(delta_ns * 1000000 / hpet_period_fs);
+    if (ticks == 0) ticks = 1;
+
+    /* The comparator fires on a match, so a target the counter passed
+     * while it was written would wait a full wrap: retry further out */
+    for (;;) {
+        uint32_t target = hpet_reg_read(HPET_REG_COUNTER) + ticks;
+        hpet_reg_write(HPET_REG_TIMER_COMPARATOR(hpet_event_timer), target);
+        if ((int32_t)(target - hpet_reg_read(HPET_REG_COUNTER)) > 0) {
+            return 0;
+        }
+        if (ticks > 0x3FFFFFFF) {
+            return -1;
+        }
+        ticks *= 2;
+    }
+}
+
+/* Turn the first FSB capable comparator into a clockevent */
+static void hpet_clockevent_init(uint32_t timers) {
+    int apic_id = lapic_cpu_apic_id(0);
+    if (apic_id < 0) {
+        printf("HPET: no local APIC, no clockevent\n");
+        return;
+    }
+
+    for (uint32_t n = 0; n < timers; n++) {
+        uint32_t config = hpet_reg_read(HPET_REG_TIMER_CONFIG(n));
+        if (!(config & HPET_TIMER_FSB_CAPABLE)) {
+            continue;
+        }
+
+        int vector = idt_alloc_vectors(1);
+        if (vector < 0) {
+            printf("HPET: no free vector, no clockevent\n");
+            return;
+        }
+        hpet_event_timer = n;
+        hpet_event_vector = (uint8_t)vector;
+        register_interrupt_handler(hpet_event_vector, hpet_interrupt);
+
+        /* Same message an MSI would send: data is the vector, address the local APIC */
+        hpet_reg_write(HPET_REG_TIMER_FSB(n), hpet_event_vector);
+        hpet_reg_write(HPET_REG_TIMER_FSB(n) + 4,
+                       PCI_MSI_ADDRESS_BASE | (uint32_t)apic_id << PCI_MSI_ADDRESS_DEST_SHIFT);
+
+        /* Edge-triggered one-shot on the low 32 bits of the counter */
+        config &= ~(HPET_TIMER_LEVEL | HPET_TIMER_PERIODIC);
+        config |= HPET_TIMER_32BIT_MODE | HPET_TIMER_FSB_ENABLE | HPET_TIMER_ENABLE;
+        hpet_reg_write(HPET_REG_TIMER_CONFIG(n), config);
+
+        /* Half the counter range, so a target is never mistaken for one in the past */
+        hpet_clockevent.max_delta_ns = (uint64_t)0x7FFFFFFF * hpet_period_fs / 1000000;
+        clockevent_register(&hpet_clockevent);
+        return;
+    }
+    printf("HPET: no comparator can signal through FSB, no clockevent\n");
+}
+
+/* Map and start the HPET */
+int hpet_init(void) {
+    const acpi_platform_t* platform = acpi_platform();
+    uint64_t address = platform->hpet_address;
+    if (!address) {
+        return -1;
+    }
+    if (address >> 32 || paging_map_region((uint32_t)address, HPET_REGISTER_SIZE, PDE_CACHE_DISABLE) != 0) {
+        printf("HPET: cannot map registers at %08llx\n", (unsigned long long)address);
+        return -1;
+    }
+    hpet_registers = (volatile uint32_t*)(uint32_t)address;
+
+    uint32_t capabilities = hpet_reg_read(HPET_REG_CAPABILITIES);
+    hpet_period_fs = hpet_reg_read(HPET_REG_CAPABILITIES + 4);
+    if (hpet_period_fs == 0 || hpet_period_fs > HPET_MAX_PERIOD_FS) {
+        printf("HPET: invalid period %u fs\n", hpet_period_fs);
+        hpet_registers = NULL;
+        return -1;
+    }
+    uint32_t timers = ((capabilities >> HPET_CAP_TIMERS_SHIFT) & HPET_CAP_TIMERS_MASK) + 1;
+
+    /* Stop, quiesce every comparator firmware may have armed, restart without legacy routes */
+    uint32_t config = hpet_reg_read(HPET_REG_CONFIG);
+    hpet_reg_write(HPET_REG_CONFIG, config & ~(HPET_CONFIG_ENABLE | HPET_CONFIG_LEGACY_ROUTE));
+    for (uint32_t n = 0; n < timers; n++) {
+        uint32_t timer = hpet_reg_read(HPET_REG_TIMER_CONFIG(n));
+        hpet_reg_write(HPET_REG_TIMER_CONFIG(n), timer & ~(HPET_TIMER_ENABLE | HPET_TIMER_FSB_ENABLE));
+    }
+    hpet_reg_write(HPET_REG_INTERRUPT_STATUS, 0xFFFFFFFF);
+    hpet_reg_write(HPET_REG_CONFIG, (config & ~HPET_CONFIG_LEGACY_ROUTE) | HPET_CONFIG_ENABLE);
+
+    hpet_clocksource.frequency_hz = 1000000000000000ull / hpet_period_fs;
+    printf("HPET: %u comparators, %s counter at %llu Hz, registers at %08x\n", timers,
+           (capabilities & HPET_CAP_COUNTER_64BIT) ? "64-bit" : "32-bit",
+           (unsigned long long)hpet_clocksource.frequency_hz, (uint32_t)address);
+    clocksource_register(&hpet_clocksource);
+
+    hpet_clockevent_init(timers);
+    return 0;
+}
+
+/* Optional hardware: its absence is not a failure */
+static int hpet_initcall(void) {
+    hpet_init();
+    return 0;
+}
+INITCALL(hpet, hpet_initcall, "idt,lapic");
@@ -0,0 +1,67 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <stdint.h>
+
+/* High Precision Event Timer
+ *
+ * A memory-mapped block with one up-counting main counter (10 MHz or
+ * more, period in femtoseconds in the capabilities register) and up to
+ * 32 comparators. The ACPI HPET table gives its address.
+ *
+ * The main counter is the "hpet" clocksource. Only its low 32 bits are
+ * read: one uncached load instead of the three a torn-read-safe 64-bit
+ * read takes, and clock_ns() extends it.
+ *
+ * A comparator that can signal through a front side bus message (FSB,
+ * the HPET's own MSI) becomes the "hpet" clockevent: a one-shot 32-bit
+ * comparator delivered to the local APIC on a dynamic vector. Without
+ * one its interrupts would need an I/O APIC, or the legacy replacement
+ * routes that take IRQ0 away from the PIT, so no clockevent is offered.
+ * QEMU only advertises FSB delivery with -global hpet.msi=on.
+ */
+
+/* Register offsets */
+#define HPET_REG_CAPABILITIES       0x000
+#define HPET_REG_CONFIG             0x010
+#define HPET_REG_INTERRUPT_STATUS   0x020
+#define HPET_REG_COUNTER            0x0F0
+#define HPET_REG_TIMER_CONFIG(n)    (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+#define HPET_REG_TIMER_FSB(n)       (0x110 + 0x20 * (n))  /* Data, then address at +4 */
+
+/* Size of the register block */
+#define HPET_REGISTER_SIZE          0x400
+
+/* Capabilities (low half; the high half is the period in femtoseconds) */
+#define HPET_CAP_TIMERS_SHIFT       8       /* Index of the last comparator */
+#define HPET_CAP_TIMERS_MASK        0x1F
+#define HPET_CAP_COUNTER_64BIT      (1u << 13)
+
+/* Upper bound on the period the specification allows (100 ns) */
+#define HPET_MAX_PERIOD_FS          100000000u
+
+/* General configuration */
+#define HPET_CONFIG_ENABLE          (1u << 0)
+#define HPET_CONFIG_LEGACY_ROUTE    (1u << 1)
+
+/* Timer configuration and capabilities (low half) */
+#define HPET_TIMER_LEVEL            (1u << 1)
+#define HPET_TIMER_ENABLE           (1u << 2)
+#define HPET_TIMER_PERIODIC         (1u << 3)
+#define HPET_TIMER_32BIT_MODE       (1u << 8)
+#define HPET_TIMER_FSB_ENABLE       (1u << 14)
+#define HPET_TIMER_FSB_CAPABLE      (1u << 15)
+
+/* Shortest one-shot delay armed; shorter ones could be missed while the comparator is written */
+#define HPET_MIN_DELTA_NS           2000
+
+/* Map and start the HPET, register its clocksource and clockevent
+ * Returns: 0 on success, -1 without a usable HPET
+ */
+int hpet_init(void);
+
+/* Read the low 32 bits of the main counter (0 before hpet_init() succeeded) */
+uint64_t hpet_read(void);
+
+#endif /* HPET_H */
@@ -3,6 +3,9 @@
 #include <stdio.h>
 #include "../arch/x86/io.h"
 #include "../arch/x86/idt.h"
+#include "vga.h"
+#include "../trace.h"
+#include "../init.h"
 
 /* PS/2 keyboard IRQ number */
 #define KEYBOARD_IRQ 1
@@ -10,6 +13,7 @@
 /* Keyboard state tracking */
 static keyboard_modifiers_t modifiers = {0};
 static uint8_t key_states[128] = {0};  /* Track state of each key */
+static int extended_scancode = 0;       /* Last byte was KEY_EXTENDED_PREFIX */
 
 /* Scancode set 1 (US QWERTY layout) lookup table 
  * Index is the scancode, value is the ASCII character 
@@ -55,6 +59,11 @@ keyboard_status_t keyboard_init(void) {
     return KEYBOARD_SUCCESS;
 }
 
+static int keyboard_initcall(void) {
+    return keyboard_init() == KEYBOARD_SUCCESS ? 0 : -1;
+}
+INITCALL(keyboard, keyboard_initcall, "idt");
+
 /* Wait for the keyboard controller to be ready to accept input */
 keyboard_status_t keyboard_wait_write(void) {
     int timeout = 1000;
@@ -110,12 +119,43 @@ char keyboard_scancode_to_ascii(uint8_t scancode) {
     return uppercase ? scancode_to_ascii_high[scancode] : scancode_to_ascii_low[scancode];
 }
 
+/* Handle keys that only exist as extended (0xE0-prefixed) scancodes
+ * Returns: 1 if the key was consumed, 0 to process it normally */
+static int keyboard_handle_extended(uint8_t scancode) {
+    /* Shift+PgUp / Shift+PgDn scroll the console by half a screen */
+    if (scancode == KEY_PAGE_UP && modifiers.shift) {
+        terminal_scrollback(VGA_HEIGHT / 2);
+        return 1;
+    }
+    if (scancode == KEY_PAGE_DOWN && modifiers.shift) {
+        terminal_scrollback(-(VGA_HEIGHT / 2));
+        return 1;
+    }
+    
+    /* Swallow releases of the keys above */
+    uint8_t released_key = scancode & 0x7F;
+    return (scancode & 0x80) && (released_key == KEY_PAGE_UP || released_key == KEY_PAGE_DOWN);
+}
+
 /* Keyboard interrupt handler */
 void keyboard_handler(registers_t* regs) {
     (void)regs; /* Avoid unused parameter warning */
     
     /* Read the scancode */
     uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    TRACE(KEYBOARD, scancode, 0, 0);
+    
+    /* Extended keys arrive as a 0xE0 prefix followed by the scancode */
+    if (scancode == KEY_EXTENDED_PREFIX) {
+        extended_scancode = 1;
+        return;
+    }
+    if (extended_scancode) {
+        extended_scancode = 0;
+        if (keyboard_handle_extended(scancode)) {
+            return;
+        }
+    }
     
     /* Update key state */
     if (scancode < 128) {
@@ -143,6 +183,12 @@ void keyboard_handler(registers_t* regs) {
             case KEY_SCROLLLOCK:
                 modifiers.scrolllock = !modifiers.scrolllock;
                 break;
+            case KEY_F12:
+                /* Shift+F12 writes the trace buffers to COM1 */
+                if (modifiers.shift) {
+                    trace_request_dump();
+                }
+                break;
             default:
                 /* Convert scancode to ASCII and print if it's a printable character */
                 char ascii = keyboard_scancode_to_ascii(scancode);
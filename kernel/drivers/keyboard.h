@@ -73,7 +73,10 @@ typedef enum {
     KEY_F11 = 0x57,
     KEY_F12 = 0x58,
     KEY_NUMLOCK = 0x45,
-    KEY_SCROLLLOCK = 0x46
+    KEY_SCROLLLOCK = 0x46,
+    KEY_PAGE_UP = 0x49,      /* Sent after KEY_EXTENDED_PREFIX */
+    KEY_PAGE_DOWN = 0x51,    /* Sent after KEY_EXTENDED_PREFIX */
+    KEY_EXTENDED_PREFIX = 0xE0
 } special_keys_t;
 
 /* Initialize the PS/2 keyboard
@@ -1,10 +1,27 @@
 #include "pci.h"
+#include "acpi.h"
 #include "../arch/x86/io.h"
+#include "../arch/x86/paging.h"
 #include "../stdlib/stdio.h" // For printf
+#include "../stdlib/string.h" // For memcpy
 #include "pci_db.h" // For human-readable names
+#include "../init.h"
+#include "../arch/x86/tsc.h"
+
+// An ECAM window from the MCFG table: 4 KiB of config space per function,
+// at base + (bus << 20 | device << 15 | function << 12)
+typedef struct {
+    uint32_t base;      // Address of bus 0 (below start_bus is unmapped)
+    uint8_t start_bus;
+    uint8_t end_bus;
+} pci_ecam_region_t;
+
+static pci_ecam_region_t pci_ecam_regions[ACPI_MAX_ECAM_REGIONS];
+static size_t pci_ecam_region_count = 0;
+static int pci_config_ready = 0;
 
 // Helper function to create the 32-bit address for CONFIG_ADDRESS
-static uint32_t pci_build_address(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+static uint32_t pci_build_address(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset) {
     // Ensure the offset is aligned to 4 bytes for dword reads/writes
     // and extract the lower 2 bits for later use in word/byte reads.
     uint8_t offset_aligned = offset & 0xFC; // Mask out lower 2 bits
@@ -18,13 +35,70 @@ static uint32_t pci_build_address(uint8_t bus, uint8_t device, uint8_t func, uin
     return address;
 }
 
+// Find the ECAM address of a config register, or NULL if the bus has no window
+static volatile void* pci_ecam_address(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset) {
+    for (size_t i = 0; i < pci_ecam_region_count; i++) {
+        const pci_ecam_region_t* region = &pci_ecam_regions[i];
+        if (bus >= region->start_bus && bus <= region->end_bus) {
+            return (volatile void*)(region->base + ((uint32_t)bus << 20) +
+                                    ((uint32_t)device << 15) + ((uint32_t)func << 12) + offset);
+        }
+    }
+    return NULL;
+}
+
+// Map the ECAM windows listed in the ACPI MCFG table
+void pci_config_init(void) {
+    if (pci_config_ready) {
+        return;
+    }
+    pci_config_ready = 1;
+
+    const acpi_platform_t* platform = acpi_platform();
+    for (size_t i = 0; i < platform->ecam_count && pci_ecam_region_count < ACPI_MAX_ECAM_REGIONS; i++) {
+        const acpi_mcfg_entry_t* entry = &platform->ecam[i];
+
+        // Only segment 0 is reachable through mechanism 1 and pci_device_t has no segment
+        if (entry->segment != 0 || entry->end_bus < entry->start_bus) {
+            continue;
+        }
+
+        uint64_t start = entry->base_address + ((uint64_t)entry->start_bus << 20);
+        uint64_t size = (uint64_t)(entry->end_bus - entry->start_bus + 1) << 20;
+        if (start + size > 0x100000000ull ||
+            paging_map_region((uint32_t)start, (uint32_t)size, PDE_CACHE_DISABLE) != 0) {
+            printf("PCI: cannot map ECAM at %08llx, buses %02x-%02x\n",
+                   (unsigned long long)start, entry->start_bus, entry->end_bus);
+            continue;
+        }
+
+        pci_ecam_region_t* region = &pci_ecam_regions[pci_ecam_region_count++];
+        region->base = (uint32_t)entry->base_address;
+        region->start_bus = entry->start_bus;
+        region->end_bus = entry->end_bus;
+    }
+}
+
+// Describe how configuration space is reached
+const char* pci_config_mechanism(void) {
+    return pci_ecam_region_count ? "ECAM" : "port I/O";
+}
+
 // Read a 32-bit DWORD from PCI configuration space
-uint32_t pci_read_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+uint32_t pci_read_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset) {
     // Check if the offset is dword-aligned. PCI requires this.
-    if (offset & 0x03) {
-        // Handle error: Offset not dword aligned
-        // For now, return an error indicator or 0. Returning all FFs is common.
-        // printf("PCI Read Error: Offset %x not dword aligned.\n", offset);
+    if ((offset & 0x03) || offset >= PCIE_CONFIG_SPACE_SIZE) {
+        // Returning all FFs is what a read from a missing device gives
+        return 0xFFFFFFFF;
+    }
+
+    volatile void* ecam = pci_ecam_address(bus, device, func, offset);
+    if (ecam) {
+        return *(volatile uint32_t*)ecam;
+    }
+
+    // Mechanism 1 only reaches the first 256 bytes
+    if (offset >= PCI_CONFIG_SPACE_SIZE) {
         return 0xFFFFFFFF;
     }
     
@@ -40,9 +114,9 @@ uint32_t pci_read_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint8_
 }
 
 // Read a 16-bit WORD from PCI configuration space
-uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset) {
     // Read the containing DWORD
-    uint32_t dword = pci_read_config_dword(bus, device, func, offset & 0xFC);
+    uint32_t dword = pci_read_config_dword(bus, device, func, offset & ~3);
     
     // Extract the correct word based on the original offset's lower 2 bits
     // offset & 0x02 determines if we want the high word (offset 2 or 3) or low word (offset 0 or 1)
@@ -50,70 +124,391 @@ uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t func, uint8_t
 }
 
 // Read an 8-bit BYTE from PCI configuration space
-uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset) {
     // Read the containing DWORD
-    uint32_t dword = pci_read_config_dword(bus, device, func, offset & 0xFC);
+    uint32_t dword = pci_read_config_dword(bus, device, func, offset & ~3);
     
     // Extract the correct byte based on the original offset's lower 2 bits
     return (uint8_t)((dword >> ((offset & 3) * 8)) & 0xFF);
 }
 
+// Write a 32-bit DWORD to PCI configuration space
+void pci_write_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset, uint32_t value) {
+    if ((offset & 0x03) || offset >= PCIE_CONFIG_SPACE_SIZE) {
+        return;
+    }
+
+    volatile void* ecam = pci_ecam_address(bus, device, func, offset);
+    if (ecam) {
+        *(volatile uint32_t*)ecam = value;
+        return;
+    }
+    if (offset >= PCI_CONFIG_SPACE_SIZE) {
+        return;
+    }
+
+    outl(PCI_CONFIG_ADDRESS, pci_build_address(bus, device, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+// Write a 16-bit WORD to PCI configuration space
+void pci_write_config_word(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset, uint16_t value) {
+    if ((offset & 0x01) || offset >= PCIE_CONFIG_SPACE_SIZE) {
+        return;
+    }
+
+    volatile void* ecam = pci_ecam_address(bus, device, func, offset);
+    if (ecam) {
+        *(volatile uint16_t*)ecam = value;
+        return;
+    }
+    if (offset >= PCI_CONFIG_SPACE_SIZE) {
+        return;
+    }
+
+    // The data port decodes byte lanes, so a word write leaves the other half alone
+    outl(PCI_CONFIG_ADDRESS, pci_build_address(bus, device, func, offset));
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+}
+
 // Check if a device exists by reading its Vendor ID
 uint16_t pci_check_device(uint8_t bus, uint8_t device, uint8_t func) {
     return pci_read_config_word(bus, device, func, PCI_VENDOR_ID_OFFSET);
 }
 
-// Enumerate the PCI bus(es)
+// The device table, filled by pci_scan()
+static pci_device_t pci_table[PCI_MAX_DEVICES];
+static size_t pci_table_count = 0;
+static size_t pci_scan_next = 0;    // Slot the scan fills next
+static int pci_scanned = 0;
+static uint64_t pci_scan_cycles = 0;
+
+// Buses already scanned, so a misconfigured bridge cannot loop the scan
+static uint8_t pci_bus_seen[PCI_MAX_BUSES / 8];
+
+// Field accessors for the raw header
+static uint8_t header_byte(const uint32_t* header, uint8_t offset) {
+    return (uint8_t)(header[offset / 4] >> ((offset & 3) * 8));
+}
+
+static uint16_t header_word(const uint32_t* header, uint8_t offset) {
+    return (uint16_t)(header[offset / 4] >> ((offset & 2) * 8));
+}
+
+// Size one BAR by writing all ones and reading back which bits stick
+// Returns the number of BAR registers it uses (2 for 64-bit memory BARs)
+static int pci_size_bar(pci_device_t* dev, int index) {
+    uint8_t offset = PCI_BAR0_OFFSET + index * 4;
+    uint32_t original = dev->header[offset / 4];
+    pci_bar_t* bar = &dev->bars[index];
+
+    pci_write_config_dword(dev->bus, dev->device, dev->func, offset, 0xFFFFFFFF);
+    uint32_t mask = pci_read_config_dword(dev->bus, dev->device, dev->func, offset);
+    pci_write_config_dword(dev->bus, dev->device, dev->func, offset, original);
+
+    if (original & PCI_BAR_IO) {
+        bar->io = 1;
+        bar->base = original & ~0x3u;
+        // Only the low 16 bits decode on x86 I/O space
+        mask = (mask & ~0x3u) | 0xFFFF0000u;
+        bar->size = mask == 0xFFFF0000u ? 0 : (uint32_t)(~mask + 1);
+        return 1;
+    }
+
+    bar->prefetchable = (original & PCI_BAR_PREFETCHABLE) != 0;
+    uint64_t base = original & ~0xFu;
+    uint64_t size_mask = mask & ~0xFu;
+    int used = 1;
+
+    if ((original & PCI_BAR_MEM_TYPE_MASK) == PCI_BAR_MEM_TYPE_64 && index + 1 < dev->bar_count) {
+        uint8_t high_offset = offset + 4;
+        uint32_t high = dev->header[high_offset / 4];
+        pci_write_config_dword(dev->bus, dev->device, dev->func, high_offset, 0xFFFFFFFF);
+        uint32_t high_mask = pci_read_config_dword(dev->bus, dev->device, dev->func, high_offset);
+        pci_write_config_dword(dev->bus, dev->device, dev->func, high_offset, high);
+
+        bar->is_64bit = 1;
+        base |= (uint64_t)high << 32;
+        size_mask |= (uint64_t)high_mask << 32;
+        used = 2;
+    } else {
+        size_mask |= 0xFFFFFFFF00000000ull;
+    }
+
+    bar->base = base;
+    bar->size = size_mask == 0xFFFFFFFF00000000ull || size_mask == 0 ? 0 : ~size_mask + 1;
+    return used;
+}
+
+// Size all BARs of a function with decoding switched off, so a half-written
+// BAR never claims addresses that belong to something else. Host bridges
+// stay on: on some chipsets the memory bit gates access to RAM itself.
+static void pci_size_bars(pci_device_t* dev) {
+    uint16_t command = header_word(dev->header, PCI_COMMAND_OFFSET);
+    int host_bridge = dev->class_code == 0x06 && dev->subclass_code == 0x00;
+
+    if (!host_bridge) {
+        pci_write_config_word(dev->bus, dev->device, dev->func, PCI_COMMAND_OFFSET,
+                              command & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+    }
+
+    for (int i = 0; i < dev->bar_count;) {
+        i += pci_size_bar(dev, i);
+    }
+
+    if (!host_bridge) {
+        pci_write_config_word(dev->bus, dev->device, dev->func, PCI_COMMAND_OFFSET, command);
+    }
+}
+
+static void pci_scan_bus(uint8_t bus);
+
+// Read a function's header into the next table slot and follow bridges.
+// Bound drivers and their interrupt handlers hold pointers into the table,
+// so the entry is built on the side and only copied in if it changed.
+static void pci_scan_function(uint8_t bus, uint8_t device, uint8_t func) {
+    if (pci_scan_next >= PCI_MAX_DEVICES) {
+        return;
+    }
+
+    pci_device_t* entry = &pci_table[pci_scan_next++];
+    pci_device_t found = {0};
+    pci_device_t* dev = &found;
+    dev->bus = bus;
+    dev->device = device;
+    dev->func = func;
+
+    for (int i = 0; i < PCI_HEADER_SIZE / 4; i++) {
+        dev->header[i] = pci_read_config_dword(bus, device, func, i * 4);
+    }
+
+    const uint32_t* header = dev->header;
+    dev->vendor_id = header_word(header, PCI_VENDOR_ID_OFFSET);
+    dev->device_id = header_word(header, PCI_DEVICE_ID_OFFSET);
+    dev->revision = header_byte(header, PCI_REVISION_ID_OFFSET);
+    dev->prog_if = header_byte(header, PCI_PROG_IF_OFFSET);
+    dev->subclass_code = header_byte(header, PCI_SUBCLASS_CODE_OFFSET);
+    dev->class_code = header_byte(header, PCI_CLASS_CODE_OFFSET);
+    dev->header_type = header_byte(header, PCI_HEADER_TYPE_OFFSET) & PCI_HEADER_TYPE_MASK;
+    dev->irq_line = header_byte(header, PCI_INTERRUPT_LINE_OFFSET);
+    dev->irq_pin = header_byte(header, PCI_INTERRUPT_PIN_OFFSET);
+
+    switch (dev->header_type) {
+        case PCI_HEADER_TYPE_DEVICE:
+            dev->bar_count = 6;
+            break;
+        case PCI_HEADER_TYPE_BRIDGE:
+            dev->bar_count = 2;
+            dev->secondary_bus = header_byte(header, PCI_SECONDARY_BUS_OFFSET);
+            dev->subordinate_bus = header_byte(header, PCI_SUBORDINATE_BUS_OFFSET);
+            break;
+        default:
+            // CardBus bridges have no BARs we would use
+            break;
+    }
+    // A rescan meets the functions in the same order. Keep the BARs sized
+    // the first time instead of switching decode off under a bound driver.
+    if (pci_scanned && entry->bus == bus && entry->device == device && entry->func == func &&
+        entry->vendor_id == dev->vendor_id && entry->device_id == dev->device_id) {
+        memcpy(dev->bars, entry->bars, sizeof(dev->bars));
+    } else {
+        pci_size_bars(dev);
+    }
+    if (memcmp(entry, dev, sizeof(*entry)) != 0) {
+        *entry = found;
+    }
+
+    // The firmware numbered the buses; a bridge left at 0 has nothing behind it yet
+    if (dev->header_type == PCI_HEADER_TYPE_BRIDGE && dev->secondary_bus > bus) {
+        pci_scan_bus(dev->secondary_bus);
+    }
+}
+
+// Scan every device (and function) on one bus
+static void pci_scan_bus(uint8_t bus) {
+    if (pci_bus_seen[bus / 8] & (1 << (bus % 8))) {
+        return;
+    }
+    pci_bus_seen[bus / 8] |= 1 << (bus % 8);
+
+    for (uint8_t device = 0; device < 32; device++) {
+        if (pci_check_device(bus, device, 0) == PCI_INVALID_VENDOR_ID) {
+            continue;
+        }
+
+        uint8_t header_type = pci_read_config_byte(bus, device, 0, PCI_HEADER_TYPE_OFFSET);
+        uint8_t max_funcs = (header_type & PCI_MULTIFUNCTION_MASK) ? 8 : 1;
+
+        for (uint8_t func = 0; func < max_funcs; func++) {
+            if (func == 0 || pci_check_device(bus, device, func) != PCI_INVALID_VENDOR_ID) {
+                pci_scan_function(bus, device, func);
+            }
+        }
+    }
+}
+
+// Scan the whole hierarchy into the device table
+size_t pci_scan(void) {
+    pci_config_init();
+    uint64_t start = tsc_read();
+
+    // The table stays readable while it is refilled; its size is set at the end
+    pci_scan_next = 0;
+    for (size_t i = 0; i < sizeof(pci_bus_seen); i++) {
+        pci_bus_seen[i] = 0;
+    }
+
+    // A multi-function host bridge at 00:00.0 means one root bus per function
+    uint8_t header_type = pci_read_config_byte(0, 0, 0, PCI_HEADER_TYPE_OFFSET);
+    if (header_type & PCI_MULTIFUNCTION_MASK) {
+        for (uint8_t func = 0; func < 8; func++) {
+            if (pci_check_device(0, 0, func) != PCI_INVALID_VENDOR_ID) {
+                pci_scan_bus(func);
+            }
+        }
+    } else {
+        pci_scan_bus(0);
+    }
+
+    pci_table_count = pci_scan_next;
+    pci_scanned = 1;
+    pci_scan_cycles = tsc_read() - start;
+    return pci_table_count;
+}
+
+// Scan on first use of the table
+static void pci_ensure_scanned(void) {
+    if (!pci_scanned) {
+        pci_scan();
+    }
+}
+
+// Number of functions in the device table
+size_t pci_device_count(void) {
+    pci_ensure_scanned();
+    return pci_table_count;
+}
+
+// Get a function from the device table
+const pci_device_t* pci_get_device(size_t index) {
+    pci_ensure_scanned();
+    return index < pci_table_count ? &pci_table[index] : NULL;
+}
+
+// Position of a function in the device table
+size_t pci_device_index(const pci_device_t* dev) {
+    if (dev < pci_table || dev >= pci_table + pci_table_count) {
+        return PCI_MAX_DEVICES;
+    }
+    return (size_t)(dev - pci_table);
+}
+
+// Set command register bits of a function
+void pci_enable_device(const pci_device_t* dev, uint16_t command) {
+    uint16_t current = pci_read_config_word(dev->bus, dev->device, dev->func, PCI_COMMAND_OFFSET);
+    if ((current & command) != command) {
+        pci_write_config_word(dev->bus, dev->device, dev->func, PCI_COMMAND_OFFSET, current | command);
+    }
+}
+
+// Walk the capability list; a malformed list ends after 48 entries
+uint8_t pci_find_capability(const pci_device_t* dev, uint8_t id, uint8_t start) {
+    if (!(header_word(dev->header, PCI_STATUS_OFFSET) & PCI_STATUS_CAP_LIST) ||
+        dev->header_type == PCI_HEADER_TYPE_CARDBUS) {
+        return 0;
+    }
+
+    uint8_t offset = start ? pci_read_config_byte(dev->bus, dev->device, dev->func, start + 1)
+                           : header_byte(dev->header, PCI_CAPABILITY_LIST_OFFSET);
+    for (int guard = 0; guard < 48 && offset >= PCI_HEADER_SIZE; guard++) {
+        offset &= 0xFC;
+        uint16_t entry = pci_read_config_word(dev->bus, dev->device, dev->func, offset);
+        if ((entry & 0xFF) == id) {
+            return offset;
+        }
+        offset = entry >> 8;
+    }
+    return 0;
+}
+
+// Find the first cached function with the given vendor and device ID
+const pci_device_t* pci_lookup(uint16_t vendor_id, uint16_t device_id) {
+    pci_ensure_scanned();
+    for (size_t i = 0; i < pci_table_count; i++) {
+        if (pci_table[i].vendor_id == vendor_id && pci_table[i].device_id == device_id) {
+            return &pci_table[i];
+        }
+    }
+    return NULL;
+}
+
+// Find the first function with the given vendor and device ID
+int pci_find_device(uint16_t vendor_id, uint16_t device_id,
+                    uint8_t* bus, uint8_t* device, uint8_t* func) {
+    const pci_device_t* dev = pci_lookup(vendor_id, device_id);
+    if (!dev) {
+        return 0;
+    }
+
+    *bus = dev->bus;
+    *device = dev->device;
+    *func = dev->func;
+    return 1;
+}
+
+// Print the device table
 void pci_enumerate_bus() {
+    pci_ensure_scanned();
+
     printf("\nPCI Bus Enumeration:\n");
-    printf("%-8s | %-12s | %-20s | %-20s\n", "Bus:Dev", "Vendor", "Device", "Class");
+    printf("%-8s | %-12s | %-24s | %-20s | %s\n", "Bus:Dev", "Vendor", "Device", "Class", "IRQ");
     printf("-----------------------------------------------------------\n");
 
-    // For simplicity, we'll only scan the first bus (bus 0) for now
-    // A full implementation would scan buses 0-255
-    for (uint8_t bus = 0; bus < 1; bus++) { // Simplified loop
-        for (uint8_t device = 0; device < 32; device++) {
-            uint8_t func = 0;
-            uint16_t vendor_id = pci_check_device(bus, device, func);
+    size_t buses = 0;
+    for (size_t i = 0; i < sizeof(pci_bus_seen); i++) {
+        for (uint8_t bits = pci_bus_seen[i]; bits; bits &= bits - 1) {
+            buses++;
+        }
+    }
 
-            if (vendor_id == PCI_INVALID_VENDOR_ID) {
-                continue; // No device here
-            }
+    for (size_t i = 0; i < pci_table_count; i++) {
+        const pci_device_t* dev = &pci_table[i];
 
-            // Read header type to check for multi-function devices
-            uint8_t header_type = pci_read_config_byte(bus, device, func, PCI_HEADER_TYPE_OFFSET);
-            uint8_t max_funcs = (header_type & PCI_MULTIFUNCTION_MASK) ? 8 : 1;
-
-            // Iterate through functions if it's a multi-function device
-            for (; func < max_funcs; func++) {
-                vendor_id = pci_check_device(bus, device, func);
-                if (vendor_id == PCI_INVALID_VENDOR_ID) {
-                    continue; // No function here
-                }
-
-                // Read other details
-                uint16_t device_id = pci_read_config_word(bus, device, func, PCI_DEVICE_ID_OFFSET);
-                uint8_t class_code = pci_read_config_byte(bus, device, func, PCI_CLASS_CODE_OFFSET);
-                uint8_t subclass_code = pci_read_config_byte(bus, device, func, PCI_SUBCLASS_CODE_OFFSET);
-
-                // Get human-readable names
-                const char* vendor_name = pci_vendor_name(vendor_id);
-                const char* device_name = pci_device_name(vendor_id, device_id);
-                const char* class_name = pci_class_name(class_code, subclass_code);
-
-                // Format bus:device.function
-                char location[9];
-                snprintf(location, sizeof(location), "%02x:%02x.%x", bus, device, func);
-
-                // Print device information with names
-                printf("%-8s| %-12s | %-24s | %-20s\n",
-                       location,
-                       vendor_name,
-                       device_name,
-                       class_name);
-            }
+        // Format bus:device.function
+        char location[9];
+        snprintf(location, sizeof(location), "%02x:%02x.%x", dev->bus, dev->device, dev->func);
+
+        char irq[8] = "-";
+        if (dev->irq_pin && dev->irq_line != 0xFF) {
+            snprintf(irq, sizeof(irq), "%u", dev->irq_line);
+        }
+
+        // pci.ids names can be long; cut them to the column widths
+        printf("%-8s| %-12.12s | %-24.24s | %-20.20s | %s\n",
+               location,
+               pci_vendor_name(dev->vendor_id),
+               pci_device_name(dev->vendor_id, dev->device_id),
+               pci_class_name(dev->class_code, dev->subclass_code),
+               irq);
+
+        if (dev->header_type == PCI_HEADER_TYPE_BRIDGE) {
+            printf("          bridge to buses %02x-%02x\n", dev->secondary_bus, dev->subordinate_bus);
+        }
+        for (int b = 0; b < dev->bar_count; b++) {
+            const pci_bar_t* bar = &dev->bars[b];
+            if (bar->size == 0) continue;
+            printf("          BAR%d %s %08llx size %llx%s%s\n", b, bar->io ? "io " : "mem",
+                   (unsigned long long)bar->base, (unsigned long long)bar->size,
+                   bar->is_64bit ? " 64-bit" : "", bar->prefetchable ? " prefetchable" : "");
         }
     }
     printf("-----------------------------------------------------------\n");
-    printf("PCI Enumeration Complete.\n");
-} 
\ No newline at end of file
+    printf("PCI Enumeration Complete: %u functions on %u buses, scanned in %u us through %s.\n",
+           pci_table_count, buses, (uint32_t)tsc_to_us(pci_scan_cycles), pci_config_mechanism());
+}
+
+static int pci_initcall(void) {
+    pci_enumerate_bus();
+    return 0;
+}
+INITCALL(pci, pci_initcall, "");
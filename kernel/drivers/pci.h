@@ -2,11 +2,16 @@
 #define KERNEL_PCI_H
 
 #include "../stdlib/stdint.h"
+#include "../stdlib/stddef.h"
 
 // PCI Configuration Space Access Ports (Mechanism 1)
 #define PCI_CONFIG_ADDRESS 0xCF8
 #define PCI_CONFIG_DATA    0xCFC
 
+// Configuration space per function: legacy PCI, and PCI Express through ECAM
+#define PCI_CONFIG_SPACE_SIZE  256
+#define PCIE_CONFIG_SPACE_SIZE 4096
+
 // Value returned for non-existent devices
 #define PCI_INVALID_VENDOR_ID 0xFFFF
 
@@ -33,44 +38,157 @@
 #define PCI_BAR5_OFFSET             0x24
 #define PCI_SUBSYSTEM_VENDOR_ID_OFFSET 0x2C
 #define PCI_SUBSYSTEM_ID_OFFSET     0x2E
+#define PCI_CAPABILITY_LIST_OFFSET  0x34
 #define PCI_INTERRUPT_LINE_OFFSET   0x3C
 #define PCI_INTERRUPT_PIN_OFFSET    0x3D
 
+// Header Type 0x01 (PCI-to-PCI bridge) Specific Offsets
+#define PCI_PRIMARY_BUS_OFFSET      0x18
+#define PCI_SECONDARY_BUS_OFFSET    0x19
+#define PCI_SUBORDINATE_BUS_OFFSET  0x1A
+
 // Header Type masks
 #define PCI_HEADER_TYPE_MASK        0x7F
 #define PCI_MULTIFUNCTION_MASK      0x80
 
+// Header types
+#define PCI_HEADER_TYPE_DEVICE      0x00
+#define PCI_HEADER_TYPE_BRIDGE      0x01
+#define PCI_HEADER_TYPE_CARDBUS     0x02
+
+// Command register bits
+#define PCI_COMMAND_IO              0x0001  // Decode I/O space BARs
+#define PCI_COMMAND_MEMORY          0x0002  // Decode memory space BARs
+#define PCI_COMMAND_BUS_MASTER      0x0004  // Allow DMA
+#define PCI_COMMAND_INTX_DISABLE    0x0400  // Do not assert INTx# (MSI in use)
+
+// Status register bits
+#define PCI_STATUS_CAP_LIST         0x0010  // Capability list at PCI_CAPABILITY_LIST_OFFSET
+
+// Capability IDs
+#define PCI_CAP_ID_PM               0x01    // Power management
+#define PCI_CAP_ID_MSI              0x05    // Message signalled interrupts
+#define PCI_CAP_ID_VENDOR           0x09    // Vendor specific (virtio uses these)
+#define PCI_CAP_ID_EXP              0x10    // PCI Express
+#define PCI_CAP_ID_MSIX             0x11    // MSI-X
+#define PCI_CAP_ID_SATA             0x12    // SATA index/data pair
+
+// BAR low bits
+#define PCI_BAR_IO                  0x01    // I/O space BAR
+#define PCI_BAR_MEM_TYPE_MASK       0x06
+#define PCI_BAR_MEM_TYPE_64         0x04    // 64-bit memory BAR (uses the next BAR too)
+#define PCI_BAR_PREFETCHABLE        0x08
+
+// Standard header size, read in one pass per function
+#define PCI_HEADER_SIZE             64
+
+// Limits of the cached device table
+#define PCI_MAX_DEVICES             256
+#define PCI_MAX_BARS                6
+#define PCI_MAX_BUSES               256
+
+// A sized Base Address Register
+typedef struct {
+    uint64_t base;          // Address with the flag bits removed (0 if unused)
+    uint64_t size;          // Decoded size in bytes (0 if unused)
+    uint8_t io;             // 1 for I/O space, 0 for memory
+    uint8_t is_64bit;       // Memory BAR spanning this and the next register
+    uint8_t prefetchable;
+} pci_bar_t;
+
+// One function found by the scan
+typedef struct {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t func;
+    uint8_t header_type;    // PCI_HEADER_TYPE_* (multi-function bit removed)
+
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass_code;
+    uint8_t prog_if;
+    uint8_t revision;
+
+    uint8_t irq_line;       // Legacy IRQ routed by the firmware (0xFF if none)
+    uint8_t irq_pin;        // 1-4 for INTA#-INTD#, 0 if the function uses none
+    uint8_t secondary_bus;  // Bridges only: bus behind the bridge
+    uint8_t subordinate_bus;// Bridges only: highest bus below the bridge
+
+    pci_bar_t bars[PCI_MAX_BARS];
+    uint8_t bar_count;      // 6 for devices, 2 for bridges
+
+    // The raw header as read during the scan (before BAR sizing)
+    uint32_t header[PCI_HEADER_SIZE / 4];
+} pci_device_t;
+
 // Function prototypes
 
+/**
+ * @brief Sets up memory-mapped configuration access (ECAM) from the ACPI MCFG table.
+ *
+ * With ECAM, reads and writes are plain MMIO and reach the 4 KiB extended
+ * space of PCI Express functions. Without an MCFG table (e.g. QEMU -machine pc)
+ * everything keeps going through ports 0xCF8/0xCFC, limited to 256 bytes.
+ * pci_scan() calls this; calling it again does nothing.
+ */
+void pci_config_init(void);
+
+/**
+ * @brief Names the configuration access mechanism in use.
+ * @return "ECAM" or "port I/O".
+ */
+const char* pci_config_mechanism(void);
+
 /**
  * @brief Read a 32-bit value from PCI configuration space.
  * @param bus PCI bus number (0-255)
  * @param device PCI device number (0-31)
  * @param func PCI function number (0-7)
- * @param offset Register offset within the configuration space (must be 4-byte aligned)
+ * @param offset Register offset within the configuration space (below 256 without ECAM; must be 4-byte aligned)
  * @return The 32-bit value read.
  */
-uint32_t pci_read_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+uint32_t pci_read_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset);
 
 /**
  * @brief Read a 16-bit value from PCI configuration space.
  * @param bus PCI bus number (0-255)
  * @param device PCI device number (0-31)
  * @param func PCI function number (0-7)
- * @param offset Register offset within the configuration space.
+ * @param offset Register offset within the configuration space (below 256 without ECAM).
  * @return The 16-bit value read.
  */
-uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset);
 
 /**
  * @brief Read an 8-bit value from PCI configuration space.
  * @param bus PCI bus number (0-255)
  * @param device PCI device number (0-31)
  * @param func PCI function number (0-7)
- * @param offset Register offset within the configuration space.
+ * @param offset Register offset within the configuration space (below 256 without ECAM).
  * @return The 8-bit value read.
  */
-uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset);
+
+/**
+ * @brief Write a 32-bit value to PCI configuration space.
+ * @param bus PCI bus number (0-255)
+ * @param device PCI device number (0-31)
+ * @param func PCI function number (0-7)
+ * @param offset Register offset within the configuration space (below 256 without ECAM; must be 4-byte aligned)
+ * @param value The value to write.
+ */
+void pci_write_config_dword(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset, uint32_t value);
+
+/**
+ * @brief Write a 16-bit value to PCI configuration space.
+ * @param bus PCI bus number (0-255)
+ * @param device PCI device number (0-31)
+ * @param func PCI function number (0-7)
+ * @param offset Register offset within the configuration space (below 256 without ECAM; must be 2-byte aligned)
+ * @param value The value to write.
+ */
+void pci_write_config_word(uint8_t bus, uint8_t device, uint8_t func, uint16_t offset, uint16_t value);
 
 /**
  * @brief Checks if a device exists at the specified bus, device, and function.
@@ -82,7 +200,77 @@ uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t func, uint8_t
 uint16_t pci_check_device(uint8_t bus, uint8_t device, uint8_t func);
 
 /**
- * @brief Enumerates the PCI bus(es) and prints information about found devices.
+ * @brief Scans every bus reachable through PCI-to-PCI bridges into the device table.
+ *
+ * Each function's header is read once, its BARs are sized and the result is
+ * cached; later queries do not touch configuration space. The scan runs on
+ * first use of the table, so calling this is only needed to rescan. A
+ * rescan keeps the BAR sizes of functions it already knew, so devices in
+ * use never have their decoding switched off, and only overwrites entries
+ * that changed, so pointers held by drivers never see a half-filled one.
+ * Driver bindings (pci_driver.h) are kept by table index across a rescan.
+ * @return Number of functions found.
+ */
+size_t pci_scan(void);
+
+/**
+ * @brief Gets the number of functions in the device table.
+ * @return Number of cached functions.
+ */
+size_t pci_device_count(void);
+
+/**
+ * @brief Gets a function from the device table, in scan order.
+ * @param index Index below pci_device_count()
+ * @return The cached function, or NULL if index is out of range.
+ */
+const pci_device_t* pci_get_device(size_t index);
+
+/**
+ * @brief Gets the position of a function in the device table.
+ * @param dev Function returned by pci_get_device() or pci_lookup()
+ * @return Its index, or PCI_MAX_DEVICES if dev is not in the table.
+ */
+size_t pci_device_index(const pci_device_t* dev);
+
+/**
+ * @brief Sets bits in a function's command register, e.g. to enable decoding and DMA.
+ * @param dev Function from the device table
+ * @param command PCI_COMMAND_* bits to set
+ */
+void pci_enable_device(const pci_device_t* dev, uint16_t command);
+
+/**
+ * @brief Walks a function's capability list.
+ * @param dev Function from the device table
+ * @param id PCI_CAP_ID_* to look for
+ * @param start 0 for the first match, or the offset of a previous match to find the next one
+ * @return Config space offset of the capability, or 0 if there is none.
+ */
+uint8_t pci_find_capability(const pci_device_t* dev, uint8_t id, uint8_t start);
+
+/**
+ * @brief Finds the first function with the given vendor and device ID.
+ * @param vendor_id Vendor ID to look for
+ * @param device_id Device ID to look for
+ * @param bus Receives the bus number of the match
+ * @param device Receives the device number of the match
+ * @param func Receives the function number of the match
+ * @return 1 if a matching function was found, 0 otherwise.
+ */
+int pci_find_device(uint16_t vendor_id, uint16_t device_id,
+                    uint8_t* bus, uint8_t* device, uint8_t* func);
+
+/**
+ * @brief Finds the first function with the given vendor and device ID in the device table.
+ * @param vendor_id Vendor ID to look for
+ * @param device_id Device ID to look for
+ * @return The cached function, or NULL if there is none.
+ */
+const pci_device_t* pci_lookup(uint16_t vendor_id, uint16_t device_id);
+
+/**
+ * @brief Prints the device table, scanning first if needed.
  */
 void pci_enumerate_bus();
 
@@ -1,28 +1,44 @@
 #include "pci_db.h"
 
-const char* pci_vendor_name(uint16_t vendor_id) {
-    for (const pci_vendor_info_t* vendor = pci_vendors; vendor->name != NULL; vendor++) {
-        if (vendor->id == vendor_id) {
-            return vendor->name;
-        }
+// Key for the name of a whole class in pci_class_ids
+#define PCI_ID_CLASS_ONLY 0x10000
+
+// Must match pci_id_hash() in tools/gen_pci_ids.py
+static uint32_t pci_id_hash(uint32_t key, uint32_t seed) {
+    uint32_t h = key ^ (seed * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// Name stored for key, or NULL if the table does not have it
+static const char* pci_id_lookup(const pci_id_table_t* table, uint32_t key) {
+    if (table->count == 0) {
+        return NULL;
     }
-    return "Unknown Vendor";
+    uint32_t seed = table->seeds[pci_id_hash(key, 0) % table->bucket_count];
+    const pci_id_entry_t* entry = &table->entries[pci_id_hash(key, seed) % table->count];
+    return entry->key == key ? &pci_id_strings[entry->name] : NULL;
+}
+
+const char* pci_vendor_name(uint16_t vendor_id) {
+    const char* name = pci_id_lookup(&pci_vendor_ids, vendor_id);
+    return name ? name : "Unknown Vendor";
 }
 
 const char* pci_device_name(uint16_t vendor_id, uint16_t device_id) {
-    for (const pci_device_info_t* device = pci_devices; device->name != NULL; device++) {
-        if (device->vendor_id == vendor_id && device->device_id == device_id) {
-            return device->name;
-        }
-    }
-    return "Unknown Device";
+    const char* name = pci_id_lookup(&pci_device_ids, (uint32_t)vendor_id << 16 | device_id);
+    return name ? name : "Unknown Device";
 }
 
 const char* pci_class_name(uint8_t class_code, uint8_t subclass) {
-    for (const pci_class_info_t* class = pci_classes; class->name != NULL; class++) {
-        if (class->class_code == class_code && class->subclass == subclass) {
-            return class->name;
-        }
+    const char* name = pci_id_lookup(&pci_class_ids, (uint32_t)class_code << 8 | subclass);
+    if (name == NULL) {
+        // Unlisted subclass: fall back to the name of the class
+        name = pci_id_lookup(&pci_class_ids, PCI_ID_CLASS_ONLY | class_code);
     }
-    return "Unknown Class";
-} 
\ No newline at end of file
+    return name ? name : "Unknown Class";
+} 
@@ -0,0 +1,251 @@
+#include "pci_driver.h"
+#include "../stdlib/stdio.h" // For printf
+#include "../init.h"
+#include "../arch/x86/tsc.h"
+
+// Registered drivers, gathered by the linker (see linker.ld)
+extern const pci_driver_t __pci_driver_start[];
+extern const pci_driver_t __pci_driver_end[];
+
+typedef enum {
+    PCI_BIND_NONE,          // No driver (or not matched yet)
+    PCI_BIND_QUEUED,        // Matched, probe waiting for pci_probe_poll()
+    PCI_BIND_DEFERRED,      // Probe asked to be retried later
+    PCI_BIND_BOUND,         // Probe succeeded
+    PCI_BIND_FAILED         // Probe failed; not retried
+} pci_bind_state_t;
+
+// Driver state of one function, at the function's index in the device table
+typedef struct {
+    const pci_driver_t* driver;
+    const pci_device_id_t* id;
+    void* data;
+    uint32_t defer_mark;    // Successful probes when the probe deferred
+    uint8_t state;          // pci_bind_state_t
+} pci_binding_t;
+
+// One ID table entry in the match index
+typedef struct {
+    uint32_t key;           // vendor << 16 | device (exact entries only)
+    const pci_driver_t* driver;
+    const pci_device_id_t* id;
+} pci_match_t;
+
+static pci_binding_t pci_bindings[PCI_MAX_DEVICES];
+
+// Entries naming a vendor and device, sorted by key; equal keys keep link order
+static pci_match_t pci_exact_matches[PCI_MATCH_MAX];
+static size_t pci_exact_count = 0;
+
+// Entries with a wildcard ID (class matches), in link order
+static pci_match_t pci_generic_matches[PCI_MATCH_MAX];
+static size_t pci_generic_count = 0;
+
+static int pci_index_ready = 0;
+static uint32_t pci_probe_successes = 0;
+
+// Check the class part of an entry
+static int pci_class_matches(const pci_device_id_t* id, const pci_device_t* dev) {
+    uint32_t class_code = (uint32_t)dev->class_code << 16 |
+                          (uint32_t)dev->subclass_code << 8 | dev->prog_if;
+    return (class_code & id->class_mask) == (id->class_code & id->class_mask);
+}
+
+// Build the match index from every driver's ID table
+static void pci_build_index(void) {
+    pci_index_ready = 1;
+
+    for (const pci_driver_t* driver = __pci_driver_start; driver < __pci_driver_end; driver++) {
+        for (const pci_device_id_t* id = driver->ids; id->vendor_id != 0; id++) {
+            pci_match_t match = { (uint32_t)id->vendor_id << 16 | id->device_id, driver, id };
+
+            if (id->vendor_id == PCI_ANY_ID || id->device_id == PCI_ANY_ID) {
+                if (pci_generic_count == PCI_MATCH_MAX) {
+                    printf("PCI: match index full, %s entries dropped\n", driver->name);
+                    continue;
+                }
+                pci_generic_matches[pci_generic_count++] = match;
+                continue;
+            }
+
+            if (pci_exact_count == PCI_MATCH_MAX) {
+                printf("PCI: match index full, %s entries dropped\n", driver->name);
+                continue;
+            }
+
+            // Insertion sort: a handful of entries, and it keeps link order for equal keys
+            size_t pos = pci_exact_count++;
+            while (pos > 0 && pci_exact_matches[pos - 1].key > match.key) {
+                pci_exact_matches[pos] = pci_exact_matches[pos - 1];
+                pos--;
+            }
+            pci_exact_matches[pos] = match;
+        }
+    }
+}
+
+// Find the driver for a function: vendor/device entries first, then wildcards
+const pci_driver_t* pci_driver_match(const pci_device_t* dev, const pci_device_id_t** id) {
+    if (!pci_index_ready) {
+        pci_build_index();
+    }
+
+    // Binary search for the first entry with the function's key
+    uint32_t key = (uint32_t)dev->vendor_id << 16 | dev->device_id;
+    size_t low = 0, high = pci_exact_count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (pci_exact_matches[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    const pci_match_t* found = NULL;
+    for (size_t i = low; i < pci_exact_count && pci_exact_matches[i].key == key; i++) {
+        if (pci_class_matches(pci_exact_matches[i].id, dev)) {
+            found = &pci_exact_matches[i];
+            break;
+        }
+    }
+
+    for (size_t i = 0; !found && i < pci_generic_count; i++) {
+        const pci_device_id_t* entry = pci_generic_matches[i].id;
+        if ((entry->vendor_id == PCI_ANY_ID || entry->vendor_id == dev->vendor_id) &&
+            (entry->device_id == PCI_ANY_ID || entry->device_id == dev->device_id) &&
+            pci_class_matches(entry, dev)) {
+            found = &pci_generic_matches[i];
+        }
+    }
+
+    if (id) {
+        *id = found ? found->id : NULL;
+    }
+    return found ? found->driver : NULL;
+}
+
+// Run the probe of a matched function and record the outcome
+static void pci_run_probe(size_t index) {
+    pci_binding_t* binding = &pci_bindings[index];
+    const pci_device_t* dev = pci_get_device(index);
+
+    uint64_t start = tsc_read();
+    int result = binding->driver->probe(dev, binding->id);
+    uint32_t us = (uint32_t)tsc_to_us(tsc_read() - start);
+
+    if (result == 0) {
+        binding->state = PCI_BIND_BOUND;
+        pci_probe_successes++;
+        printf("PCI: %02x:%02x.%x bound to %s (%u us)\n",
+               dev->bus, dev->device, dev->func, binding->driver->name, us);
+    } else if (result == PCI_PROBE_DEFER) {
+        binding->state = PCI_BIND_DEFERRED;
+        binding->defer_mark = pci_probe_successes;
+    } else {
+        binding->state = PCI_BIND_FAILED;
+        binding->data = NULL;
+        printf("PCI: %s probe of %02x:%02x.%x failed (%d)\n",
+               binding->driver->name, dev->bus, dev->device, dev->func, result);
+    }
+}
+
+// Match every unbound function; probe synchronous drivers now
+size_t pci_drivers_bind(void) {
+    size_t count = pci_device_count();
+    size_t matched = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        pci_binding_t* binding = &pci_bindings[i];
+        if (binding->state != PCI_BIND_NONE) {
+            continue;
+        }
+
+        binding->driver = pci_driver_match(pci_get_device(i), &binding->id);
+        if (!binding->driver) {
+            continue;
+        }
+        matched++;
+
+        if (binding->driver->flags & PCI_DRIVER_ASYNC) {
+            binding->state = PCI_BIND_QUEUED;
+        } else {
+            pci_run_probe(i);
+        }
+    }
+    return matched;
+}
+
+// Run the first queued probe, else the first deferred one that may now succeed
+int pci_probe_poll(void) {
+    size_t count = pci_device_count();
+
+    for (size_t i = 0; i < count; i++) {
+        if (pci_bindings[i].state == PCI_BIND_QUEUED) {
+            pci_run_probe(i);
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (pci_bindings[i].state == PCI_BIND_DEFERRED &&
+            pci_bindings[i].defer_mark != pci_probe_successes) {
+            pci_run_probe(i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Probe everything that can be probed now
+void pci_probe_wait(void) {
+    while (pci_probe_poll()) {
+    }
+}
+
+// Look up the binding of a function from the device table
+static pci_binding_t* pci_binding(const pci_device_t* dev) {
+    size_t index = pci_device_index(dev);
+    return index < PCI_MAX_DEVICES ? &pci_bindings[index] : NULL;
+}
+
+// Driver bound to a function
+const pci_driver_t* pci_device_driver(const pci_device_t* dev) {
+    pci_binding_t* binding = pci_binding(dev);
+    return binding && binding->state == PCI_BIND_BOUND ? binding->driver : NULL;
+}
+
+// Release a function from its driver
+void pci_device_unbind(const pci_device_t* dev) {
+    pci_binding_t* binding = pci_binding(dev);
+    if (!binding) {
+        return;
+    }
+
+    if (binding->state == PCI_BIND_BOUND && binding->driver->remove) {
+        binding->driver->remove(dev);
+    }
+    binding->driver = NULL;
+    binding->id = NULL;
+    binding->data = NULL;
+    binding->state = PCI_BIND_NONE;
+}
+
+void pci_set_driver_data(const pci_device_t* dev, void* data) {
+    pci_binding_t* binding = pci_binding(dev);
+    if (binding) {
+        binding->data = data;
+    }
+}
+
+void* pci_get_driver_data(const pci_device_t* dev) {
+    pci_binding_t* binding = pci_binding(dev);
+    return binding ? binding->data : NULL;
+}
+
+static int pci_drivers_initcall(void) {
+    size_t matched = pci_drivers_bind();
+    printf("PCI: %u drivers registered, %u functions matched\n",
+           (size_t)(__pci_driver_end - __pci_driver_start), matched);
+    return 0;
+}
+INITCALL(pci_drivers, pci_drivers_initcall, "pci,idt");
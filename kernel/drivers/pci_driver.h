@@ -0,0 +1,133 @@
+#ifndef KERNEL_PCI_DRIVER_H
+#define KERNEL_PCI_DRIVER_H
+
+#include "../stdlib/stdint.h"
+#include "../stdlib/stddef.h"
+#include "pci.h"
+
+/*
+ * PCI driver model
+ *
+ * A driver lists the functions it handles in an ID table and registers
+ * itself with PCI_DRIVER(); the linker gathers the drivers into one
+ * section (see linker.ld).
+ *
+ *   static const pci_device_id_t piix_ide_ids[] = {
+ *       { PCI_DEVICE(0x8086, 0x7010) },
+ *       { PCI_DEVICE_CLASS(0x01, 0x01) },
+ *       { 0 }
+ *   };
+ *   PCI_DRIVER(piix_ide) = { "piix-ide", piix_ide_ids, piix_ide_probe, piix_ide_remove, 0 };
+ *
+ * After the scan, pci_drivers_bind() indexes every table once and binds
+ * each function to the first driver that matches it, vendor/device
+ * entries before class entries. Probes of PCI_DRIVER_ASYNC drivers, and
+ * probes that return PCI_PROBE_DEFER, do not run during boot: the idle
+ * loop runs them one at a time through pci_probe_poll(). A deferred
+ * probe is retried after another probe succeeds, so a driver can wait
+ * for one it depends on.
+ */
+
+// Wildcard for pci_device_id_t vendor and device IDs
+#define PCI_ANY_ID                  0xFFFF
+
+// Returned by a probe to be retried once another driver has probed
+#define PCI_PROBE_DEFER             1
+
+// Driver flags
+#define PCI_DRIVER_ASYNC            0x01    // Probe from the idle loop, not during boot
+
+// Upper bound on ID table entries over all drivers
+#define PCI_MATCH_MAX               128
+
+// One ID table entry; a function matches if every field does
+typedef struct {
+    uint16_t vendor_id;     // PCI_ANY_ID for any
+    uint16_t device_id;     // PCI_ANY_ID for any
+    uint32_t class_code;    // class << 16 | subclass << 8 | prog_if
+    uint32_t class_mask;    // Bits of class_code that must match (0 for any class)
+} pci_device_id_t;
+
+// Entry initializers
+#define PCI_DEVICE(vendor, device)  (vendor), (device), 0, 0
+#define PCI_DEVICE_CLASS(class_code, subclass) \
+    PCI_ANY_ID, PCI_ANY_ID, ((uint32_t)(class_code) << 16 | (uint32_t)(subclass) << 8), 0xFFFF00
+
+typedef struct {
+    const char* name;
+    const pci_device_id_t* ids;     // Terminated by an entry with vendor_id 0
+
+    /**
+     * Bring up a matched function.
+     * @return 0 when bound, PCI_PROBE_DEFER to be retried later, or a negative error.
+     */
+    int (*probe)(const pci_device_t* dev, const pci_device_id_t* id);
+
+    // Release the function (may be NULL)
+    void (*remove)(const pci_device_t* dev);
+
+    uint32_t flags;                 // PCI_DRIVER_*
+} pci_driver_t;
+
+// Register a driver: PCI_DRIVER(name) = { ... };
+#define PCI_DRIVER(name)                                                 \
+    static const pci_driver_t pci_driver_##name                          \
+        __attribute__((used, section(".pci_driver"), aligned(4)))
+
+/**
+ * @brief Matches every function in the device table against the registered drivers.
+ *
+ * Builds the match index on first use, runs the probes of synchronous
+ * drivers and queues the rest for pci_probe_poll(). Functions that are
+ * already bound are left alone, so calling this again only picks up new ones.
+ * @return Number of functions bound or queued for a probe.
+ */
+size_t pci_drivers_bind(void);
+
+/**
+ * @brief Runs one queued or deferred probe.
+ * @return 1 if a probe ran, 0 if there was nothing to do.
+ */
+int pci_probe_poll(void);
+
+/**
+ * @brief Runs queued probes until none is left or only deferred ones that cannot make progress.
+ */
+void pci_probe_wait(void);
+
+/**
+ * @brief Finds the registered driver that would bind a function.
+ * @param dev Function from the device table
+ * @param id Receives the matching ID table entry (may be NULL)
+ * @return The driver, or NULL if none matches.
+ */
+const pci_driver_t* pci_driver_match(const pci_device_t* dev, const pci_device_id_t** id);
+
+/**
+ * @brief Gets the driver bound to a function.
+ * @param dev Function from the device table
+ * @return The driver, or NULL if the function is unbound or its probe has not succeeded yet.
+ */
+const pci_driver_t* pci_device_driver(const pci_device_t* dev);
+
+/**
+ * @brief Calls the driver's remove callback and unbinds the function.
+ * @param dev Function from the device table
+ */
+void pci_device_unbind(const pci_device_t* dev);
+
+/**
+ * @brief Attaches driver state to a bound function.
+ * @param dev Function from the device table
+ * @param data Driver state, returned by pci_get_driver_data()
+ */
+void pci_set_driver_data(const pci_device_t* dev, void* data);
+
+/**
+ * @brief Gets the driver state attached to a function.
+ * @param dev Function from the device table
+ * @return The state set by the driver, or NULL.
+ */
+void* pci_get_driver_data(const pci_device_t* dev);
+
+#endif // KERNEL_PCI_DRIVER_H
@@ -0,0 +1,364 @@
+#include "pci_msi.h"
+#include "../arch/x86/lapic.h"
+#include "../arch/x86/pic.h"
+#include "../arch/x86/paging.h"
+#include "../stdlib/stdio.h" // For printf
+
+// First vector of the PIC's IRQs (see idt_init())
+#define PCI_IRQ_PIC_VECTOR_BASE 32
+
+// Vectors of one function, at the function's index in the device table
+typedef struct {
+    uint8_t type;                   // PCI_IRQ_* in use, 0 for none
+    uint8_t count;
+    uint8_t cap;                    // MSI or MSI-X capability offset
+    uint8_t vectors[PCI_IRQ_MAX_VECTORS];
+    volatile uint32_t* msix_table;  // Mapped MSI-X table
+} pci_irq_state_t;
+
+static pci_irq_state_t pci_irqs[PCI_MAX_DEVICES];
+
+// Helpers for the function's capability registers
+static uint16_t cap_read_word(const pci_device_t* dev, uint8_t offset) {
+    return pci_read_config_word(dev->bus, dev->device, dev->func, offset);
+}
+
+static void cap_write_word(const pci_device_t* dev, uint8_t offset, uint16_t value) {
+    pci_write_config_word(dev->bus, dev->device, dev->func, offset, value);
+}
+
+static void cap_write_dword(const pci_device_t* dev, uint8_t offset, uint32_t value) {
+    pci_write_config_dword(dev->bus, dev->device, dev->func, offset, value);
+}
+
+// Interrupt state of a function, or NULL if it is not in the device table
+static pci_irq_state_t* pci_irq_state(const pci_device_t* dev) {
+    size_t index = pci_device_index(dev);
+    return index < PCI_MAX_DEVICES ? &pci_irqs[index] : NULL;
+}
+
+// Message address targeting a CPU's local APIC
+static int pci_msi_address(uint32_t cpu, uint32_t* address) {
+    int apic_id = lapic_cpu_apic_id(cpu);
+    if (apic_id < 0) {
+        return -1;
+    }
+    *address = PCI_MSI_ADDRESS_BASE | (uint32_t)apic_id << PCI_MSI_ADDRESS_DEST_SHIFT;
+    return 0;
+}
+
+// Stop the function from asserting INTx# while messages are in use, and let it write them
+static void pci_irq_messages_on(const pci_device_t* dev, int on) {
+    uint16_t command = cap_read_word(dev, PCI_COMMAND_OFFSET);
+    if (on) {
+        command |= PCI_COMMAND_INTX_DISABLE | PCI_COMMAND_BUS_MASTER;
+    } else {
+        command &= ~PCI_COMMAND_INTX_DISABLE;
+    }
+    cap_write_word(dev, PCI_COMMAND_OFFSET, command);
+}
+
+// Map the MSI-X table from the BAR named in the capability
+static volatile uint32_t* pci_msix_map_table(const pci_device_t* dev, uint8_t cap, uint32_t entries) {
+    uint32_t table = pci_read_config_dword(dev->bus, dev->device, dev->func, cap + PCI_MSIX_TABLE);
+    uint8_t bir = table & 0x7;
+    if (bir >= dev->bar_count) {
+        return NULL;
+    }
+
+    const pci_bar_t* bar = &dev->bars[bir];
+    uint64_t start = bar->base + (table & ~0x7u);
+    uint32_t size = entries * PCI_MSIX_ENTRY_SIZE;
+    if (bar->io || bar->size < (table & ~0x7u) + size || start + size > 0x100000000ull ||
+        paging_map_region((uint32_t)start, size, PDE_CACHE_DISABLE) != 0) {
+        return NULL;
+    }
+    return (volatile uint32_t*)(uint32_t)start;
+}
+
+// Enable MSI-X with one vector per entry
+static int pci_msix_enable(const pci_device_t* dev, pci_irq_state_t* state,
+                           uint32_t min, uint32_t max, uint32_t address) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSIX, 0);
+    if (!cap) {
+        return -1;
+    }
+
+    uint16_t control = cap_read_word(dev, cap + PCI_MSIX_CONTROL);
+    uint32_t entries = (control & PCI_MSIX_CONTROL_SIZE_MASK) + 1;
+    uint32_t count = max < entries ? max : entries;
+    if (count < min) {
+        return -1;
+    }
+
+    volatile uint32_t* table = pci_msix_map_table(dev, cap, entries);
+    if (!table) {
+        printf("PCI: %02x:%02x.%x MSI-X table not reachable\n", dev->bus, dev->device, dev->func);
+        return -1;
+    }
+
+    // Entries need not be consecutive vectors, so take them one at a time
+    uint32_t allocated = 0;
+    while (allocated < count) {
+        int vector = idt_alloc_vectors(1);
+        if (vector < 0) {
+            break;
+        }
+        state->vectors[allocated++] = (uint8_t)vector;
+    }
+    if (allocated < min) {
+        for (uint32_t i = 0; i < allocated; i++) {
+            idt_free_vectors(state->vectors[i], 1);
+        }
+        return -1;
+    }
+
+    // Program the table with the whole function masked, then let it go
+    cap_write_word(dev, cap + PCI_MSIX_CONTROL, control | PCI_MSIX_CONTROL_ENABLE | PCI_MSIX_CONTROL_MASK_ALL);
+    for (uint32_t i = 0; i < entries; i++) {
+        volatile uint32_t* entry = table + i * PCI_MSIX_ENTRY_SIZE / 4;
+        if (i < allocated) {
+            entry[PCI_MSIX_ENTRY_ADDRESS_LO / 4] = address;
+            entry[PCI_MSIX_ENTRY_ADDRESS_HI / 4] = 0;
+            entry[PCI_MSIX_ENTRY_DATA / 4] = state->vectors[i];
+            entry[PCI_MSIX_ENTRY_CONTROL / 4] = 0;
+        } else {
+            entry[PCI_MSIX_ENTRY_CONTROL / 4] = PCI_MSIX_ENTRY_MASKED;
+        }
+    }
+    pci_irq_messages_on(dev, 1);
+    cap_write_word(dev, cap + PCI_MSIX_CONTROL,
+                   (control | PCI_MSIX_CONTROL_ENABLE) & ~PCI_MSIX_CONTROL_MASK_ALL);
+
+    state->type = PCI_IRQ_MSIX;
+    state->cap = cap;
+    state->count = (uint8_t)allocated;
+    state->msix_table = table;
+    return (int)allocated;
+}
+
+// Data register offset of an MSI capability
+static uint8_t pci_msi_data_offset(uint16_t control) {
+    return control & PCI_MSI_CONTROL_64BIT ? PCI_MSI_DATA_64 : PCI_MSI_DATA_32;
+}
+
+// Enable MSI with a power-of-two block of vectors
+static int pci_msi_enable(const pci_device_t* dev, pci_irq_state_t* state,
+                          uint32_t min, uint32_t max, uint32_t address) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSI, 0);
+    if (!cap) {
+        return -1;
+    }
+
+    uint16_t control = cap_read_word(dev, cap + PCI_MSI_CONTROL);
+    uint32_t supported = 1u << ((control >> PCI_MSI_CONTROL_MMC_SHIFT) & 0x7);
+    if (supported > PCI_IRQ_MAX_VECTORS) {
+        supported = PCI_IRQ_MAX_VECTORS;
+    }
+
+    // Largest power of two within what both sides allow
+    uint32_t count = 1;
+    while (count * 2 <= supported && count * 2 <= max) {
+        count *= 2;
+    }
+    if (count < min) {
+        return -1;
+    }
+
+    int first = idt_alloc_vectors(count);
+    while (first < 0 && count / 2 >= min && count > 1) {
+        count /= 2;
+        first = idt_alloc_vectors(count);
+    }
+    if (first < 0) {
+        return -1;
+    }
+
+    cap_write_dword(dev, cap + PCI_MSI_ADDRESS_LO, address);
+    if (control & PCI_MSI_CONTROL_64BIT) {
+        cap_write_dword(dev, cap + PCI_MSI_ADDRESS_HI, 0);
+    }
+    // The function puts the message number in the low bits of the data
+    cap_write_word(dev, cap + pci_msi_data_offset(control), (uint16_t)first);
+
+    uint32_t log2_count = 0;
+    while ((1u << log2_count) < count) {
+        log2_count++;
+    }
+    control &= ~(0x7 << PCI_MSI_CONTROL_MME_SHIFT);
+    control |= log2_count << PCI_MSI_CONTROL_MME_SHIFT | PCI_MSI_CONTROL_ENABLE;
+    pci_irq_messages_on(dev, 1);
+    cap_write_word(dev, cap + PCI_MSI_CONTROL, control);
+
+    for (uint32_t i = 0; i < count; i++) {
+        state->vectors[i] = (uint8_t)(first + i);
+    }
+    state->type = PCI_IRQ_MSI;
+    state->cap = cap;
+    state->count = (uint8_t)count;
+    return (int)count;
+}
+
+// Use the function's INTx# line as routed by the firmware
+static int pci_legacy_enable(const pci_device_t* dev, pci_irq_state_t* state) {
+    if (!dev->irq_pin || dev->irq_line >= 16) {
+        return -1;
+    }
+
+    state->vectors[0] = PCI_IRQ_PIC_VECTOR_BASE + dev->irq_line;
+    state->type = PCI_IRQ_LEGACY;
+    state->count = 1;
+    if (dev->irq_line >= 8) {
+        pic_enable_irq(2);  // Cascade from the slave PIC
+    }
+    pic_enable_irq(dev->irq_line);
+    return 1;
+}
+
+// Allocate vectors with the best available mechanism
+int pci_irq_alloc(const pci_device_t* dev, uint32_t min, uint32_t max, uint32_t types) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    if (!state || state->type || min == 0 || min > max) {
+        return -1;
+    }
+    if (max > PCI_IRQ_MAX_VECTORS) {
+        max = PCI_IRQ_MAX_VECTORS;
+    }
+
+    int count = -1;
+    uint32_t address;
+    if (pci_msi_address(0, &address) == 0) {
+        if (types & PCI_IRQ_MSIX) {
+            count = pci_msix_enable(dev, state, min, max, address);
+        }
+        if (count < 0 && (types & PCI_IRQ_MSI)) {
+            count = pci_msi_enable(dev, state, min, max, address);
+        }
+    }
+    if (count < 0 && (types & PCI_IRQ_LEGACY) && min == 1) {
+        count = pci_legacy_enable(dev, state);
+    }
+    if (count < 0) {
+        return -1;
+    }
+
+    printf("PCI: %02x:%02x.%x %s, %d vector%s from %u\n", dev->bus, dev->device, dev->func,
+           state->type == PCI_IRQ_MSIX ? "MSI-X" : state->type == PCI_IRQ_MSI ? "MSI" : "INTx",
+           count, count == 1 ? "" : "s", state->vectors[0]);
+    return count;
+}
+
+// Release the vectors and go back to INTx
+void pci_irq_free(const pci_device_t* dev) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    if (!state || !state->type) {
+        return;
+    }
+
+    if (state->type == PCI_IRQ_MSIX) {
+        uint16_t control = cap_read_word(dev, state->cap + PCI_MSIX_CONTROL);
+        cap_write_word(dev, state->cap + PCI_MSIX_CONTROL,
+                       (control | PCI_MSIX_CONTROL_MASK_ALL) & ~PCI_MSIX_CONTROL_ENABLE);
+        for (uint32_t i = 0; i < state->count; i++) {
+            idt_free_vectors(state->vectors[i], 1);
+        }
+        pci_irq_messages_on(dev, 0);
+    } else if (state->type == PCI_IRQ_MSI) {
+        uint16_t control = cap_read_word(dev, state->cap + PCI_MSI_CONTROL);
+        cap_write_word(dev, state->cap + PCI_MSI_CONTROL, control & ~PCI_MSI_CONTROL_ENABLE);
+        idt_free_vectors(state->vectors[0], state->count);
+        pci_irq_messages_on(dev, 0);
+    } else {
+        // The line may be shared, so it stays unmasked; only the handler goes
+        register_interrupt_handler(state->vectors[0], 0);
+    }
+
+    state->type = 0;
+    state->count = 0;
+    state->cap = 0;
+    state->msix_table = NULL;
+}
+
+uint32_t pci_irq_type(const pci_device_t* dev) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    return state ? state->type : 0;
+}
+
+int pci_irq_vector(const pci_device_t* dev, uint32_t index) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    if (!state || index >= state->count) {
+        return -1;
+    }
+    return state->vectors[index];
+}
+
+int pci_irq_set_handler(const pci_device_t* dev, uint32_t index, isr_handler_t handler) {
+    int vector = pci_irq_vector(dev, index);
+    if (vector < 0) {
+        return -1;
+    }
+    register_interrupt_handler((uint8_t)vector, handler);
+    return 0;
+}
+
+// Point an interrupt's message at another CPU
+int pci_irq_set_affinity(const pci_device_t* dev, uint32_t index, uint32_t cpu) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    uint32_t address;
+    if (!state || index >= state->count) {
+        return -1;
+    }
+    if (state->type == PCI_IRQ_LEGACY) {
+        return cpu == 0 ? 0 : -1;
+    }
+    if (pci_msi_address(cpu, &address) != 0) {
+        return -1;
+    }
+
+    if (state->type == PCI_IRQ_MSIX) {
+        // Mask the entry so the device never sends half an update
+        volatile uint32_t* entry = state->msix_table + index * PCI_MSIX_ENTRY_SIZE / 4;
+        uint32_t control = entry[PCI_MSIX_ENTRY_CONTROL / 4];
+        entry[PCI_MSIX_ENTRY_CONTROL / 4] = control | PCI_MSIX_ENTRY_MASKED;
+        entry[PCI_MSIX_ENTRY_ADDRESS_LO / 4] = address;
+        entry[PCI_MSIX_ENTRY_CONTROL / 4] = control;
+    } else {
+        cap_write_dword(dev, state->cap + PCI_MSI_ADDRESS_LO, address);
+    }
+    return 0;
+}
+
+// Mask or unmask an interrupt at the function (or the PIC for INTx)
+int pci_irq_mask(const pci_device_t* dev, uint32_t index, int masked) {
+    pci_irq_state_t* state = pci_irq_state(dev);
+    if (!state || index >= state->count) {
+        return -1;
+    }
+
+    if (state->type == PCI_IRQ_MSIX) {
+        volatile uint32_t* entry = state->msix_table + index * PCI_MSIX_ENTRY_SIZE / 4;
+        uint32_t control = entry[PCI_MSIX_ENTRY_CONTROL / 4];
+        entry[PCI_MSIX_ENTRY_CONTROL / 4] = masked ? control | PCI_MSIX_ENTRY_MASKED
+                                                   : control & ~PCI_MSIX_ENTRY_MASKED;
+        return 0;
+    }
+
+    if (state->type == PCI_IRQ_MSI) {
+        uint16_t control = cap_read_word(dev, state->cap + PCI_MSI_CONTROL);
+        if (!(control & PCI_MSI_CONTROL_MASKABLE)) {
+            return -1;
+        }
+        uint8_t offset = state->cap + (control & PCI_MSI_CONTROL_64BIT ? PCI_MSI_MASK_64 : PCI_MSI_MASK_32);
+        uint32_t bits = pci_read_config_dword(dev->bus, dev->device, dev->func, offset);
+        bits = masked ? bits | (1u << index) : bits & ~(1u << index);
+        cap_write_dword(dev, offset, bits);
+        return 0;
+    }
+
+    if (masked) {
+        pic_disable_irq(dev->irq_line);
+    } else {
+        pic_enable_irq(dev->irq_line);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#ifndef KERNEL_PCI_MSI_H
+#define KERNEL_PCI_MSI_H
+
+#include "../stdlib/stdint.h"
+#include "../stdlib/stddef.h"
+#include "../arch/x86/idt.h"
+#include "pci.h"
+
+/*
+ * PCI interrupt vectors: MSI-X, MSI or legacy INTx
+ *
+ * A driver asks for between min and max vectors, typically one per
+ * queue, and gets the best mechanism the function and the CPU support:
+ *
+ *   int count = pci_irq_alloc(dev, 1, queues, PCI_IRQ_ALL_TYPES);
+ *   for (int q = 0; q < count; q++) {
+ *       pci_irq_set_handler(dev, q, queue_interrupt);
+ *   }
+ *
+ * Message signalled vectors come from the dynamic IDT range (48 and
+ * up), are delivered through the local APIC and never share a line.
+ * MSI-X programs an address/data pair per vector, so each vector can
+ * target its own CPU; MSI has one pair per function and needs a
+ * power-of-two block of vectors.
+ */
+
+// Interrupt mechanisms, as a mask of the ones a driver accepts
+#define PCI_IRQ_LEGACY              0x01    // INTx# through the 8259 PIC
+#define PCI_IRQ_MSI                 0x02
+#define PCI_IRQ_MSIX                0x04
+#define PCI_IRQ_ALL_TYPES           (PCI_IRQ_LEGACY | PCI_IRQ_MSI | PCI_IRQ_MSIX)
+
+// Vectors per function
+#define PCI_IRQ_MAX_VECTORS         32
+
+// MSI capability registers (offsets from the capability)
+#define PCI_MSI_CONTROL             0x02
+#define PCI_MSI_ADDRESS_LO          0x04
+#define PCI_MSI_ADDRESS_HI          0x08    // 64-bit capable functions only
+#define PCI_MSI_DATA_32             0x08
+#define PCI_MSI_DATA_64             0x0C
+#define PCI_MSI_MASK_32             0x0C    // Per-vector masking capable functions only
+#define PCI_MSI_MASK_64             0x10
+
+// MSI control bits
+#define PCI_MSI_CONTROL_ENABLE      0x0001
+#define PCI_MSI_CONTROL_MMC_SHIFT   1       // log2 of vectors supported
+#define PCI_MSI_CONTROL_MME_SHIFT   4       // log2 of vectors enabled
+#define PCI_MSI_CONTROL_64BIT       0x0080
+#define PCI_MSI_CONTROL_MASKABLE    0x0100
+
+// MSI-X capability registers
+#define PCI_MSIX_CONTROL            0x02
+#define PCI_MSIX_TABLE              0x04    // Offset in a BAR, BAR index in the low 3 bits
+
+// MSI-X control bits
+#define PCI_MSIX_CONTROL_SIZE_MASK  0x07FF  // Table entries - 1
+#define PCI_MSIX_CONTROL_MASK_ALL   0x4000
+#define PCI_MSIX_CONTROL_ENABLE     0x8000
+
+// MSI-X table entry layout
+#define PCI_MSIX_ENTRY_SIZE         16
+#define PCI_MSIX_ENTRY_ADDRESS_LO   0x0
+#define PCI_MSIX_ENTRY_ADDRESS_HI   0x4
+#define PCI_MSIX_ENTRY_DATA         0x8
+#define PCI_MSIX_ENTRY_CONTROL      0xC
+#define PCI_MSIX_ENTRY_MASKED       0x1
+
+// Message address: the local APIC window, destination APIC ID in bits 12-19
+#define PCI_MSI_ADDRESS_BASE        0xFEE00000
+#define PCI_MSI_ADDRESS_DEST_SHIFT  12
+
+/**
+ * @brief Allocates interrupt vectors for a function and enables them.
+ *
+ * Tries MSI-X, then MSI, then INTx (which only gives one vector), skipping
+ * the mechanisms not in types. Message signalled interrupts need the local
+ * APIC. Vectors start out targeted at CPU 0 and unmasked, with no handler.
+ * @param dev Function from the device table
+ * @param min Fewest vectors the driver can work with
+ * @param max Vectors the driver would like (at most PCI_IRQ_MAX_VECTORS)
+ * @param types PCI_IRQ_* mechanisms the driver accepts
+ * @return Number of vectors allocated, or -1 if none of the mechanisms can give min.
+ */
+int pci_irq_alloc(const pci_device_t* dev, uint32_t min, uint32_t max, uint32_t types);
+
+/**
+ * @brief Releases a function's vectors and switches it back to INTx.
+ * @param dev Function from the device table
+ */
+void pci_irq_free(const pci_device_t* dev);
+
+/**
+ * @brief Gets the mechanism in use.
+ * @param dev Function from the device table
+ * @return PCI_IRQ_MSIX, PCI_IRQ_MSI, PCI_IRQ_LEGACY, or 0 if nothing is allocated.
+ */
+uint32_t pci_irq_type(const pci_device_t* dev);
+
+/**
+ * @brief Gets the IDT vector of one of a function's interrupts.
+ * @param dev Function from the device table
+ * @param index Interrupt index below the count pci_irq_alloc() returned
+ * @return The vector, or -1 if index is out of range.
+ */
+int pci_irq_vector(const pci_device_t* dev, uint32_t index);
+
+/**
+ * @brief Installs the handler for one of a function's interrupts.
+ *
+ * The handler's regs->int_no is the vector, which tells queues sharing
+ * a handler apart. Legacy INTx lines may be shared with other functions.
+ * @param dev Function from the device table
+ * @param index Interrupt index
+ * @param handler Handler to call, or NULL to remove it
+ * @return 0 on success, -1 if index is out of range.
+ */
+int pci_irq_set_handler(const pci_device_t* dev, uint32_t index, isr_handler_t handler);
+
+/**
+ * @brief Routes one of a function's interrupts to a CPU.
+ *
+ * With MSI every vector of the function moves together; INTx always goes
+ * to the CPU the PIC is wired to (CPU 0).
+ * @param dev Function from the device table
+ * @param index Interrupt index
+ * @param cpu CPU number
+ * @return 0 on success, -1 if index or cpu is out of range or the mechanism cannot route it.
+ */
+int pci_irq_set_affinity(const pci_device_t* dev, uint32_t index, uint32_t cpu);
+
+/**
+ * @brief Masks or unmasks one of a function's interrupts at the source.
+ *
+ * MSI-X masks per vector; MSI only if the function supports per-vector
+ * masking; INTx masks the whole PIC line.
+ * @param dev Function from the device table
+ * @param index Interrupt index
+ * @param masked 1 to mask, 0 to unmask
+ * @return 0 on success, -1 if the interrupt cannot be masked.
+ */
+int pci_irq_mask(const pci_device_t* dev, uint32_t index, int masked);
+
+#endif // KERNEL_PCI_MSI_H
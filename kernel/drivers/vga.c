@@ -4,20 +4,31 @@
 #include <string.h>
 #include <stdio.h>
 #include "../arch/x86/io.h"
+#include "../arch/x86/cpu.h"
+#include "fbcon.h"
 
 /* Hardware text mode constants */
 #define VGA_MEMORY 0xB8000
 #define VGA_CTRL_REGISTER 0x3D4
 #define VGA_DATA_REGISTER 0x3D5
+#define VGA_START_HIGH 12
+#define VGA_START_LOW 13
 #define VGA_CURSOR_HIGH 14
 #define VGA_CURSOR_LOW 15
 
+/* Text memory spans 32 KiB (0xB8000-0xBFFFF); the CRTC start address
+ * can point the visible screen at any row inside that window */
+#define VGA_WINDOW_ROWS ((32 * 1024) / (VGA_WIDTH * sizeof(uint16_t)))
+
 /* ANSI escape sequence states */
 #define ANSI_STATE_NORMAL     0
 #define ANSI_STATE_ESC        1
 #define ANSI_STATE_BRACKET    2
 #define ANSI_STATE_PARAMS     3
 
+/* Bitmask with one bit per screen row */
+#define VGA_ALL_ROWS ((1u << VGA_HEIGHT) - 1)
+
 /* Terminal state */
 static uint16_t* const VGA_BUFFER = (uint16_t*) VGA_MEMORY;
 static size_t terminal_row;
@@ -26,6 +37,25 @@ static uint8_t terminal_color;
 static uint8_t terminal_default_color;
 static int cursor_enabled = 1;
 
+/* RAM shadow of the screen and its scrollback history
+ * All drawing happens here; terminal_flush() copies changed rows to video
+ * memory. The rows form a ring of VGA_HISTORY_LINES lines whose last
+ * VGA_HEIGHT lines are the screen, so scrolling only has to move
+ * shadow_top: screen row y lives in ring row (shadow_top + y) % VGA_HISTORY_LINES.
+ */
+static uint16_t shadow_buffer[VGA_HISTORY_LINES][VGA_WIDTH];
+static size_t shadow_top = 0;
+static size_t history_lines = VGA_HEIGHT;   /* Valid ring rows, screen included */
+static size_t view_offset = 0;              /* Lines scrolled back; 0 shows the live screen */
+static uint32_t dirty_rows = 0;             /* Bit y set: screen row y needs flushing */
+static size_t cursor_hw_pos = (size_t)-1;   /* Position last sent to the CRTC */
+
+/* Hardware scrolling: screen row 0 is shown from this row of the text window
+ * (or of the framebuffer, which has room for window_rows cell rows) */
+static size_t window_rows = VGA_WINDOW_ROWS;
+static size_t vga_origin_row = 0;
+static size_t vga_origin_hw = (size_t)-1;   /* Start address last sent to the CRTC */
+
 /* ANSI escape sequence parsing */
 static int ansi_state = ANSI_STATE_NORMAL;
 static char ansi_params[16];
@@ -55,11 +85,79 @@ static const enum vga_color ansi_to_vga_bright_color[8] = {
     VGA_COLOR_WHITE         /* ANSI: Bright White */
 };
 
-/* Update hardware cursor position */
+/* Get the ring row shown on screen row y, lines_back lines into the history */
+static inline uint16_t* history_row(size_t y, size_t lines_back) {
+    size_t index = (shadow_top + VGA_HISTORY_LINES + y - lines_back) & (VGA_HISTORY_LINES - 1);
+    return shadow_buffer[index];
+}
+
+/* Get the shadow row backing screen row y */
+static inline uint16_t* shadow_row(size_t y) {
+    return history_row(y, 0);
+}
+
+/* Fill screen row y of the shadow buffer with blanks */
+static void shadow_clear_row(size_t y, uint8_t color) {
+    uint16_t* row = shadow_row(y);
+    uint16_t blank = vga_entry(' ', color);
+    for (size_t x = 0; x < VGA_WIDTH; x++) {
+        row[x] = blank;
+    }
+    dirty_rows |= 1u << y;
+}
+
+/* Copy one row to video memory using 32-bit string stores */
+static void copy_row_to_vga(uint16_t* dest, const uint16_t* src) {
+    size_t dwords = VGA_WIDTH * sizeof(uint16_t) / 4;
+    asm volatile ("rep movsl"
+                  : "+D"(dest), "+S"(src), "+c"(dwords)
+                  :
+                  : "memory");
+}
+
+/* Draw one shadow row at row window_row of the display window */
+static void display_row(size_t window_row, const uint16_t* src) {
+    if (fbcon_active()) {
+        fbcon_draw_row(window_row, src, VGA_WIDTH);
+    } else {
+        copy_row_to_vga(VGA_BUFFER + window_row * VGA_WIDTH, src);
+    }
+}
+
+/* Point the CRTC start address at the current origin row */
+static void update_origin(void) {
+    size_t pos = vga_origin_row * VGA_WIDTH;
+    if (pos == vga_origin_hw) return;
+    vga_origin_hw = pos;
+    
+    if (fbcon_active()) {
+        fbcon_set_origin(vga_origin_row);
+        return;
+    }
+    
+    outb(VGA_CTRL_REGISTER, VGA_START_HIGH);
+    outb(VGA_DATA_REGISTER, (pos >> 8) & 0xFF);
+    outb(VGA_CTRL_REGISTER, VGA_START_LOW);
+    outb(VGA_DATA_REGISTER, pos & 0xFF);
+}
+
+/* Update hardware cursor position
+ * Skips the four CRTC writes if the cursor hasn't moved.
+ * While the view is scrolled back the cursor is parked
+ * just below the visible window. */
 static void update_cursor(void) {
     if (!cursor_enabled) return;
     
-    size_t pos = terminal_row * VGA_WIDTH + terminal_column;
+    size_t pos = (vga_origin_row + terminal_row) * VGA_WIDTH + terminal_column;
+    if (view_offset != 0) {
+        pos = (vga_origin_row + VGA_HEIGHT) * VGA_WIDTH;
+    }
+    if (fbcon_active()) {
+        fbcon_set_cursor(view_offset != 0 ? FBCON_CURSOR_HIDDEN : pos);
+        return;
+    }
+    if (pos == cursor_hw_pos) return;
+    cursor_hw_pos = pos;
     
     outb(VGA_CTRL_REGISTER, VGA_CURSOR_HIGH);
     outb(VGA_DATA_REGISTER, (pos >> 8) & 0xFF);
@@ -70,7 +168,10 @@ static void update_cursor(void) {
 /* Enable or disable the hardware cursor */
 void terminal_cursor_enable(int enable) {
     cursor_enabled = enable;
-    if (!enable) {
+    cursor_hw_pos = (size_t)-1;
+    if (!enable && fbcon_active()) {
+        fbcon_set_cursor(FBCON_CURSOR_HIDDEN);
+    } else if (!enable) {
         outb(VGA_CTRL_REGISTER, 0x0A);
         outb(VGA_DATA_REGISTER, 0x20);
     }
@@ -92,9 +193,11 @@ vga_status_t terminal_setpos(size_t x, size_t y) {
         return VGA_ERROR_INVALID_POSITION;
     }
     
+    uint32_t flags = irq_save();
     terminal_column = x;
     terminal_row = y;
-    update_cursor();
+    terminal_flush();
+    irq_restore(flags);
     
     return VGA_SUCCESS;
 }
@@ -119,37 +222,135 @@ uint8_t terminal_getcolor(void) {
     return terminal_color;
 }
 
-/* Clear the terminal screen */
-void terminal_clear(void) {
+/* Copy dirty rows from the shadow buffer to video memory
+ * Output while scrolled back returns the view to the live screen */
+void terminal_flush(void) {
+    uint32_t flags = irq_save();
+    
+    if (view_offset != 0) {
+        view_offset = 0;
+        dirty_rows = VGA_ALL_ROWS;
+    }
+    
+    uint32_t dirty = dirty_rows;
+    dirty_rows = 0;
+    
+    /* The framebuffer cursor is drawn into the pixels; take it off first */
+    if (dirty && fbcon_active()) {
+        fbcon_set_cursor(FBCON_CURSOR_HIDDEN);
+    }
+    
+    while (dirty) {
+        size_t y = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        display_row(vga_origin_row + y, shadow_row(y));
+    }
+    
+    update_origin();
+    update_cursor();
+    irq_restore(flags);
+}
+
+/* Show the screen lines_back lines into the history */
+static void render_scrollback(void) {
+    if (fbcon_active()) {
+        fbcon_set_cursor(FBCON_CURSOR_HIDDEN);
+    }
     for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            VGA_BUFFER[index] = vga_entry(' ', terminal_color);
+        display_row(vga_origin_row + y, history_row(y, view_offset));
+    }
+    
+    /* Video memory no longer matches the live screen */
+    dirty_rows = VGA_ALL_ROWS;
+    update_cursor();
+}
+
+/* Move the view through the scrollback history */
+void terminal_scrollback(int lines) {
+    uint32_t flags = irq_save();
+    
+    size_t max_offset = history_lines - VGA_HEIGHT;
+    int offset = (int)view_offset + lines;
+    if (offset < 0) offset = 0;
+    if ((size_t)offset > max_offset) offset = (int)max_offset;
+    
+    if ((size_t)offset != view_offset) {
+        view_offset = (size_t)offset;
+        if (view_offset == 0) {
+            dirty_rows = VGA_ALL_ROWS;
+            terminal_flush();
+        } else {
+            render_scrollback();
         }
     }
+    
+    irq_restore(flags);
+}
+
+/* Redraw the whole screen from the shadow buffer
+ * Used when the display backend changes under the terminal */
+void terminal_redraw(void) {
+    uint32_t flags = irq_save();
+    
+    window_rows = fbcon_active() ? fbcon_window_rows() : VGA_WINDOW_ROWS;
+    vga_origin_row = 0;
+    vga_origin_hw = (size_t)-1;
+    cursor_hw_pos = (size_t)-1;
+    dirty_rows = VGA_ALL_ROWS;
+    view_offset = 0;
+    terminal_flush();
+    
+    irq_restore(flags);
+}
+
+/* Clear the shadow screen without flushing */
+static void shadow_clear(void) {
+    for (size_t y = 0; y < VGA_HEIGHT; y++) {
+        shadow_clear_row(y, terminal_color);
+    }
+}
+
+/* Clear the terminal screen */
+void terminal_clear(void) {
+    uint32_t flags = irq_save();
+    shadow_clear();
+    terminal_flush();
+    irq_restore(flags);
+}
+
+/* Scroll the shadow screen up without flushing
+ * Rotating the row ring is O(1) and keeps the old top line as history.
+ * Video memory follows by moving the CRTC start address down, so rows
+ * already on screen don't have to be copied again; only once the origin
+ * runs off the end of the window (32 KiB of text memory, or the
+ * framebuffer's extra rows) is the screen redrawn at the top.
+ */
+static void shadow_scroll(size_t lines) {
+    if (lines > VGA_HEIGHT) lines = VGA_HEIGHT;
+    
+    for (size_t i = 0; i < lines; i++) {
+        shadow_top = (shadow_top + 1) & (VGA_HISTORY_LINES - 1);
+        if (history_lines < VGA_HISTORY_LINES) history_lines++;
+        shadow_clear_row(VGA_HEIGHT - 1, terminal_color);
+    }
+    
+    if (lines < VGA_HEIGHT && vga_origin_row + lines + VGA_HEIGHT <= window_rows) {
+        vga_origin_row += lines;
+        dirty_rows = (dirty_rows >> lines) | (VGA_ALL_ROWS & ~(VGA_ALL_ROWS >> lines));
+    } else {
+        vga_origin_row = 0;
+        dirty_rows = VGA_ALL_ROWS;
+    }
 }
 
 /* Scroll the terminal up by n lines */
 vga_status_t terminal_scroll(size_t lines) {
     if (lines == 0) return VGA_SUCCESS;
-    if (lines >= VGA_HEIGHT) {
-        terminal_clear();
-        return VGA_SUCCESS;
-    }
     
-    /* Move lines up */
-    size_t move_size = (VGA_HEIGHT - lines) * VGA_WIDTH * sizeof(uint16_t);
-    memmove(VGA_BUFFER, 
-            VGA_BUFFER + (lines * VGA_WIDTH),
-            move_size);
-    
-    /* Clear bottom lines */
-    for (size_t y = VGA_HEIGHT - lines; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            VGA_BUFFER[index] = vga_entry(' ', terminal_color);
-        }
-    }
+    uint32_t flags = irq_save();
+    shadow_scroll(lines);
+    terminal_flush();
+    irq_restore(flags);
     
     return VGA_SUCCESS;
 }
@@ -161,95 +362,112 @@ void terminal_init(void) {
     terminal_default_color = vga_entry_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     terminal_color = terminal_default_color;
     
-    terminal_clear();
+    shadow_top = 0;
+    history_lines = VGA_HEIGHT;
+    view_offset = 0;
+    vga_origin_row = 0;
+    vga_origin_hw = (size_t)-1;
     terminal_cursor_enable(1);
+    terminal_clear();
     
     /* Reset ANSI state */
     ansi_state = ANSI_STATE_NORMAL;
 }
 
-/* Put a character at a specific position */
-vga_status_t terminal_putentryat(char c, uint8_t color, size_t x, size_t y) {
+/* Put a character into the shadow screen without flushing */
+static vga_status_t shadow_putentryat(char c, uint8_t color, size_t x, size_t y) {
     if (x >= VGA_WIDTH || y >= VGA_HEIGHT) {
         return VGA_ERROR_INVALID_POSITION;
     }
     
-    const size_t index = y * VGA_WIDTH + x;
-    VGA_BUFFER[index] = vga_entry(c, color);
+    shadow_row(y)[x] = vga_entry(c, color);
+    dirty_rows |= 1u << y;
     
     return VGA_SUCCESS;
 }
 
-/* Process ANSI SGR (Select Graphic Rendition) parameters */
-static void process_ansi_params(void) {
-    /* Add a null terminator */
-    ansi_params[ansi_param_index] = '\0';
-    
-    /* Split the parameter string by semicolons */
-    char* param = ansi_params;
-    char* next_param;
-    
-    while (param && *param) {
-        /* Find the next parameter (after semicolon) */
-        next_param = strchr(param, ';');
-        if (next_param) {
-            *next_param = '\0';
-            next_param++;
-        }
-        
-        /* Convert the parameter to an integer */
-        int code = atoi(param);
-        
-        /* Process the SGR code */
-        switch (code) {
-            case 0: /* Reset / Normal */
-                terminal_color = terminal_default_color;
-                break;
-                
-            case 1: /* Bold/Bright (increase color intensity) */
-                /* If foreground is standard color (0-7), make it bright (8-15) */
-                if ((terminal_color & 0x0F) < 8) {
-                    terminal_color = (terminal_color & 0xF0) | 
-                                    ((terminal_color & 0x0F) + 8);
-                }
-                break;
-                
-            case 30: case 31: case 32: case 33: /* Foreground colors */
-            case 34: case 35: case 36: case 37:
-                /* Set foreground color (code - 30 is the color index) */
-                terminal_color = (terminal_color & 0xF0) | 
-                                ansi_to_vga_color[code - 30];
-                break;
-                
-            case 40: case 41: case 42: case 43: /* Background colors */
-            case 44: case 45: case 46: case 47:
-                /* Set background color (code - 40 is the color index) */
-                terminal_color = (terminal_color & 0x0F) | 
-                                (ansi_to_vga_color[code - 40] << 4);
-                break;
-                
-            case 90: case 91: case 92: case 93: /* Bright foreground colors */
-            case 94: case 95: case 96: case 97:
-                /* Set bright foreground color (code - 90 is the color index) */
+/* Put a character at a specific position */
+vga_status_t terminal_putentryat(char c, uint8_t color, size_t x, size_t y) {
+    uint32_t flags = irq_save();
+    vga_status_t status = shadow_putentryat(c, color, x, y);
+    if (status == VGA_SUCCESS) {
+        terminal_flush();
+    }
+    irq_restore(flags);
+    return status;
+}
+
+/* Apply one ANSI SGR (Select Graphic Rendition) code */
+static void apply_sgr_code(int code) {
+    switch (code) {
+        case 0: /* Reset / Normal */
+            terminal_color = terminal_default_color;
+            break;
+            
+        case 1: /* Bold/Bright (increase color intensity) */
+            /* If foreground is standard color (0-7), make it bright (8-15) */
+            if ((terminal_color & 0x0F) < 8) {
                 terminal_color = (terminal_color & 0xF0) | 
-                                ansi_to_vga_bright_color[code - 90];
-                break;
-                
-            case 100: case 101: case 102: case 103: /* Bright background colors */
-            case 104: case 105: case 106: case 107:
-                /* Set bright background color (code - 100 is the color index) */
-                terminal_color = (terminal_color & 0x0F) | 
-                                (ansi_to_vga_bright_color[code - 100] << 4);
-                break;
+                                ((terminal_color & 0x0F) + 8);
+            }
+            break;
+            
+        case 30: case 31: case 32: case 33: /* Foreground colors */
+        case 34: case 35: case 36: case 37:
+            /* Set foreground color (code - 30 is the color index) */
+            terminal_color = (terminal_color & 0xF0) | 
+                            ansi_to_vga_color[code - 30];
+            break;
+            
+        case 40: case 41: case 42: case 43: /* Background colors */
+        case 44: case 45: case 46: case 47:
+            /* Set background color (code - 40 is the color index) */
+            terminal_color = (terminal_color & 0x0F) | 
+                            (ansi_to_vga_color[code - 40] << 4);
+            break;
+            
+        case 90: case 91: case 92: case 93: /* Bright foreground colors */
+        case 94: case 95: case 96: case 97:
+            /* Set bright foreground color (code - 90 is the color index) */
+            terminal_color = (terminal_color & 0xF0) | 
+                            ansi_to_vga_bright_color[code - 90];
+            break;
+            
+        case 100: case 101: case 102: case 103: /* Bright background colors */
+        case 104: case 105: case 106: case 107:
+            /* Set bright background color (code - 100 is the color index) */
+            terminal_color = (terminal_color & 0x0F) | 
+                            (ansi_to_vga_bright_color[code - 100] << 4);
+            break;
+    }
+}
+
+/* Process ANSI SGR parameters
+ * One pass over the collected digits and semicolons; an empty
+ * parameter ends the list. */
+static void process_ansi_params(void) {
+    int code = 0;
+    size_t digits = 0;
+    
+    for (size_t i = 0; i < ansi_param_index; i++) {
+        char c = ansi_params[i];
+        if (c == ';') {
+            if (digits == 0) return;
+            apply_sgr_code(code);
+            code = 0;
+            digits = 0;
+        } else {
+            /* Codes past 999 are all unknown; stop growing to avoid overflow */
+            if (code < 1000) code = code * 10 + (c - '0');
+            digits++;
         }
-        
-        /* Move to the next parameter */
-        param = next_param;
     }
+    if (digits > 0) apply_sgr_code(code);
 }
 
-/* Put a character at the current position */
-vga_status_t terminal_putchar(char c) {
+/* Put a character at the current position in the shadow screen
+ * This is the body of terminal_putchar(); callers flush afterwards */
+static vga_status_t terminal_emit(char c) {
     vga_status_t status = VGA_SUCCESS;
     
     /* ANSI escape sequence processing */
@@ -262,7 +480,6 @@ vga_status_t terminal_putchar(char c) {
         if (c == '[') {
             ansi_state = ANSI_STATE_BRACKET;
             ansi_param_index = 0;
-            memset(ansi_params, 0, sizeof(ansi_params));
             return VGA_SUCCESS;
         } else {
             ansi_state = ANSI_STATE_NORMAL;
@@ -294,7 +511,7 @@ vga_status_t terminal_putchar(char c) {
     if (c == '\n') {
         terminal_column = 0;
         if (++terminal_row == VGA_HEIGHT) {
-            status = terminal_scroll(1);
+            shadow_scroll(1);
             terminal_row = VGA_HEIGHT - 1;
         }
     } else if (c == '\r') {
@@ -302,42 +519,55 @@ vga_status_t terminal_putchar(char c) {
     } else if (c == '\b') {
         if (terminal_column > 0) {
             terminal_column--;
-            status = terminal_putentryat(' ', terminal_color, 
-                                       terminal_column, terminal_row);
+            status = shadow_putentryat(' ', terminal_color, 
+                                     terminal_column, terminal_row);
         }
     } else if (c == '\t') {
         /* Tab stops every 8 columns */
         size_t spaces = 8 - (terminal_column % 8);
         for (size_t i = 0; i < spaces && terminal_column < VGA_WIDTH; i++) {
-            status = terminal_putentryat(' ', terminal_color, 
-                                       terminal_column++, terminal_row);
+            status = shadow_putentryat(' ', terminal_color, 
+                                     terminal_column++, terminal_row);
             if (status != VGA_SUCCESS) break;
         }
     } else {
-        status = terminal_putentryat(c, terminal_color, 
-                                   terminal_column, terminal_row);
+        status = shadow_putentryat(c, terminal_color, 
+                                 terminal_column, terminal_row);
         if (status == VGA_SUCCESS && ++terminal_column == VGA_WIDTH) {
             terminal_column = 0;
             if (++terminal_row == VGA_HEIGHT) {
-                status = terminal_scroll(1);
+                shadow_scroll(1);
                 terminal_row = VGA_HEIGHT - 1;
             }
         }
     }
     
-    update_cursor();
     return status;
 }
 
-/* Write a string to the terminal */
+/* Put a character at the current position */
+vga_status_t terminal_putchar(char c) {
+    uint32_t flags = irq_save();
+    vga_status_t status = terminal_emit(c);
+    terminal_flush();
+    irq_restore(flags);
+    return status;
+}
+
+/* Write a string to the terminal
+ * Draws into the shadow buffer, then flushes dirty rows and
+ * moves the hardware cursor once for the whole string */
 vga_status_t terminal_write(const char* data) {
     vga_status_t status = VGA_SUCCESS;
+    uint32_t flags = irq_save();
     
     for (size_t i = 0; data[i] != '\0'; i++) {
-        status = terminal_putchar(data[i]);
+        status = terminal_emit(data[i]);
         if (status != VGA_SUCCESS) break;
     }
     
+    terminal_flush();
+    irq_restore(flags);
     return status;
 }
 
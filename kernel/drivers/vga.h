@@ -9,6 +9,9 @@
 #define VGA_WIDTH  80
 #define VGA_HEIGHT 25
 
+/* Lines kept in RAM for scrollback, screen included (power of two) */
+#define VGA_HISTORY_LINES 4096
+
 /* Text mode color constants */
 enum vga_color {
     VGA_COLOR_BLACK = 0,
@@ -82,11 +85,28 @@ uint8_t terminal_getcolor(void);
  */
 void terminal_clear(void);
 
+/* Copy changed rows of the RAM shadow buffer to video memory
+ * and move the hardware cursor. Output functions call this
+ * themselves; it is only needed after direct shadow updates.
+ */
+void terminal_flush(void);
+
+/* Redraw the whole screen from the shadow buffer
+ * Called when the display backend changes (see fbcon.h).
+ */
+void terminal_redraw(void);
+
 /* Scroll the terminal up by n lines
  * Returns: VGA_SUCCESS on success, error code otherwise
  */
 vga_status_t terminal_scroll(size_t lines);
 
+/* Scroll the view through the scrollback history
+ * Positive values move back in time, negative values towards the
+ * live screen. Any new output returns the view to the live screen.
+ */
+void terminal_scrollback(int lines);
+
 /* Put a character at a specific position with specific color
  * Returns: VGA_SUCCESS on success, error code otherwise
  */
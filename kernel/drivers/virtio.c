@@ -0,0 +1,431 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "virtio.h"
+#include "pci.h"
+#include "pci_msi.h"
+#include "../arch/x86/io.h"
+#include "../arch/x86/paging.h"
+#include "../arch/x86/tsc.h"
+
+/* Legacy registers, from the I/O BAR */
+#define VIRTIO_LEGACY_DEVICE_FEATURES   0x00
+#define VIRTIO_LEGACY_DRIVER_FEATURES   0x04
+#define VIRTIO_LEGACY_QUEUE_PFN         0x08    /* Ring address / 4096 */
+#define VIRTIO_LEGACY_QUEUE_SIZE        0x0C
+#define VIRTIO_LEGACY_QUEUE_SELECT      0x0E
+#define VIRTIO_LEGACY_QUEUE_NOTIFY      0x10
+#define VIRTIO_LEGACY_STATUS            0x12
+#define VIRTIO_LEGACY_ISR               0x13
+#define VIRTIO_LEGACY_QUEUE_VECTOR      0x16    /* MSI-X only */
+#define VIRTIO_LEGACY_CONFIG            0x14    /* 0x18 while MSI-X is enabled */
+#define VIRTIO_LEGACY_CONFIG_MSIX       0x18
+
+/* Legacy rings: the used ring starts on the next page */
+#define VIRTIO_LEGACY_ALIGN             4096
+
+/* Vendor capability: what it describes and where */
+#define VIRTIO_PCI_CAP_TYPE             3
+#define VIRTIO_PCI_CAP_BAR              4
+#define VIRTIO_PCI_CAP_OFFSET           8
+#define VIRTIO_PCI_CAP_LENGTH           12
+#define VIRTIO_PCI_CAP_NOTIFY_MULT      16      /* Notify capability only */
+
+#define VIRTIO_PCI_CAP_COMMON           1
+#define VIRTIO_PCI_CAP_NOTIFY           2
+#define VIRTIO_PCI_CAP_ISR              3
+#define VIRTIO_PCI_CAP_DEVICE           4
+
+/* Modern common configuration */
+#define VIRTIO_COMMON_DEVICE_FEATURE_SELECT 0x00
+#define VIRTIO_COMMON_DEVICE_FEATURE    0x04
+#define VIRTIO_COMMON_DRIVER_FEATURE_SELECT 0x08
+#define VIRTIO_COMMON_DRIVER_FEATURE    0x0C
+#define VIRTIO_COMMON_MSIX_CONFIG       0x10
+#define VIRTIO_COMMON_STATUS            0x14
+#define VIRTIO_COMMON_QUEUE_SELECT      0x16
+#define VIRTIO_COMMON_QUEUE_SIZE        0x18
+#define VIRTIO_COMMON_QUEUE_MSIX_VECTOR 0x1A
+#define VIRTIO_COMMON_QUEUE_ENABLE      0x1C
+#define VIRTIO_COMMON_QUEUE_NOTIFY_OFF  0x1E
+#define VIRTIO_COMMON_QUEUE_DESC        0x20
+#define VIRTIO_COMMON_QUEUE_DRIVER      0x28
+#define VIRTIO_COMMON_QUEUE_DEVICE      0x30
+
+static inline uint8_t mmio_read8(volatile uint8_t* base, uint32_t offset) {
+    return *(volatile uint8_t*)(base + offset);
+}
+
+static inline uint16_t mmio_read16(volatile uint8_t* base, uint32_t offset) {
+    return *(volatile uint16_t*)(base + offset);
+}
+
+static inline uint32_t mmio_read32(volatile uint8_t* base, uint32_t offset) {
+    return *(volatile uint32_t*)(base + offset);
+}
+
+static inline void mmio_write8(volatile uint8_t* base, uint32_t offset, uint8_t value) {
+    *(volatile uint8_t*)(base + offset) = value;
+}
+
+static inline void mmio_write16(volatile uint8_t* base, uint32_t offset, uint16_t value) {
+    *(volatile uint16_t*)(base + offset) = value;
+}
+
+static inline void mmio_write32(volatile uint8_t* base, uint32_t offset, uint32_t value) {
+    *(volatile uint32_t*)(base + offset) = value;
+}
+
+static uint8_t virtio_get_status(const virtio_device_t* vdev) {
+    if (vdev->modern) return mmio_read8(vdev->common, VIRTIO_COMMON_STATUS);
+    return inb(vdev->io_base + VIRTIO_LEGACY_STATUS);
+}
+
+static void virtio_set_status(virtio_device_t* vdev, uint8_t status) {
+    if (vdev->modern) {
+        mmio_write8(vdev->common, VIRTIO_COMMON_STATUS, status);
+    } else {
+        outb(vdev->io_base + VIRTIO_LEGACY_STATUS, status);
+    }
+}
+
+/* Map the memory BAR a capability points into
+ * Returns: the region's address, or NULL if the BAR is unusable or the
+ * region does not fit in it */
+static volatile uint8_t* virtio_map_cap(const pci_device_t* dev, uint8_t cap) {
+    uint8_t index = pci_read_config_byte(dev->bus, dev->device, dev->func, cap + VIRTIO_PCI_CAP_BAR);
+    uint32_t offset = pci_read_config_dword(dev->bus, dev->device, dev->func, cap + VIRTIO_PCI_CAP_OFFSET);
+    uint32_t length = pci_read_config_dword(dev->bus, dev->device, dev->func, cap + VIRTIO_PCI_CAP_LENGTH);
+    if (index >= PCI_MAX_BARS) return NULL;
+
+    const pci_bar_t* bar = &dev->bars[index];
+    if (bar->io || !bar->base || (bar->base >> 32)) return NULL;
+    if (length == 0 || (uint64_t)offset + length > bar->size) return NULL;
+    if (paging_map_region((uint32_t)bar->base, (uint32_t)bar->size, PDE_CACHE_DISABLE) != 0) return NULL;
+    return (volatile uint8_t*)(uint32_t)bar->base + offset;
+}
+
+/* Collect the modern transport's regions
+ * Returns: 0 if all four were found and mapped, -1 otherwise */
+static int virtio_find_modern(virtio_device_t* vdev, const pci_device_t* dev) {
+    for (uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_VENDOR, 0); cap;
+         cap = pci_find_capability(dev, PCI_CAP_ID_VENDOR, cap)) {
+        uint8_t type = pci_read_config_byte(dev->bus, dev->device, dev->func, cap + VIRTIO_PCI_CAP_TYPE);
+        volatile uint8_t** region;
+        switch (type) {
+        case VIRTIO_PCI_CAP_COMMON: region = &vdev->common; break;
+        case VIRTIO_PCI_CAP_NOTIFY: region = &vdev->notify_base; break;
+        case VIRTIO_PCI_CAP_ISR: region = &vdev->isr; break;
+        case VIRTIO_PCI_CAP_DEVICE: region = &vdev->device_config; break;
+        default: continue;
+        }
+        /* The first capability of a type is the preferred one */
+        if (*region) continue;
+
+        *region = virtio_map_cap(dev, cap);
+        if (type == VIRTIO_PCI_CAP_NOTIFY) {
+            vdev->notify_multiplier = pci_read_config_dword(dev->bus, dev->device, dev->func,
+                                                            cap + VIRTIO_PCI_CAP_NOTIFY_MULT);
+        }
+    }
+    return vdev->common && vdev->notify_base && vdev->isr && vdev->device_config ? 0 : -1;
+}
+
+/* Find the transport, reset the device and acknowledge it */
+int virtio_pci_init(virtio_device_t* vdev, const pci_device_t* dev) {
+    memset(vdev, 0, sizeof(*vdev));
+    vdev->pci = dev;
+
+    if (virtio_find_modern(vdev, dev) == 0) {
+        vdev->modern = 1;
+        pci_enable_device(dev, PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER);
+    } else {
+        const pci_bar_t* bar = &dev->bars[0];
+        if (!bar->io || !bar->base) return -1;
+        vdev->io_base = (uint16_t)bar->base;
+        pci_enable_device(dev, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    }
+
+    if (virtio_reset(vdev) != 0) return -1;
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return 0;
+}
+
+/* Accept the offered features in wanted */
+int virtio_negotiate(virtio_device_t* vdev, uint64_t wanted) {
+    uint64_t offered;
+    if (vdev->modern) {
+        mmio_write32(vdev->common, VIRTIO_COMMON_DEVICE_FEATURE_SELECT, 0);
+        offered = mmio_read32(vdev->common, VIRTIO_COMMON_DEVICE_FEATURE);
+        mmio_write32(vdev->common, VIRTIO_COMMON_DEVICE_FEATURE_SELECT, 1);
+        offered |= (uint64_t)mmio_read32(vdev->common, VIRTIO_COMMON_DEVICE_FEATURE) << 32;
+        if (!(offered & VIRTIO_F_VERSION_1)) return -1;
+        wanted |= VIRTIO_F_VERSION_1;
+    } else {
+        offered = inl(vdev->io_base + VIRTIO_LEGACY_DEVICE_FEATURES);
+    }
+    vdev->features = offered & wanted;
+
+    if (!vdev->modern) {
+        outl(vdev->io_base + VIRTIO_LEGACY_DRIVER_FEATURES, (uint32_t)vdev->features);
+        return 0;
+    }
+
+    mmio_write32(vdev->common, VIRTIO_COMMON_DRIVER_FEATURE_SELECT, 0);
+    mmio_write32(vdev->common, VIRTIO_COMMON_DRIVER_FEATURE, (uint32_t)vdev->features);
+    mmio_write32(vdev->common, VIRTIO_COMMON_DRIVER_FEATURE_SELECT, 1);
+    mmio_write32(vdev->common, VIRTIO_COMMON_DRIVER_FEATURE, (uint32_t)(vdev->features >> 32));
+
+    uint8_t status = virtio_get_status(vdev);
+    virtio_set_status(vdev, status | VIRTIO_STATUS_FEATURES_OK);
+    return (virtio_get_status(vdev) & VIRTIO_STATUS_FEATURES_OK) ? 0 : -1;
+}
+
+/* Copy bytes from the device-specific config area */
+void virtio_config_read(const virtio_device_t* vdev, uint32_t offset, void* buffer, uint32_t size) {
+    uint8_t* bytes = (uint8_t*)buffer;
+    if (vdev->modern) {
+        for (uint32_t i = 0; i < size; i++) {
+            bytes[i] = mmio_read8(vdev->device_config, offset + i);
+        }
+        return;
+    }
+
+    /* The legacy config area moves up while MSI-X is on */
+    uint16_t base = vdev->io_base + (pci_irq_type(vdev->pci) == PCI_IRQ_MSIX
+                                     ? VIRTIO_LEGACY_CONFIG_MSIX : VIRTIO_LEGACY_CONFIG);
+    for (uint32_t i = 0; i < size; i++) {
+        bytes[i] = inb(base + offset + i);
+    }
+}
+
+/* Lay the rings out in vq->ring the way the legacy transport expects */
+static void virtqueue_init(virtqueue_t* vq, virtio_device_t* vdev, uint16_t index, uint16_t size) {
+    memset(vq->ring, 0, sizeof(vq->ring));
+    vq->device = vdev;
+    vq->index = index;
+    vq->size = size;
+
+    uint32_t avail_offset = size * sizeof(virtq_desc_t);
+    uint32_t used_offset = avail_offset + sizeof(uint16_t) * (3 + size);
+    used_offset = (used_offset + VIRTIO_LEGACY_ALIGN - 1) & ~(VIRTIO_LEGACY_ALIGN - 1);
+    vq->desc = (virtq_desc_t*)vq->ring;
+    vq->avail = (virtq_avail_t*)(vq->ring + avail_offset);
+    vq->used = (virtq_used_t*)(vq->ring + used_offset);
+    vq->used_event = &vq->avail->ring[size];
+    vq->avail_event = (volatile uint16_t*)&vq->used->ring[size];
+
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = (uint16_t)(i + 1);
+        vq->tokens[i] = NULL;
+    }
+    vq->free_head = 0;
+    vq->free_count = size;
+    vq->avail_idx = 0;
+    vq->kicked_idx = 0;
+    vq->last_used = 0;
+    vq->notify = NULL;
+}
+
+/* Set up queue index on vq */
+int virtio_queue_setup(virtio_device_t* vdev, uint16_t index, virtqueue_t* vq) {
+    int msix = pci_irq_type(vdev->pci) == PCI_IRQ_MSIX;
+
+    if (!vdev->modern) {
+        outw(vdev->io_base + VIRTIO_LEGACY_QUEUE_SELECT, index);
+        uint16_t size = inw(vdev->io_base + VIRTIO_LEGACY_QUEUE_SIZE);
+        /* The legacy transport cannot shrink a queue */
+        if (size == 0 || size > VIRTQ_MAX_SIZE) return -1;
+
+        virtqueue_init(vq, vdev, index, size);
+        outl(vdev->io_base + VIRTIO_LEGACY_QUEUE_PFN, (uint32_t)vq->ring / VIRTIO_LEGACY_ALIGN);
+        if (msix) {
+            outw(vdev->io_base + VIRTIO_LEGACY_QUEUE_VECTOR, 0);
+            if (inw(vdev->io_base + VIRTIO_LEGACY_QUEUE_VECTOR) != 0) return -1;
+        }
+        return 0;
+    }
+
+    mmio_write16(vdev->common, VIRTIO_COMMON_QUEUE_SELECT, index);
+    uint16_t size = mmio_read16(vdev->common, VIRTIO_COMMON_QUEUE_SIZE);
+    if (size == 0) return -1;
+    if (size > VIRTQ_MAX_SIZE) size = VIRTQ_MAX_SIZE;
+    mmio_write16(vdev->common, VIRTIO_COMMON_QUEUE_SIZE, size);
+
+    virtqueue_init(vq, vdev, index, size);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DESC, (uint32_t)vq->desc);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DESC + 4, 0);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DRIVER, (uint32_t)vq->avail);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DRIVER + 4, 0);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DEVICE, (uint32_t)vq->used);
+    mmio_write32(vdev->common, VIRTIO_COMMON_QUEUE_DEVICE + 4, 0);
+
+    if (msix) {
+        mmio_write16(vdev->common, VIRTIO_COMMON_QUEUE_MSIX_VECTOR, 0);
+        if (mmio_read16(vdev->common, VIRTIO_COMMON_QUEUE_MSIX_VECTOR) != 0) return -1;
+    }
+
+    uint16_t notify_off = mmio_read16(vdev->common, VIRTIO_COMMON_QUEUE_NOTIFY_OFF);
+    vq->notify = (volatile uint16_t*)(vdev->notify_base + notify_off * vdev->notify_multiplier);
+    mmio_write16(vdev->common, VIRTIO_COMMON_QUEUE_ENABLE, 1);
+    return 0;
+}
+
+void virtio_driver_ok(virtio_device_t* vdev) {
+    virtio_set_status(vdev, virtio_get_status(vdev) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+int virtio_reset(virtio_device_t* vdev) {
+    virtio_set_status(vdev, 0);
+    /* A modern device may take a while to finish the reset */
+    uint64_t start = tsc_read();
+    while (vdev->modern && virtio_get_status(vdev) != 0) {
+        if (tsc_to_us(tsc_read() - start) > (uint64_t)VIRTIO_RESET_TIMEOUT_MS * 1000) return -1;
+    }
+    return 0;
+}
+
+void virtio_fail(virtio_device_t* vdev) {
+    virtio_set_status(vdev, virtio_get_status(vdev) | VIRTIO_STATUS_FAILED);
+}
+
+/* Read and acknowledge the ISR status */
+uint8_t virtio_isr_status(virtio_device_t* vdev) {
+    if (vdev->modern) return mmio_read8(vdev->isr, 0);
+    return inb(vdev->io_base + VIRTIO_LEGACY_ISR);
+}
+
+/* Add a chain of out buffers followed by in buffers */
+int virtqueue_add(virtqueue_t* vq, const virtq_buffer_t* buffers, uint32_t out, uint32_t in, void* token) {
+    uint32_t total = out + in;
+    int indirect = virtio_has_feature(vq->device, VIRTIO_F_INDIRECT_DESC) &&
+                   total > 1 && total <= VIRTQ_INDIRECT_MAX;
+    uint32_t needed = indirect ? 1 : total;
+    if (total == 0 || vq->free_count < needed) return -1;
+
+    uint16_t head = vq->free_head;
+    if (indirect) {
+        /* The head's own table: the chain takes one ring descriptor */
+        virtq_desc_t* table = vq->indirect[head];
+        for (uint32_t i = 0; i < total; i++) {
+            table[i].addr = (uint32_t)buffers[i].addr;
+            table[i].len = buffers[i].len;
+            table[i].flags = (uint16_t)((i >= out ? VIRTQ_DESC_F_WRITE : 0) |
+                                        (i + 1 < total ? VIRTQ_DESC_F_NEXT : 0));
+            table[i].next = (uint16_t)(i + 1);
+        }
+        vq->desc[head].addr = (uint32_t)table;
+        vq->desc[head].len = total * sizeof(virtq_desc_t);
+        vq->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+        vq->free_head = vq->desc[head].next;
+    } else {
+        /* Free descriptors are already linked through next */
+        uint16_t index = head;
+        uint16_t last = head;
+        for (uint32_t i = 0; i < total; i++) {
+            virtq_desc_t* desc = &vq->desc[index];
+            desc->addr = (uint32_t)buffers[i].addr;
+            desc->len = buffers[i].len;
+            desc->flags = (uint16_t)((i >= out ? VIRTQ_DESC_F_WRITE : 0) | VIRTQ_DESC_F_NEXT);
+            last = index;
+            index = desc->next;
+        }
+        vq->desc[last].flags &= (uint16_t)~VIRTQ_DESC_F_NEXT;
+        vq->free_head = index;
+    }
+    vq->free_count = (uint16_t)(vq->free_count - needed);
+    vq->tokens[head] = token;
+
+    vq->avail->ring[vq->avail_idx & (vq->size - 1)] = head;
+    vq->avail_idx++;
+    return 0;
+}
+
+/* Publish the added chains and notify the device if it wants to know */
+void virtqueue_kick(virtqueue_t* vq) {
+    uint16_t old = vq->kicked_idx;
+    uint16_t new = vq->avail_idx;
+    if (old == new) return;
+
+    /* Ring entries before the index; x86 keeps stores in order */
+    asm volatile ("" : : : "memory");
+    vq->avail->idx = new;
+    vq->kicked_idx = new;
+    /* The index store must be visible before the device's wishes are read */
+    __sync_synchronize();
+
+    int notify;
+    if (virtio_has_feature(vq->device, VIRTIO_F_EVENT_IDX)) {
+        /* Notify if the device's avail_event lies among the entries just published */
+        notify = (uint16_t)(new - *vq->avail_event - 1) < (uint16_t)(new - old);
+    } else {
+        notify = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+    if (!notify) return;
+
+    if (vq->device->modern) {
+        *vq->notify = vq->index;
+    } else {
+        outw(vq->device->io_base + VIRTIO_LEGACY_QUEUE_NOTIFY, vq->index);
+    }
+}
+
+/* Give the chain at head back to the free list
+ * Returns: its token */
+static void* virtqueue_free_chain(virtqueue_t* vq, uint16_t head) {
+    uint16_t count = 1;
+    uint16_t last = head;
+    if (!(vq->desc[head].flags & VIRTQ_DESC_F_INDIRECT)) {
+        while (vq->desc[last].flags & VIRTQ_DESC_F_NEXT) {
+            last = vq->desc[last].next;
+            count++;
+        }
+    }
+    vq->desc[last].next = vq->free_head;
+    vq->free_head = head;
+    vq->free_count = (uint16_t)(vq->free_count + count);
+
+    void* token = vq->tokens[head];
+    vq->tokens[head] = NULL;
+    return token;
+}
+
+/* Take one completed chain off the used ring */
+void* virtqueue_get_used(virtqueue_t* vq, uint32_t* len) {
+    if (vq->last_used == vq->used->idx) return NULL;
+    /* The element after the index; x86 keeps loads in order */
+    asm volatile ("" : : : "memory");
+
+    virtq_used_elem_t* elem = &vq->used->ring[vq->last_used & (vq->size - 1)];
+    uint16_t head = (uint16_t)elem->id;
+    if (len) *len = elem->len;
+
+    void* token = virtqueue_free_chain(vq, head);
+    vq->last_used++;
+    if (virtio_has_feature(vq->device, VIRTIO_F_EVENT_IDX)) {
+        *vq->used_event = vq->last_used;
+    }
+    return token;
+}
+
+/* Take back a chain the device will not complete */
+void* virtqueue_detach(virtqueue_t* vq) {
+    for (uint16_t head = 0; head < vq->size; head++) {
+        if (vq->tokens[head]) return virtqueue_free_chain(vq, head);
+    }
+    return NULL;
+}
+
+/* Ask for an interrupt on the next completion */
+int virtqueue_enable_interrupts(virtqueue_t* vq) {
+    if (virtio_has_feature(vq->device, VIRTIO_F_EVENT_IDX)) {
+        *vq->used_event = vq->last_used;
+    } else {
+        vq->avail->flags &= (uint16_t)~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+    /* A completion that raced the store above may not interrupt */
+    __sync_synchronize();
+    return vq->last_used != vq->used->idx;
+}
@@ -0,0 +1,218 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pci.h"
+
+/* virtio over PCI: transport and split virtqueues
+ *
+ * A virtio device exposes feature bits, a status byte, a device-specific
+ * config area and a number of virtqueues. The legacy (0.9.5) transport
+ * puts all of it in an I/O BAR; the modern (1.0) transport describes
+ * memory-mapped common, notify, ISR and device config regions with
+ * vendor-specific PCI capabilities. Transitional devices (QEMU's default
+ * on a PCI bus) offer both; the modern one is used when its BAR lies
+ * below 4 GiB.
+ *
+ * A split virtqueue is a descriptor table, an avail ring the driver
+ * publishes chains on and a used ring the device returns them on. With
+ * VIRTIO_F_INDIRECT_DESC a request of several buffers takes one ring
+ * descriptor pointing at a per-slot table, so the ring holds as many
+ * requests as it has entries. With VIRTIO_F_EVENT_IDX each side tells
+ * the other which index it wants to hear about next: the driver only
+ * notifies (a VM exit) when the device asked for the new entries, and
+ * the device only interrupts when the driver asked for a completion.
+ *
+ * Probe order for a driver:
+ *
+ *   virtio_pci_init(vdev, dev);
+ *   virtio_negotiate(vdev, VIRTIO_F_INDIRECT_DESC | VIRTIO_F_EVENT_IDX | device bits);
+ *   pci_irq_alloc(dev, 1, 1, PCI_IRQ_MSIX | PCI_IRQ_LEGACY);
+ *   virtio_queue_setup(vdev, 0, vq);
+ *   virtio_driver_ok(vdev);
+ *
+ * Queue memory is handed to the device by address, so virtqueue_t and
+ * the buffers must be identity mapped (all kernel memory is).
+ */
+
+/* PCI IDs: transitional devices are 0x1000 + type - 1, modern ones 0x1040 + type */
+#define VIRTIO_PCI_VENDOR           0x1AF4
+#define VIRTIO_PCI_LEGACY_ID(type)  (0x1000 + (type) - 1)
+#define VIRTIO_PCI_MODERN_ID(type)  (0x1040 + (type))
+
+/* Device types */
+#define VIRTIO_ID_NET               1
+#define VIRTIO_ID_BLOCK             2
+
+/* Device status */
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FEATURES_OK   0x08
+#define VIRTIO_STATUS_NEEDS_RESET   0x40
+#define VIRTIO_STATUS_FAILED        0x80
+
+/* Transport feature bits */
+#define VIRTIO_F_INDIRECT_DESC      (1ull << 28)
+#define VIRTIO_F_EVENT_IDX          (1ull << 29)
+#define VIRTIO_F_VERSION_1          (1ull << 32)
+
+/* Longest a device may take to finish a reset */
+#define VIRTIO_RESET_TIMEOUT_MS     1000
+
+/* Ring sizes handled; legacy devices dictate theirs */
+#define VIRTQ_MAX_SIZE              256
+#define VIRTQ_INDIRECT_MAX          16      /* Buffers per chain with indirect descriptors */
+#define VIRTQ_RING_BYTES            12288   /* Legacy layout of VIRTQ_MAX_SIZE entries */
+
+/* Descriptor flags */
+#define VIRTQ_DESC_F_NEXT           1
+#define VIRTQ_DESC_F_WRITE          2       /* Device writes the buffer */
+#define VIRTQ_DESC_F_INDIRECT       4
+
+/* Ring flags, without VIRTIO_F_EVENT_IDX */
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+/* No MSI-X vector for a queue or config changes */
+#define VIRTIO_MSI_NO_VECTOR        0xFFFF
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];            /* Followed by used_event */
+} virtq_avail_t;
+
+typedef struct {
+    uint32_t id;                /* Head of the chain */
+    uint32_t len;               /* Bytes the device wrote */
+} virtq_used_elem_t;
+
+typedef struct {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    virtq_used_elem_t ring[];   /* Followed by avail_event */
+} virtq_used_t;
+
+/* One buffer of a chain */
+typedef struct {
+    void* addr;
+    uint32_t len;
+} virtq_buffer_t;
+
+struct virtio_device;
+
+/* A split virtqueue; the rings live in ring[] */
+typedef struct virtqueue {
+    uint8_t ring[VIRTQ_RING_BYTES] __attribute__((aligned(4096)));
+    virtq_desc_t indirect[VIRTQ_MAX_SIZE][VIRTQ_INDIRECT_MAX];
+
+    struct virtio_device* device;
+    uint16_t index;
+    uint16_t size;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    volatile uint16_t* used_event;  /* In the avail ring: interrupt after this used index */
+    volatile uint16_t* avail_event; /* In the used ring: notify after this avail index */
+
+    uint16_t free_head;         /* Free descriptors, linked through next */
+    uint16_t free_count;
+    uint16_t avail_idx;         /* Entries published, ahead of avail->idx until kicked */
+    uint16_t kicked_idx;        /* avail->idx at the last kick */
+    uint16_t last_used;         /* Next used entry to consume */
+    void* tokens[VIRTQ_MAX_SIZE];   /* Per head descriptor */
+
+    volatile uint16_t* notify;  /* Modern: doorbell */
+} virtqueue_t;
+
+/* A virtio PCI function */
+typedef struct virtio_device {
+    const pci_device_t* pci;
+    int modern;
+    uint64_t features;          /* Negotiated */
+
+    /* Legacy: everything in an I/O BAR */
+    uint16_t io_base;
+
+    /* Modern: regions from the vendor capabilities */
+    volatile uint8_t* common;
+    volatile uint8_t* notify_base;
+    uint32_t notify_multiplier;
+    volatile uint8_t* isr;
+    volatile uint8_t* device_config;
+} virtio_device_t;
+
+/* Find the transport, reset the device and acknowledge it
+ * Returns: 0 on success, -1 if neither transport is usable
+ */
+int virtio_pci_init(virtio_device_t* vdev, const pci_device_t* dev);
+
+/* Accept the offered features in wanted (VERSION_1 is added on the modern transport)
+ * Returns: 0 on success, -1 if the device refuses them
+ */
+int virtio_negotiate(virtio_device_t* vdev, uint64_t wanted);
+
+/* Check a negotiated feature */
+static inline int virtio_has_feature(const virtio_device_t* vdev, uint64_t feature) {
+    return (vdev->features & feature) != 0;
+}
+
+/* Copy bytes from the device-specific config area */
+void virtio_config_read(const virtio_device_t* vdev, uint32_t offset, void* buffer, uint32_t size);
+
+/* Set up queue index on vq, signalling MSI-X table entry 0 if the PCI
+ * layer enabled MSI-X (call after pci_irq_alloc())
+ * Returns: 0 on success, -1 if the queue does not exist or does not fit
+ */
+int virtio_queue_setup(virtio_device_t* vdev, uint16_t index, virtqueue_t* vq);
+
+/* Tell the device the driver is ready */
+void virtio_driver_ok(virtio_device_t* vdev);
+
+/* Reset the device, which stops it using its queues
+ * Returns: 0 on success, -1 if it is still resetting after VIRTIO_RESET_TIMEOUT_MS
+ */
+int virtio_reset(virtio_device_t* vdev);
+
+/* Mark the device failed, e.g. when the probe gives up */
+void virtio_fail(virtio_device_t* vdev);
+
+/* Read and acknowledge the ISR status (INTx only; MSI-X needs no acknowledgement)
+ * Returns: bit 0 for a queue interrupt, bit 1 for a config change
+ */
+uint8_t virtio_isr_status(virtio_device_t* vdev);
+
+/* Add a chain of out buffers (device reads) followed by in buffers
+ * (device writes); token comes back from virtqueue_get_used()
+ * Returns: 0 on success, -1 if the ring has no room (or the chain is empty)
+ */
+int virtqueue_add(virtqueue_t* vq, const virtq_buffer_t* buffers, uint32_t out, uint32_t in, void* token);
+
+/* Publish the chains added since the last kick and notify the device if it wants to know */
+void virtqueue_kick(virtqueue_t* vq);
+
+/* Take one completed chain off the used ring
+ * Returns: its token, or NULL if nothing completed
+ */
+void* virtqueue_get_used(virtqueue_t* vq, uint32_t* len);
+
+/* Take back a chain the device will not complete, once it is reset
+ * Returns: its token, or NULL when no chain is left
+ */
+void* virtqueue_detach(virtqueue_t* vq);
+
+/* Ask for an interrupt on the next completion
+ * Returns: 1 if completions arrived meanwhile and should be taken first, 0 otherwise
+ */
+int virtqueue_enable_interrupts(virtqueue_t* vq);
+
+#endif /* VIRTIO_H */
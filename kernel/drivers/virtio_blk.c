@@ -0,0 +1,403 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "virtio_blk.h"
+#include "virtio.h"
+#include "pci.h"
+#include "pci_driver.h"
+#include "pci_msi.h"
+#include "../arch/x86/cpu.h"
+#include "../arch/x86/tsc.h"
+#include "../trace.h"
+
+/* Device feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX       (1ull << 1)
+#define VIRTIO_BLK_F_SEG_MAX        (1ull << 2)
+#define VIRTIO_BLK_F_RO             (1ull << 5)
+
+/* Device config */
+#define VIRTIO_BLK_CONFIG_CAPACITY  0x00    /* Sectors, 64 bits */
+#define VIRTIO_BLK_CONFIG_SIZE_MAX  0x08
+#define VIRTIO_BLK_CONFIG_SEG_MAX   0x0C
+
+/* Request types */
+#define VIRTIO_BLK_T_IN             0
+#define VIRTIO_BLK_T_OUT            1
+
+/* Header and status byte around the data buffers */
+#define VIRTIO_BLK_SEGMENTS_MAX     (VIRTQ_INDIRECT_MAX - 2)
+
+typedef struct {
+    virtio_device_t device;
+    virtqueue_t queue;
+    virtio_blk_request_t* head;     /* Waiting for room in the ring */
+    virtio_blk_request_t* tail;
+    uint64_t progress;              /* TSC of the last issue into an idle ring or completion */
+    uint8_t failed;                 /* Timed out and reset; takes no more requests */
+} virtio_blk_t;
+
+static virtio_blk_t virtio_blk_devices[VIRTIO_BLK_MAX_DISKS];
+static virtio_blk_disk_t virtio_blk_disks[VIRTIO_BLK_MAX_DISKS];
+static uint32_t virtio_blk_total = 0;
+
+/* Block layer view of the disks; one virtio request per block request */
+static block_device_t virtio_blk_block_devices[VIRTIO_BLK_MAX_DISKS];
+static virtio_blk_request_t virtio_blk_block_requests[VIRTIO_BLK_MAX_DISKS][BLOCK_QUEUE_REQUESTS];
+
+/* Sectors one request can carry on a disk */
+static uint32_t virtio_blk_max_sectors(const virtio_blk_disk_t* disk) {
+    uint64_t sectors = (uint64_t)disk->segment_max * disk->segment_bytes / VIRTIO_BLK_SECTOR_SIZE;
+    return sectors < VIRTIO_BLK_MAX_SECTORS ? (uint32_t)sectors : VIRTIO_BLK_MAX_SECTORS;
+}
+
+/* The request's memory as a segment list */
+static const block_segment_t* virtio_blk_segments(const virtio_blk_request_t* request,
+                                                  block_segment_t* whole, uint32_t* count) {
+    if (request->segment_count) {
+        *count = request->segment_count;
+        return request->segments;
+    }
+    whole->addr = request->buffer;
+    whole->len = request->count * VIRTIO_BLK_SECTOR_SIZE;
+    *count = 1;
+    return whole;
+}
+
+/* Data buffers a request takes once its segments are split at segment_bytes */
+static uint32_t virtio_blk_buffer_count(const virtio_blk_request_t* request, const virtio_blk_disk_t* disk) {
+    block_segment_t whole;
+    uint32_t count;
+    const block_segment_t* segments = virtio_blk_segments(request, &whole, &count);
+    uint32_t buffers = 0;
+    for (uint32_t s = 0; s < count; s++) {
+        buffers += (segments[s].len + disk->segment_bytes - 1) / disk->segment_bytes;
+    }
+    return buffers;
+}
+
+/* Move waiting requests into the ring and notify once (interrupts disabled) */
+static void virtio_blk_start(uint32_t index) {
+    virtio_blk_t* blk = &virtio_blk_devices[index];
+    const virtio_blk_disk_t* disk = &virtio_blk_disks[index];
+
+    while (blk->head) {
+        if (blk->queue.free_count == blk->queue.size) {
+            blk->progress = tsc_read();
+        }
+        virtio_blk_request_t* request = blk->head;
+        request->header.type = request->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+        request->header.reserved = 0;
+        request->header.sector = request->lba;
+        request->device_status = 0xFF;
+
+        /* Header, data in segments of at most segment_bytes, status */
+        virtq_buffer_t buffers[VIRTQ_INDIRECT_MAX];
+        uint32_t count = 0;
+        buffers[count].addr = &request->header;
+        buffers[count++].len = sizeof(request->header);
+
+        block_segment_t whole;
+        uint32_t segment_count;
+        const block_segment_t* segments = virtio_blk_segments(request, &whole, &segment_count);
+        for (uint32_t s = 0; s < segment_count; s++) {
+            uint8_t* data = (uint8_t*)segments[s].addr;
+            uint32_t bytes = segments[s].len;
+            while (bytes > 0) {
+                uint32_t length = bytes < disk->segment_bytes ? bytes : disk->segment_bytes;
+                buffers[count].addr = data;
+                buffers[count++].len = length;
+                data += length;
+                bytes -= length;
+            }
+        }
+        buffers[count].addr = &request->device_status;
+        buffers[count++].len = 1;
+
+        /* Data goes out with the header for a write and comes back with the status for a read */
+        uint32_t out = request->write ? count - 1 : 1;
+        if (virtqueue_add(&blk->queue, buffers, out, count - out, request) != 0) break;
+
+        blk->head = request->next;
+        if (!blk->head) blk->tail = NULL;
+        request->next = NULL;
+        TRACE(VIRTIO_BLK_ISSUE, index, (uint32_t)request->lba, request->count);
+    }
+    virtqueue_kick(&blk->queue);
+}
+
+/* Complete what the device returned and refill the ring (interrupts disabled) */
+static void virtio_blk_service(uint32_t index) {
+    virtio_blk_t* blk = &virtio_blk_devices[index];
+
+    do {
+        virtio_blk_request_t* request;
+        while ((request = (virtio_blk_request_t*)virtqueue_get_used(&blk->queue, NULL)) != NULL) {
+            blk->progress = tsc_read();
+            uint8_t status = request->device_status;
+            TRACE(VIRTIO_BLK_COMPLETE, index, (uint32_t)request->lba, status);
+            request->error = status;
+            request->status = status == VIRTIO_BLK_S_OK ? VIRTIO_BLK_REQUEST_DONE : VIRTIO_BLK_REQUEST_ERROR;
+            if (request->done) {
+                request->done(request);
+            }
+        }
+    } while (virtqueue_enable_interrupts(&blk->queue));
+
+    virtio_blk_start(index);
+}
+
+/* Fail a request that the device will not complete (interrupts disabled) */
+static void virtio_blk_abort(virtio_blk_request_t* request) {
+    request->error = 0;
+    request->status = VIRTIO_BLK_REQUEST_TIMEOUT;
+    if (request->done) {
+        request->done(request);
+    }
+}
+
+/* Complete what the device returned, and give the disk up if the ring
+ * has stalled for VIRTIO_BLK_TIMEOUT_MS (thread context, interrupts disabled).
+ * Reset stops the device touching the requests' memory; bringing it back
+ * would take the whole probe again, so it stays failed. */
+static void virtio_blk_poll(uint32_t index) {
+    virtio_blk_t* blk = &virtio_blk_devices[index];
+    virtio_blk_service(index);
+    if (blk->queue.free_count == blk->queue.size ||
+        tsc_to_us(tsc_read() - blk->progress) <= (uint64_t)VIRTIO_BLK_TIMEOUT_MS * 1000) {
+        return;
+    }
+
+    printf("virtio-blk: disk %u timed out, %s\n", index,
+           virtio_reset(&blk->device) == 0 ? "reset and failed" : "failed, the reset did not finish");
+    virtio_fail(&blk->device);
+    blk->failed = 1;
+    virtio_blk_request_t* request;
+    while ((request = (virtio_blk_request_t*)virtqueue_detach(&blk->queue)) != NULL) {
+        virtio_blk_abort(request);
+    }
+    while ((request = blk->head) != NULL) {
+        blk->head = request->next;
+        virtio_blk_abort(request);
+    }
+    blk->tail = NULL;
+}
+
+static void virtio_blk_interrupt(registers_t* regs) {
+    for (uint32_t i = 0; i < virtio_blk_total; i++) {
+        virtio_blk_t* blk = &virtio_blk_devices[i];
+        if (pci_irq_vector(blk->device.pci, 0) != (int)regs->int_no) continue;
+        /* INTx may be shared; the ISR read says whether it was this device and lowers the line */
+        if (pci_irq_type(blk->device.pci) == PCI_IRQ_LEGACY && !virtio_isr_status(&blk->device)) continue;
+        virtio_blk_service(i);
+    }
+}
+
+/* Queue a request on its disk */
+int virtio_blk_submit(virtio_blk_request_t* request) {
+    if (request->disk >= virtio_blk_total || request->count == 0 ||
+        virtio_blk_devices[request->disk].failed) {
+        return -1;
+    }
+    const virtio_blk_disk_t* disk = &virtio_blk_disks[request->disk];
+    if (request->lba + request->count > disk->sectors ||
+        request->count > VIRTIO_BLK_MAX_SECTORS ||
+        (request->write && disk->read_only)) {
+        return -1;
+    }
+    if (request->segment_count && !block_segments_valid(request->segments, request->segment_count,
+                                                        request->count * VIRTIO_BLK_SECTOR_SIZE)) {
+        return -1;
+    }
+    if (virtio_blk_buffer_count(request, disk) > disk->segment_max) return -1;
+
+    virtio_blk_t* blk = &virtio_blk_devices[request->disk];
+    request->status = VIRTIO_BLK_REQUEST_PENDING;
+    request->error = 0;
+    request->next = NULL;
+
+    uint32_t flags = irq_save();
+    if (blk->tail) {
+        blk->tail->next = request;
+    } else {
+        blk->head = request;
+    }
+    blk->tail = request;
+    virtio_blk_start(request->disk);
+    irq_restore(flags);
+    return 0;
+}
+
+/* Wait until a submitted request completes */
+int virtio_blk_wait(virtio_blk_request_t* request) {
+    while (request->status == VIRTIO_BLK_REQUEST_PENDING) {
+        uint32_t flags = irq_save();
+        virtio_blk_poll(request->disk);
+        if (request->status == VIRTIO_BLK_REQUEST_PENDING && (flags & EFLAGS_IF)) {
+            cpu_wait_for_interrupt(virtio_blk_devices[request->disk].progress +
+                                   (uint64_t)VIRTIO_BLK_TIMEOUT_MS * tsc_khz());
+        }
+        irq_restore(flags);
+    }
+    return request->status;
+}
+
+/* Split a transfer into requests the disk takes and run them in turn */
+static int virtio_blk_transfer(uint32_t disk, uint64_t lba, uint32_t count, void* buffer, int write) {
+    if (disk >= virtio_blk_total) return -1;
+    uint32_t limit = virtio_blk_max_sectors(&virtio_blk_disks[disk]);
+    uint8_t* bytes = (uint8_t*)buffer;
+
+    while (count > 0) {
+        uint32_t chunk = count < limit ? count : limit;
+        virtio_blk_request_t request = { 0 };
+        request.disk = disk;
+        request.lba = lba;
+        request.count = chunk;
+        request.buffer = bytes;
+        request.write = write;
+        if (virtio_blk_submit(&request) != 0) return -1;
+        int status = virtio_blk_wait(&request);
+        if (status != VIRTIO_BLK_REQUEST_DONE) return status;
+
+        lba += chunk;
+        count -= chunk;
+        bytes += chunk * VIRTIO_BLK_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+int virtio_blk_read(uint32_t disk, uint64_t lba, uint32_t count, void* buffer) {
+    return virtio_blk_transfer(disk, lba, count, buffer, 0);
+}
+
+int virtio_blk_write(uint32_t disk, uint64_t lba, uint32_t count, const void* buffer) {
+    return virtio_blk_transfer(disk, lba, count, (void*)buffer, 1);
+}
+
+uint32_t virtio_blk_disk_count(void) {
+    return virtio_blk_total;
+}
+
+const virtio_blk_disk_t* virtio_blk_get_disk(uint32_t index) {
+    return index < virtio_blk_total ? &virtio_blk_disks[index] : NULL;
+}
+
+static void virtio_blk_block_done(virtio_blk_request_t* native) {
+    block_complete((block_request_t*)native->context, native->status != VIRTIO_BLK_REQUEST_DONE);
+}
+
+/* Turn a block request into a virtio request */
+static int virtio_blk_block_start(block_device_t* dev, block_request_t* request) {
+    uint32_t disk = (uint32_t)(dev - virtio_blk_block_devices);
+    virtio_blk_request_t* native = &virtio_blk_block_requests[disk][request->tag];
+    native->disk = disk;
+    native->lba = request->sector;
+    native->count = request->sectors;
+    native->buffer = NULL;
+    native->segments = request->segments;
+    native->segment_count = request->segment_count;
+    native->write = request->write;
+    native->done = virtio_blk_block_done;
+    native->context = request;
+    if (virtio_blk_submit(native) != 0) {
+        block_complete(request, -1);
+    }
+    return 0;
+}
+
+static void virtio_blk_block_poll(block_device_t* dev) {
+    virtio_blk_poll((uint32_t)(dev - virtio_blk_block_devices));
+}
+
+static const block_device_ops_t virtio_blk_block_ops = { virtio_blk_block_start, virtio_blk_block_poll };
+
+static int virtio_blk_probe(const pci_device_t* dev, const pci_device_id_t* id) {
+    (void)id;
+    if (virtio_blk_total == VIRTIO_BLK_MAX_DISKS) {
+        printf("virtio-blk: %02x:%02x.%x ignored, %u disks at most\n",
+               dev->bus, dev->device, dev->func, VIRTIO_BLK_MAX_DISKS);
+        return -1;
+    }
+
+    uint32_t index = virtio_blk_total;
+    virtio_blk_t* blk = &virtio_blk_devices[index];
+    virtio_device_t* vdev = &blk->device;
+    if (virtio_pci_init(vdev, dev) != 0) {
+        printf("virtio-blk: %02x:%02x.%x has no usable transport\n", dev->bus, dev->device, dev->func);
+        return -1;
+    }
+    if (virtio_negotiate(vdev, VIRTIO_F_INDIRECT_DESC | VIRTIO_F_EVENT_IDX |
+                               VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO) != 0) {
+        printf("virtio-blk: feature negotiation failed\n");
+        virtio_fail(vdev);
+        return -1;
+    }
+
+    virtio_blk_disk_t* disk = &virtio_blk_disks[index];
+    memset(disk, 0, sizeof(*disk));
+    virtio_config_read(vdev, VIRTIO_BLK_CONFIG_CAPACITY, &disk->sectors, sizeof(disk->sectors));
+    disk->segment_max = VIRTIO_BLK_SEGMENTS_MAX;
+    disk->segment_bytes = VIRTIO_BLK_MAX_SECTORS * VIRTIO_BLK_SECTOR_SIZE;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t seg_max;
+        virtio_config_read(vdev, VIRTIO_BLK_CONFIG_SEG_MAX, &seg_max, sizeof(seg_max));
+        if (seg_max && seg_max < disk->segment_max) disk->segment_max = seg_max;
+    }
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SIZE_MAX)) {
+        uint32_t size_max;
+        virtio_config_read(vdev, VIRTIO_BLK_CONFIG_SIZE_MAX, &size_max, sizeof(size_max));
+        /* Whole sectors, so a sector never straddles two buffers */
+        size_max &= ~(uint32_t)(VIRTIO_BLK_SECTOR_SIZE - 1);
+        if (size_max && size_max < disk->segment_bytes) disk->segment_bytes = size_max;
+    }
+    disk->read_only = virtio_has_feature(vdev, VIRTIO_BLK_F_RO);
+    disk->modern = (uint8_t)vdev->modern;
+    disk->indirect = virtio_has_feature(vdev, VIRTIO_F_INDIRECT_DESC);
+    disk->event_idx = virtio_has_feature(vdev, VIRTIO_F_EVENT_IDX);
+
+    /* One vector for the one queue; virtio functions have MSI-X but no MSI */
+    if (pci_irq_alloc(dev, 1, 1, PCI_IRQ_MSIX | PCI_IRQ_LEGACY) < 1 ||
+        virtio_queue_setup(vdev, 0, &blk->queue) != 0) {
+        printf("virtio-blk: queue setup failed\n");
+        pci_irq_free(dev);
+        virtio_fail(vdev);
+        return -1;
+    }
+    blk->head = NULL;
+    blk->tail = NULL;
+    blk->failed = 0;
+    disk->queue_size = blk->queue.size;
+
+    virtio_blk_total++;
+    pci_irq_set_handler(dev, 0, virtio_blk_interrupt);
+    virtio_driver_ok(vdev);
+
+    printf("virtio-blk: disk %u: %llu MiB%s, %s, queue %u%s%s, %s\n", index,
+           (unsigned long long)(disk->sectors / (1024 * 1024 / VIRTIO_BLK_SECTOR_SIZE)),
+           disk->read_only ? " read-only" : "", disk->modern ? "modern" : "legacy",
+           disk->queue_size, disk->indirect ? ", indirect" : "", disk->event_idx ? ", event-idx" : "",
+           pci_irq_type(dev) == PCI_IRQ_MSIX ? "MSI-X" : "INTx");
+
+    block_device_t* block = &virtio_blk_block_devices[index];
+    snprintf(block->name, sizeof(block->name), "vblk%u", index);
+    block->sectors = disk->sectors;
+    block->max_sectors = virtio_blk_max_sectors(disk);
+    /* Segments the device would split further are only safe one at a time */
+    block->max_segments = 1;
+    if (disk->segment_bytes >= block->max_sectors * VIRTIO_BLK_SECTOR_SIZE) {
+        block->max_segments = disk->segment_max < BLOCK_MAX_SEGMENTS ? disk->segment_max : BLOCK_MAX_SEGMENTS;
+    }
+    /* Requests beyond the ring's room wait in the disk's own queue */
+    block->queue_depth = BLOCK_QUEUE_REQUESTS;
+    block->ops = &virtio_blk_block_ops;
+    block_register(block);
+    return 0;
+}
+
+static const pci_device_id_t virtio_blk_ids[] = {
+    { PCI_DEVICE(VIRTIO_PCI_VENDOR, VIRTIO_PCI_LEGACY_ID(VIRTIO_ID_BLOCK)) },
+    { PCI_DEVICE(VIRTIO_PCI_VENDOR, VIRTIO_PCI_MODERN_ID(VIRTIO_ID_BLOCK)) },
+    { 0 }
+};
+PCI_DRIVER(virtio_blk) = { "virtio-blk", virtio_blk_ids, virtio_blk_probe, NULL, 0 };
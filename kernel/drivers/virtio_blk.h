@@ -0,0 +1,123 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../block.h"
+
+/* virtio block devices (QEMU -drive if=virtio, -device virtio-blk-pci)
+ *
+ * A request is a chain of three or more buffers on the device's single
+ * virtqueue: a header with the operation and sector, the data, and a
+ * status byte the device fills in. With indirect descriptors a request
+ * takes one ring entry, so as many requests as the ring has entries are
+ * in flight at once; further ones wait in a per-disk queue. Requests
+ * queued together are published with one notification, and with event
+ * indexes the device is only notified when it is not already working
+ * through the ring (see virtio.h).
+ *
+ * Completions arrive on MSI-X when the PCI layer can set it up (see
+ * pci_msi.h), INTx otherwise:
+ *
+ *   virtio_blk_request_t request = { .disk = 0, .lba = 0, .count = 8, .buffer = page };
+ *   if (virtio_blk_submit(&request) == 0 && virtio_blk_wait(&request) == VIRTIO_BLK_REQUEST_DONE) { ... }
+ *
+ * Buffers must be identity mapped (all kernel memory is); so must the
+ * request itself, which holds the header and status byte.
+ */
+
+#define VIRTIO_BLK_SECTOR_SIZE      512
+
+/* Limits */
+#define VIRTIO_BLK_MAX_DISKS        2
+#define VIRTIO_BLK_MAX_SECTORS      8192    /* Per request: 4 MiB */
+
+/* Time the ring may go without a completion before the disk is given up */
+#define VIRTIO_BLK_TIMEOUT_MS       5000
+
+/* Request status */
+#define VIRTIO_BLK_REQUEST_PENDING  1       /* Queued or in flight */
+#define VIRTIO_BLK_REQUEST_DONE     0
+#define VIRTIO_BLK_REQUEST_ERROR    -1      /* See error for the device's status */
+#define VIRTIO_BLK_REQUEST_TIMEOUT  -2
+
+/* Status byte the device returns */
+#define VIRTIO_BLK_S_OK             0
+#define VIRTIO_BLK_S_IOERR          1
+#define VIRTIO_BLK_S_UNSUPP         2
+
+/* One transfer; owned by the driver from virtio_blk_submit() until status leaves PENDING */
+typedef struct virtio_blk_request {
+    uint32_t disk;              /* Index for virtio_blk_get_disk() */
+    uint64_t lba;               /* First sector */
+    uint32_t count;             /* Sectors, 1 to VIRTIO_BLK_MAX_SECTORS */
+    void* buffer;               /* count * VIRTIO_BLK_SECTOR_SIZE bytes */
+    /* Scatter-gather list used instead of buffer when segment_count is set */
+    const block_segment_t* segments;
+    uint32_t segment_count;
+    int write;                  /* 1 to write the buffer to the disk */
+
+    volatile int status;        /* VIRTIO_BLK_REQUEST_* */
+    uint8_t error;              /* VIRTIO_BLK_S_* after a failure */
+
+    /* Called from the interrupt on completion (may be NULL) */
+    void (*done)(struct virtio_blk_request* request);
+    void* context;              /* For the callback */
+
+    struct virtio_blk_request* next;    /* Disk queue link */
+
+    /* Read by the device: operation and sector */
+    struct {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t sector;
+    } __attribute__((packed)) header;
+    uint8_t device_status;      /* Written by the device */
+} virtio_blk_request_t;
+
+/* A disk found during the probe */
+typedef struct {
+    uint64_t sectors;           /* Capacity */
+    uint32_t segment_max;       /* Data buffers per request */
+    uint32_t segment_bytes;     /* Largest data buffer */
+    uint16_t queue_size;        /* Ring entries */
+    uint8_t read_only;
+    uint8_t modern;             /* virtio 1.0 transport, else legacy */
+    uint8_t indirect;           /* Negotiated VIRTIO_F_INDIRECT_DESC */
+    uint8_t event_idx;          /* Negotiated VIRTIO_F_EVENT_IDX */
+} virtio_blk_disk_t;
+
+/* Queue a request on its disk
+ * Returns: 0 if queued, -1 if the request is invalid
+ */
+int virtio_blk_submit(virtio_blk_request_t* request);
+
+/* Wait until a submitted request completes
+ * Lets the completion interrupt in when interrupts are enabled and
+ * polls the queue otherwise, so it also works during boot. If the ring
+ * sees no completion for VIRTIO_BLK_TIMEOUT_MS, the device is reset and
+ * marked failed, everything submitted to it fails with
+ * VIRTIO_BLK_REQUEST_TIMEOUT and further submits are refused.
+ * Returns: the request's final status
+ */
+int virtio_blk_wait(virtio_blk_request_t* request);
+
+/* Read count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int virtio_blk_read(uint32_t disk, uint64_t lba, uint32_t count, void* buffer);
+
+/* Write count sectors starting at lba and wait for them
+ * Returns: 0 on success, negative on failure
+ */
+int virtio_blk_write(uint32_t disk, uint64_t lba, uint32_t count, const void* buffer);
+
+/* Get the number of disks found */
+uint32_t virtio_blk_disk_count(void);
+
+/* Get a disk by index
+ * Returns: the disk, or NULL if index is out of range
+ */
+const virtio_blk_disk_t* virtio_blk_get_disk(uint32_t index);
+
+#endif /* VIRTIO_BLK_H */
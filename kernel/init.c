@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "init.h"
+#include "arch/x86/tsc.h"
+
+/* Initcall table, gathered by the linker (see linker.ld) */
+extern const initcall_t __initcall_start[];
+extern const initcall_t __initcall_end[];
+
+/* Upper bound on registered initcalls */
+#define INITCALL_MAX 64
+
+typedef enum {
+    INITCALL_PENDING,
+    INITCALL_DONE,
+    INITCALL_FAILED
+} initcall_state_t;
+
+typedef struct {
+    const char* name;
+    uint64_t end;               /* TSC when the phase finished */
+} boot_phase_t;
+
+static uint64_t boot_start;
+static boot_phase_t boot_phases[BOOT_PHASE_MAX];
+static size_t boot_phase_count = 0;
+
+/* Take the boot start timestamp */
+void boot_timing_start(void) {
+    boot_start = tsc_read();
+}
+
+/* Mark the end of a boot phase */
+void boot_phase(const char* name) {
+    if (boot_phase_count < BOOT_PHASE_MAX) {
+        boot_phases[boot_phase_count].name = name;
+        boot_phases[boot_phase_count].end = tsc_read();
+        boot_phase_count++;
+    }
+}
+
+/* Find a registered initcall by name
+ * Returns: its index, or -1 if there is none */
+static int initcall_find(const char* name, size_t length) {
+    size_t count = __initcall_end - __initcall_start;
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(__initcall_start[i].name) == length &&
+            strncmp(__initcall_start[i].name, name, length) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Check an initcall's dependencies
+ * Returns: INITCALL_DONE if all ran, INITCALL_FAILED if one failed or
+ * does not exist, INITCALL_PENDING if some still have to run */
+static initcall_state_t initcall_ready(const initcall_t* call, const initcall_state_t* states) {
+    const char* depends = call->depends;
+    while (*depends) {
+        size_t length = strcspn(depends, ",");
+        int index = initcall_find(depends, length);
+        if (index < 0) {
+            printf("initcall %s: unknown dependency %.*s\n", call->name, (int)length, depends);
+            return INITCALL_FAILED;
+        }
+        if (states[index] != INITCALL_DONE) return states[index];
+        depends += length;
+        if (*depends == ',') depends++;
+    }
+    return INITCALL_DONE;
+}
+
+/* Run every initcall in dependency order */
+int initcalls_run(void) {
+    size_t count = __initcall_end - __initcall_start;
+    initcall_state_t states[INITCALL_MAX];
+    size_t remaining = count;
+    int failures = 0;
+
+    if (count > INITCALL_MAX) {
+        printf("initcalls: %u registered, only %u run\n", count, INITCALL_MAX);
+        count = remaining = INITCALL_MAX;
+    }
+    for (size_t i = 0; i < count; i++) states[i] = INITCALL_PENDING;
+
+    /* Each pass runs everything whose dependencies are met, in link order */
+    while (remaining > 0) {
+        size_t progress = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (states[i] != INITCALL_PENDING) continue;
+
+            const initcall_t* call = &__initcall_start[i];
+            initcall_state_t ready = initcall_ready(call, states);
+            if (ready == INITCALL_PENDING) continue;
+
+            if (ready == INITCALL_FAILED) {
+                printf("initcall %s: skipped, a dependency failed\n", call->name);
+                states[i] = INITCALL_FAILED;
+            } else if (call->call() != 0) {
+                printf("initcall %s: failed\n", call->name);
+                states[i] = INITCALL_FAILED;
+            } else {
+                states[i] = INITCALL_DONE;
+            }
+            if (states[i] == INITCALL_FAILED) failures++;
+            boot_phase(call->name);
+            remaining--;
+            progress++;
+        }
+
+        /* Nothing could run: the rest wait on each other */
+        if (progress == 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (states[i] == INITCALL_PENDING) {
+                    printf("initcall %s: dependency cycle\n", __initcall_start[i].name);
+                    failures++;
+                }
+            }
+            break;
+        }
+    }
+    return failures;
+}
+
+/* Print the time spent in each boot phase */
+void boot_report(void) {
+    uint64_t previous = boot_start;
+    uint64_t total = boot_phase_count ? boot_phases[boot_phase_count - 1].end - boot_start : 0;
+
+    /* QEMU starts the TSC at reset, so this is firmware plus boot loader */
+    printf("Boot time: %u us before kernel_main, %u us in it\n",
+           (uint32_t)tsc_to_us(boot_start), (uint32_t)tsc_to_us(total));
+    for (size_t i = 0; i < boot_phase_count; i++) {
+        uint64_t cycles = boot_phases[i].end - previous;
+        uint32_t permille = total ? (uint32_t)(cycles * 1000 / total) : 0;
+        printf("  %-12s %8u us %3u.%u%%\n", boot_phases[i].name,
+               (uint32_t)tsc_to_us(cycles), permille / 10, permille % 10);
+        previous = boot_phases[i].end;
+    }
+}
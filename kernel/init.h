@@ -0,0 +1,53 @@
+#ifndef INIT_H
+#define INIT_H
+
+#include <stdint.h>
+
+/* Boot timing and initcalls
+ *
+ * kernel_main() brings up the CPU, memory and console in a fixed order
+ * and marks the end of each step with boot_phase(). Everything after
+ * that is an initcall: a function registered next to the code it
+ * initializes, with the initcalls it needs run first.
+ *
+ *   static int keyboard_initcall(void) { ... return 0; }
+ *   INITCALL(keyboard, keyboard_initcall, "idt");
+ *
+ * initcalls_run() orders them by their dependencies, runs them and
+ * times each one as a boot phase; boot_report() prints the breakdown.
+ * Initcalls that do not depend on each other are free to be reordered,
+ * and later to run on other CPUs.
+ */
+
+/* A registered initcall */
+typedef struct {
+    const char* name;           /* Name other initcalls depend on */
+    int (*call)(void);          /* Returns 0 on success */
+    const char* depends;        /* Comma-separated names, "" for none */
+} initcall_t;
+
+/* Register fn as initcall name; depends lists initcalls that must run first */
+#define INITCALL(name, fn, depends)                                      \
+    static const initcall_t initcall_##name                              \
+        __attribute__((used, section(".initcall"), aligned(4))) =        \
+        { #name, fn, depends }
+
+/* Maximum number of recorded boot phases */
+#define BOOT_PHASE_MAX 32
+
+/* Take the boot start timestamp; call first thing in kernel_main() */
+void boot_timing_start(void);
+
+/* Mark the end of a boot phase; it started where the previous one ended */
+void boot_phase(const char* name);
+
+/* Run every initcall in dependency order, each timed as a boot phase
+ * An initcall whose dependency failed or does not exist is skipped.
+ * Returns: number of initcalls that failed or were skipped
+ */
+int initcalls_run(void);
+
+/* Print the time spent in each boot phase (needs a calibrated TSC) */
+void boot_report(void);
+
+#endif /* INIT_H */
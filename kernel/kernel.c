@@ -11,7 +11,20 @@
 
 #include "arch/x86/gdt.h"
 #include "arch/x86/paging.h"
+#include "arch/x86/tsc.h"
+#include "arch/x86/cpufeature.h"
+#include "arch/x86/memops.h"
+#include "arch/x86/fpu.h"
+#include "arch/x86/qemu.h"
 #include "drivers/pci.h"
+#include "drivers/pci_driver.h"
+#include "drivers/fbcon.h"
+#include "klog.h"
+#include "profile.h"
+#include "trace.h"
+#include "init.h"
+#include "page_cache.h"
+#include "bench/bench.h"
 
 /* Helper macro to check multiboot magic value */
 #define CHECK_MULTIBOOT_MAGIC(x) ((x) == MULTIBOOT_MAGIC)
@@ -34,20 +47,80 @@ void print_logo(void) {
     printf("\n");
 }
 
+/* Get the boot loader's command line, or NULL if it passed none */
+static const char* multiboot_cmdline(uint32_t magic, uint32_t addr) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || addr == 0) return NULL;
+    const multiboot_info_t* info = (const multiboot_info_t*)addr;
+    if (!(info->flags & MULTIBOOT_INFO_CMDLINE)) return NULL;
+    return (const char*)info->cmdline;
+}
+
+/* Get the end of the free RAM around start from the boot loader's memory
+ * map, or 0 if start is not free RAM or there is no map. Only available
+ * entries count, so firmware areas such as the ACPI tables are left out. */
+static uint32_t multiboot_memory_end(uint32_t magic, uint32_t addr, uint32_t start) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || addr == 0) return 0;
+    const multiboot_info_t* info = (const multiboot_info_t*)addr;
+    if (!(info->flags & MULTIBOOT_INFO_MEM_MAP)) return 0;
+
+    uint32_t offset = 0;
+    while (offset + sizeof(multiboot_mmap_entry_t) <= info->mmap_length) {
+        const multiboot_mmap_entry_t* entry = (const multiboot_mmap_entry_t*)(info->mmap_addr + offset);
+        uint64_t end = entry->addr + entry->len;
+        if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && entry->addr <= start && start < end) {
+            return end > 0xFFFFF000 ? 0xFFFFF000 : (uint32_t)end & ~0xFFFu;
+        }
+        offset += entry->size + sizeof(entry->size);
+    }
+    return 0;
+}
+
 /* The kernel main function */
 void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_addr) {
+    /* rdtsc works before calibration; cycles are converted for the report */
+    boot_timing_start();
+
     /* Initialize the GDT first! */
     gdt_init();
+    boot_phase("gdt");
 
     /* Initialize Paging */
     paging_init();
+    boot_phase("paging");
 
-    /* Mark multiboot_addr as unused */
-    (void)multiboot_addr;
+    /* Options passed with QEMU -append (the first 4 MiB are identity mapped) */
+    const char* cmdline = multiboot_cmdline(multiboot_magic, multiboot_addr);
     
     /* First thing: initialize terminal and serial for output */
     terminal_init();
     serial_init(NULL);
+    boot_phase("console");
+    
+    /* Calibrate the TSC so log timestamps can be decoded */
+    tsc_init();
+    klog_init();
+    boot_phase("tsc");
+    
+    /* Detect CPU features, set up x87/SSE and pick the memory functions to match */
+    cpu_features_init();
+    fpu_init();
+    memops_init();
+    boot_phase("cpu");
+    
+    /* Tracepoints named by trace=<events> (kernels built with TRACE=1) */
+    char trace_events[128];
+    int tracing = cmdline && cmdline_get(cmdline, "trace", trace_events, sizeof(trace_events));
+    if (tracing) {
+        trace_enable(trace_parse_events(trace_events));
+    }
+    
+#ifdef CONFIG_FBCON
+    /* Move the console onto the linear framebuffer if there is one */
+    if (fbcon_init() != FBCON_SUCCESS) {
+        printf("Framebuffer console unavailable, staying in text mode\n");
+    }
+    boot_phase("fbcon");
+#endif
     
     /* Display the VibeOS logo */
     print_logo();
@@ -58,29 +131,89 @@ void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_addr) {
     } else {
         printf("\033[32mMultiboot-compliant boot confirmed\033[0m\n");
     }
+    if (cmdline && *cmdline) {
+        printf("Command line: %s\n", cmdline);
+    }
     
     /* Basic output to both console and serial */
     printf("\033[32mKernel booted successfully\033[0m\n\n");
+    boot_phase("banner");
+    
+    /* Disk pages are cached in the free RAM from 64 MiB up (see page_cache.h) */
+    page_cache_init(PAGE_CACHE_BASE, multiboot_memory_end(multiboot_magic, multiboot_addr, PAGE_CACHE_BASE));
+    boot_phase("page cache");
     
-    /* Initialize the IDT */
-    idt_init();
+    /* Interrupts, keyboard, PCI scan: see the INITCALL()s next to each */
+    initcalls_run();
     
     /* Register a custom handler for the divide by zero exception */
     register_interrupt_handler(0, test_interrupt_handler);
     
-    /* Initialize the PS/2 keyboard */
-    keyboard_init();
-
-    /* Enumerate PCI devices */
-    pci_enumerate_bus();
-    
     /* Enable interrupts so keyboard can generate events */
     asm volatile ("sti");
     
+    boot_report();
+    
+#ifdef CONFIG_BENCH
+    /* Show the boot log first, the benchmarks overwrite the screen */
+    klog_drain();
+
+    /* Headless run (make bench): bench=<prefixes> runs the registered
+     * cases, reports them on COM1 and leaves QEMU */
+    char bench_filter[128];
+    if (cmdline && cmdline_get(cmdline, "bench", bench_filter, sizeof(bench_filter))) {
+        /* profile=<hz>[,stacks] samples the run and dumps it afterwards */
+        char profile_option[32];
+        int profiling = cmdline_get(cmdline, "profile", profile_option, sizeof(profile_option));
+        if (profiling) {
+            const char* comma = strchr(profile_option, ',');
+            profile_start(atoi(profile_option), comma && strcmp(comma + 1, "stacks") == 0);
+        }
+
+        /* Cases may use devices whose drivers probe asynchronously */
+        pci_probe_wait();
+        bench_run(bench_filter);
+
+        if (profiling) {
+            profile_stop();
+            profile_flush();
+        }
+        if (tracing) {
+            trace_dump();
+        }
+        qemu_exit(0);
+        printf("isa-debug-exit not present, continuing\n");
+    }
+
+    bench_vga_console();
+    bench_fbcon();
+    bench_memops();
+    bench_printf();
+    bench_strings();
+#endif
+    
     printf("\n\033[1;36mKeyboard ready! Start typing...\033[0m\n");
     
-    /* Main kernel loop - halt when idle but wake on interrupts */
+    /* From here on the idle loop feeds the console */
+    klog_defer_console();
+    
+    /* Main kernel loop - drain the kernel log, then halt until the next interrupt */
     while (1) {
-        asm volatile ("hlt");
+        klog_drain();
+        trace_poll();
+        
+        /* Asynchronous and deferred PCI probes, one per pass */
+        if (pci_probe_poll()) {
+            continue;
+        }
+        
+        /* Only halt if no interrupt queued more output since the drain.
+         * sti takes effect after the next instruction, so no wakeup is lost. */
+        asm volatile ("cli");
+        if (klog_pending()) {
+            asm volatile ("sti");
+            continue;
+        }
+        asm volatile ("sti; hlt");
     }
 } 
\ No newline at end of file
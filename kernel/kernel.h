@@ -7,6 +7,40 @@
 /* Multiboot header magic values */
 #define MULTIBOOT_MAGIC 0x1BADB002
 
+/* Value a multiboot loader passes in EAX */
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+/* multiboot_info_t flag: the cmdline field is valid */
+#define MULTIBOOT_INFO_CMDLINE (1 << 2)
+
+/* multiboot_info_t flag: the mmap_length and mmap_addr fields are valid */
+#define MULTIBOOT_INFO_MEM_MAP (1 << 6)
+
+/* Memory map entry type: RAM free for the OS (others are reserved, ACPI, ...) */
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+/* Leading fields of the multiboot information structure */
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;      /* KiB of RAM from 1 MiB up to the first hole */
+    uint32_t boot_device;
+    uint32_t cmdline;        /* Physical address of a NUL-terminated string */
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;    /* Bytes of memory map entries at mmap_addr */
+    uint32_t mmap_addr;
+} multiboot_info_t;
+
+/* A memory map entry; size does not count itself */
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;           /* MULTIBOOT_MEMORY_* */
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
 /* Kernel entry point - called from boot.S */
 void kernel_main(uint32_t multiboot_magic, uint32_t multiboot_addr);
 
@@ -0,0 +1,221 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "klog.h"
+#include "arch/x86/tsc.h"
+#include "drivers/vga.h"
+#include "drivers/serial.h"
+
+/* Mask for turning a sequence number into a slot index */
+#define KLOG_RECORD_MASK (KLOG_RECORD_COUNT - 1)
+
+/* Only the boot processor runs kernel code for now */
+#define KLOG_CURRENT_CPU() 0
+
+/* The ring lives in its own page-aligned .bss subsection (see linker.ld) */
+klog_ring_t klog_ring __attribute__((section(".bss.klog"), aligned(4096)));
+
+/* Set once the idle loop drains the ring; before that writes drain it themselves */
+static volatile int console_deferred = 0;
+
+static void klog_flush_records(int panic);
+
+/* Most verbose level echoed to the console */
+static int console_level = KLOG_INFO;
+
+/* Names printed by klog_dump() */
+static const char* const level_names[8] = {
+    "emerg", "alert", "crit", "err", "warn", "notice", "info", "debug"
+};
+
+/* Initialize the ring header */
+void klog_init(void) {
+    memcpy(klog_ring.magic, KLOG_MAGIC, sizeof(klog_ring.magic));
+    klog_ring.record_size = sizeof(klog_record_t);
+    klog_ring.record_count = KLOG_RECORD_COUNT;
+    klog_ring.tsc_khz = tsc_khz();
+
+    printf("Kernel log ring at %p (%u bytes), TSC %u kHz\n",
+           &klog_ring, sizeof(klog_ring), klog_ring.tsc_khz);
+}
+
+/* Copy a message into the ring */
+size_t klog_write(int level, const char* message, size_t length) {
+    /* Reserve a sequence number; this is the only shared write */
+    uint32_t seq = __atomic_fetch_add(&klog_ring.head, 1, __ATOMIC_RELAXED);
+    klog_record_t* record = &klog_ring.records[seq & KLOG_RECORD_MASK];
+
+    /* Mark the slot as busy before touching its contents */
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (length > KLOG_MESSAGE_MAX) length = KLOG_MESSAGE_MAX;
+    record->cpu = KLOG_CURRENT_CPU();
+    record->level = (uint8_t)level;
+    record->length = (uint16_t)length;
+    record->timestamp = tsc_read();
+    memcpy(record->message, message, length);
+
+    /* Publish the record */
+    __atomic_store_n(&record->seq, seq + 1, __ATOMIC_RELEASE);
+
+    if (!console_deferred) {
+        klog_flush_records(0);
+    }
+    return length;
+}
+
+/* Format a message with va_list args and copy it into the ring */
+int klog_vprintf(int level, const char* format, va_list args) {
+    char buffer[KLOG_MESSAGE_MAX];
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    return (int)klog_write(level, buffer, strlen(buffer));
+}
+
+/* Format a message and copy it into the ring */
+int klog_printf(int level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = klog_vprintf(level, format, args);
+    va_end(args);
+    return result;
+}
+
+/* Check if records are waiting to be written to the console */
+int klog_pending(void) {
+    return __atomic_load_n(&klog_ring.tail, __ATOMIC_RELAXED) !=
+           __atomic_load_n(&klog_ring.head, __ATOMIC_RELAXED);
+}
+
+/* Write a string straight to the console devices */
+static void console_write(const char* str) {
+    terminal_write(str);
+    serial_write_string(str);
+}
+
+/* Copy the record for sequence number seq out of the ring
+ * Returns: 1 on success, 0 if the writer hasn't finished it yet,
+ *          -1 if it was already overwritten by a newer record
+ */
+static int klog_read_record(uint32_t seq, klog_record_t* out) {
+    klog_record_t* record = &klog_ring.records[seq & KLOG_RECORD_MASK];
+
+    uint32_t before = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+    if (before != seq + 1) {
+        /* Either still being written, or lapped by a newer record */
+        if (before == 0 || (int32_t)(before - (seq + 1)) < 0) return 0;
+        return -1;
+    }
+
+    out->cpu = record->cpu;
+    out->level = record->level;
+    out->length = record->length;
+    out->timestamp = record->timestamp;
+    memcpy(out->message, record->message, out->length);
+
+    /* If a writer reused the slot while we were copying, discard the copy */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&record->seq, __ATOMIC_RELAXED) != before) return -1;
+
+    out->seq = before;
+    return 1;
+}
+
+/* Shared implementation of klog_drain() and klog_panic_flush() */
+static void klog_flush_records(int panic) {
+    klog_record_t record;
+    char text[KLOG_MESSAGE_MAX + 1];
+
+    for (;;) {
+        uint32_t tail = __atomic_load_n(&klog_ring.tail, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&klog_ring.head, __ATOMIC_ACQUIRE);
+        if (tail == head) break;
+
+        /* Writers lapped the console: skip to the oldest record still present */
+        if (head - tail > KLOG_RECORD_COUNT) {
+            uint32_t oldest = head - KLOG_RECORD_COUNT;
+            if (__atomic_compare_exchange_n(&klog_ring.tail, &tail, oldest, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add(&klog_ring.dropped, oldest - tail, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+
+        int status = klog_read_record(tail, &record);
+        if (status == 0 && !panic) break;  /* Writer still busy, try again later */
+
+        /* Claim the record so that no other drainer prints it too */
+        if (!__atomic_compare_exchange_n(&klog_ring.tail, &tail, tail + 1, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        if (status < 0) {
+            __atomic_fetch_add(&klog_ring.dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (status == 0 || record.level > console_level) continue;
+
+        memcpy(text, record.message, record.length);
+        text[record.length] = '\0';
+        console_write(text);
+    }
+}
+
+/* Write pending records to the VGA console and serial port */
+void klog_drain(void) {
+    klog_flush_records(0);
+}
+
+/* Stop draining on every write and leave the console to klog_drain() */
+void klog_defer_console(void) {
+    klog_flush_records(0);
+    console_deferred = 1;
+}
+
+/* Synchronously flush pending records from a crash path */
+void klog_panic_flush(void) {
+    klog_flush_records(1);
+}
+
+/* Print the whole ring with timestamps, CPU and level (dmesg) */
+void klog_dump(void) {
+    klog_record_t record;
+    char line[KLOG_MESSAGE_MAX + 48];
+
+    uint32_t head = __atomic_load_n(&klog_ring.head, __ATOMIC_ACQUIRE);
+    uint32_t first = head > KLOG_RECORD_COUNT ? head - KLOG_RECORD_COUNT : 0;
+
+    for (uint32_t seq = first; seq != head; seq++) {
+        if (klog_read_record(seq, &record) != 1) continue;
+
+        uint64_t us = tsc_to_us(record.timestamp);
+        uint32_t seconds = (uint32_t)(us / 1000000);
+        uint32_t micros = (uint32_t)(us % 1000000);
+
+        /* Strip the trailing newline; the prefix adds one per record */
+        size_t length = record.length;
+        if (length == KLOG_MESSAGE_MAX) length--;
+        if (length > 0 && record.message[length - 1] == '\n') length--;
+        record.message[length] = '\0';
+
+        snprintf(line, sizeof(line), "[%5u.%06u] cpu%u %-6s %s\n",
+                 seconds, micros, record.cpu,
+                 level_names[record.level & 7], record.message);
+        console_write(line);
+    }
+
+    if (klog_ring.dropped) {
+        snprintf(line, sizeof(line), "klog: %u records dropped before reaching the console\n",
+                 klog_ring.dropped);
+        console_write(line);
+    }
+}
+
+/* Set the most verbose level that is echoed to the console */
+void klog_set_console_level(int level) {
+    console_level = level;
+}
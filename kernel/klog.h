@@ -0,0 +1,119 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+/* Kernel log ring buffer (dmesg)
+ *
+ * printf() and friends no longer talk to the VGA console and the UART
+ * directly. Writers format their message and copy it into a fixed-size,
+ * lock-free ring; nothing else happens on the hot path. The console is
+ * fed later by klog_drain(), which the kernel calls from its idle loop.
+ * Until that loop starts (klog_defer_console()), every write also
+ * drains the ring on the spot, so a boot that hangs early still shows
+ * everything logged before the hang.
+ *
+ * The ring lives in its own page-aligned section so it can be inspected
+ * after a crash: find it with `nm build/kernel.bin | grep klog_ring` and
+ * dump it from the QEMU monitor with `pmemsave <addr> <size> klog.bin`.
+ * Memory is identity mapped, so the symbol address is the physical one.
+ */
+
+/* Log levels (same meaning as the Unix syslog levels) */
+#define KLOG_EMERG    0  /* System is unusable */
+#define KLOG_ALERT    1  /* Action must be taken immediately */
+#define KLOG_CRIT     2  /* Critical conditions */
+#define KLOG_ERR      3  /* Error conditions */
+#define KLOG_WARNING  4  /* Warning conditions */
+#define KLOG_NOTICE   5  /* Normal but significant condition */
+#define KLOG_INFO     6  /* Informational (printf default) */
+#define KLOG_DEBUG    7  /* Debug-level messages */
+
+/* Ring geometry (record count must be a power of two) */
+#define KLOG_RECORD_COUNT  512
+#define KLOG_MESSAGE_MAX   256
+
+/* Magic value at the start of the ring, for finding it in memory dumps */
+#define KLOG_MAGIC "VIBEKLOG"
+
+/* A single log record
+ * seq is written last: it holds (sequence number + 1) once the record is
+ * complete, and 0 while a writer is filling the slot in.
+ */
+typedef struct {
+    volatile uint32_t seq;      /* Commit marker, see above */
+    uint8_t  cpu;               /* CPU that wrote the record */
+    uint8_t  level;             /* KLOG_* level */
+    uint16_t length;            /* Message length in bytes (no terminator) */
+    uint64_t timestamp;         /* TSC value when the record was reserved */
+    char     message[KLOG_MESSAGE_MAX];
+} klog_record_t;
+
+/* The ring itself */
+typedef struct {
+    char     magic[8];          /* KLOG_MAGIC (not null terminated) */
+    uint32_t record_size;       /* sizeof(klog_record_t) */
+    uint32_t record_count;      /* KLOG_RECORD_COUNT */
+    uint32_t tsc_khz;           /* TSC frequency for decoding timestamps */
+    volatile uint32_t head;     /* Next sequence number to hand out */
+    volatile uint32_t tail;     /* Next sequence number for the console */
+    volatile uint32_t dropped;  /* Records overwritten before reaching the console */
+    klog_record_t records[KLOG_RECORD_COUNT];
+} klog_ring_t;
+
+/* Initialize the ring header
+ * Logging works before this is called; this only fills in the
+ * metadata used to decode a memory dump. Call after tsc_init().
+ */
+void klog_init(void);
+
+/* Copy a message into the ring
+ * Safe to call from any context, including interrupt handlers.
+ * Messages longer than KLOG_MESSAGE_MAX are truncated.
+ * Returns: number of bytes stored
+ */
+size_t klog_write(int level, const char* message, size_t length);
+
+/* Format a message and copy it into the ring
+ * Returns: number of characters stored
+ */
+int klog_printf(int level, const char* format, ...);
+
+/* Format a message with va_list args and copy it into the ring
+ * Returns: number of characters stored
+ */
+int klog_vprintf(int level, const char* format, va_list args);
+
+/* Check if records are waiting to be written to the console
+ * Returns: 1 if the console is behind, 0 otherwise
+ */
+int klog_pending(void);
+
+/* Write pending records to the VGA console and serial port
+ * Runs the slow device output; call from a deferred context
+ * such as the idle loop, never from an interrupt handler.
+ */
+void klog_drain(void);
+
+/* Stop draining on every write and leave the console to klog_drain()
+ * Call once the idle loop that drains the ring is about to start.
+ */
+void klog_defer_console(void);
+
+/* Synchronously flush pending records from a crash path
+ * Unlike klog_drain(), records left half-written by an interrupted
+ * writer are skipped instead of waited for.
+ */
+void klog_panic_flush(void);
+
+/* Print the whole ring with timestamps, CPU and level (dmesg) */
+void klog_dump(void);
+
+/* Set the most verbose level that is echoed to the console
+ * Records above this level are kept in the ring only.
+ */
+void klog_set_console_level(int level);
+
+#endif /* KLOG_H */
@@ -0,0 +1,41 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "ksyms.h"
+
+/* Generated by tools/gen_ksyms.sh: the symbol count, then the
+ * addresses (sorted), then offsets into the names that follow */
+extern const uint32_t ksym_table[];
+
+/* End of the last function (see linker.ld) */
+extern const char __text_end[];
+
+/* Find the function containing addr by binary search */
+const char* ksym_lookup(uint32_t addr, uint32_t* start) {
+    uint32_t count = ksym_table[0];
+    const uint32_t* addresses = ksym_table + 1;
+    const uint32_t* name_offsets = addresses + count;
+    const char* names = (const char*)(name_offsets + count);
+
+    if (count == 0 || addr < addresses[0] || addr >= (uint32_t)__text_end) {
+        return NULL;
+    }
+
+    /* Last symbol at or below addr */
+    uint32_t low = 0, high = count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (addresses[mid] <= addr) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (start) *start = addresses[low];
+    return names + name_offsets[low];
+}
+
+/* Number of symbols in the table */
+uint32_t ksym_count(void) {
+    return ksym_table[0];
+}
@@ -0,0 +1,23 @@
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include <stdint.h>
+
+/* Kernel symbol table
+ *
+ * The build links the kernel once, lists its text symbols with nm and
+ * links again with the list as a table (tools/gen_ksyms.sh). The table
+ * is the last section of the image, so every other address is the same
+ * in both links and the final image describes itself.
+ */
+
+/* Find the function containing addr
+ * If start is not NULL it receives the address the function begins at.
+ * Returns: the function name, or NULL if addr is outside the table
+ */
+const char* ksym_lookup(uint32_t addr, uint32_t* start);
+
+/* Number of symbols in the table (0 in the first link) */
+uint32_t ksym_count(void);
+
+#endif /* KSYMS_H */
@@ -0,0 +1,688 @@
+#include "page_cache.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "arch/x86/paging.h"
+
+/* An ARC list, most recently used at the head */
+typedef struct {
+    page_t* head;
+    page_t* tail;
+    uint32_t count;
+} page_list_t;
+
+/* Lists indexed by page state; PAGE_FREE's stays empty */
+static page_list_t page_lists[PAGE_B2 + 1];
+
+static uint32_t page_cache_pages = 0;   /* Capacity c: frames in the pool */
+static uint32_t page_cache_target = 0;  /* ARC's p: wanted size of T1 */
+static uint32_t page_cache_dirty = 0;
+
+/* Pools carved out of the cache's memory: 2c descriptors (resident
+ * pages and ghosts), c tree nodes and c frames */
+static page_t* page_free_list = NULL;
+static page_tree_node_t* node_free_list = NULL;
+static uint32_t node_free_count = 0;
+static uint8_t* frame_free_list = NULL;    /* Linked through each frame's first word */
+
+static page_mapping_t* page_mappings[PAGE_CACHE_MAX_MAPPINGS];
+static uint32_t page_mapping_count = 0;
+static page_mapping_t page_device_mappings[BLOCK_MAX_DEVICES];
+static uint32_t page_device_mapping_count = 0;
+
+static page_cache_stats_t page_cache_stats;
+
+/* Writeback batch, kept static: bios live until block_wait() returns */
+static page_t* writeback_pages[PAGE_CACHE_WRITEBACK_BATCH];
+static bio_t writeback_bios[PAGE_CACHE_WRITEBACK_BATCH];
+static block_segment_t writeback_segments[PAGE_CACHE_WRITEBACK_BATCH];
+
+static uint32_t ctz64(uint64_t value) {
+    uint32_t low = (uint32_t)value;
+    return low ? (uint32_t)__builtin_ctz(low) : 32 + (uint32_t)__builtin_ctz((uint32_t)(value >> 32));
+}
+
+/* Take the free RAM from start to end for the cache */
+int page_cache_init(uint32_t start, uint32_t end) {
+    uint32_t bytes = end > start ? end - start : 0;
+    if (bytes > PAGE_CACHE_MAX_BYTES) bytes = PAGE_CACHE_MAX_BYTES;
+
+    /* Each frame brings two descriptors and a node; leave a page for aligning the frames */
+    uint32_t per_page = PAGE_CACHE_PAGE_SIZE + 2 * sizeof(page_t) + sizeof(page_tree_node_t);
+    uint32_t pages = bytes > PAGE_CACHE_PAGE_SIZE ? (bytes - PAGE_CACHE_PAGE_SIZE) / per_page : 0;
+    if (pages < PAGE_CACHE_MIN_PAGES) {
+        printf("Page cache: off, %u MiB of free RAM at 0x%08x\n", bytes / (1024 * 1024), start);
+        return -1;
+    }
+    if (paging_map_region(start, bytes, 0) != 0) {
+        printf("Page cache: off, 0x%08x is mapped already\n", start);
+        return -1;
+    }
+
+    page_t* descriptors = (page_t*)start;
+    page_tree_node_t* nodes = (page_tree_node_t*)(descriptors + 2 * pages);
+    uint32_t frames = ((uint32_t)(nodes + pages) + PAGE_CACHE_PAGE_SIZE - 1) & ~(PAGE_CACHE_PAGE_SIZE - 1);
+
+    memset(descriptors, 0, 2 * pages * sizeof(page_t));
+    for (uint32_t i = 2 * pages; i-- > 0;) {
+        descriptors[i].next = page_free_list;
+        page_free_list = &descriptors[i];
+    }
+    for (uint32_t i = pages; i-- > 0;) {
+        nodes[i].parent = node_free_list;
+        node_free_list = &nodes[i];
+    }
+    node_free_count = pages;
+    for (uint32_t i = pages; i-- > 0;) {
+        uint8_t* frame = (uint8_t*)(frames + i * PAGE_CACHE_PAGE_SIZE);
+        *(uint8_t**)frame = frame_free_list;
+        frame_free_list = frame;
+    }
+
+    page_cache_pages = pages;
+    printf("Page cache: %u pages (%u MiB) at 0x%08x, ARC replacement\n", pages,
+           pages / (1024 * 1024 / PAGE_CACHE_PAGE_SIZE), frames);
+    return 0;
+}
+
+uint32_t page_cache_capacity(void) {
+    return page_cache_pages;
+}
+
+/* Set up a mapping for pages laid out on a device by map */
+int page_mapping_init(page_mapping_t* mapping, block_device_t* device, uint64_t size,
+                      int (*map)(page_mapping_t*, uint64_t, uint64_t*), void* private_data) {
+    if (page_mapping_count == PAGE_CACHE_MAX_MAPPINGS) return -1;
+    memset(mapping, 0, sizeof(*mapping));
+    mapping->device = device;
+    mapping->size = size;
+    mapping->map = map;
+    mapping->private_data = private_data;
+    page_mappings[page_mapping_count++] = mapping;
+    return 0;
+}
+
+/* Get the mapping of a whole block device */
+page_mapping_t* page_cache_device(block_device_t* dev) {
+    if (!dev) return NULL;
+    for (uint32_t i = 0; i < page_device_mapping_count; i++) {
+        if (page_device_mappings[i].device == dev) return &page_device_mappings[i];
+    }
+    if (page_device_mapping_count == BLOCK_MAX_DEVICES) return NULL;
+
+    page_mapping_t* mapping = &page_device_mappings[page_device_mapping_count];
+    if (page_mapping_init(mapping, dev, dev->sectors * BLOCK_SECTOR_SIZE, NULL, NULL) != 0) return NULL;
+    page_device_mapping_count++;
+    return mapping;
+}
+
+/* ARC lists */
+
+static void list_unlink(page_t* page) {
+    page_list_t* list = &page_lists[page->state];
+    if (page->prev) page->prev->next = page->next; else list->head = page->next;
+    if (page->next) page->next->prev = page->prev; else list->tail = page->prev;
+    page->prev = NULL;
+    page->next = NULL;
+    list->count--;
+}
+
+/* Move a page to the head of the list for state */
+static void list_move(page_t* page, uint8_t state) {
+    if (page->state != PAGE_FREE) list_unlink(page);
+    page_list_t* list = &page_lists[state];
+    page->state = state;
+    page->prev = NULL;
+    page->next = list->head;
+    if (list->head) list->head->prev = page; else list->tail = page;
+    list->head = page;
+    list->count++;
+}
+
+/* Radix tree */
+
+static page_tree_node_t* node_alloc(void) {
+    page_tree_node_t* node = node_free_list;
+    node_free_list = node->parent;
+    node_free_count--;
+    memset(node, 0, sizeof(*node));
+    return node;
+}
+
+static void node_free(page_tree_node_t* node) {
+    node->parent = node_free_list;
+    node_free_list = node;
+    node_free_count++;
+}
+
+/* Shift of the smallest root that covers index */
+static uint8_t tree_shift_for(uint64_t index) {
+    uint8_t shift = 0;
+    while (index >> (shift + PAGE_TREE_BITS)) shift += PAGE_TREE_BITS;
+    return shift;
+}
+
+static page_t* tree_lookup(const page_mapping_t* mapping, uint64_t index) {
+    const page_tree_node_t* node = mapping->root;
+    if (!node || (index >> (node->shift + PAGE_TREE_BITS))) return NULL;
+    while (node->shift) {
+        node = node->slots[(index >> node->shift) & (PAGE_TREE_SLOTS - 1)];
+        if (!node) return NULL;
+    }
+    return node->slots[index & (PAGE_TREE_SLOTS - 1)];
+}
+
+/* Nodes tree_insert() would allocate for index */
+static uint32_t tree_nodes_needed(const page_mapping_t* mapping, uint64_t index) {
+    const page_tree_node_t* node = mapping->root;
+    if (!node) return tree_shift_for(index) / PAGE_TREE_BITS + 1;
+
+    /* Above the root: the new roots, then a fresh path from below the top */
+    uint8_t shift = tree_shift_for(index);
+    if (shift > node->shift) return (shift - node->shift) / PAGE_TREE_BITS + shift / PAGE_TREE_BITS;
+
+    while (node->shift) {
+        const page_tree_node_t* child = node->slots[(index >> node->shift) & (PAGE_TREE_SLOTS - 1)];
+        if (!child) return node->shift / PAGE_TREE_BITS;
+        node = child;
+    }
+    return 0;
+}
+
+/* Mark slot offset of node dirty, and its ancestors' slots leading to it */
+static void tree_tag_set(page_tree_node_t* node, uint32_t offset) {
+    while (node) {
+        uint64_t was = node->dirty;
+        node->dirty |= 1ull << offset;
+        if (was) return;
+        offset = node->offset;
+        node = node->parent;
+    }
+}
+
+static void tree_tag_clear(page_tree_node_t* node, uint32_t offset) {
+    while (node) {
+        node->dirty &= ~(1ull << offset);
+        if (node->dirty) return;
+        offset = node->offset;
+        node = node->parent;
+    }
+}
+
+/* Add a page; tree_nodes_needed() nodes must be free */
+static void tree_insert(page_mapping_t* mapping, page_t* page) {
+    uint64_t index = page->index;
+    if (!mapping->root) {
+        mapping->root = node_alloc();
+        mapping->root->shift = tree_shift_for(index);
+    }
+    while (index >> (mapping->root->shift + PAGE_TREE_BITS)) {
+        page_tree_node_t* root = node_alloc();
+        root->shift = mapping->root->shift + PAGE_TREE_BITS;
+        root->slots[0] = mapping->root;
+        root->count = 1;
+        root->dirty = mapping->root->dirty ? 1 : 0;
+        mapping->root->parent = root;
+        mapping->root->offset = 0;
+        mapping->root = root;
+    }
+
+    page_tree_node_t* node = mapping->root;
+    while (node->shift) {
+        uint32_t offset = (index >> node->shift) & (PAGE_TREE_SLOTS - 1);
+        page_tree_node_t* child = node->slots[offset];
+        if (!child) {
+            child = node_alloc();
+            child->shift = node->shift - PAGE_TREE_BITS;
+            child->parent = node;
+            child->offset = offset;
+            node->slots[offset] = child;
+            node->count++;
+        }
+        node = child;
+    }
+    node->slots[index & (PAGE_TREE_SLOTS - 1)] = page;
+    node->count++;
+    page->node = node;
+}
+
+/* Remove a page, freeing the nodes it leaves empty */
+static void tree_remove(page_mapping_t* mapping, page_t* page) {
+    page_tree_node_t* node = page->node;
+    uint32_t offset = page->index & (PAGE_TREE_SLOTS - 1);
+    tree_tag_clear(node, offset);
+    node->slots[offset] = NULL;
+    node->count--;
+    page->node = NULL;
+
+    while (node->count == 0) {
+        page_tree_node_t* parent = node->parent;
+        if (!parent) {
+            mapping->root = NULL;
+            node_free(node);
+            return;
+        }
+        parent->slots[node->offset] = NULL;
+        parent->count--;
+        node_free(node);
+        node = parent;
+    }
+}
+
+/* First dirty page at or after start below node, which covers indexes from base */
+static page_t* tree_next_dirty(page_tree_node_t* node, uint64_t base, uint64_t start) {
+    uint32_t first = 0;
+    if (start > base) {
+        uint64_t slot = (start - base) >> node->shift;
+        if (slot >= PAGE_TREE_SLOTS) return NULL;
+        first = (uint32_t)slot;
+    }
+
+    uint64_t slots = node->dirty & (~0ull << first);
+    while (slots) {
+        uint32_t offset = ctz64(slots);
+        if (node->shift == 0) return node->slots[offset];
+        page_t* page = tree_next_dirty(node->slots[offset], base + ((uint64_t)offset << node->shift), start);
+        if (page) return page;
+        slots &= slots - 1;
+    }
+    return NULL;
+}
+
+/* Pages */
+
+/* Sectors behind a page: where they start and how many (the last page
+ * of a mapping may be short)
+ * Returns: 0 on success, -1 if the page has no sectors */
+static int page_sectors(page_t* page, uint64_t* sector, uint32_t* count) {
+    page_mapping_t* mapping = page->mapping;
+    if (mapping->map) {
+        if (mapping->map(mapping, page->index, sector) != 0) return -1;
+    } else {
+        *sector = mapping->first_sector + page->index * PAGE_CACHE_PAGE_SECTORS;
+    }
+    uint64_t left = mapping->size - page->index * PAGE_CACHE_PAGE_SIZE;
+    uint32_t bytes = left < PAGE_CACHE_PAGE_SIZE ? (uint32_t)left : PAGE_CACHE_PAGE_SIZE;
+    *count = (bytes + BLOCK_SECTOR_SIZE - 1) / BLOCK_SECTOR_SIZE;
+    return 0;
+}
+
+static void page_clear_dirty(page_t* page) {
+    if (!(page->flags & PAGE_DIRTY)) return;
+    page->flags &= ~PAGE_DIRTY;
+    tree_tag_clear(page->node, page->index & (PAGE_TREE_SLOTS - 1));
+    page->mapping->dirty--;
+    page_cache_dirty--;
+}
+
+/* Note that a held page's data was changed */
+void page_cache_mark_dirty(page_t* page) {
+    if (page->flags & PAGE_DIRTY) return;
+    page->flags |= PAGE_DIRTY;
+    tree_tag_set(page->node, page->index & (PAGE_TREE_SLOTS - 1));
+    page->mapping->dirty++;
+    page_cache_dirty++;
+}
+
+/* Give a resident page's frame back */
+static void page_free_frame(page_t* page) {
+    *(uint8_t**)page->data = frame_free_list;
+    frame_free_list = page->data;
+    page->data = NULL;
+    page->flags &= ~PAGE_UPTODATE;
+    page->mapping->pages--;
+}
+
+/* Forget a page or ghost entirely (a dirty page's changes are lost); also
+ * takes back a new page that failed to get a frame and is on no list yet */
+static void page_drop(page_t* page) {
+    page_clear_dirty(page);
+    if (page->data) page_free_frame(page);
+    tree_remove(page->mapping, page);
+    if (page->state != PAGE_FREE) list_unlink(page);
+    page->state = PAGE_FREE;
+    page->mapping = NULL;
+    page->next = page_free_list;
+    page_free_list = page;
+}
+
+/* Read or write a page's sectors and wait
+ * Returns: 0 on success, -1 on failure */
+static int page_io(page_t* page, int write) {
+    uint64_t sector;
+    uint32_t count;
+    if (page_sectors(page, &sector, &count) != 0) return -1;
+    if (!write && count < PAGE_CACHE_PAGE_SECTORS) {
+        memset(page->data + count * BLOCK_SECTOR_SIZE, 0, PAGE_CACHE_PAGE_SIZE - count * BLOCK_SECTOR_SIZE);
+    }
+
+    block_segment_t segment = { page->data, count * BLOCK_SECTOR_SIZE };
+    bio_t bio;
+    memset(&bio, 0, sizeof(bio));
+    bio.device = page->mapping->device;
+    bio.sector = sector;
+    bio.segments = &segment;
+    bio.segment_count = 1;
+    bio.write = write;
+    if (block_submit(&bio) != 0) return -1;
+    return block_wait(&bio) == BIO_DONE ? 0 : -1;
+}
+
+/* Write back up to a batch of a mapping's dirty pages from *start on, in
+ * index order under one plug so adjacent ones merge; *start moves past them
+ * Returns: pages in the batch (0 when there are no more), *failed set on an error */
+static uint32_t writeback_batch(page_mapping_t* mapping, uint64_t* start, int* failed) {
+    uint32_t count = 0;
+    while (count < PAGE_CACHE_WRITEBACK_BATCH && mapping->root) {
+        page_t* page = tree_next_dirty(mapping->root, 0, *start);
+        if (!page) break;
+        writeback_pages[count++] = page;
+        *start = page->index + 1;
+    }
+    if (count == 0) return 0;
+
+    block_device_t* dev = mapping->device;
+    block_plug(dev);
+    for (uint32_t i = 0; i < count; i++) {
+        page_t* page = writeback_pages[i];
+        bio_t* bio = &writeback_bios[i];
+        page->holds++;
+        page_clear_dirty(page);
+        bio->status = BIO_ERROR;
+
+        uint64_t sector;
+        uint32_t sectors;
+        if (page_sectors(page, &sector, &sectors) != 0) continue;
+        writeback_segments[i].addr = page->data;
+        writeback_segments[i].len = sectors * BLOCK_SECTOR_SIZE;
+        bio->device = dev;
+        bio->sector = sector;
+        bio->segments = &writeback_segments[i];
+        bio->segment_count = 1;
+        bio->write = 1;
+        bio->done = NULL;
+        if (block_submit(bio) != 0) bio->status = BIO_ERROR;
+    }
+    block_unplug(dev);
+
+    for (uint32_t i = 0; i < count; i++) {
+        page_t* page = writeback_pages[i];
+        if (writeback_bios[i].status == BIO_PENDING) block_wait(&writeback_bios[i]);
+        if (writeback_bios[i].status == BIO_DONE) {
+            page_cache_stats.written++;
+        } else {
+            page_cache_mark_dirty(page);
+            page_cache_stats.errors++;
+            *failed = 1;
+        }
+        page->holds--;
+    }
+    page_cache_stats.writebacks++;
+    return count;
+}
+
+/* Write back the dirty pages of a mapping, or of all mappings */
+int page_cache_sync(page_mapping_t* mapping) {
+    int failed = 0;
+    for (uint32_t i = 0; i < page_mapping_count; i++) {
+        if (mapping && page_mappings[i] != mapping) continue;
+        uint64_t start = 0;
+        while (writeback_batch(page_mappings[i], &start, &failed) > 0) {
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+/* Take a resident page's frame, keeping it as a ghost or forgetting it;
+ * a dirty page is written back first, together with the dirty pages after it
+ * Returns: 0 on success, -1 if it could not be written */
+static int page_evict(page_t* page, int ghost) {
+    if (page->flags & PAGE_DIRTY) {
+        uint64_t start = page->index;
+        int failed = 0;
+        writeback_batch(page->mapping, &start, &failed);
+        if (page->flags & PAGE_DIRTY) return -1;
+    }
+    page_cache_stats.evictions++;
+    if (!ghost) {
+        page_drop(page);
+        return 0;
+    }
+    page_free_frame(page);
+    list_move(page, page->state == PAGE_T1 ? PAGE_B1 : PAGE_B2);
+    return 0;
+}
+
+/* Evict the least recently used page of a list that is not held
+ * Returns: 0 on success, -1 if there is none */
+static int evict_lru(uint8_t state, int ghost) {
+    page_t* page = page_lists[state].tail;
+    while (page) {
+        page_t* prev = page->prev;
+        if (!page->holds && page_evict(page, ghost) == 0) return 0;
+        page = prev;
+    }
+    return -1;
+}
+
+/* Forget the least recently used ghost of a list that is not held
+ * Returns: 0 on success, -1 if there is none */
+static int drop_lru_ghost(uint8_t state) {
+    for (page_t* page = page_lists[state].tail; page; page = page->prev) {
+        if (!page->holds) {
+            page_drop(page);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ARC's REPLACE: free a frame from T1 or T2 depending on the target,
+ * keeping the evicted page as a ghost
+ * Returns: 0 on success, -1 if every resident page is held or dirty and unwritable */
+static int arc_replace(int in_b2) {
+    uint32_t t1 = page_lists[PAGE_T1].count;
+    uint8_t first = t1 && (t1 > page_cache_target || (in_b2 && t1 == page_cache_target)) ? PAGE_T1 : PAGE_T2;
+    if (evict_lru(first, 1) == 0) return 0;
+    return evict_lru(first == PAGE_T1 ? PAGE_T2 : PAGE_T1, 1);
+}
+
+/* Free a descriptor or tree nodes: ghosts go first, the longer list's oldest
+ * Returns: 0 on success, -1 if nothing can go */
+static int page_reclaim(void) {
+    uint8_t longer = page_lists[PAGE_B1].count >= page_lists[PAGE_B2].count ? PAGE_B1 : PAGE_B2;
+    if (drop_lru_ghost(longer) == 0 || drop_lru_ghost(longer == PAGE_B1 ? PAGE_B2 : PAGE_B1) == 0) return 0;
+    return evict_lru(PAGE_T1, 0) == 0 || evict_lru(PAGE_T2, 0) == 0 ? 0 : -1;
+}
+
+/* ARC's directory upkeep before a page nobody remembers comes in */
+static void arc_make_room(void) {
+    uint32_t c = page_cache_pages;
+    uint32_t t1 = page_lists[PAGE_T1].count;
+    uint32_t b1 = page_lists[PAGE_B1].count;
+    uint32_t total = t1 + b1 + page_lists[PAGE_T2].count + page_lists[PAGE_B2].count;
+
+    if (t1 + b1 >= c) {
+        /* B1 full: forget its oldest; B1 empty: T1 is the whole cache, drop its oldest */
+        if (b1 && t1 < c) {
+            drop_lru_ghost(PAGE_B1);
+        } else {
+            evict_lru(PAGE_T1, 0);
+        }
+    } else if (total >= 2 * c) {
+        drop_lru_ghost(PAGE_B2);
+    }
+}
+
+/* Find or bring in a page and hold it; read says whether its disk contents are wanted */
+static page_t* page_lookup(page_mapping_t* mapping, uint64_t index, int read) {
+    if (!page_cache_pages || index >> PAGE_CACHE_INDEX_BITS ||
+        index * PAGE_CACHE_PAGE_SIZE >= mapping->size) {
+        return NULL;
+    }
+
+    page_t* page = tree_lookup(mapping, index);
+    if (page && (page->state == PAGE_T1 || page->state == PAGE_T2)) {
+        page_cache_stats.hits++;
+        list_move(page, PAGE_T2);
+        page->holds++;
+        return page;
+    }
+    page_cache_stats.misses++;
+
+    int ghost = page != NULL;
+    int in_b2 = 0;
+    if (page) {
+        /* A ghost hit: grow the target of the list that would have kept the page */
+        uint32_t b1 = page_lists[PAGE_B1].count;
+        uint32_t b2 = page_lists[PAGE_B2].count;
+        if (page->state == PAGE_B1) {
+            uint32_t delta = b1 >= b2 ? 1 : b2 / b1;
+            page_cache_target = page_cache_target + delta < page_cache_pages ? page_cache_target + delta
+                                                                             : page_cache_pages;
+            page_cache_stats.ghost_hits[0]++;
+        } else {
+            uint32_t delta = b2 >= b1 ? 1 : b1 / b2;
+            page_cache_target = page_cache_target > delta ? page_cache_target - delta : 0;
+            page_cache_stats.ghost_hits[1]++;
+            in_b2 = 1;
+        }
+        page->holds++;
+    } else {
+        arc_make_room();
+        while (!page_free_list || node_free_count < tree_nodes_needed(mapping, index)) {
+            if (page_reclaim() != 0) return NULL;
+        }
+        page = page_free_list;
+        page_free_list = page->next;
+        page->mapping = mapping;
+        page->index = index;
+        page->flags = 0;
+        page->holds = 1;
+        page->state = PAGE_FREE;
+        page->next = NULL;
+        tree_insert(mapping, page);
+    }
+
+    if (!frame_free_list && arc_replace(in_b2) != 0) {
+        page->holds--;
+        if (!ghost) page_drop(page);
+        return NULL;
+    }
+    page->data = frame_free_list;
+    frame_free_list = *(uint8_t**)page->data;
+    mapping->pages++;
+    list_move(page, ghost ? PAGE_T2 : PAGE_T1);
+
+    if (read) {
+        if (page_io(page, 0) != 0) {
+            page_cache_stats.errors++;
+            page_drop(page);
+            return NULL;
+        }
+        page_cache_stats.reads++;
+    }
+    page->flags |= PAGE_UPTODATE;
+    return page;
+}
+
+/* Look a page up, reading it from disk on a miss, and hold it */
+page_t* page_cache_get(page_mapping_t* mapping, uint64_t index) {
+    return page_lookup(mapping, index, 1);
+}
+
+void page_cache_release(page_t* page) {
+    if (page->holds) page->holds--;
+}
+
+/* Copy bytes out of a mapping through the cache */
+int page_cache_read(page_mapping_t* mapping, uint64_t offset, void* buffer, uint32_t length) {
+    if (offset >= mapping->size) return 0;
+    if (length > mapping->size - offset) length = (uint32_t)(mapping->size - offset);
+
+    uint8_t* out = buffer;
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t within = (uint32_t)offset & (PAGE_CACHE_PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_CACHE_PAGE_SIZE - within;
+        if (chunk > length - done) chunk = length - done;
+
+        page_t* page = page_lookup(mapping, offset / PAGE_CACHE_PAGE_SIZE, 1);
+        if (!page) return -1;
+        memcpy(out + done, page->data + within, chunk);
+        page_cache_release(page);
+        done += chunk;
+        offset += chunk;
+    }
+    return (int)done;
+}
+
+/* Copy bytes into a mapping's pages, leaving them dirty */
+int page_cache_write(page_mapping_t* mapping, uint64_t offset, const void* buffer, uint32_t length) {
+    if (offset >= mapping->size) return 0;
+    if (length > mapping->size - offset) length = (uint32_t)(mapping->size - offset);
+
+    const uint8_t* in = buffer;
+    uint32_t done = 0;
+    while (done < length) {
+        uint64_t index = offset / PAGE_CACHE_PAGE_SIZE;
+        uint32_t within = (uint32_t)offset & (PAGE_CACHE_PAGE_SIZE - 1);
+        uint32_t chunk = PAGE_CACHE_PAGE_SIZE - within;
+        if (chunk > length - done) chunk = length - done;
+
+        /* A page written whole (up to the mapping's end) need not be read first */
+        uint64_t page_bytes = mapping->size - index * PAGE_CACHE_PAGE_SIZE;
+        if (page_bytes > PAGE_CACHE_PAGE_SIZE) page_bytes = PAGE_CACHE_PAGE_SIZE;
+        int whole = within == 0 && chunk == page_bytes;
+
+        page_t* page = page_lookup(mapping, index, !whole);
+        if (!page) return -1;
+        if (whole && page_bytes < PAGE_CACHE_PAGE_SIZE) {
+            memset(page->data + page_bytes, 0, PAGE_CACHE_PAGE_SIZE - (uint32_t)page_bytes);
+        }
+        memcpy(page->data + within, in + done, chunk);
+        page_cache_mark_dirty(page);
+        page_cache_release(page);
+        done += chunk;
+        offset += chunk;
+    }
+
+    if (page_cache_dirty > page_cache_pages / PAGE_CACHE_DIRTY_DIVISOR && page_cache_sync(NULL) != 0) {
+        return -1;
+    }
+    return (int)done;
+}
+
+/* Drop a mapping's clean pages and ghosts */
+void page_cache_invalidate(page_mapping_t* mapping) {
+    for (uint8_t state = PAGE_T1; state <= PAGE_B2; state++) {
+        page_t* page = page_lists[state].head;
+        while (page) {
+            page_t* next = page->next;
+            if (page->mapping == mapping && !page->holds && !(page->flags & PAGE_DIRTY)) {
+                page_drop(page);
+            }
+            page = next;
+        }
+    }
+}
+
+const page_cache_stats_t* page_cache_get_stats(void) {
+    return &page_cache_stats;
+}
+
+/* Print the counters and the ARC list sizes */
+void page_cache_print_stats(void) {
+    const page_cache_stats_t* stats = &page_cache_stats;
+    printf("Page cache: %llu hits, %llu misses (%llu B1, %llu B2 ghost hits), %llu evictions\n",
+           (unsigned long long)stats->hits, (unsigned long long)stats->misses,
+           (unsigned long long)stats->ghost_hits[0], (unsigned long long)stats->ghost_hits[1],
+           (unsigned long long)stats->evictions);
+    printf("  %llu pages read, %llu written in %llu batches, %llu errors\n",
+           (unsigned long long)stats->reads, (unsigned long long)stats->written,
+           (unsigned long long)stats->writebacks, (unsigned long long)stats->errors);
+    printf("  T1 %u, T2 %u, B1 %u, B2 %u of %u pages, T1 target %u, %u dirty\n",
+           page_lists[PAGE_T1].count, page_lists[PAGE_T2].count, page_lists[PAGE_B1].count,
+           page_lists[PAGE_B2].count, page_cache_pages, page_cache_target, page_cache_dirty);
+}
@@ -0,0 +1,181 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "block.h"
+
+/* Page cache
+ *
+ * Keeps 4 KiB pages of block devices (and, through a mapping's map
+ * callback, of anything laid out on one, such as a file) in free RAM
+ * from PAGE_CACHE_BASE (64 MiB) up, as the boot loader's memory map
+ * reports it; the linker script keeps the kernel image below. Pages are
+ * found by (mapping, page index) in a radix tree per mapping, 64 slots
+ * per node, whose nodes also carry a dirty tag per slot so writeback
+ * finds dirty pages in disk order without visiting clean ones.
+ *
+ * Replacement is ARC (Megiddo and Modha, FAST '03): pages seen once sit
+ * on a recency list T1, pages seen again on a frequency list T2, and the
+ * keys of pages recently evicted from each stay in the tree as ghosts
+ * (B1, B2) without memory behind them. A hit on a ghost moves the
+ * target size of T1 towards the list that would have kept the page, so
+ * a long sequential read only ever cycles through T1 and does not push
+ * out a working set that is read repeatedly.
+ *
+ * Writes dirty pages in place; they are written back in batches of
+ * adjacent pages under one block_plug(), so the block layer merges them
+ * into few requests: when dirty pages pass a quarter of the cache, when
+ * a dirty page is about to be evicted, and on page_cache_sync().
+ *
+ *   page_mapping_t* disk = page_cache_device(block_find("ata0"));
+ *   page_cache_read(disk, offset, buffer, length);
+ *
+ * All of it runs in thread context; bios complete from the interrupt but
+ * cache state is only touched by the waiting caller.
+ */
+
+#define PAGE_CACHE_PAGE_SIZE        4096
+#define PAGE_CACHE_PAGE_SECTORS     (PAGE_CACHE_PAGE_SIZE / BLOCK_SECTOR_SIZE)
+
+/* Memory: free RAM from PAGE_CACHE_BASE, at most PAGE_CACHE_MAX_BYTES */
+#define PAGE_CACHE_BASE             0x04000000  /* 64 MiB, clear of the bench areas */
+#define PAGE_CACHE_MAX_BYTES        (256u * 1024 * 1024)
+#define PAGE_CACHE_MIN_PAGES        64
+
+/* Writeback */
+#define PAGE_CACHE_WRITEBACK_BATCH  64          /* Pages per plugged batch */
+#define PAGE_CACHE_DIRTY_DIVISOR    4           /* Write back beyond capacity / 4 dirty */
+
+/* Radix tree */
+#define PAGE_TREE_BITS              6
+#define PAGE_TREE_SLOTS             (1u << PAGE_TREE_BITS)
+#define PAGE_CACHE_INDEX_BITS       42          /* Page indexes below 2^42 (16 PiB) */
+
+#define PAGE_CACHE_MAX_MAPPINGS     32
+
+/* Page states: resident on an ARC list, a ghost, or unused */
+#define PAGE_FREE                   0
+#define PAGE_T1                     1           /* Resident, seen once */
+#define PAGE_T2                     2           /* Resident, seen again */
+#define PAGE_B1                     3           /* Ghost of T1 */
+#define PAGE_B2                     4           /* Ghost of T2 */
+
+/* Page flags */
+#define PAGE_UPTODATE               0x01        /* data holds the disk contents */
+#define PAGE_DIRTY                  0x02        /* data is newer than the disk */
+
+struct page_mapping;
+struct page_tree_node;
+
+/* A cached page; data is valid while the page is held (see page_cache_get()) */
+typedef struct page {
+    struct page_mapping* mapping;
+    uint64_t index;             /* Page within the mapping */
+    uint8_t* data;              /* PAGE_CACHE_PAGE_SIZE bytes, NULL for ghosts */
+    uint8_t state;              /* PAGE_FREE, PAGE_T1, ... */
+    uint8_t flags;              /* PAGE_UPTODATE, PAGE_DIRTY */
+    uint16_t holds;             /* Held pages are not evicted */
+
+    struct page_tree_node* node;        /* Leaf holding the page */
+    struct page* prev;          /* ARC list or free list links */
+    struct page* next;
+} page_t;
+
+/* A radix tree node; slots hold nodes, or pages at shift 0 */
+typedef struct page_tree_node {
+    void* slots[PAGE_TREE_SLOTS];
+    uint64_t dirty;             /* Slots with a dirty page below them */
+    struct page_tree_node* parent;
+    uint8_t offset;             /* Slot in the parent */
+    uint8_t shift;              /* Index bits below this node's slots */
+    uint16_t count;             /* Slots in use */
+} page_tree_node_t;
+
+/* Something cached: a whole device, or pages laid out on one by map */
+typedef struct page_mapping {
+    block_device_t* device;
+    uint64_t size;              /* Bytes; pages past the end are not cached */
+
+    /* Disk sector holding the page (NULL: first_sector + index * 8)
+     * Returns: 0 on success, -1 if the page has no sectors behind it */
+    int (*map)(struct page_mapping* mapping, uint64_t index, uint64_t* sector);
+    uint64_t first_sector;
+    void* private_data;         /* For map */
+
+    /* Set by the cache */
+    page_tree_node_t* root;
+    uint32_t pages;             /* Resident */
+    uint32_t dirty;
+} page_mapping_t;
+
+/* Counters for the whole cache */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t ghost_hits[2];     /* Misses on a B1, B2 ghost */
+    uint64_t evictions;
+    uint64_t reads;             /* Pages read from disk */
+    uint64_t writebacks;        /* Batches */
+    uint64_t written;           /* Pages written back */
+    uint64_t errors;            /* Failed page reads and writes */
+} page_cache_stats_t;
+
+/* Take the free RAM from start (page aligned; the kernel passes
+ * PAGE_CACHE_BASE) up to end for the cache; nothing else may use it
+ * Returns: 0 on success, -1 if there is too little RAM (the cache stays off)
+ */
+int page_cache_init(uint32_t start, uint32_t end);
+
+/* Get the number of pages the cache can hold (0 while it is off) */
+uint32_t page_cache_capacity(void);
+
+/* Set up a mapping for pages laid out on a device by map
+ * Returns: 0 on success, -1 if too many mappings are registered
+ */
+int page_mapping_init(page_mapping_t* mapping, block_device_t* device, uint64_t size,
+                      int (*map)(page_mapping_t*, uint64_t, uint64_t*), void* private_data);
+
+/* Get the mapping of a whole block device, set up on first use
+ * Returns: the mapping, or NULL if dev is NULL or mappings ran out
+ */
+page_mapping_t* page_cache_device(block_device_t* dev);
+
+/* Look a page up, reading it from disk on a miss, and hold it
+ * Pass each page to page_cache_release() once done with its data.
+ * Returns: the page, or NULL if it is past the end, the read failed or
+ * every resident page is held
+ */
+page_t* page_cache_get(page_mapping_t* mapping, uint64_t index);
+
+/* Let a page from page_cache_get() be evicted again */
+void page_cache_release(page_t* page);
+
+/* Note that a held page's data was changed */
+void page_cache_mark_dirty(page_t* page);
+
+/* Copy bytes out of a mapping through the cache
+ * Returns: bytes read (short at the end of the mapping), -1 on failure
+ */
+int page_cache_read(page_mapping_t* mapping, uint64_t offset, void* buffer, uint32_t length);
+
+/* Copy bytes into a mapping's pages, leaving them dirty
+ * Returns: bytes written (short at the end of the mapping), -1 on failure
+ */
+int page_cache_write(page_mapping_t* mapping, uint64_t offset, const void* buffer, uint32_t length);
+
+/* Write back the dirty pages of a mapping, or of all mappings if NULL
+ * Returns: 0 on success, -1 if a page failed to write (it stays dirty)
+ */
+int page_cache_sync(page_mapping_t* mapping);
+
+/* Drop a mapping's clean pages and ghosts, e.g. after writing its device directly */
+void page_cache_invalidate(page_mapping_t* mapping);
+
+/* Get the cache's counters */
+const page_cache_stats_t* page_cache_get_stats(void);
+
+/* Print the counters and the ARC list sizes */
+void page_cache_print_stats(void);
+
+#endif /* PAGE_CACHE_H */
@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "profile.h"
+#include "ksyms.h"
+#include "drivers/serial.h"
+#include "arch/x86/pit.h"
+#include "arch/x86/pic.h"
+
+#define PROFILE_BUCKET_MASK (PROFILE_BUCKETS - 1)
+
+/* Give up on a sample after this many occupied buckets */
+#define PROFILE_MAX_PROBES  32
+
+/* Only the boot processor runs kernel code for now */
+#define PROFILE_CURRENT_CPU() 0
+
+/* The boot stack (boot.S); frame pointers outside it end a walk */
+extern char stack_bottom[];
+extern char stack_top[];
+
+static profile_cpu_t profile_cpus[PROFILE_MAX_CPUS];
+static volatile int profile_running = 0;
+static int profile_call_chains = 0;
+static uint32_t profile_hz = 0;
+
+/* Start of the function containing addr, or addr itself if unknown */
+static uint32_t function_of(uint32_t addr) {
+    uint32_t start;
+    return ksym_lookup(addr, &start) ? start : addr;
+}
+
+/* Collect the interrupted function and, if enabled, its callers
+ * Returns: number of frames stored
+ */
+static uint32_t collect_frames(const registers_t* regs, uint32_t* frames) {
+    uint32_t depth = 0;
+    frames[depth++] = function_of(regs->eip);
+    if (!profile_call_chains) return depth;
+
+    /* Each frame holds the caller's ebp, then the return address.
+     * Callers live higher up the stack, so a valid chain only climbs;
+     * kernel_main's frame ends it with the zero ebp from boot.S. */
+    uint32_t ebp = regs->ebp;
+    while (depth < PROFILE_MAX_DEPTH) {
+        if (ebp & 3 || ebp < (uint32_t)stack_bottom || ebp + 8 > (uint32_t)stack_top) break;
+
+        const uint32_t* frame = (const uint32_t*)ebp;
+        if (frame[1] == 0) break;
+
+        /* The return address can be the first byte of the next function */
+        frames[depth++] = function_of(frame[1] - 1);
+        if (frame[0] <= ebp) break;
+        ebp = frame[0];
+    }
+    return depth;
+}
+
+static uint32_t hash_frames(const uint32_t* frames, uint32_t depth) {
+    uint32_t hash = depth;
+    for (uint32_t i = 0; i < depth; i++) {
+        hash = (hash ^ frames[i]) * 0x9E3779B1u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+/* Plain loops rather than memcmp()/memcpy(): the SSE versions would
+ * cost a lazy FPU switch on every sample */
+static int same_frames(const profile_bucket_t* bucket, const uint32_t* frames, uint32_t depth) {
+    if (bucket->depth != depth) return 0;
+    for (uint32_t i = 0; i < depth; i++) {
+        if (bucket->frames[i] != frames[i]) return 0;
+    }
+    return 1;
+}
+
+/* Record one sample; runs in the timer interrupt with interrupts off */
+void profile_sample(const registers_t* regs) {
+    if (!profile_running) return;
+
+    profile_cpu_t* cpu = &profile_cpus[PROFILE_CURRENT_CPU()];
+    uint32_t frames[PROFILE_MAX_DEPTH];
+    uint32_t depth = collect_frames(regs, frames);
+    uint32_t index = hash_frames(frames, depth);
+
+    /* Linear probing: find this stack's bucket or claim a free one */
+    for (uint32_t probe = 0; probe < PROFILE_MAX_PROBES; probe++, index++) {
+        profile_bucket_t* bucket = &cpu->buckets[index & PROFILE_BUCKET_MASK];
+        if (bucket->count == 0) {
+            bucket->depth = depth;
+            for (uint32_t i = 0; i < depth; i++) bucket->frames[i] = frames[i];
+        } else if (!same_frames(bucket, frames, depth)) {
+            continue;
+        }
+        bucket->count++;
+        cpu->samples++;
+        return;
+    }
+    cpu->dropped++;
+}
+
+/* Start sampling at roughly hz on the PIT */
+uint32_t profile_start(uint32_t hz, int call_chains) {
+    profile_call_chains = call_chains;
+    profile_hz = pit_set_frequency(hz);
+    profile_running = 1;
+    pic_enable_irq(0);
+    return profile_hz;
+}
+
+/* Stop sampling and restore the BIOS timer rate */
+void profile_stop(void) {
+    pic_disable_irq(0);
+    profile_running = 0;
+    pit_set_frequency(PIT_DEFAULT_HZ);
+}
+
+/* Discard all samples */
+void profile_reset(void) {
+    memset(profile_cpus, 0, sizeof(profile_cpus));
+}
+
+/* Write one frame's function name, or its address if it has none */
+static void write_frame(uint32_t addr) {
+    const char* name = ksym_lookup(addr, NULL);
+    if (name) {
+        serial_write_string(name);
+    } else {
+        char hex[16];
+        snprintf(hex, sizeof(hex), "0x%08x", addr);
+        serial_write_string(hex);
+    }
+}
+
+/* Write the histogram to COM1 in folded-stack format */
+void profile_flush(void) {
+    char line[96];
+
+    uint32_t samples = 0, dropped = 0;
+    for (int c = 0; c < PROFILE_MAX_CPUS; c++) {
+        samples += profile_cpus[c].samples;
+        dropped += profile_cpus[c].dropped;
+    }
+    snprintf(line, sizeof(line), "# profile begin hz=%u samples=%u dropped=%u\n",
+             profile_hz, samples, dropped);
+    serial_write_string(line);
+
+    for (int c = 0; c < PROFILE_MAX_CPUS; c++) {
+        for (uint32_t b = 0; b < PROFILE_BUCKETS; b++) {
+            const profile_bucket_t* bucket = &profile_cpus[c].buckets[b];
+            if (bucket->count == 0) continue;
+
+            /* Outermost caller first */
+            for (uint32_t i = bucket->depth; i-- > 0;) {
+                write_frame(bucket->frames[i]);
+                if (i > 0) serial_write_string(";");
+            }
+            snprintf(line, sizeof(line), " %u\n", bucket->count);
+            serial_write_string(line);
+        }
+    }
+    serial_write_string("# profile end\n");
+}
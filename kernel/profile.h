@@ -0,0 +1,64 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "arch/x86/idt.h"
+
+/* Sampling profiler
+ *
+ * While running, every timer interrupt records where the kernel was
+ * interrupted. Samples are bucketed by function (through the embedded
+ * symbol table, see ksyms.h) in a per-CPU hash table; with call chains
+ * enabled the bucket key is the whole stack, found by following the
+ * saved frame pointers. Nothing is printed while sampling.
+ *
+ * profile_flush() writes one line per bucket to COM1 in the folded
+ * format flame graph tools read, root first, between two markers:
+ *
+ *   # profile begin hz=997 samples=5120 dropped=0
+ *   kernel_main;bench_run;run_memcpy_4k;memcpy_sse2 4711
+ *   # profile end
+ *
+ * Headless runs enable it with `make bench BENCH_PROFILE=997,stacks`.
+ */
+
+/* Hash table geometry (bucket count must be a power of two) */
+#define PROFILE_BUCKETS    1024
+#define PROFILE_MAX_DEPTH  16
+#define PROFILE_MAX_CPUS   1
+
+/* One distinct sample: a function, or a stack of them */
+typedef struct {
+    uint32_t count;                     /* Samples taken here (0 = free) */
+    uint32_t depth;                     /* Frames used */
+    uint32_t frames[PROFILE_MAX_DEPTH]; /* Function addresses, innermost first */
+} profile_bucket_t;
+
+/* Per-CPU histogram, only touched by that CPU's timer interrupt */
+typedef struct {
+    uint32_t samples;                   /* Samples recorded */
+    uint32_t dropped;                   /* Samples lost to a full table */
+    profile_bucket_t buckets[PROFILE_BUCKETS];
+} profile_cpu_t;
+
+/* Start sampling at roughly hz on the PIT (IRQ0)
+ * With call_chains set, each sample also walks the frame pointers.
+ * Returns: the sampling rate actually programmed, in Hz
+ */
+uint32_t profile_start(uint32_t hz, int call_chains);
+
+/* Stop sampling and put the PIT back to its BIOS rate */
+void profile_stop(void);
+
+/* Discard all samples */
+void profile_reset(void);
+
+/* Record one sample; called from the timer interrupt handler */
+void profile_sample(const registers_t* regs);
+
+/* Write the histogram to COM1 in folded-stack format
+ * Slow (a line per bucket over the UART); call with sampling stopped.
+ */
+void profile_flush(void);
+
+#endif /* PROFILE_H */
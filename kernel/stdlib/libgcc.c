@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <stddef.h>
+
+/* Compiler runtime support routines
+ *
+ * On i386 GCC turns 64-bit division and modulo into calls to these helpers,
+ * which normally live in libgcc. We link with -nostdlib, so the kernel has
+ * to provide its own copies.
+ */
+
+uint64_t __udivmoddi4(uint64_t num, uint64_t den, uint64_t* rem);
+uint64_t __udivdi3(uint64_t num, uint64_t den);
+uint64_t __umoddi3(uint64_t num, uint64_t den);
+int64_t __divdi3(int64_t num, int64_t den);
+int64_t __moddi3(int64_t num, int64_t den);
+
+/* Unsigned 64-bit division returning quotient and (optionally) remainder */
+uint64_t __udivmoddi4(uint64_t num, uint64_t den, uint64_t* rem) {
+    uint64_t quot = 0;
+    uint64_t bit = 1;
+
+    /* Division by zero: mimic the CPU and raise #DE */
+    if (den == 0) {
+        volatile uint32_t zero = 0;
+        return 1 / zero;
+    }
+
+    /* Fast path: 32-bit divisor, two hardware divides (high then low half) */
+    if ((den >> 32) == 0) {
+        uint32_t d = (uint32_t)den;
+        uint32_t num_high = (uint32_t)(num >> 32);
+        uint32_t num_low = (uint32_t)num;
+        uint32_t quot_high = num_high / d;
+        uint32_t quot_low;
+        uint32_t r = num_high % d;
+
+        asm ("divl %4"
+             : "=a"(quot_low), "=d"(r)
+             : "a"(num_low), "d"(r), "rm"(d));
+
+        if (rem) *rem = r;
+        return ((uint64_t)quot_high << 32) | quot_low;
+    }
+
+    /* Slow path: shift-and-subtract long division */
+    while (den < num && !(den & (1ULL << 63))) {
+        den <<= 1;
+        bit <<= 1;
+    }
+    while (bit) {
+        if (num >= den) {
+            num -= den;
+            quot |= bit;
+        }
+        den >>= 1;
+        bit >>= 1;
+    }
+
+    if (rem) *rem = num;
+    return quot;
+}
+
+/* Unsigned 64-bit division */
+uint64_t __udivdi3(uint64_t num, uint64_t den) {
+    return __udivmoddi4(num, den, NULL);
+}
+
+/* Unsigned 64-bit modulo */
+uint64_t __umoddi3(uint64_t num, uint64_t den) {
+    uint64_t rem;
+    __udivmoddi4(num, den, &rem);
+    return rem;
+}
+
+/* Signed 64-bit division (truncates toward zero) */
+int64_t __divdi3(int64_t num, int64_t den) {
+    int negative = (num < 0) != (den < 0);
+    uint64_t unum = num < 0 ? -(uint64_t)num : (uint64_t)num;
+    uint64_t uden = den < 0 ? -(uint64_t)den : (uint64_t)den;
+    uint64_t quot = __udivmoddi4(unum, uden, NULL);
+    return negative ? -(int64_t)quot : (int64_t)quot;
+}
+
+/* Signed 64-bit modulo (result takes the sign of the dividend) */
+int64_t __moddi3(int64_t num, int64_t den) {
+    uint64_t unum = num < 0 ? -(uint64_t)num : (uint64_t)num;
+    uint64_t uden = den < 0 ? -(uint64_t)den : (uint64_t)den;
+    uint64_t rem;
+    __udivmoddi4(unum, uden, &rem);
+    return num < 0 ? -(int64_t)rem : (int64_t)rem;
+}
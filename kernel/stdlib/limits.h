@@ -19,16 +19,16 @@
 #define INT_MAX     2147483647
 #define UINT_MAX    4294967295U
 
-#define LONG_MIN    (-2147483648L)
-#define LONG_MAX    2147483647L
-#define ULONG_MAX   4294967295UL
+#define LONG_MIN    (-__LONG_MAX__ - 1L)
+#define LONG_MAX    __LONG_MAX__
+#define ULONG_MAX   (__LONG_MAX__ * 2UL + 1UL)
 
 /* Size limits */
-#define SIZE_MAX    UINT_MAX
-#define SSIZE_MAX   INT_MAX
+#define SIZE_MAX    __SIZE_MAX__
+#define SSIZE_MAX   __PTRDIFF_MAX__
 
 /* Pointer limits */
-#define PTRDIFF_MIN INT_MIN
-#define PTRDIFF_MAX INT_MAX
+#define PTRDIFF_MIN (-__PTRDIFF_MAX__ - 1)
+#define PTRDIFF_MAX __PTRDIFF_MAX__
 
 #endif /* _VIBEOS_LIMITS_H */ 
\ No newline at end of file
@@ -7,10 +7,11 @@
 /* Offset of a member in a struct */
 #define offsetof(type, member) __builtin_offsetof(type, member)
 
-/* Unsigned integer type that can hold the result of sizeof */
-typedef unsigned int size_t;
+/* Unsigned integer type that can hold the result of sizeof
+ * (the compiler's own types, so the host test build gets 64-bit ones) */
+typedef __SIZE_TYPE__ size_t;
 
 /* Signed integer type that can hold the result of pointer subtraction */
-typedef int ptrdiff_t;
+typedef __PTRDIFF_TYPE__ ptrdiff_t;
 
 #endif /* _VIBEOS_STDDEF_H */ 
\ No newline at end of file
@@ -22,12 +22,12 @@ typedef signed long long int_least64_t;
 typedef unsigned long long uint_least64_t;
 
 /* Integer type capable of holding a pointer */
-typedef int intptr_t;
-typedef unsigned int uintptr_t;
+typedef __INTPTR_TYPE__ intptr_t;
+typedef __UINTPTR_TYPE__ uintptr_t;
 
 /* Greatest-width integer types */
-typedef long long intmax_t;
-typedef unsigned long long uintmax_t;
+typedef __INTMAX_TYPE__ intmax_t;
+typedef __UINTMAX_TYPE__ uintmax_t;
 
 /* Limits of exact-width integer types */
 #define INT8_MIN (-128)
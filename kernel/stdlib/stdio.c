@@ -4,8 +4,7 @@
 #include <string.h>
 #include <stdint.h>
 
-#include "../drivers/vga.h"
-#include "../drivers/serial.h"
+#include "../klog.h"
 
 /* Helper function to apply padding */
 static void apply_padding(char* buffer, size_t* i, size_t* count, size_t max_chars, 
@@ -25,25 +24,19 @@ static void copy_str_bounded(char* buffer, size_t* i, size_t* count, size_t max_
     }
 }
 
-/* Write a string to both terminal and serial outputs */
+/* Queue a string for both terminal and serial outputs */
 void puts(const char* str) {
-    terminal_write(str);
-    serial_write_string(str);
+    klog_write(KLOG_INFO, str, strlen(str));
 }
 
-/* Format a string and output to both terminal and serial */
+/* Format a string and queue it for both terminal and serial */
 int printf(const char* format, ...) {
-    char buffer[256];
     va_list args;
     
     va_start(args, format);
-    int result = vsnprintf(buffer, sizeof(buffer), format, args);
+    int result = klog_vprintf(KLOG_INFO, format, args);
     va_end(args);
     
-    /* Output to both VGA and serial */
-    terminal_write(buffer);
-    serial_write_string(buffer);
-    
     return result;
 }
 
@@ -56,185 +49,272 @@ int snprintf(char* buffer, size_t size, const char* format, ...) {
     return result;
 }
 
-/* Format a string with va_list args and store it in the buffer */
+/* Conversion flags and sizes parsed from a format specifier */
+typedef struct {
+    int left_align;     /* '-' */
+    int zero_pad;       /* '0' */
+    int plus_sign;      /* '+' */
+    int space_sign;     /* ' ' */
+    int alternate;      /* '#' */
+    size_t width;
+    int precision;      /* -1 if not given */
+} format_spec_t;
+
+/* Length modifiers */
+typedef enum {
+    LENGTH_DEFAULT,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_Z,
+    LENGTH_J,
+    LENGTH_T
+} format_length_t;
+
+/* Output a converted number with sign, prefix, precision and padding */
+static void format_number(char* buffer, size_t* i, size_t* count, size_t max_chars,
+                          const format_spec_t* spec, char sign, const char* prefix,
+                          const char* digits, size_t len) {
+    size_t prefix_len = strlen(prefix);
+    size_t zeros = 0;
+
+    /* Precision is the minimum number of digits */
+    if (spec->precision >= 0 && (size_t)spec->precision > len) {
+        zeros = spec->precision - len;
+    }
+
+    size_t total = (sign ? 1 : 0) + prefix_len + zeros + len;
+    size_t padding = spec->width > total ? spec->width - total : 0;
+
+    /* The 0 flag pads between the prefix and the digits, unless a
+     * precision or left alignment was requested */
+    if (spec->zero_pad && !spec->left_align && spec->precision < 0) {
+        zeros += padding;
+        padding = 0;
+    }
+
+    if (!spec->left_align) apply_padding(buffer, i, count, max_chars, padding, ' ');
+    if (sign) copy_str_bounded(buffer, i, count, max_chars, &sign, 1);
+    copy_str_bounded(buffer, i, count, max_chars, prefix, prefix_len);
+    apply_padding(buffer, i, count, max_chars, zeros, '0');
+    copy_str_bounded(buffer, i, count, max_chars, digits, len);
+    if (spec->left_align) apply_padding(buffer, i, count, max_chars, padding, ' ');
+}
+
+/* Output a string or character with width padding */
+static void format_text(char* buffer, size_t* i, size_t* count, size_t max_chars,
+                        const format_spec_t* spec, const char* str, size_t len) {
+    size_t padding = spec->width > len ? spec->width - len : 0;
+
+    if (!spec->left_align) apply_padding(buffer, i, count, max_chars, padding, ' ');
+    copy_str_bounded(buffer, i, count, max_chars, str, len);
+    if (spec->left_align) apply_padding(buffer, i, count, max_chars, padding, ' ');
+}
+
+/* Fetch an unsigned integer argument of the given length */
+static uint64_t fetch_unsigned(va_list* args, format_length_t length) {
+    switch (length) {
+        case LENGTH_HH: return (unsigned char)va_arg(*args, unsigned int);
+        case LENGTH_H:  return (unsigned short)va_arg(*args, unsigned int);
+        case LENGTH_L:  return va_arg(*args, unsigned long);
+        case LENGTH_LL: return va_arg(*args, unsigned long long);
+        case LENGTH_Z:  return va_arg(*args, size_t);
+        case LENGTH_J:  return va_arg(*args, uintmax_t);
+        case LENGTH_T:  return (uint64_t)va_arg(*args, ptrdiff_t);
+        default:        return va_arg(*args, unsigned int);
+    }
+}
+
+/* Fetch a signed integer argument of the given length */
+static int64_t fetch_signed(va_list* args, format_length_t length) {
+    switch (length) {
+        case LENGTH_HH: return (signed char)va_arg(*args, int);
+        case LENGTH_H:  return (short)va_arg(*args, int);
+        case LENGTH_L:  return va_arg(*args, long);
+        case LENGTH_LL: return va_arg(*args, long long);
+        case LENGTH_Z:  return (int64_t)(ptrdiff_t)va_arg(*args, size_t);
+        case LENGTH_J:  return va_arg(*args, intmax_t);
+        case LENGTH_T:  return va_arg(*args, ptrdiff_t);
+        default:        return va_arg(*args, int);
+    }
+}
+
+/* Format a string with va_list args and store it in the buffer
+ * Supports the flags "-0+ #", width and precision (also as '*'), the
+ * length modifiers hh, h, l, ll, z, j and t, and the conversions
+ * d i u x X o p s c %.
+ */
 int vsnprintf(char* buffer, size_t size, const char* format, va_list args) {
     size_t count = 0;
     size_t i = 0;
-    char temp_buf[64];  /* Temporary buffer for number conversions */
+    char temp_buf[24];  /* Temporary buffer for number conversions */
+    va_list ap;
     
     /* Ensure size is at least 1 for null terminator */
     if (size == 0) return 0;
     size_t max_chars = size - 1; // Reserve space for null terminator
+    
+    /* Work on a copy so the helpers can take its address */
+    va_copy(ap, args);
 
     /* Process format string */
     for (size_t pos = 0; format[pos] != '\0'; pos++) {
         if (i >= max_chars) break; // Stop if buffer is full
 
-        /* Handle format specifiers */
-        if (format[pos] == '%' && format[pos + 1] != '\0') {
-            pos++;  /* Move past the '%' */
-            
-            // Parse flags and width
-            char pad_char = ' '; // Default padding character is space
-            size_t min_width = 0;
-            int is_zero_padded = 0;
-            int is_left_aligned = 0;
-
-            // Check for left alignment flag
-            if (format[pos] == '-') {
-                is_left_aligned = 1;
-                pos++;
+        /* Regular character */
+        if (format[pos] != '%' || format[pos + 1] == '\0') {
+            buffer[i++] = format[pos];
+            count++;
+            continue;
+        }
+        pos++;  /* Move past the '%' */
+        
+        format_spec_t spec = {0, 0, 0, 0, 0, 0, -1};
+        
+        // Parse flags, in any order
+        for (;; pos++) {
+            char flag = format[pos];
+            if (flag == '-') spec.left_align = 1;
+            else if (flag == '0') spec.zero_pad = 1;
+            else if (flag == '+') spec.plus_sign = 1;
+            else if (flag == ' ') spec.space_sign = 1;
+            else if (flag == '#') spec.alternate = 1;
+            else break;
+        }
+        
+        // Parse minimum width
+        if (format[pos] == '*') {
+            int width = va_arg(ap, int);
+            if (width < 0) {
+                spec.left_align = 1;
+                width = -width;
             }
-
-            // Check for zero-padding flag (only if not left-aligned)
-            if (!is_left_aligned && format[pos] == '0') {
-                is_zero_padded = 1;
-                pad_char = '0';
+            spec.width = width;
+            pos++;
+        } else {
+            while (format[pos] >= '0' && format[pos] <= '9') {
+                spec.width = spec.width * 10 + (format[pos] - '0');
                 pos++;
             }
-
-            // Check for minimum width
-            while (format[pos] >= '0' && format[pos] <= '9') {
-                min_width = min_width * 10 + (format[pos] - '0');
+        }
+        
+        // Parse precision
+        if (format[pos] == '.') {
+            pos++;
+            spec.precision = 0;
+            if (format[pos] == '*') {
+                spec.precision = va_arg(ap, int);
+                if (spec.precision < 0) spec.precision = -1;
                 pos++;
+            } else {
+                while (format[pos] >= '0' && format[pos] <= '9') {
+                    spec.precision = spec.precision * 10 + (format[pos] - '0');
+                    pos++;
+                }
+            }
+        }
+        
+        // Parse length modifier
+        format_length_t length = LENGTH_DEFAULT;
+        switch (format[pos]) {
+            case 'h':
+                length = (format[pos + 1] == 'h') ? LENGTH_HH : LENGTH_H;
+                pos += (length == LENGTH_HH) ? 2 : 1;
+                break;
+            case 'l':
+                length = (format[pos + 1] == 'l') ? LENGTH_LL : LENGTH_L;
+                pos += (length == LENGTH_LL) ? 2 : 1;
+                break;
+            case 'z': length = LENGTH_Z; pos++; break;
+            case 'j': length = LENGTH_J; pos++; break;
+            case 't': length = LENGTH_T; pos++; break;
+        }
+        
+        // Handle the actual format specifier
+        char conversion = format[pos];
+        switch (conversion) {
+            case 's': {  /* String */
+                const char* str = va_arg(ap, const char*);
+                if (str == NULL) str = "(null)";
+                size_t str_len = spec.precision >= 0 ? strnlen(str, spec.precision) : strlen(str);
+                format_text(buffer, &i, &count, max_chars, &spec, str, str_len);
+                break;
             }
             
-            // Handle the actual format specifier
-            switch (format[pos]) {
-                case 's': {  /* String */
-                    const char* str = va_arg(args, const char*);
-                    if (str == NULL) str = "(null)";
-                    size_t str_len = strlen(str);
-                    size_t padding = min_width > str_len ? min_width - str_len : 0;
-                    
-                    // For left alignment, print string first then padding
-                    if (is_left_aligned) {
-                        copy_str_bounded(buffer, &i, &count, max_chars, str, str_len);
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                    } else {
-                        // Right alignment (default)
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                        copy_str_bounded(buffer, &i, &count, max_chars, str, str_len);
-                    }
-                    break;
-                }
-                
-                case 'c': {  /* Character */
-                    char c = (char)va_arg(args, int);
-                    size_t padding = min_width > 1 ? min_width - 1 : 0;
-                    
-                    if (is_left_aligned) {
-                        if (i < max_chars) {
-                            buffer[i++] = c;
-                            count++;
-                        }
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                    } else {
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                        if (i < max_chars) {
-                            buffer[i++] = c;
-                            count++;
-                        }
-                    }
-                    break;
-                }
-                
-                case 'd':
-                case 'i': {  /* Signed integer */
-                    int value = va_arg(args, int);
-                    size_t len = itoa(value, temp_buf, 10);
-                    size_t padding = min_width > len ? min_width - len : 0;
-                    
-                    if (is_left_aligned) {
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf, len);
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                    } else {
-                        // Handle sign for zero padding
-                        if (value < 0 && is_zero_padded) {
-                            if (i < max_chars) buffer[i++] = '-';
-                            temp_buf[0] = '0'; // Remove sign from temp_buf for padding logic
-                        }
-                        apply_padding(buffer, &i, &count, max_chars, padding, pad_char);
-                        size_t start_idx = (value < 0 && is_zero_padded) ? 1 : 0;
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf + start_idx, len - start_idx);
-                    }
-                    break;
-                }
+            case 'c': {  /* Character */
+                char c = (char)va_arg(ap, int);
+                format_text(buffer, &i, &count, max_chars, &spec, &c, 1);
+                break;
+            }
+            
+            case 'd':
+            case 'i': {  /* Signed integer */
+                int64_t value = fetch_signed(&ap, length);
+                uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+                char sign = value < 0 ? '-' : spec.plus_sign ? '+' : spec.space_sign ? ' ' : 0;
+                size_t len = (spec.precision == 0 && magnitude == 0) ? 0 : ulltoa(magnitude, temp_buf, 10);
+                format_number(buffer, &i, &count, max_chars, &spec, sign, "", temp_buf, len);
+                break;
+            }
+            
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {  /* Unsigned integer, hexadecimal and octal */
+                uint64_t value = fetch_unsigned(&ap, length);
+                int base = (conversion == 'u') ? 10 : (conversion == 'o') ? 8 : 16;
+                size_t len = (spec.precision == 0 && value == 0) ? 0 : ulltoa(value, temp_buf, base);
+                const char* prefix = "";
                 
-                case 'u':
-                case 'x': {  /* Unsigned integer and Hexadecimal (lowercase) */
-                    unsigned int value = va_arg(args, unsigned int);
-                    int base = (format[pos] == 'u') ? 10 : 16;
-                    size_t len = utoa(value, temp_buf, base);
-                    size_t padding = min_width > len ? min_width - len : 0;
-                    
-                    if (is_left_aligned) {
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf, len);
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                    } else {
-                        apply_padding(buffer, &i, &count, max_chars, padding, pad_char);
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf, len);
+                if (conversion == 'X') {
+                    for (size_t d = 0; d < len; d++) {
+                        if (temp_buf[d] >= 'a') temp_buf[d] -= 'a' - 'A';
                     }
-                    break;
                 }
-                                
-                case 'p': {  /* Pointer */
-                    void* ptr_val = va_arg(args, void*);
-                    uint32_t value = (uint32_t)ptr_val;
-                    size_t len = utoa(value, temp_buf, 16);
-                    size_t prefix_len = 2; // "0x"
-                    
-                    if (min_width < len + prefix_len) min_width = len + prefix_len; 
-                    size_t padding = min_width > (len + prefix_len) ? min_width - (len + prefix_len) : 0;
-                    
-                    if (is_left_aligned) {
-                        // Output "0x" prefix first
-                        if (i < max_chars) { buffer[i++] = '0'; count++; }
-                        if (i < max_chars) { buffer[i++] = 'x'; count++; }
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf, len);
-                        apply_padding(buffer, &i, &count, max_chars, padding, ' ');
-                    } else {
-                        is_zero_padded = 1; // Pointers usually zero padded
-                        pad_char = '0';
-                        // Output "0x" prefix first
-                        if (i < max_chars) { buffer[i++] = '0'; count++; }
-                        if (i < max_chars) { buffer[i++] = 'x'; count++; }
-                        apply_padding(buffer, &i, &count, max_chars, padding, pad_char);
-                        copy_str_bounded(buffer, &i, &count, max_chars, temp_buf, len);
-                    }
-                    break;
+                if (spec.alternate && value != 0) {
+                    if (conversion == 'x') prefix = "0x";
+                    if (conversion == 'X') prefix = "0X";
                 }
-                
-                case '%': {  /* Escaped % character */
-                    if (i < max_chars) {
-                        buffer[i++] = '%';
-                        count++;
-                    }
-                    break;
+                if (spec.alternate && conversion == 'o' &&
+                    (len == 0 || temp_buf[0] != '0') &&
+                    (spec.precision < 0 || (size_t)spec.precision <= len)) {
+                    prefix = "0";
                 }
-                
-                default:  /* Unsupported format, just output as-is */
-                    if (i < max_chars) {
-                        buffer[i++] = '%';
-                        count++;
-                    }
-                    if (i < max_chars && format[pos] != '\0') {
-                        buffer[i++] = format[pos];
-                        count++;
-                    }
-                    break;
+                format_number(buffer, &i, &count, max_chars, &spec, 0, prefix, temp_buf, len);
+                break;
             }
-        } else {
-            /* Regular character */
-            if (i < max_chars) {
-                buffer[i++] = format[pos];
+                            
+            case 'p': {  /* Pointer, zero padded to the width unless left aligned */
+                uintptr_t value = (uintptr_t)va_arg(ap, void*);
+                size_t len = ulltoa(value, temp_buf, 16);
+                if (!spec.left_align) spec.zero_pad = 1;
+                format_number(buffer, &i, &count, max_chars, &spec, 0, "0x", temp_buf, len);
+                break;
+            }
+            
+            case '%': {  /* Escaped % character */
+                buffer[i++] = '%';
                 count++;
+                break;
             }
+            
+            default:  /* Unsupported format, just output as-is */
+                buffer[i++] = '%';
+                count++;
+                if (i < max_chars && conversion != '\0') {
+                    buffer[i++] = conversion;
+                    count++;
+                }
+                if (conversion == '\0') pos--;
+                break;
         }
     }
     
+    va_end(ap);
+    
     /* Ensure null-termination */
     buffer[i] = '\0'; 
     
     return count;
-} 
\ No newline at end of file
+}
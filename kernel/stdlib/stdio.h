@@ -5,32 +5,47 @@
 #include <stdint.h>
 #include <stdarg.h>
 
-/* Write a string to both terminal and serial outputs */
+/* Queue a string for both terminal and serial outputs */
 void puts(const char* str);
 
 /* Format a string and output to both terminal and serial
- * This is the preferred output function that writes to both
- * VGA text mode display and serial console simultaneously.
+ * This is the preferred output function. The message is copied into
+ * the kernel log ring (see klog.h) at KLOG_INFO level and reaches the
+ * VGA text mode display and serial console when the log is drained.
  * 
  * Supported format specifiers:
  * %s - String
  * %c - Character
  * %d, %i - Signed integer
  * %u - Unsigned integer
- * %x - Hexadecimal (lowercase)
+ * %x, %X - Hexadecimal (lowercase, uppercase)
+ * %o - Octal
  * %p - Pointer (displayed as hex with 0x prefix)
  * %% - Literal %
  * 
- * Width and padding modifiers:
+ * Length modifiers (for d, i, u, x, X, o):
+ * hh, h - char, short
+ * l - long
+ * ll - long long (64-bit, e.g. %llu, %llx for TSC values)
+ * z - size_t (%zu)
+ * j, t - intmax_t, ptrdiff_t
+ * 
+ * Flags, width and precision:
  * %Ns - Right-pad with spaces to width N (e.g., %10s)
+ * %-Ns - Left-align in width N
  * %0Nd - Left-pad with zeros to width N (e.g., %05d)
  * %Nd - Left-pad with spaces to width N (e.g., %5d)
+ * %+d, % d - Always print a sign (or a space) for signed values
+ * %#x, %#o - Add the 0x or 0 prefix
+ * %.Nd - At least N digits; %.Ns - at most N characters
+ * %*d, %.*d - Width or precision taken from an int argument
  * 
  * Examples:
  * printf("%s", "hello")      -> "hello"
  * printf("%10s", "hello")    -> "     hello"
  * printf("%05d", 42)         -> "00042"
- * printf("%p", ptr)          -> "0x00001234"
+ * printf("%p", ptr)          -> "0x1234"
+ * printf("%#010llx", tsc)    -> "0x0012d687"
  */
 int printf(const char* format, ...);
 
@@ -2,22 +2,98 @@
 #include <stdint.h>
 #include <limits.h>
 
+/* Word-at-a-time (SWAR) helpers
+ * The scanning functions read aligned 32-bit words, which never cross a
+ * page boundary, so reading a few bytes past the terminator is safe.
+ * swar_has_zero() is nonzero iff a byte of w is zero; only the lowest
+ * flagged byte is exact (a borrow can flag a 0x01 byte above a zero),
+ * which is all that forward scans need. swar_zero_bytes() is exact.
+ */
+#define SWAR_ONES   0x01010101u
+#define SWAR_HIGHS  0x80808080u
+#define SWAR_LOWS   0x7F7F7F7Fu
+#define SWAR_PAGE_SIZE 4096
+
+typedef uint32_t __attribute__((may_alias)) swar_word_t;
+typedef uint32_t __attribute__((may_alias, aligned(1))) swar_unaligned_t;
+
+static inline uint32_t swar_has_zero(uint32_t w) {
+    return (w - SWAR_ONES) & ~w & SWAR_HIGHS;
+}
+
+static inline uint32_t swar_zero_bytes(uint32_t w) {
+    return ~(((w & SWAR_LOWS) + SWAR_LOWS) | w | SWAR_LOWS);
+}
+
+static inline int swar_aligned(const void* p) {
+    return ((uintptr_t)p & (sizeof(uint32_t) - 1)) == 0;
+}
+
+/* String functions
+ * Like the memory functions below, the scanning functions call through
+ * a table so an SSE2 set can be installed at boot (see str_ops_install()).
+ */
+
+const str_ops_t str_ops_swar = {
+    "swar", strlen_swar, strnlen_swar, strchr_swar, strrchr_swar,
+    strcmp_swar, strspn_table, strcspn_table
+};
+
+static const str_ops_t* str_ops = &str_ops_swar;
+
+/* Install a set of string function implementations */
+void str_ops_install(const str_ops_t* ops) {
+    str_ops = ops;
+}
+
+/* Get the installed string function implementations */
+const str_ops_t* str_ops_current(void) {
+    return str_ops;
+}
+
 /* String length functions */
 
 /* Calculate string length */
 size_t strlen(const char* str) {
-    const char* s = str;
-    while (*s) s++;
-    return s - str;
+    return str_ops->length(str);
 }
 
 /* Calculate string length with maximum limit */
 size_t strnlen(const char* str, size_t maxlen) {
+    return str_ops->length_max(str, maxlen);
+}
+
+/* Calculate string length a word at a time */
+size_t strlen_swar(const char* str) {
     const char* s = str;
-    while (maxlen > 0 && *s) {
-        s++;
-        maxlen--;
+    
+    /* Bytes up to the first word boundary */
+    for (; !swar_aligned(s); s++) {
+        if (!*s) return s - str;
     }
+    
+    const swar_word_t* w = (const swar_word_t*)s;
+    while (!swar_has_zero(*w)) w++;
+    
+    /* Locate the terminator inside the last word */
+    for (s = (const char*)w; *s; s++);
+    return s - str;
+}
+
+/* Calculate string length with maximum limit a word at a time */
+size_t strnlen_swar(const char* str, size_t maxlen) {
+    const char* s = str;
+    
+    for (; maxlen > 0 && !swar_aligned(s); s++, maxlen--) {
+        if (!*s) return s - str;
+    }
+    
+    /* Whole words only, so nothing past str + maxlen is read */
+    for (; maxlen >= sizeof(uint32_t); s += sizeof(uint32_t), maxlen -= sizeof(uint32_t)) {
+        if (swar_has_zero(*(const swar_word_t*)s)) break;
+    }
+    
+    for (; maxlen > 0 && *s; s++, maxlen--);
     return s - str;
 }
 
@@ -52,9 +128,36 @@ char* strncpy(char* dest, const char* src, size_t n) {
 
 /* Compare two strings */
 int strcmp(const char* s1, const char* s2) {
+    return str_ops->compare(s1, s2);
+}
+
+/* Compare two strings a word at a time
+ * s1 is read in aligned words; s2 in unaligned words (fine on x86),
+ * except where one would cross into the next page. */
+int strcmp_swar(const char* s1, const char* s2) {
     const unsigned char* p1 = (const unsigned char*)s1;
     const unsigned char* p2 = (const unsigned char*)s2;
     
+    for (; !swar_aligned(p1); p1++, p2++) {
+        if (!*p1 || *p1 != *p2) return *p1 - *p2;
+    }
+    
+    for (;;) {
+        if (((uintptr_t)p2 & (SWAR_PAGE_SIZE - 1)) > SWAR_PAGE_SIZE - sizeof(uint32_t)) {
+            for (size_t i = 0; i < sizeof(uint32_t); i++, p1++, p2++) {
+                if (!*p1 || *p1 != *p2) return *p1 - *p2;
+            }
+            continue;
+        }
+        
+        uint32_t w1 = *(const swar_word_t*)p1;
+        uint32_t w2 = *(const swar_unaligned_t*)p2;
+        if (w1 != w2 || swar_has_zero(w1)) break;
+        p1 += sizeof(uint32_t);
+        p2 += sizeof(uint32_t);
+    }
+    
+    /* The difference or the terminator is in this word */
     while (*p1 && *p1 == *p2) {
         p1++;
         p2++;
@@ -85,8 +188,49 @@ int strncmp(const char* s1, const char* s2, size_t n) {
 
 /* Memory functions */
 
+/* Memory functions
+ * The public entry points call through mem_ops, which starts out with the
+ * portable C versions below and may be replaced once at boot by faster
+ * CPU-specific ones (see mem_ops_install()). */
+
+const mem_ops_t mem_ops_generic = {
+    "generic", memcpy_generic, memmove_generic, memset_generic, memcmp_generic
+};
+
+static const mem_ops_t* mem_ops = &mem_ops_generic;
+
+/* Install a set of memory function implementations */
+void mem_ops_install(const mem_ops_t* ops) {
+    mem_ops = ops;
+}
+
+/* Get the installed memory function implementations */
+const mem_ops_t* mem_ops_current(void) {
+    return mem_ops;
+}
+
 /* Copy memory area */
 void* memcpy(void* dest, const void* src, size_t n) {
+    return mem_ops->copy(dest, src, n);
+}
+
+/* Copy memory area, handling overlapping regions */
+void* memmove(void* dest, const void* src, size_t n) {
+    return mem_ops->move(dest, src, n);
+}
+
+/* Fill memory with a constant byte */
+void* memset(void* s, int c, size_t n) {
+    return mem_ops->set(s, c, n);
+}
+
+/* Compare memory areas */
+int memcmp(const void* s1, const void* s2, size_t n) {
+    return mem_ops->compare(s1, s2, n);
+}
+
+/* Copy memory area (portable version) */
+void* memcpy_generic(void* dest, const void* src, size_t n) {
     unsigned char* d = (unsigned char*)dest;
     const unsigned char* s = (const unsigned char*)src;
     
@@ -120,14 +264,14 @@ void* memcpy(void* dest, const void* src, size_t n) {
     return dest;
 }
 
-/* Copy memory area, handling overlapping regions */
-void* memmove(void* dest, const void* src, size_t n) {
+/* Copy memory area, handling overlapping regions (portable version) */
+void* memmove_generic(void* dest, const void* src, size_t n) {
     unsigned char* d = (unsigned char*)dest;
     const unsigned char* s = (const unsigned char*)src;
     
     /* If dest is before src or after the end of src, we can copy forward */
     if (d <= s || d >= s + n) {
-        return memcpy(dest, src, n);
+        return memcpy_generic(dest, src, n);
     }
     
     /* Otherwise, copy backward to handle overlapping regions */
@@ -164,8 +308,8 @@ void* memmove(void* dest, const void* src, size_t n) {
     return dest;
 }
 
-/* Fill memory with a constant byte */
-void* memset(void* s, int c, size_t n) {
+/* Fill memory with a constant byte (portable version) */
+void* memset_generic(void* s, int c, size_t n) {
     unsigned char* p = (unsigned char*)s;
     unsigned char byte = (unsigned char)c;
     
@@ -205,8 +349,8 @@ void* memset(void* s, int c, size_t n) {
     return s;
 }
 
-/* Compare memory areas */
-int memcmp(const void* s1, const void* s2, size_t n) {
+/* Compare memory areas (portable version) */
+int memcmp_generic(const void* s1, const void* s2, size_t n) {
     const unsigned char* p1 = (const unsigned char*)s1;
     const unsigned char* p2 = (const unsigned char*)s2;
     
@@ -267,69 +411,150 @@ void reverse_str(char* start, char* end) {
     }
 }
 
-/* Convert integer to string and return length */
-size_t itoa(int32_t value, char* str, int base) {
-    size_t i = 0;
-    int is_negative = 0;
-    
-    /* Handle 0 explicitly */
-    if (value == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return i;
+/* Integer to string conversion
+ * Digits are produced backwards from the end of a scratch buffer, so no
+ * reversal pass is needed. Decimal conversion emits two digits per
+ * division using a lookup table; 64-bit values are first split into
+ * 8-digit chunks so that the inner loops only ever divide 32-bit values
+ * by a constant (a multiply, no libgcc call).
+ */
+
+/* "00" "01" ... "99" */
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char digit_chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/* Longest conversion: 64 binary digits */
+#define CONVERT_BUFFER_SIZE 64
+
+/* Write the decimal digits of value so that they end at end
+ * Returns: pointer to the first digit */
+static char* convert_dec32(uint32_t value, char* end) {
+    while (value >= 100) {
+        uint32_t quotient = value / 100;
+        uint32_t pair = (value - quotient * 100) * 2;
+        end -= 2;
+        end[0] = digit_pairs[pair];
+        end[1] = digit_pairs[pair + 1];
+        value = quotient;
+    }
+    if (value >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[value * 2];
+        end[1] = digit_pairs[value * 2 + 1];
+    } else {
+        *--end = (char)('0' + value);
     }
-    
-    /* Handle negative numbers for base 10 */
-    if (value < 0 && base == 10) {
-        is_negative = 1;
-        value = -value;
+    return end;
+}
+
+/* Write exactly 8 decimal digits (with leading zeros) ending at end */
+static char* convert_dec8(uint32_t value, char* end) {
+    for (int i = 0; i < 4; i++) {
+        uint32_t quotient = value / 100;
+        uint32_t pair = (value - quotient * 100) * 2;
+        end -= 2;
+        end[0] = digit_pairs[pair];
+        end[1] = digit_pairs[pair + 1];
+        value = quotient;
+    }
+    return end;
+}
+
+/* Write the hex digits of a 32-bit value ending at end
+ * The digit count comes from the highest set bit, so the loop
+ * has a fixed trip count instead of testing the value */
+static char* convert_hex32(uint32_t value, char* end, size_t min_digits) {
+    size_t digits = value ? (35 - __builtin_clz(value)) / 4 : 1;
+    if (digits < min_digits) digits = min_digits;
+    for (size_t i = 0; i < digits; i++) {
+        *--end = digit_chars[value & 0xF];
+        value >>= 4;
+    }
+    return end;
+}
+
+/* Write the digits of value in base 2-36 ending at end
+ * Returns: pointer to the first digit */
+static char* convert_unsigned(uint64_t value, char* end, int base) {
+    uint32_t high = (uint32_t)(value >> 32);
+
+    if (base == 10) {
+        while (value > UINT32_MAX) {
+            uint64_t quotient = value / 100000000;
+            end = convert_dec8((uint32_t)(value - quotient * 100000000), end);
+            value = quotient;
+        }
+        return convert_dec32((uint32_t)value, end);
     }
-    
-    /* Process individual digits */
-    while (value != 0) {
-        int remainder = value % base;
-        str[i++] = (remainder < 10) ? remainder + '0' : remainder + 'a' - 10;
-        value /= base;
+
+    if (base == 16) {
+        if (high == 0) return convert_hex32((uint32_t)value, end, 1);
+        end = convert_hex32((uint32_t)value, end, 8);
+        return convert_hex32(high, end, 1);
     }
-    
-    /* Add negative sign if needed */
-    if (is_negative)
-        str[i++] = '-';
-    
-    /* Null terminate the string */
-    str[i] = '\0';
-    
-    /* Reverse the string */
-    reverse_str(str, &str[i - 1]);
-    
-    return i;
+
+    /* Other bases are rare; one division per digit is fine */
+    if (base < 2 || base > 36) base = 10;
+    do {
+        *--end = digit_chars[value % (unsigned)base];
+        value /= (unsigned)base;
+    } while (value != 0);
+    return end;
 }
 
-/* Convert unsigned integer to string and return length */
-size_t utoa(uint32_t value, char* str, int base) {
-    size_t i = 0;
-    
-    /* Handle 0 explicitly */
-    if (value == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return i;
+/* Copy the digits between start and end to str and null terminate */
+static size_t convert_finish(const char* start, const char* end, char* str) {
+    size_t length = end - start;
+    for (size_t i = 0; i < length; i++) {
+        str[i] = start[i];
     }
-    
-    /* Process individual digits */
-    while (value != 0) {
-        int remainder = value % base;
-        str[i++] = (remainder < 10) ? remainder + '0' : remainder + 'a' - 10;
-        value /= base;
+    str[length] = '\0';
+    return length;
+}
+
+/* Convert 64-bit unsigned integer to string and return length */
+size_t ulltoa(uint64_t value, char* str, int base) {
+    char buffer[CONVERT_BUFFER_SIZE];
+    char* end = buffer + sizeof(buffer);
+    return convert_finish(convert_unsigned(value, end, base), end, str);
+}
+
+/* Convert 64-bit integer to string and return length
+ * Only base 10 is signed; other bases print the two's complement bits */
+size_t lltoa(int64_t value, char* str, int base) {
+    char buffer[CONVERT_BUFFER_SIZE + 1];
+    char* end = buffer + sizeof(buffer);
+    char* start;
+
+    if (base == 10 && value < 0) {
+        start = convert_unsigned(-(uint64_t)value, end, base);
+        *--start = '-';
+    } else {
+        start = convert_unsigned((uint64_t)value, end, base);
     }
-    
-    /* Null terminate the string */
-    str[i] = '\0';
-    
-    /* Reverse the string */
-    reverse_str(str, &str[i - 1]);
-    
-    return i;
+    return convert_finish(start, end, str);
+}
+
+/* Convert integer to string and return length */
+size_t itoa(int32_t value, char* str, int base) {
+    if (base != 10) return ulltoa((uint32_t)value, str, base);
+    return lltoa(value, str, base);
+}
+
+/* Convert unsigned integer to string and return length */
+size_t utoa(uint32_t value, char* str, int base) {
+    return ulltoa(value, str, base);
 }
 
 /* Convert a string to an integer */
@@ -366,27 +591,60 @@ int atoi(const char* str) {
 
 /* Find the first occurrence of a character in a string */
 char* strchr(const char* str, int c) {
+    return str_ops->find(str, c);
+}
+
+/* Find the last occurrence of a character in a string */
+char* strrchr(const char* str, int c) {
+    return str_ops->find_last(str, c);
+}
+
+/* Find the first occurrence of a character a word at a time */
+char* strchr_swar(const char* str, int c) {
     const unsigned char ch = (unsigned char)c;
     const unsigned char* s = (const unsigned char*)str;
     
-    while (*s != ch) {
+    for (; !swar_aligned(s); s++) {
+        if (*s == ch) return (char*)s;
+        if (!*s) return NULL;
+    }
+    
+    /* Stop at the first word holding the character or the terminator */
+    uint32_t pattern = ch * SWAR_ONES;
+    const swar_word_t* w = (const swar_word_t*)s;
+    while (!(swar_has_zero(*w) | swar_has_zero(*w ^ pattern))) w++;
+    
+    for (s = (const unsigned char*)w; *s != ch; s++) {
         if (!*s) return NULL;
-        s++;
     }
     return (char*)s;
 }
 
-/* Find the last occurrence of a character in a string */
-char* strrchr(const char* str, int c) {
+/* Find the last occurrence of a character a word at a time */
+char* strrchr_swar(const char* str, int c) {
     const unsigned char ch = (unsigned char)c;
     const unsigned char* s = (const unsigned char*)str;
     const unsigned char* last = NULL;
     
-    while (*s) {
+    for (; !swar_aligned(s); s++) {
         if (*s == ch) last = s;
-        s++;
+        if (!*s) return (char*)last;
+    }
+    
+    /* Remember the highest match of every word before the terminator's */
+    uint32_t pattern = ch * SWAR_ONES;
+    const swar_word_t* w = (const swar_word_t*)s;
+    for (; !swar_has_zero(*w); w++) {
+        uint32_t matches = swar_zero_bytes(*w ^ pattern);
+        if (matches) {
+            last = (const unsigned char*)w + (31 - __builtin_clz(matches)) / 8;
+        }
+    }
+    
+    for (s = (const unsigned char*)w; ; s++) {
+        if (*s == ch) last = s;
+        if (!*s) break;
     }
-    if (*s == ch) last = s;  /* Check null terminator */
     return (char*)last;
 }
 
@@ -428,35 +686,51 @@ char* strtok(char* str, const char* delimiters) {
 
 /* Helper function: get length of initial segment matching chars in accept */
 size_t strspn(const char* str, const char* accept) {
-    const char* s = str;
-    const char* a;
-
-    while (*s) {
-        for (a = accept; *a; a++) {
-            if (*s == *a) {
-                break;
-            }
-        }
-        if (!*a) {
-            break;
-        }
-        s++;
-    }
-    return s - str;
+    return str_ops->span(str, accept);
 }
 
 /* Helper function: get length of initial segment not matching chars in reject */
 size_t strcspn(const char* str, const char* reject) {
-    const char* s = str;
-    const char* r;
+    return str_ops->complement_span(str, reject);
+}
 
-    while (*s) {
-        for (r = reject; *r; r++) {
-            if (*s == *r) {
-                return s - str;
-            }
-        }
-        s++;
+/* Build a 256-bit membership set from the bytes of chars */
+static void byteset_build(uint32_t set[8], const char* chars) {
+    for (int i = 0; i < 8; i++) {
+        set[i] = 0;
     }
-    return s - str;
+    for (const unsigned char* c = (const unsigned char*)chars; *c; c++) {
+        set[*c >> 5] |= 1u << (*c & 31);
+    }
+}
+
+static inline int byteset_contains(const uint32_t set[8], unsigned char c) {
+    return (set[c >> 5] >> (c & 31)) & 1;
+}
+
+/* strspn with a bitmap lookup per byte instead of a scan of accept */
+size_t strspn_table(const char* str, const char* accept) {
+    uint32_t set[8];
+    const unsigned char* s = (const unsigned char*)str;
+    
+    byteset_build(set, accept);
+    while (byteset_contains(set, *s)) s++;  /* '\0' is never in the set */
+    return (const char*)s - str;
+}
+
+/* strcspn with a bitmap lookup per byte instead of a scan of reject */
+size_t strcspn_table(const char* str, const char* reject) {
+    uint32_t set[8];
+    const unsigned char* s = (const unsigned char*)str;
+    
+    /* A single reject character is just strchr */
+    if (reject[0] && !reject[1]) {
+        const char* found = str_ops->find(str, reject[0]);
+        return found ? (size_t)(found - str) : str_ops->length(str);
+    }
+    
+    byteset_build(set, reject);
+    set[0] |= 1;  /* Stop at the terminator too */
+    while (!byteset_contains(set, *s)) s++;
+    return (const char*)s - str;
 } 
\ No newline at end of file
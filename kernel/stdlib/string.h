@@ -22,6 +22,66 @@ void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 
+/* Portable C implementations of the memory functions */
+void* memcpy_generic(void* dest, const void* src, size_t n);
+void* memmove_generic(void* dest, const void* src, size_t n);
+void* memset_generic(void* s, int c, size_t n);
+int memcmp_generic(const void* s1, const void* s2, size_t n);
+
+/* Memory function implementations
+ * memcpy(), memmove(), memset() and memcmp() call through the installed
+ * table, so faster CPU-specific versions can be selected once at boot
+ * (see arch/x86/memops.c). The generic versions are used until then.
+ */
+typedef struct {
+    const char* name;
+    void* (*copy)(void* dest, const void* src, size_t n);
+    void* (*move)(void* dest, const void* src, size_t n);
+    void* (*set)(void* s, int c, size_t n);
+    int (*compare)(const void* s1, const void* s2, size_t n);
+} mem_ops_t;
+
+extern const mem_ops_t mem_ops_generic;
+
+/* Install a set of memory function implementations */
+void mem_ops_install(const mem_ops_t* ops);
+
+/* Get the installed memory function implementations */
+const mem_ops_t* mem_ops_current(void);
+
+/* Word-at-a-time implementations of the string scanning functions */
+size_t strlen_swar(const char* str);
+size_t strnlen_swar(const char* str, size_t maxlen);
+char* strchr_swar(const char* str, int c);
+char* strrchr_swar(const char* str, int c);
+int strcmp_swar(const char* s1, const char* s2);
+size_t strspn_table(const char* str, const char* accept);
+size_t strcspn_table(const char* str, const char* reject);
+
+/* String function implementations
+ * strlen(), strnlen(), strchr(), strrchr(), strcmp(), strspn() and
+ * strcspn() call through the installed table, like the memory functions.
+ * The word-at-a-time versions are used until something else is installed.
+ */
+typedef struct {
+    const char* name;
+    size_t (*length)(const char* str);
+    size_t (*length_max)(const char* str, size_t maxlen);
+    char* (*find)(const char* str, int c);
+    char* (*find_last)(const char* str, int c);
+    int (*compare)(const char* s1, const char* s2);
+    size_t (*span)(const char* str, const char* accept);
+    size_t (*complement_span)(const char* str, const char* reject);
+} str_ops_t;
+
+extern const str_ops_t str_ops_swar;
+
+/* Install a set of string function implementations */
+void str_ops_install(const str_ops_t* ops);
+
+/* Get the installed string function implementations */
+const str_ops_t* str_ops_current(void);
+
 /* Integer to string conversion
  * Returns the number of characters written to str (excluding null terminator)
  * str must be large enough to hold the output string
@@ -31,6 +91,13 @@ int memcmp(const void* s1, const void* s2, size_t n);
 size_t itoa(int32_t value, char* str, int base);
 size_t utoa(uint32_t value, char* str, int base);
 
+/* 64-bit integer to string conversion
+ * Same contract as itoa/utoa; buffers need 21 bytes for base 10
+ * (sign + 19 or 20 digits + null) and 17 bytes for base 16.
+ */
+size_t lltoa(int64_t value, char* str, int base);
+size_t ulltoa(uint64_t value, char* str, int base);
+
 /* String manipulation helper */
 void reverse_str(char* start, char* end);
 
@@ -0,0 +1,138 @@
+#ifdef CONFIG_TRACE
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+#include "drivers/serial.h"
+#include "arch/x86/tsc.h"
+
+#define TRACE_RECORD_MASK (TRACE_RECORD_COUNT - 1)
+
+/* Only the boot processor runs kernel code for now */
+#define TRACE_CURRENT_CPU() 0
+
+volatile uint32_t trace_enabled_events = 0;
+
+static trace_buffer_t trace_buffers[TRACE_MAX_CPUS];
+static volatile int trace_dump_pending = 0;
+
+static const char* const event_names[] = {
+#define TRACE_EVENT_NAME(id, name, args) name,
+    TRACE_EVENTS(TRACE_EVENT_NAME)
+#undef TRACE_EVENT_NAME
+};
+
+static const char* const event_args[] = {
+#define TRACE_EVENT_ARGS(id, name, args) args,
+    TRACE_EVENTS(TRACE_EVENT_ARGS)
+#undef TRACE_EVENT_ARGS
+};
+
+/* Append one record; an interrupt arriving meanwhile just takes the next slot */
+void trace_record(trace_event_t event, uint32_t a0, uint32_t a1, uint32_t a2) {
+    uint32_t cpu = TRACE_CURRENT_CPU();
+    trace_buffer_t* buffer = &trace_buffers[cpu];
+    uint32_t slot = __atomic_fetch_add(&buffer->head, 1, __ATOMIC_RELAXED);
+    trace_record_t* record = &buffer->records[slot & TRACE_RECORD_MASK];
+
+    record->timestamp = tsc_read();
+    record->event = (uint16_t)event;
+    record->cpu = (uint8_t)cpu;
+    record->reserved = 0;
+    record->args[0] = a0;
+    record->args[1] = a1;
+    record->args[2] = a2;
+}
+
+/* Turn a comma-separated list of event names into a mask */
+uint32_t trace_parse_events(const char* list) {
+    uint32_t mask = 0;
+
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        if (length == 3 && strncmp(list, "all", 3) == 0) {
+            mask |= (1u << TRACE_EVENT_COUNT) - 1;
+        }
+        for (int event = 0; event < TRACE_EVENT_COUNT; event++) {
+            if (strlen(event_names[event]) == length &&
+                strncmp(list, event_names[event], length) == 0) {
+                mask |= 1u << event;
+            }
+        }
+        list += length;
+        if (*list == ',') list++;
+    }
+    return mask;
+}
+
+/* Record exactly the events in mask */
+void trace_enable(uint32_t mask) {
+    trace_enabled_events = mask;
+}
+
+/* Write one record as a line of hex bytes */
+static void dump_record(const trace_record_t* record) {
+    static const char digits[] = "0123456789abcdef";
+    const uint8_t* bytes = (const uint8_t*)record;
+    char line[2 + 2 * sizeof(trace_record_t) + 2];
+    size_t length = 0;
+
+    line[length++] = 'T';
+    line[length++] = ' ';
+    for (size_t i = 0; i < sizeof(trace_record_t); i++) {
+        line[length++] = digits[bytes[i] >> 4];
+        line[length++] = digits[bytes[i] & 0xF];
+    }
+    line[length++] = '\n';
+    line[length] = '\0';
+    serial_write_string(line);
+}
+
+/* Write every CPU's ring to COM1, oldest record first */
+void trace_dump(void) {
+    char line[128];
+    uint32_t enabled = trace_enabled_events;
+    trace_enabled_events = 0;
+
+    snprintf(line, sizeof(line), "# trace begin cpus=%u tsc_khz=%u record_size=%u\n",
+             TRACE_MAX_CPUS, tsc_khz(), (uint32_t)sizeof(trace_record_t));
+    serial_write_string(line);
+    for (int event = 0; event < TRACE_EVENT_COUNT; event++) {
+        snprintf(line, sizeof(line), "# trace event %d %s %s\n",
+                 event, event_names[event], event_args[event]);
+        serial_write_string(line);
+    }
+
+    for (int cpu = 0; cpu < TRACE_MAX_CPUS; cpu++) {
+        const trace_buffer_t* buffer = &trace_buffers[cpu];
+        uint32_t head = buffer->head;
+        uint32_t first = head > TRACE_RECORD_COUNT ? head - TRACE_RECORD_COUNT : 0;
+
+        snprintf(line, sizeof(line), "# trace cpu %d records=%u lost=%u\n",
+                 cpu, head - first, first);
+        serial_write_string(line);
+        for (uint32_t seq = first; seq != head; seq++) {
+            dump_record(&buffer->records[seq & TRACE_RECORD_MASK]);
+        }
+    }
+    serial_write_string("# trace end\n");
+
+    trace_enabled_events = enabled;
+}
+
+/* Ask the idle loop for a dump */
+void trace_request_dump(void) {
+    trace_dump_pending = 1;
+}
+
+/* Run a requested dump */
+void trace_poll(void) {
+    if (trace_dump_pending) {
+        trace_dump_pending = 0;
+        trace_dump();
+    }
+}
+
+#endif /* CONFIG_TRACE */
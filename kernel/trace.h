@@ -0,0 +1,115 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/* Static tracepoints
+ *
+ * TRACE(event, a, b, c) records a TSC timestamp, the CPU, the event id
+ * and three raw 32-bit arguments into a per-CPU binary ring; nothing is
+ * formatted and no device is touched. Old records are overwritten.
+ *
+ * Tracepoints only exist in kernels built with `make TRACE=1`; otherwise
+ * TRACE() expands to nothing and its arguments are not evaluated. When
+ * built in, a tracepoint whose event is not enabled costs one load and
+ * one branch that is predicted not taken.
+ *
+ * Events are enabled with trace=<names> on the kernel command line
+ * (e.g. trace=irq_entry,keyboard or trace=all). The rings are written to
+ * COM1 on Shift+F12, after a headless benchmark run and when the kernel
+ * halts on an exception; tools/trace_decode.py turns the serial log into
+ * a timeline.
+ */
+
+/* Event list: id, name, argument names (unused arguments are left out) */
+#define TRACE_EVENTS(EVENT)                                                    \
+    EVENT(IRQ_ENTRY,           "irq_entry",           "vector,err_code,eip")   \
+    EVENT(IRQ_EXIT,            "irq_exit",            "vector")                \
+    EVENT(KEYBOARD,            "keyboard",            "scancode")              \
+    EVENT(PAGE_MAP,            "page_map",            "phys,size,flags")       \
+    EVENT(PAGE_CONFLICT,       "page_conflict",       "phys,current")          \
+    EVENT(PAGE_FAULT,          "page_fault",          "address,err_code,eip")  \
+    EVENT(ATA_ISSUE,           "ata_issue",           "drive,lba,sectors")     \
+    EVENT(ATA_COMPLETE,        "ata_complete",        "drive,status,error")    \
+    EVENT(AHCI_ISSUE,          "ahci_issue",          "disk,slot,lba")         \
+    EVENT(AHCI_COMPLETE,       "ahci_complete",       "disk,slot,status")      \
+    EVENT(VIRTIO_BLK_ISSUE,    "virtio_blk_issue",    "disk,lba,sectors")      \
+    EVENT(VIRTIO_BLK_COMPLETE, "virtio_blk_complete", "disk,lba,status")
+
+typedef enum {
+#define TRACE_EVENT_ID(id, name, args) TRACE_##id,
+    TRACE_EVENTS(TRACE_EVENT_ID)
+#undef TRACE_EVENT_ID
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+/* Ring geometry (record count must be a power of two) */
+#define TRACE_RECORD_COUNT  4096
+#define TRACE_MAX_CPUS      1
+#define TRACE_ARGS          3
+
+/* One event, dumped as-is (little endian) */
+typedef struct {
+    uint64_t timestamp;         /* TSC when the event was recorded */
+    uint16_t event;             /* trace_event_t */
+    uint8_t  cpu;               /* CPU that recorded it */
+    uint8_t  reserved;
+    uint32_t args[TRACE_ARGS];  /* Raw arguments */
+} trace_record_t;
+
+/* Per-CPU ring; head counts every record ever written */
+typedef struct {
+    volatile uint32_t head;
+    trace_record_t records[TRACE_RECORD_COUNT];
+} trace_buffer_t;
+
+#ifdef CONFIG_TRACE
+
+/* Bit n set: event n is recorded */
+extern volatile uint32_t trace_enabled_events;
+
+#define TRACE(id, a0, a1, a2)                                                       \
+    do {                                                                            \
+        if (__builtin_expect(trace_enabled_events & (1u << TRACE_##id), 0)) {       \
+            trace_record(TRACE_##id, (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2)); \
+        }                                                                           \
+    } while (0)
+
+/* Append one record to the current CPU's ring
+ * Safe to call from any context; use TRACE() instead of calling this.
+ */
+void trace_record(trace_event_t event, uint32_t a0, uint32_t a1, uint32_t a2);
+
+/* Turn a comma-separated list of event names ("all" for every event)
+ * into an event mask; unknown names are ignored.
+ * Returns: the mask
+ */
+uint32_t trace_parse_events(const char* list);
+
+/* Record exactly the events in mask from now on */
+void trace_enable(uint32_t mask);
+
+/* Write every CPU's ring to COM1, oldest record first
+ * Recording is paused meanwhile. Slow; not for interrupt handlers.
+ */
+void trace_dump(void);
+
+/* Ask for a trace_dump() from the idle loop; safe in interrupt handlers */
+void trace_request_dump(void);
+
+/* Run a requested dump; called from the idle loop */
+void trace_poll(void);
+
+#else
+
+#define TRACE(id, a0, a1, a2) do { } while (0)
+
+static inline uint32_t trace_parse_events(const char* list) { (void)list; return 0; }
+static inline void trace_enable(uint32_t mask) { (void)mask; }
+static inline void trace_dump(void) { }
+static inline void trace_request_dump(void) { }
+static inline void trace_poll(void) { }
+
+#endif /* CONFIG_TRACE */
+
+#endif /* TRACE_H */
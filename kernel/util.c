@@ -1,8 +1,32 @@
 #include <stddef.h>
+#include <string.h>
 #include "util.h"
 
 /* Simple delay function - spins CPU */
 void delay(int count) {
     for (int i = 0; i < count * 10000; i++)
         asm volatile ("nop");
-} 
\ No newline at end of file
+}
+
+/* Find a key=value option in a space-separated command line */
+int cmdline_get(const char* cmdline, const char* key, char* value, size_t size) {
+    size_t key_length = strlen(key);
+    const char* option = cmdline;
+
+    while (option && *option) {
+        while (*option == ' ') option++;
+        size_t length = strcspn(option, " ");
+
+        if (length >= key_length && strncmp(option, key, key_length) == 0 &&
+            (length == key_length || option[key_length] == '=')) {
+            const char* start = option + key_length + (length > key_length);
+            size_t copy = option + length - start;
+            if (copy > size - 1) copy = size - 1;
+            memcpy(value, start, copy);
+            value[copy] = '\0';
+            return 1;
+        }
+        option += length;
+    }
+    return 0;
+}
@@ -1,7 +1,16 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stddef.h>
+
 /* Simple delay function - spins CPU */
 void delay(int count);
 
+/* Find a key=value option in a space-separated command line
+ * and copy its value (truncated to size - 1 characters) into value.
+ * A bare key without "=" has an empty value.
+ * Returns: 1 if the key is present, 0 otherwise
+ */
+int cmdline_get(const char* cmdline, const char* key, char* value, size_t size);
+
 #endif /* UTIL_H */ 
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* The parser itself, built for the host next to the stub below */
+#include "../../kernel/drivers/acpi.c"
+
+/* Tests of kernel/drivers/acpi.c on the host
+ *
+ * Synthetic tables are laid out in memory from mmap() below 4 GiB (the
+ * parser turns table addresses into 32-bit pointers, as in the kernel)
+ * and handed to it in place of the BIOS areas: an RSDP search past
+ * candidates with bad checksums, an ACPI 2.0 XSDT with MADT, MCFG,
+ * HPET and FADT plus a table with a bad checksum, and an ACPI 1.0 RSDT
+ * with a short FADT and a truncated MADT. The table layouts are checked
+ * against the offsets in the ACPI specification. Exits with status 1
+ * if anything fails.
+ */
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* Report a failed check (only the first few are printed) */
+#define CHECK(cond, ...)                                  \
+    do {                                                  \
+        checks++;                                         \
+        if (!(cond)) {                                    \
+            if (failures++ < 20) {                        \
+                printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+                printf(__VA_ARGS__);                      \
+                printf("\n");                             \
+            }                                             \
+        }                                                 \
+    } while (0)
+
+#define TEST_MEMORY_BYTES   (64 * 1024)
+
+static uint8_t* memory;
+static uint32_t memory_used = 0;
+
+/* Paging stub: the tables are host memory, readable as they are */
+int paging_map_region(uint32_t start, uint32_t size, uint32_t flags) {
+    (void)start;
+    (void)size;
+    (void)flags;
+    return 0;
+}
+
+/* Take zeroed, 16-byte aligned memory below 4 GiB */
+static void* alloc(uint32_t size) {
+    void* block = memory + memory_used;
+    memory_used += (size + 15) & ~15u;
+    if (memory_used > TEST_MEMORY_BYTES) {
+        printf("test memory exhausted\n");
+        exit(2);
+    }
+    return block;
+}
+
+static uint32_t address_of(const void* pointer) {
+    return (uint32_t)(uintptr_t)pointer;
+}
+
+/* Set a checksum byte so that length bytes from data sum to zero */
+static void set_checksum(void* data, uint32_t length, uint8_t* checksum) {
+    *checksum = 0;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += ((const uint8_t*)data)[i];
+    }
+    *checksum = (uint8_t)-sum;
+}
+
+/* Start a table of length bytes with a valid header */
+static acpi_sdt_header_t* new_table(const char* signature, uint32_t length) {
+    acpi_sdt_header_t* table = alloc(length);
+    memcpy(table->signature, signature, 4);
+    table->length = length;
+    table->revision = 1;
+    memcpy(table->oem_id, "VIBEOS", 6);
+    return table;
+}
+
+static void seal_table(acpi_sdt_header_t* table) {
+    set_checksum(table, table->length, &table->checksum);
+}
+
+/* An RSDP of revision 0 (20 bytes checked) or 2 (length bytes too) */
+static acpi_rsdp_t* new_rsdp(uint8_t revision, uint32_t rsdt, uint64_t xsdt) {
+    acpi_rsdp_t* rsdp = alloc(sizeof(acpi_rsdp_t));
+    memcpy(rsdp->signature, "RSD PTR ", 8);
+    memcpy(rsdp->oem_id, "VIBEOS", 6);
+    rsdp->revision = revision;
+    rsdp->rsdt_address = rsdt;
+    if (revision >= 2) {
+        rsdp->length = sizeof(acpi_rsdp_t);
+        rsdp->xsdt_address = xsdt;
+    }
+    set_checksum(rsdp, 20, &rsdp->checksum);
+    if (revision >= 2) {
+        set_checksum(rsdp, sizeof(acpi_rsdp_t), &rsdp->extended_checksum);
+    }
+    return rsdp;
+}
+
+/* Forget what the parser cached and let it start from rsdp */
+static const acpi_platform_t* parse(const acpi_rsdp_t* rsdp) {
+    acpi_rsdp = rsdp;
+    acpi_searched = 1;
+    acpi_table_count = 0;
+    acpi_tables_ready = 0;
+    memset(&acpi_platform_info, 0, sizeof(acpi_platform_info));
+    acpi_platform_ready = 0;
+    return acpi_platform();
+}
+
+/* Field offsets and sizes from the ACPI specification */
+static void test_layouts(void) {
+    CHECK(sizeof(acpi_rsdp_t) == 36, "RSDP is %zu bytes", sizeof(acpi_rsdp_t));
+    CHECK(sizeof(acpi_sdt_header_t) == 36, "table header is %zu bytes", sizeof(acpi_sdt_header_t));
+    CHECK(sizeof(acpi_mcfg_t) == 44 && sizeof(acpi_mcfg_entry_t) == 16, "MCFG layout");
+    CHECK(sizeof(acpi_madt_t) == 44, "MADT header is %zu bytes", sizeof(acpi_madt_t));
+    CHECK(sizeof(acpi_madt_local_apic_t) == 8 && sizeof(acpi_madt_io_apic_t) == 12 &&
+          sizeof(acpi_madt_irq_override_t) == 10 && sizeof(acpi_madt_lapic_override_t) == 12,
+          "MADT record layouts");
+    CHECK(sizeof(acpi_generic_address_t) == 12, "generic address is %zu bytes", sizeof(acpi_generic_address_t));
+    CHECK(sizeof(acpi_hpet_t) == 56, "HPET is %zu bytes", sizeof(acpi_hpet_t));
+
+    CHECK(offsetof(acpi_fadt_t, sci_interrupt) == 46, "FADT SCI_INT at %zu", offsetof(acpi_fadt_t, sci_interrupt));
+    CHECK(offsetof(acpi_fadt_t, pm_timer_block) == 76, "FADT PM_TMR_BLK at %zu",
+          offsetof(acpi_fadt_t, pm_timer_block));
+    CHECK(offsetof(acpi_fadt_t, pm_timer_length) == 91, "FADT PM_TMR_LEN at %zu",
+          offsetof(acpi_fadt_t, pm_timer_length));
+    CHECK(offsetof(acpi_fadt_t, flags) == 112, "FADT flags at %zu", offsetof(acpi_fadt_t, flags));
+    CHECK(offsetof(acpi_fadt_t, reset_register) == 116, "FADT RESET_REG at %zu",
+          offsetof(acpi_fadt_t, reset_register));
+    CHECK(offsetof(acpi_fadt_t, reset_value) == 128, "FADT RESET_VALUE at %zu", offsetof(acpi_fadt_t, reset_value));
+    CHECK(offsetof(acpi_fadt_t, x_pm_timer_block) == 208, "FADT X_PM_TMR_BLK at %zu",
+          offsetof(acpi_fadt_t, x_pm_timer_block));
+    CHECK(sizeof(acpi_fadt_t) == 220, "FADT is %zu bytes", sizeof(acpi_fadt_t));
+}
+
+/* The search steps over a bad checksum and a bad extended checksum */
+static void test_rsdp_search(void) {
+    uint8_t* area = alloc(256);
+    acpi_rsdp_t* bad = new_rsdp(0, 0, 0);
+    acpi_rsdp_t* bad_extended = new_rsdp(2, 0, 0x1000);
+    acpi_rsdp_t* good = new_rsdp(2, 0, 0x2000);
+    bad->checksum ^= 1;
+    bad_extended->extended_checksum ^= 1;
+    memcpy(area, bad, sizeof(acpi_rsdp_t));
+    memcpy(area + 48, bad_extended, sizeof(acpi_rsdp_t));
+    memcpy(area + 88, "RSD PTR ", 8);      /* Not on a 16-byte boundary */
+    memcpy(area + 96, good, sizeof(acpi_rsdp_t));
+
+    const acpi_rsdp_t* found = acpi_scan_rsdp(address_of(area), address_of(area) + 256);
+    CHECK(found == (const acpi_rsdp_t*)(area + 96), "found the RSDP at +%ld",
+          found ? (long)((const uint8_t*)found - area) : -1L);
+    CHECK(acpi_scan_rsdp(address_of(area), address_of(area) + 96) == NULL, "an RSDP in the bad candidates");
+}
+
+/* ACPI 2.0: everything through the XSDT */
+static void test_xsdt(void) {
+    /* MADT: two usable CPUs and a disabled one, an I/O APIC, an override
+     * of IRQ 0 and of the local APIC address */
+    uint32_t madt_length = sizeof(acpi_madt_t) + 3 * sizeof(acpi_madt_local_apic_t) +
+                           sizeof(acpi_madt_io_apic_t) + sizeof(acpi_madt_irq_override_t) +
+                           sizeof(acpi_madt_lapic_override_t);
+    acpi_madt_t* madt = (acpi_madt_t*)new_table("APIC", madt_length);
+    madt->local_apic_address = 0xFEE00000;
+    madt->flags = ACPI_MADT_PCAT_COMPAT;
+    uint8_t* record = madt->entries;
+    static const uint32_t cpu_flags[3] = { ACPI_MADT_CPU_ENABLED, 0, ACPI_MADT_CPU_ONLINE_CAPABLE };
+    for (uint8_t i = 0; i < 3; i++) {
+        acpi_madt_local_apic_t* cpu = (acpi_madt_local_apic_t*)record;
+        cpu->record.type = ACPI_MADT_LOCAL_APIC;
+        cpu->record.length = sizeof(*cpu);
+        cpu->processor_id = i;
+        cpu->apic_id = (uint8_t)(2 * i);
+        cpu->flags = cpu_flags[i];
+        record += sizeof(*cpu);
+    }
+    acpi_madt_io_apic_t* io_apic = (acpi_madt_io_apic_t*)record;
+    io_apic->record.type = ACPI_MADT_IO_APIC;
+    io_apic->record.length = sizeof(*io_apic);
+    io_apic->id = 4;
+    io_apic->address = 0xFEC00000;
+    io_apic->gsi_base = 0;
+    record += sizeof(*io_apic);
+    acpi_madt_irq_override_t* irq = (acpi_madt_irq_override_t*)record;
+    irq->record.type = ACPI_MADT_IRQ_OVERRIDE;
+    irq->record.length = sizeof(*irq);
+    irq->source = 0;
+    irq->gsi = 2;
+    irq->flags = 0x5;
+    record += sizeof(*irq);
+    acpi_madt_lapic_override_t* lapic = (acpi_madt_lapic_override_t*)record;
+    lapic->record.type = ACPI_MADT_LAPIC_OVERRIDE;
+    lapic->record.length = sizeof(*lapic);
+    lapic->address = 0xFEE10000;
+    seal_table(&madt->header);
+
+    acpi_mcfg_t* mcfg = (acpi_mcfg_t*)new_table("MCFG", sizeof(acpi_mcfg_t) + sizeof(acpi_mcfg_entry_t));
+    mcfg->entries[0].base_address = 0xB0000000;
+    mcfg->entries[0].segment = 0;
+    mcfg->entries[0].start_bus = 0;
+    mcfg->entries[0].end_bus = 0xFF;
+    seal_table(&mcfg->header);
+
+    acpi_hpet_t* hpet = (acpi_hpet_t*)new_table("HPET", sizeof(acpi_hpet_t));
+    hpet->base_address.space_id = ACPI_SPACE_MEMORY;
+    hpet->base_address.address = 0xFED00000;
+    hpet->hpet_number = 0;
+    hpet->minimum_tick = 0x80;
+    seal_table(&hpet->header);
+
+    /* FADT: the extended PM timer block wins over the legacy one */
+    acpi_fadt_t* fadt = (acpi_fadt_t*)new_table("FACP", sizeof(acpi_fadt_t));
+    fadt->sci_interrupt = 9;
+    fadt->pm_timer_block = 0x608;
+    fadt->pm_timer_length = 4;
+    fadt->flags = ACPI_FADT_TIMER_32BIT | ACPI_FADT_RESET_SUPPORTED;
+    fadt->reset_register.space_id = ACPI_SPACE_IO;
+    fadt->reset_register.address = 0xCF9;
+    fadt->reset_value = 0x06;
+    fadt->x_pm_timer_block.space_id = ACPI_SPACE_IO;
+    fadt->x_pm_timer_block.address = 0xB008;
+    seal_table(&fadt->header);
+
+    acpi_sdt_header_t* bad = new_table("BAD!", sizeof(acpi_sdt_header_t));
+    seal_table(bad);
+    bad->checksum ^= 1;
+
+    const acpi_sdt_header_t* tables[] = { &madt->header, &mcfg->header, bad, &hpet->header, &fadt->header };
+    uint32_t count = sizeof(tables) / sizeof(tables[0]);
+    acpi_sdt_header_t* xsdt = new_table("XSDT", sizeof(acpi_sdt_header_t) + 8 * count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t address = address_of(tables[i]);
+        memcpy((uint8_t*)(xsdt + 1) + 8 * i, &address, 8);
+    }
+    seal_table(xsdt);
+
+    /* A bogus RSDT pointer too: revision 2 has to go through the XSDT */
+    const acpi_platform_t* platform = parse(new_rsdp(2, 0xDEAD0000, address_of(xsdt)));
+    CHECK(platform->present && platform->revision == 2 && strcmp(platform->oem_id, "VIBEOS") == 0,
+          "present %d, revision %u, OEM %s", platform->present, platform->revision, platform->oem_id);
+    CHECK(acpi_table_count == 4, "%zu tables kept, expected 4", acpi_table_count);
+    CHECK(acpi_find_table("BAD!") == NULL, "a table with a bad checksum was kept");
+    CHECK(acpi_find_table("MCFG") == &mcfg->header, "MCFG lookup");
+
+    CHECK(platform->local_apic_address == 0xFEE10000, "local APIC at %08x", platform->local_apic_address);
+    CHECK(platform->pic_present, "PC/AT compatibility flag");
+    CHECK(platform->cpu_count == 2, "%u CPUs", platform->cpu_count);
+    CHECK(platform->cpus[0].apic_id == 0 && platform->cpus[1].processor_id == 2 && platform->cpus[1].apic_id == 4,
+          "CPU IDs");
+    CHECK(platform->io_apic_count == 1 && platform->io_apics[0].id == 4 &&
+          platform->io_apics[0].address == 0xFEC00000, "I/O APIC");
+    CHECK(platform->irq_override_count == 1 && platform->irq_overrides[0].flags == 0x5, "IRQ override");
+    CHECK(acpi_isa_irq_to_gsi(0) == 2 && acpi_isa_irq_to_gsi(5) == 5, "ISA IRQ to GSI");
+
+    CHECK(platform->ecam_count == 1 && platform->ecam[0].base_address == 0xB0000000 &&
+          platform->ecam[0].end_bus == 0xFF, "ECAM region");
+    CHECK(platform->hpet_address == 0xFED00000 && platform->hpet_minimum_tick == 0x80, "HPET");
+
+    CHECK(platform->sci_irq == 9, "SCI IRQ %u", platform->sci_irq);
+    CHECK(platform->pm_timer_port == 0xB008 && platform->pm_timer_32bit, "PM timer %04x, 32-bit %d",
+          platform->pm_timer_port, platform->pm_timer_32bit);
+    CHECK(platform->reset_supported && platform->reset_register.address == 0xCF9 && platform->reset_value == 6,
+          "reset register");
+}
+
+/* ACPI 1.0: the RSDT, a FADT that ends after the flags and a MADT whose
+ * last record runs past the table */
+static void test_rsdt(void) {
+    acpi_madt_t* madt = (acpi_madt_t*)new_table("APIC", sizeof(acpi_madt_t) + sizeof(acpi_madt_local_apic_t) + 4);
+    madt->local_apic_address = 0xFEE00000;
+    acpi_madt_local_apic_t* cpu = (acpi_madt_local_apic_t*)madt->entries;
+    cpu->record.type = ACPI_MADT_LOCAL_APIC;
+    cpu->record.length = sizeof(*cpu);
+    cpu->flags = ACPI_MADT_CPU_ENABLED;
+    acpi_madt_io_apic_t* io_apic = (acpi_madt_io_apic_t*)(madt->entries + sizeof(*cpu));
+    io_apic->record.type = ACPI_MADT_IO_APIC;
+    io_apic->record.length = sizeof(*io_apic);
+    seal_table(&madt->header);
+
+    uint32_t fadt_length = offsetof(acpi_fadt_t, reset_register);
+    acpi_fadt_t* fadt = (acpi_fadt_t*)new_table("FACP", fadt_length);
+    fadt->pm_timer_block = 0x4008;
+    fadt->pm_timer_length = 4;
+    fadt->flags = ACPI_FADT_RESET_SUPPORTED;
+    seal_table(&fadt->header);
+
+    acpi_sdt_header_t* rsdt = new_table("RSDT", sizeof(acpi_sdt_header_t) + 8);
+    uint32_t addresses[2] = { address_of(madt), address_of(fadt) };
+    memcpy(rsdt + 1, addresses, sizeof(addresses));
+    seal_table(rsdt);
+
+    const acpi_platform_t* platform = parse(new_rsdp(0, address_of(rsdt), 0));
+    CHECK(platform->present && platform->revision == 0, "ACPI 1.0 present");
+    CHECK(acpi_table_count == 2, "%zu tables kept, expected 2", acpi_table_count);
+    CHECK(platform->cpu_count == 1 && platform->io_apic_count == 0,
+          "%u CPUs, %u I/O APICs from the truncated MADT", platform->cpu_count, platform->io_apic_count);
+    CHECK(platform->ecam_count == 0 && platform->hpet_address == 0, "no MCFG or HPET");
+    CHECK(platform->pm_timer_port == 0x4008 && !platform->pm_timer_32bit, "PM timer %04x",
+          platform->pm_timer_port);
+    CHECK(!platform->reset_supported, "reset register read past a short FADT");
+
+    platform = parse(NULL);
+    CHECK(!platform->present && acpi_find_table("APIC") == NULL, "tables without an RSDP");
+}
+
+int main(void) {
+    /* Table addresses are kept in 32 bits */
+    memory = mmap(NULL, TEST_MEMORY_BYTES, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("table memory");
+        return 2;
+    }
+
+    test_layouts();
+    test_rsdp_search();
+    test_xsdt();
+    test_rsdt();
+
+    printf("ACPI host tests: %lu checks, %lu failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#ifndef KSTD_H
+#define KSTD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+/* Host build of the kernel's freestanding stdlib
+ *
+ * `make host-test` and `make host-bench` compile kernel/stdlib/string.c
+ * and stdio.c with the host compiler against the kernel's own headers,
+ * then prefix every symbol in the objects with kstd_. They link next to
+ * the host C library without clashing, so the same program can call
+ * kstd_memcpy() and glibc's memcpy() and compare them.
+ *
+ * These declarations mirror kernel/stdlib/string.h and stdio.h.
+ */
+
+/* Memory functions */
+void* kstd_memcpy(void* dest, const void* src, size_t n);
+void* kstd_memmove(void* dest, const void* src, size_t n);
+void* kstd_memset(void* s, int c, size_t n);
+int kstd_memcmp(const void* s1, const void* s2, size_t n);
+
+typedef struct {
+    const char* name;
+    void* (*copy)(void* dest, const void* src, size_t n);
+    void* (*move)(void* dest, const void* src, size_t n);
+    void* (*set)(void* s, int c, size_t n);
+    int (*compare)(const void* s1, const void* s2, size_t n);
+} kstd_mem_ops_t;
+
+extern const kstd_mem_ops_t kstd_mem_ops_generic;
+
+/* String functions */
+size_t kstd_strlen(const char* str);
+size_t kstd_strnlen(const char* str, size_t maxlen);
+char* kstd_strcpy(char* dest, const char* src);
+char* kstd_strncpy(char* dest, const char* src, size_t n);
+int kstd_strcmp(const char* s1, const char* s2);
+int kstd_strncmp(const char* s1, const char* s2, size_t n);
+char* kstd_strchr(const char* str, int c);
+char* kstd_strrchr(const char* str, int c);
+size_t kstd_strspn(const char* str, const char* accept);
+size_t kstd_strcspn(const char* str, const char* reject);
+char* kstd_strtok(char* str, const char* delimiters);
+int kstd_atoi(const char* str);
+
+typedef struct {
+    const char* name;
+    size_t (*length)(const char* str);
+    size_t (*length_max)(const char* str, size_t maxlen);
+    char* (*find)(const char* str, int c);
+    char* (*find_last)(const char* str, int c);
+    int (*compare)(const char* s1, const char* s2);
+    size_t (*span)(const char* str, const char* accept);
+    size_t (*complement_span)(const char* str, const char* reject);
+} kstd_str_ops_t;
+
+extern const kstd_str_ops_t kstd_str_ops_swar;
+
+/* Integer conversion */
+size_t kstd_itoa(int32_t value, char* str, int base);
+size_t kstd_utoa(uint32_t value, char* str, int base);
+size_t kstd_lltoa(int64_t value, char* str, int base);
+size_t kstd_ulltoa(uint64_t value, char* str, int base);
+
+/* Formatted output (printf() and puts() go to stdout, see kstd_klog.c) */
+int kstd_printf(const char* format, ...);
+int kstd_snprintf(char* buffer, size_t size, const char* format, ...);
+int kstd_vsnprintf(char* buffer, size_t size, const char* format, va_list args);
+
+#endif /* KSTD_H */
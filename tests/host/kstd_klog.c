@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "kstd.h"
+
+/* The kernel log, as seen by the host build of stdio.c:
+ * messages go straight to stdout */
+
+size_t kstd_klog_write(int level, const char* message, size_t length) {
+    (void)level;
+    return fwrite(message, 1, length, stdout);
+}
+
+int kstd_klog_vprintf(int level, const char* format, va_list args) {
+    char line[512];
+    int length = kstd_vsnprintf(line, sizeof(line), format, args);
+    kstd_klog_write(level, line, (size_t)length);
+    return length;
+}
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* The cache itself, built for the host next to the stubs below */
+#include "../../kernel/page_cache.c"
+
+/* Tests of kernel/page_cache.c on the host
+ *
+ * The cache runs on memory from mmap() below 4 GiB (it keeps frame
+ * addresses in 32 bits, as in the kernel) over a RAM disk that the
+ * block layer stubs below complete at once. Checks ARC's scan
+ * resistance, that a miss with every page held fails cleanly, and that
+ * the radix tree's dirty tags lead writeback to every dirty page, in
+ * index order, and are gone after it. Exits with status 1 if anything
+ * fails.
+ */
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* Report a failed check (only the first few are printed) */
+#define CHECK(cond, ...)                                  \
+    do {                                                  \
+        checks++;                                         \
+        if (!(cond)) {                                    \
+            if (failures++ < 20) {                        \
+                printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+                printf(__VA_ARGS__);                      \
+                printf("\n");                             \
+            }                                             \
+        }                                                 \
+    } while (0)
+
+#define TEST_CACHE_BYTES        (1024 * 1024)
+#define TEST_DISK_SECTORS       (8 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+
+static uint8_t disk[TEST_DISK_SECTORS * BLOCK_SECTOR_SIZE];
+static block_device_t disk_device;
+
+/* Sectors of the bios written, in submission order */
+static uint64_t written_sectors[4096];
+static uint32_t written_count = 0;
+
+/* Block layer and paging stubs */
+
+int paging_map_region(uint32_t start, uint32_t size, uint32_t flags) {
+    (void)start;
+    (void)size;
+    (void)flags;
+    return 0;
+}
+
+int block_submit(bio_t* bio) {
+    uint8_t* at = disk + bio->sector * BLOCK_SECTOR_SIZE;
+    for (uint32_t s = 0; s < bio->segment_count; s++) {
+        const block_segment_t* segment = &bio->segments[s];
+        if (at + segment->len > disk + sizeof(disk)) {
+            bio->status = BIO_ERROR;
+            return 0;
+        }
+        if (bio->write) {
+            memcpy(at, segment->addr, segment->len);
+        } else {
+            memcpy(segment->addr, at, segment->len);
+        }
+        at += segment->len;
+    }
+    if (bio->write && written_count < sizeof(written_sectors) / sizeof(written_sectors[0])) {
+        written_sectors[written_count++] = bio->sector;
+    }
+    bio->status = BIO_DONE;
+    return 0;
+}
+
+int block_wait(bio_t* bio) {
+    return bio->status;
+}
+
+void block_plug(block_device_t* dev) {
+    (void)dev;
+}
+
+void block_unplug(block_device_t* dev) {
+    (void)dev;
+}
+
+/* Read a page through the cache and compare it with the disk
+ * Returns: 1 if it matches */
+static int read_page(page_mapping_t* mapping, uint64_t index) {
+    uint8_t page[PAGE_CACHE_PAGE_SIZE];
+    if (page_cache_read(mapping, index * PAGE_CACHE_PAGE_SIZE, page, sizeof(page)) != (int)sizeof(page)) {
+        return 0;
+    }
+    return memcmp(page, disk + index * PAGE_CACHE_PAGE_SIZE, sizeof(page)) == 0;
+}
+
+/* A hot set read twice sits on T2; a scan of three times the cache's
+ * pages read once only cycles through T1 and leaves it resident */
+static void test_scan_resistance(page_mapping_t* mapping) {
+    uint32_t capacity = page_cache_capacity();
+    uint32_t hot = capacity / 4;
+    const page_cache_stats_t* stats = page_cache_get_stats();
+
+    for (int round = 0; round < 2; round++) {
+        for (uint32_t i = 0; i < hot; i++) {
+            CHECK(read_page(mapping, 100 + i), "hot page %u", i);
+        }
+    }
+    CHECK(page_lists[PAGE_T2].count == hot, "T2 holds %u pages after two passes, expected %u",
+          page_lists[PAGE_T2].count, hot);
+
+    uint64_t evictions = stats->evictions;
+    for (uint32_t i = 0; i < 3 * capacity; i++) {
+        CHECK(read_page(mapping, 1000 + i), "scanned page %u", i);
+    }
+    CHECK(stats->evictions - evictions >= 2 * capacity, "the scan evicted only %llu pages",
+          (unsigned long long)(stats->evictions - evictions));
+
+    uint64_t hits = stats->hits;
+    for (uint32_t i = 0; i < hot; i++) {
+        CHECK(read_page(mapping, 100 + i), "hot page %u after the scan", i);
+    }
+    CHECK(stats->hits - hits == hot, "%llu of %u hot pages hit after the scan",
+          (unsigned long long)(stats->hits - hits), hot);
+
+    page_cache_invalidate(mapping);
+}
+
+/* Count the unused page descriptors */
+static uint32_t free_descriptors(void) {
+    uint32_t count = 0;
+    for (const page_t* page = page_free_list; page; page = page->next) {
+        count++;
+    }
+    return count;
+}
+
+/* With every resident page held a miss fails, and hands its descriptor
+ * back without touching the lists */
+static void test_all_held(page_mapping_t* mapping) {
+    uint32_t capacity = page_cache_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        CHECK(page_cache_get(mapping, 200 + i) != NULL, "hold page %u", i);
+    }
+
+    uint32_t free_before = free_descriptors();
+    CHECK(page_cache_get(mapping, 200 + capacity) == NULL, "a miss succeeded with every page held");
+    CHECK(free_descriptors() == free_before, "%u free descriptors after the failed miss, %u before",
+          free_descriptors(), free_before);
+    CHECK(page_lists[PAGE_FREE].count == 0 && page_lists[PAGE_FREE].head == NULL,
+          "the failed miss touched the free state's list");
+    CHECK(tree_lookup(mapping, 200 + capacity) == NULL, "the failed miss left its page in the tree");
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        page_cache_release(tree_lookup(mapping, 200 + i));
+    }
+    CHECK(read_page(mapping, 200 + capacity), "a miss after the release");
+    page_cache_invalidate(mapping);
+}
+
+/* Check that every node's dirty bits name exactly the slots with a dirty
+ * page below them
+ * Returns: the number of dirty pages under node */
+static uint32_t check_tags(const page_tree_node_t* node) {
+    uint32_t dirty = 0;
+    for (uint32_t slot = 0; slot < PAGE_TREE_SLOTS; slot++) {
+        uint32_t below = 0;
+        if (node->slots[slot] && node->shift == 0) {
+            below = (((const page_t*)node->slots[slot])->flags & PAGE_DIRTY) != 0;
+        } else if (node->slots[slot]) {
+            below = check_tags(node->slots[slot]);
+        }
+        int tagged = (node->dirty >> slot) & 1;
+        CHECK(tagged == (below != 0), "shift %u slot %u: tag %d with %u dirty pages below",
+              node->shift, slot, tagged, below);
+        dirty += below;
+    }
+    return dirty;
+}
+
+/* Pages spread over several tree levels: map index i of the table to sector 8 * i */
+static const uint64_t sparse_indexes[] = {
+    3, 4, 63, 64, 4095, 4096, 262143, 262144, (1ull << 30) + 7, (1ull << 36) + 1, (1ull << 41) + 5,
+};
+#define SPARSE_COUNT (sizeof(sparse_indexes) / sizeof(sparse_indexes[0]))
+
+static int sparse_map(page_mapping_t* mapping, uint64_t index, uint64_t* sector) {
+    (void)mapping;
+    for (uint32_t i = 0; i < SPARSE_COUNT; i++) {
+        if (sparse_indexes[i] == index) {
+            *sector = (uint64_t)i * PAGE_CACHE_PAGE_SECTORS;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Dirty tags follow writes up to the root, also when the tree grows a
+ * new root above a dirty page, and lead writeback to the pages in order */
+static void test_dirty_tags(void) {
+    static page_mapping_t sparse;
+    CHECK(page_mapping_init(&sparse, &disk_device, 1ull << 42 << 12, sparse_map, NULL) == 0,
+          "sparse mapping");
+
+    /* Dirty every other page but the last, smallest index last */
+    uint8_t data[PAGE_CACHE_PAGE_SIZE];
+    uint32_t dirtied = 0;
+    for (uint32_t i = SPARSE_COUNT - 1; i-- > 0;) {
+        if (i % 2) continue;
+        memset(data, (int)(0x40 + i), sizeof(data));
+        CHECK(page_cache_write(&sparse, sparse_indexes[i] * PAGE_CACHE_PAGE_SIZE, data, sizeof(data)) ==
+              (int)sizeof(data), "write page %llu", (unsigned long long)sparse_indexes[i]);
+        dirtied++;
+        CHECK(check_tags(sparse.root) == dirtied, "tags after %u writes", dirtied);
+    }
+
+    /* The last page lies past the root's reach: the tree grows new roots
+     * above the dirty pages, and their tags must follow */
+    uint8_t root_shift = sparse.root ? sparse.root->shift : 0;
+    uint32_t last = SPARSE_COUNT - 1;
+    memset(data, (int)(0x40 + last), sizeof(data));
+    CHECK(page_cache_write(&sparse, sparse_indexes[last] * PAGE_CACHE_PAGE_SIZE, data, sizeof(data)) ==
+          (int)sizeof(data), "write the last page");
+    dirtied++;
+    CHECK(sparse.root && sparse.root->shift > root_shift, "the tree did not grow");
+    CHECK(check_tags(sparse.root) == dirtied, "tags after the tree grew");
+    CHECK(sparse.dirty == dirtied, "%u dirty pages counted, %u written", sparse.dirty, dirtied);
+
+    written_count = 0;
+    CHECK(page_cache_sync(&sparse) == 0, "sync");
+    CHECK(written_count == dirtied, "%u pages written back, %u dirty", written_count, dirtied);
+    for (uint32_t i = 0, w = 0; i < SPARSE_COUNT && w < written_count; i += 2, w++) {
+        CHECK(written_sectors[w] == (uint64_t)i * PAGE_CACHE_PAGE_SECTORS,
+              "writeback %u went to sector %llu, expected page %u's", w,
+              (unsigned long long)written_sectors[w], i);
+        CHECK(disk[i * PAGE_CACHE_PAGE_SIZE] == 0x40 + i, "page %u on the disk", i);
+    }
+    CHECK(sparse.dirty == 0 && sparse.root && sparse.root->dirty == 0, "dirty state left after the sync");
+    CHECK(check_tags(sparse.root) == 0, "tags after the sync");
+
+    /* A clean page dirtied again is tagged again */
+    memset(data, 0x7F, sizeof(data));
+    page_cache_write(&sparse, sparse_indexes[1] * PAGE_CACHE_PAGE_SIZE, data, sizeof(data));
+    CHECK(check_tags(sparse.root) == 1, "tags with one dirty page");
+    CHECK(page_cache_sync(&sparse) == 0 && check_tags(sparse.root) == 0, "tags after the second sync");
+    page_cache_invalidate(&sparse);
+    CHECK(sparse.root == NULL && sparse.pages == 0, "sparse mapping empty after invalidate");
+}
+
+int main(void) {
+    /* Frame addresses are kept in 32 bits */
+    void* memory = mmap(NULL, TEST_CACHE_BYTES, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("cache memory");
+        return 2;
+    }
+    uint32_t start = (uint32_t)(uintptr_t)memory;
+    CHECK(page_cache_init(start, start + 64 * 1024) == -1, "a 64 KiB cache is refused");
+    if (page_cache_init(start, start + TEST_CACHE_BYTES) != 0) {
+        printf("page_cache_init failed\n");
+        return 2;
+    }
+
+    for (uint32_t i = 0; i < sizeof(disk) / sizeof(uint32_t); i++) {
+        ((uint32_t*)disk)[i] = i * 2654435761u;
+    }
+    disk_device.sectors = TEST_DISK_SECTORS;
+    page_mapping_t* mapping = page_cache_device(&disk_device);
+    CHECK(mapping != NULL, "device mapping");
+    if (!mapping) return 1;
+
+    test_scan_resistance(mapping);
+    test_all_held(mapping);
+    test_dirty_tags();
+
+    printf("page cache host tests: %lu checks, %lu failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
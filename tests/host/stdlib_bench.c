@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "kstd.h"
+
+/* Host benchmark of the kernel stdlib next to the host C library
+ *
+ * Reports cycles per byte for the memory and string functions at a
+ * range of sizes, and calls per second for snprintf() with typical
+ * kernel formats. Numbers are only comparable on the same machine.
+ */
+
+#define BENCH_MAX_SIZE  (64 * 1024)
+
+/* Bytes processed per measurement, so small sizes get enough calls */
+#define BENCH_BYTES     (64 * 1024 * 1024)
+
+/* Calls per snprintf measurement */
+#define BENCH_FORMAT_CALLS 2000000
+
+static unsigned char* bench_src;
+static unsigned char* bench_dst;
+
+/* Keeps results alive so calls are not optimized away */
+static volatile uintptr_t sink;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Operations being measured; each runs one call on size bytes */
+typedef enum {
+    BENCH_MEMCPY,
+    BENCH_MEMSET,
+    BENCH_MEMCMP,
+    BENCH_STRLEN,
+    BENCH_STRCHR,
+    BENCH_STRCMP,
+    BENCH_OP_COUNT
+} bench_op_t;
+
+static const char* const op_names[] = {
+    "memcpy", "memset", "memcmp", "strlen", "strchr", "strcmp"
+};
+
+static void run_op(bench_op_t op, int kernel, size_t size, uint32_t calls) {
+    const char* str = (const char*)bench_src;
+    const char* other = (const char*)bench_dst;
+
+    for (uint32_t i = 0; i < calls; i++) {
+        switch (op) {
+            case BENCH_MEMCPY:
+                sink += (uintptr_t)(kernel ? kstd_memcpy(bench_dst, bench_src, size)
+                                           : memcpy(bench_dst, bench_src, size));
+                break;
+            case BENCH_MEMSET:
+                sink += (uintptr_t)(kernel ? kstd_memset(bench_dst, (int)i, size)
+                                           : memset(bench_dst, (int)i, size));
+                break;
+            case BENCH_MEMCMP:
+                sink += kernel ? kstd_memcmp(bench_dst, bench_src, size)
+                               : memcmp(bench_dst, bench_src, size);
+                break;
+            case BENCH_STRLEN:
+                sink += kernel ? kstd_strlen(str) : strlen(str);
+                break;
+            case BENCH_STRCHR:
+                sink += (uintptr_t)(kernel ? kstd_strchr(str, 'z') : strchr(str, 'z'));
+                break;
+            case BENCH_STRCMP:
+                sink += kernel ? kstd_strcmp(str, other) : strcmp(str, other);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Set up the buffers so op scans all size bytes */
+static void prepare(bench_op_t op, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        bench_src[i] = (unsigned char)('a' + i % 23);
+    }
+    if (op >= BENCH_STRLEN) {
+        bench_src[size - 1] = '\0';
+    }
+    memcpy(bench_dst, bench_src, size);
+}
+
+/* Print one size row: cycles per byte and calls per second, kstd vs host */
+static void bench_row(bench_op_t op, size_t size) {
+    uint32_t calls = BENCH_BYTES / size;
+    double cycles_per_byte[2], calls_per_second[2];
+
+    for (int kernel = 1; kernel >= 0; kernel--) {
+        prepare(op, size);
+        run_op(op, kernel, size, calls / 16 + 1);
+
+        double start_time = now_seconds();
+        uint64_t start = __rdtsc();
+        run_op(op, kernel, size, calls);
+        uint64_t cycles = __rdtsc() - start;
+        double elapsed = now_seconds() - start_time;
+
+        cycles_per_byte[kernel] = (double)cycles / ((double)size * calls);
+        calls_per_second[kernel] = elapsed > 0 ? calls / elapsed : 0;
+    }
+
+    printf("  %7zu  %10.3f  %12.0f  %10.3f  %12.0f\n", size,
+           cycles_per_byte[1], calls_per_second[1],
+           cycles_per_byte[0], calls_per_second[0]);
+}
+
+/* snprintf() calls per second for one format, kstd vs host */
+#define BENCH_FORMAT(label, ...)                                              \
+    do {                                                                      \
+        char line[128];                                                       \
+        double start = now_seconds();                                         \
+        for (uint32_t i = 0; i < BENCH_FORMAT_CALLS; i++) {                   \
+            sink += kstd_snprintf(line, sizeof(line), __VA_ARGS__);           \
+        }                                                                     \
+        double kernel_rate = BENCH_FORMAT_CALLS / (now_seconds() - start);    \
+        start = now_seconds();                                                \
+        for (uint32_t i = 0; i < BENCH_FORMAT_CALLS; i++) {                   \
+            sink += snprintf(line, sizeof(line), __VA_ARGS__);                \
+        }                                                                     \
+        double host_rate = BENCH_FORMAT_CALLS / (now_seconds() - start);      \
+        printf("  %-12s  %12.0f  %12.0f\n", label, kernel_rate, host_rate);   \
+    } while (0)
+
+static void bench_formats(void) {
+    printf("snprintf calls/s:\n  %-12s  %12s  %12s\n", "format", "kstd", "host");
+    BENCH_FORMAT("%u", "%u", i * 2654435761u);
+    BENCH_FORMAT("%08x", "%08x", i * 2654435761u);
+    BENCH_FORMAT("%llu", "%llu", (unsigned long long)i * 0x9E3779B97F4A7C15ull);
+    BENCH_FORMAT("%s", "%s", "a kernel log message");
+    BENCH_FORMAT("log line", "[%5llu.%06u] %-8s dev %02x:%02x.%x id %04x:%04x",
+                 (unsigned long long)i, i % 1000000, "pci", i & 0xFF, i & 0x1F, i & 7,
+                 0x8086u, 0x7010u);
+}
+
+int main(void) {
+    bench_src = aligned_alloc(64, BENCH_MAX_SIZE + 64);
+    bench_dst = aligned_alloc(64, BENCH_MAX_SIZE + 64);
+    if (!bench_src || !bench_dst) return 2;
+
+    for (int op = 0; op < BENCH_OP_COUNT; op++) {
+        printf("%s:\n     size  %10s  %12s  %10s  %12s\n", op_names[op],
+               "kstd c/B", "kstd calls/s", "host c/B", "host calls/s");
+        for (size_t size = 16; size <= BENCH_MAX_SIZE; size *= 4) {
+            bench_row((bench_op_t)op, size);
+        }
+    }
+    bench_formats();
+    return 0;
+}
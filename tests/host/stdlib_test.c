@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "kstd.h"
+
+/* Differential tests of the kernel stdlib against the host C library
+ *
+ * Every kstd_ function is run on the same inputs as its glibc
+ * counterpart: all small sizes at every alignment, strings ending right
+ * before an unmapped page, and a few hundred thousand random printf
+ * format strings. Exits with status 1 if anything differs.
+ */
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* Report a mismatch (only the first few are printed) */
+#define CHECK(cond, ...)                                  \
+    do {                                                  \
+        checks++;                                         \
+        if (!(cond)) {                                    \
+            if (failures++ < 20) {                        \
+                printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+                printf(__VA_ARGS__);                      \
+                printf("\n");                             \
+            }                                             \
+        }                                                 \
+    } while (0)
+
+static int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+/* xorshift32, so runs are reproducible */
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t rng64(void) {
+    uint64_t high = rng();
+    return (high << 32) | rng();
+}
+
+/* Two readable pages followed by an unmapped one */
+static char* guard_top;
+
+static void setup_guard_page(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    char* area = mmap(NULL, 3 * page, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED || mprotect(area + 2 * page, page, PROT_NONE) != 0) {
+        perror("guard page");
+        exit(2);
+    }
+    guard_top = area + 2 * page;
+}
+
+/* Memory functions at every size up to 300 and every alignment */
+static void test_memory(void) {
+    enum { MAX = 300, PAD = 32 };
+    static unsigned char src[MAX + 2 * PAD], expect[MAX + 2 * PAD], actual[MAX + 2 * PAD];
+
+    for (size_t i = 0; i < sizeof(src); i++) src[i] = (unsigned char)rng();
+
+    for (size_t n = 0; n <= MAX; n++) {
+        for (size_t dalign = 0; dalign < 16; dalign++) {
+            size_t salign = (dalign * 7 + n) % 16;
+
+            memset(expect, 0xEE, sizeof(expect));
+            memset(actual, 0xEE, sizeof(actual));
+            memcpy(expect + dalign, src + salign, n);
+            void* ret = kstd_memcpy(actual + dalign, src + salign, n);
+            CHECK(ret == actual + dalign && memcmp(expect, actual, sizeof(actual)) == 0,
+                  "memcpy n=%zu dest+%zu src+%zu", n, dalign, salign);
+
+            memset(expect + dalign, (int)(n + 0x1F0), n);
+            ret = kstd_memset(actual + dalign, (int)(n + 0x1F0), n);
+            CHECK(ret == actual + dalign && memcmp(expect, actual, sizeof(actual)) == 0,
+                  "memset n=%zu dest+%zu", n, dalign);
+
+            /* Overlapping moves in both directions */
+            memcpy(expect, src, sizeof(src));
+            memcpy(actual, src, sizeof(src));
+            memmove(expect + dalign, expect + salign, n);
+            ret = kstd_memmove(actual + dalign, actual + salign, n);
+            CHECK(ret == actual + dalign && memcmp(expect, actual, sizeof(actual)) == 0,
+                  "memmove n=%zu dest+%zu src+%zu", n, dalign, salign);
+
+            /* Equal, then one byte changed (both directions of difference) */
+            memcpy(actual + dalign, src + salign, n);
+            CHECK(kstd_memcmp(actual + dalign, src + salign, n) == 0, "memcmp equal n=%zu", n);
+            if (n > 0) {
+                size_t pos = rng() % n;
+                actual[dalign + pos] ^= (unsigned char)(1 + rng() % 255);
+                CHECK(sign(kstd_memcmp(actual + dalign, src + salign, n)) ==
+                      sign(memcmp(actual + dalign, src + salign, n)), "memcmp n=%zu pos=%zu", n, pos);
+            }
+        }
+    }
+}
+
+/* Fill a string of len bytes from a small alphabet (with high bytes) */
+static void fill_string(char* str, size_t len) {
+    static const char alphabet[] = "abcd,; \x80\xE1";
+    for (size_t i = 0; i < len; i++) {
+        str[i] = alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    str[len] = '\0';
+}
+
+/* Every string function on one string, against glibc */
+static void check_string(const char* str, char* scratch) {
+    size_t len = strlen(str);
+    static const int chars[] = { 'a', 'd', ',', 'z', 0xE1, '\x80', 0x100 + 'b', 0 };
+
+    CHECK(kstd_strlen(str) == len, "strlen len=%zu", len);
+    for (size_t max = 0; max <= len + 2; max++) {
+        CHECK(kstd_strnlen(str, max) == strnlen(str, max), "strnlen len=%zu max=%zu", len, max);
+    }
+    CHECK(kstd_strnlen(str, SIZE_MAX) == len, "strnlen unbounded len=%zu", len);
+
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); i++) {
+        CHECK(kstd_strchr(str, chars[i]) == strchr(str, chars[i]), "strchr len=%zu c=%#x", len, chars[i]);
+        CHECK(kstd_strrchr(str, chars[i]) == strrchr(str, chars[i]), "strrchr len=%zu c=%#x", len, chars[i]);
+    }
+
+    static const char* const sets[] = { "", "a", "ab", "abcd", ", ;", "\x80\xE1", "z" };
+    for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        CHECK(kstd_strspn(str, sets[i]) == strspn(str, sets[i]), "strspn len=%zu set=%zu", len, i);
+        CHECK(kstd_strcspn(str, sets[i]) == strcspn(str, sets[i]), "strcspn len=%zu set=%zu", len, i);
+    }
+
+    /* scratch holds a copy: equal, changed at one byte, then cut short */
+    strcpy(scratch, str);
+    CHECK(kstd_strcmp(str, scratch) == 0, "strcmp equal len=%zu", len);
+    if (len > 0) {
+        size_t pos = rng() % len;
+        char saved = scratch[pos];
+        scratch[pos] = (char)(saved + 1 + rng() % 254);
+        CHECK(sign(kstd_strcmp(str, scratch)) == sign(strcmp(str, scratch)), "strcmp len=%zu", len);
+        CHECK(sign(kstd_strcmp(scratch, str)) == sign(strcmp(scratch, str)), "strcmp len=%zu", len);
+        CHECK(sign(kstd_strncmp(str, scratch, pos + 1)) == sign(strncmp(str, scratch, pos + 1)),
+              "strncmp len=%zu", len);
+        CHECK(kstd_strncmp(str, scratch, pos) == 0, "strncmp prefix len=%zu", len);
+        scratch[pos] = '\0';
+        CHECK(sign(kstd_strcmp(str, scratch)) == sign(strcmp(str, scratch)), "strcmp short len=%zu", len);
+        CHECK(sign(kstd_strcmp(scratch, str)) == sign(strcmp(scratch, str)), "strcmp short len=%zu", len);
+        scratch[pos] = saved;
+    }
+}
+
+/* String functions at every alignment, and next to an unmapped page */
+static void test_strings(void) {
+    static char buffer[256 + 32], scratch[256 + 32];
+
+    for (size_t len = 0; len <= 200; len++) {
+        for (size_t align = 0; align < 16; align++) {
+            fill_string(buffer + align, len);
+            check_string(buffer + align, scratch + (align * 3) % 16);
+        }
+
+        /* Terminator in the last readable byte, compared against
+         * a copy that also ends there */
+        char* str = guard_top - len - 1;
+        fill_string(str, len);
+        check_string(str, scratch + len % 16);
+        strcpy(buffer + 1, str);
+        check_string(buffer + 1, guard_top - len - 1);
+    }
+
+    /* Copies: bytes past the copy must stay untouched */
+    for (size_t len = 0; len <= 64; len++) {
+        char src[80], expect[96], actual[96];
+        fill_string(src, len);
+        for (size_t n = 0; n <= len + 4; n++) {
+            memset(expect, 'x', sizeof(expect));
+            memset(actual, 'x', sizeof(actual));
+            size_t copied = strnlen(src, n);  /* What strncpy() does, spelled out */
+            memcpy(expect, src, copied);
+            memset(expect + copied, 0, n - copied);
+            CHECK(kstd_strncpy(actual, src, n) == actual && memcmp(expect, actual, sizeof(actual)) == 0,
+                  "strncpy len=%zu n=%zu", len, n);
+        }
+        memset(expect, 'x', sizeof(expect));
+        memset(actual, 'x', sizeof(actual));
+        strcpy(expect, src);
+        CHECK(kstd_strcpy(actual, src) == actual && memcmp(expect, actual, sizeof(actual)) == 0,
+              "strcpy len=%zu", len);
+    }
+
+    /* Tokenizing the same string must give the same tokens */
+    for (int round = 0; round < 2000; round++) {
+        char expect[64], actual[64];
+        fill_string(expect, rng() % 60);
+        strcpy(actual, expect);
+        char* e = strtok(expect, ", ");
+        char* a = kstd_strtok(actual, ", ");
+        while (e && a && e - expect == a - actual && strcmp(e, a) == 0) {
+            e = strtok(NULL, ", ");
+            a = kstd_strtok(NULL, ", ");
+        }
+        CHECK(e == NULL && a == NULL, "strtok round %d", round);
+    }
+
+    static const char* const numbers[] = {
+        "0", "42", "-17", "+8", "  \t\n123abc", "2147483647", "-2147483648", "", "-", "x1"
+    };
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        CHECK(kstd_atoi(numbers[i]) == atoi(numbers[i]), "atoi \"%s\"", numbers[i]);
+    }
+}
+
+/* Integer conversion against printf and a plain reference */
+static void test_integers(void) {
+    char expect[80], actual[80];
+
+    for (int round = 0; round < 200000; round++) {
+        /* Spread values over all digit counts */
+        uint64_t value = rng64() >> (rng() % 64);
+        size_t length;
+
+        length = kstd_ulltoa(value, actual, 10);
+        snprintf(expect, sizeof(expect), "%" PRIu64, value);
+        CHECK(strcmp(expect, actual) == 0 && length == strlen(expect), "ulltoa %s", expect);
+
+        length = kstd_ulltoa(value, actual, 16);
+        snprintf(expect, sizeof(expect), "%" PRIx64, value);
+        CHECK(strcmp(expect, actual) == 0 && length == strlen(expect), "ulltoa hex %s", expect);
+
+        length = kstd_lltoa((int64_t)value, actual, 10);
+        snprintf(expect, sizeof(expect), "%" PRId64, (int64_t)value);
+        CHECK(strcmp(expect, actual) == 0 && length == strlen(expect), "lltoa %s", expect);
+
+        length = kstd_itoa((int32_t)value, actual, 10);
+        snprintf(expect, sizeof(expect), "%" PRId32, (int32_t)value);
+        CHECK(strcmp(expect, actual) == 0 && length == strlen(expect), "itoa %s", expect);
+
+        length = kstd_utoa((uint32_t)value, actual, 8);
+        snprintf(expect, sizeof(expect), "%" PRIo32, (uint32_t)value);
+        CHECK(strcmp(expect, actual) == 0 && length == strlen(expect), "utoa octal %s", expect);
+
+        /* Other bases against a digit-by-digit reference */
+        int base = 2 + rng() % 35;
+        char* p = expect + sizeof(expect) - 1;
+        uint64_t rest = value;
+        *p = '\0';
+        do {
+            int digit = (int)(rest % base);
+            *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            rest /= base;
+        } while (rest);
+        length = kstd_ulltoa(value, actual, base);
+        CHECK(strcmp(p, actual) == 0 && length == strlen(p), "ulltoa base %d %s", base, p);
+    }
+}
+
+/* Append one random conversion spec to fmt and format it with both
+ * implementations (single argument, or width/precision from '*') */
+static void check_random_format(void) {
+    static const char conversions[] = "diuxXoscp%";
+    static const char* const lengths[] = { "", "hh", "h", "l", "ll", "z", "j", "t" };
+    char fmt[64];
+    size_t pos = 0;
+
+    char conv = conversions[rng() % (sizeof(conversions) - 1)];
+    int numeric = strchr("diuxXo", conv) != NULL;
+    int is_signed = conv == 'd' || conv == 'i';
+
+    /* %p layout is implementation-defined; the kernel zero-pads it
+     * to the width, so only the bare form is compared */
+    int plain = conv == '%' || conv == 'p';
+
+    fmt[pos++] = '<';
+    fmt[pos++] = '%';
+    if (!plain) {
+        /* Only flag combinations the C standard defines for this conversion */
+        if (rng() % 3 == 0) fmt[pos++] = '-';
+        if (numeric && rng() % 3 == 0) fmt[pos++] = '0';
+        if (is_signed && rng() % 4 == 0) fmt[pos++] = '+';
+        if (is_signed && rng() % 4 == 0) fmt[pos++] = ' ';
+        if (strchr("xXo", conv) && rng() % 3 == 0) fmt[pos++] = '#';
+    }
+
+    int star_width = 0, star_precision = 0;
+    if (!plain && rng() % 2) {
+        if (rng() % 4 == 0) {
+            fmt[pos++] = '*';
+            star_width = 1;
+        } else {
+            pos += snprintf(fmt + pos, sizeof(fmt) - pos, "%u", rng() % 24);
+        }
+    }
+    if ((numeric || conv == 's') && rng() % 2) {
+        fmt[pos++] = '.';
+        if (rng() % 4 == 0) {
+            fmt[pos++] = '*';
+            star_precision = 1;
+        } else if (rng() % 5) {
+            pos += snprintf(fmt + pos, sizeof(fmt) - pos, "%u", rng() % 24);
+        }
+    }
+
+    const char* length = numeric ? lengths[rng() % 8] : "";
+    pos += snprintf(fmt + pos, sizeof(fmt) - pos, "%s%c>", length, conv);
+    fmt[pos] = '\0';
+
+    int width = (int)(rng() % 40) - 10;
+    int precision = (int)(rng() % 30) - 5;
+    uint64_t raw = rng64() >> (rng() % 64);
+    static const char* const strings[] = { "", "x", "hello", "a longer string argument" };
+    const char* text = strings[rng() % 4];
+    void* pointer = (void*)(uintptr_t)(raw | 1);
+
+    char expect[256], actual[256];
+    int expect_length, actual_length;
+
+    /* Call both with the argument list this spec needs */
+#define FORMAT_BOTH(...)                                                          \
+    do {                                                                          \
+        if (star_width && star_precision) {                                       \
+            expect_length = snprintf(expect, sizeof(expect), fmt, width, precision, __VA_ARGS__); \
+            actual_length = kstd_snprintf(actual, sizeof(actual), fmt, width, precision, __VA_ARGS__); \
+        } else if (star_width || star_precision) {                                \
+            int star = star_width ? width : precision;                            \
+            expect_length = snprintf(expect, sizeof(expect), fmt, star, __VA_ARGS__); \
+            actual_length = kstd_snprintf(actual, sizeof(actual), fmt, star, __VA_ARGS__); \
+        } else {                                                                  \
+            expect_length = snprintf(expect, sizeof(expect), fmt, __VA_ARGS__);   \
+            actual_length = kstd_snprintf(actual, sizeof(actual), fmt, __VA_ARGS__); \
+        }                                                                         \
+    } while (0)
+
+    if (conv == 's') {
+        FORMAT_BOTH(text);
+    } else if (conv == 'c') {
+        FORMAT_BOTH((int)(' ' + raw % 95));
+    } else if (conv == 'p') {
+        FORMAT_BOTH(pointer);
+    } else if (conv == '%') {
+        FORMAT_BOTH(0);
+    } else if (!strcmp(length, "ll") || !strcmp(length, "j")) {
+        FORMAT_BOTH((unsigned long long)raw);
+    } else if (!strcmp(length, "l") || !strcmp(length, "z") || !strcmp(length, "t")) {
+        FORMAT_BOTH((unsigned long)raw);
+    } else {
+        FORMAT_BOTH((unsigned int)raw);
+    }
+#undef FORMAT_BOTH
+
+    CHECK(expect_length == actual_length && strcmp(expect, actual) == 0,
+          "snprintf \"%s\": expected \"%s\", got \"%s\"", fmt, expect, actual);
+
+    /* Truncated output: same prefix, always terminated.
+     * The kernel returns the stored length, not the full one. */
+    size_t size = rng() % (strlen(expect) + 2);
+    char small[256];
+    memset(small, 'x', sizeof(small));
+    int stored = kstd_snprintf(small, size, "%s", expect);
+    if (size == 0) {
+        CHECK(stored == 0 && small[0] == 'x', "snprintf size 0 \"%s\"", fmt);
+    } else {
+        CHECK(strncmp(small, expect, size - 1) == 0 && strlen(small) == (size_t)stored &&
+              stored <= (int)(size - 1), "snprintf size %zu \"%s\"", size, fmt);
+    }
+}
+
+static void test_printf(void) {
+    for (int round = 0; round < 300000; round++) {
+        check_random_format();
+    }
+
+    /* Several conversions in one call, as kernel log lines use them */
+    char expect[256], actual[256];
+    snprintf(expect, sizeof(expect), "[%5llu.%06u] %-8s %#010x %p %c%%",
+             123456ULL, 42u, "pci", 0xBEEFu, (void*)expect, 'k');
+    kstd_snprintf(actual, sizeof(actual), "[%5llu.%06u] %-8s %#010x %p %c%%",
+                  123456ULL, 42u, "pci", 0xBEEFu, (void*)expect, 'k');
+    CHECK(strcmp(expect, actual) == 0, "log line: expected \"%s\", got \"%s\"", expect, actual);
+}
+
+int main(void) {
+    setup_guard_page();
+
+    test_memory();
+    test_strings();
+    test_integers();
+    test_printf();
+
+    printf("stdlib host tests: %lu checks, %lu failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Compare `make bench` results with a stored baseline.
+
+Both files hold the JSON lines the kernel writes to COM1, one object
+per benchmark case. Cases are matched by name and compared on
+cycles_per_iter; a case more than --threshold percent slower than
+the baseline is a regression and makes the script exit with status 1.
+
+Usage: bench_compare.py [--threshold PERCENT] BASELINE RESULTS
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    """Return {name: result} for the benchmark lines of a results file."""
+    results = {}
+    with open(path) as lines:
+        for line in lines:
+            line = line.strip()
+            if not line.startswith('{"bench":'):
+                continue
+            result = json.loads(line)
+            results[result["bench"]] = result
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="slowdown in percent reported as a regression (default 10)")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    args = parser.parse_args()
+
+    results = load(args.results)
+    if not results:
+        print(f"no benchmark results in {args.results}")
+        return 1
+
+    try:
+        baseline = load(args.baseline)
+    except FileNotFoundError:
+        print(f"no baseline at {args.baseline} (create one with make bench-baseline)")
+        baseline = {}
+
+    regressions = 0
+    print(f"{'case':<16} {'baseline':>12} {'now':>12} {'change':>9}")
+    for name, result in results.items():
+        if result.get("skipped"):
+            print(f"{name:<16} {'':>12} {'skipped':>12}")
+            continue
+        now = result["cycles_per_iter"]
+        before = baseline.get(name, {}).get("cycles_per_iter")
+        if not before:
+            print(f"{name:<16} {'-':>12} {now:>12.2f}")
+            continue
+        change = (now - before) * 100.0 / before
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  faster"
+        print(f"{name:<16} {before:>12.2f} {now:>12.2f} {change:>+8.1f}%{mark}")
+
+    print("(cycles per iteration)")
+    if regressions:
+        print(f"{regressions} case(s) more than {args.threshold:g}% slower than the baseline")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
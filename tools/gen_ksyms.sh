@@ -0,0 +1,29 @@
+#!/bin/sh
+# Turn `nm -n` output on stdin into the kernel symbol table (kernel/ksyms.c).
+# With empty input it emits an empty table, for the first link.
+#
+# Layout: symbol count, addresses, name offsets, then the names. Only the
+# start is referenced from code, so the table can grow between links.
+awk '
+BEGIN { count = 0 }
+$2 == "T" || $2 == "t" {
+    address[count] = $1
+    name[count] = $3
+    count++
+}
+END {
+    print "    .section .ksyms, \"a\""
+    print "    .balign 4"
+    print "    .global ksym_table"
+    print "ksym_table:"
+    print "    .long " count
+    for (i = 0; i < count; i++) print "    .long 0x" address[i]
+    offset = 0
+    for (i = 0; i < count; i++) {
+        print "    .long " offset
+        offset += length(name[i]) + 1
+    }
+    for (i = 0; i < count; i++) print "    .asciz \"" name[i] "\""
+    print ""
+    print "    .section .note.GNU-stack, \"\", @progbits"
+}'
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Generate the kernel's PCI ID tables from a pci.ids file.
+
+Reads the vendor, device and class sections of pci.ids (the format of
+https://pci-ids.ucw.cz/) and writes a C source with three minimal
+perfect hash tables over one string pool:
+
+  pci_vendor_ids   key = vendor
+  pci_device_ids   key = vendor << 16 | device
+  pci_class_ids    key = class << 8 | subclass, and 0x10000 | class for
+                   the class name itself
+
+Each table uses hash and displace: a key goes to bucket
+hash(key, 0) % bucket_count, and every bucket has a 16-bit seed chosen
+so that hash(key, seed) % count gives each key its own slot. A lookup is
+two hashes and one compare of the stored key (kernel/drivers/pci_db.c).
+Names are stored once; a name that is the tail of another shares its
+bytes. Subsystems and programming interfaces are skipped.
+
+Usage: gen_pci_ids.py PCI_IDS OUTPUT_C
+"""
+
+import sys
+
+SEED_LIMIT = 1 << 16
+MASK = 0xFFFFFFFF
+
+
+def pci_id_hash(key, seed):
+    """Must match pci_id_hash() in kernel/drivers/pci_db.c."""
+    h = (key ^ (seed * 0x9E3779B9)) & MASK
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def parse(path):
+    """Return ({vendor key: name}, {device key: name}, {class key: name})."""
+    vendors, devices, classes = {}, {}, {}
+    vendor = None
+    class_code = None
+    with open(path, encoding="utf-8", errors="replace") as ids:
+        for number, line in enumerate(ids, 1):
+            line = line.rstrip("\r\n")
+            if not line.strip() or line.startswith("#"):
+                continue
+            depth = len(line) - len(line.lstrip("\t"))
+            text = line.lstrip("\t")
+            try:
+                if depth == 0 and text.startswith("C "):
+                    code, name = text[2:].split(None, 1)
+                    vendor, class_code = None, int(code, 16)
+                    classes[0x10000 | class_code] = name.strip()
+                elif depth == 0:
+                    code, name = text.split(None, 1)
+                    vendor, class_code = int(code, 16), None
+                    vendors[vendor] = name.strip()
+                elif depth == 1 and vendor is not None:
+                    code, name = text.split(None, 1)
+                    devices[vendor << 16 | int(code, 16)] = name.strip()
+                elif depth == 1 and class_code is not None:
+                    code, name = text.split(None, 1)
+                    classes[class_code << 8 | int(code, 16)] = name.strip()
+                # Subsystems and programming interfaces (depth 2) are not used
+            except ValueError:
+                sys.exit(f"{path}:{number}: cannot parse {line!r}")
+    return vendors, devices, classes
+
+
+def place(keys, bucket_count):
+    """Return (seeds, slots) for bucket_count buckets, or None if a bucket
+    finds no seed."""
+    count = len(keys)
+    buckets = [[] for _ in range(bucket_count)]
+    for key in keys:
+        buckets[pci_id_hash(key, 0) % bucket_count].append(key)
+
+    # Fullest buckets first, while most slots are still free
+    seeds = [0] * bucket_count
+    slots = [None] * count
+    for b in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+        members = buckets[b]
+        if not members:
+            break
+        for seed in range(SEED_LIMIT):
+            wanted = [pci_id_hash(key, seed) % count for key in members]
+            if len(set(wanted)) == len(wanted) and all(slots[s] is None for s in wanted):
+                break
+        else:
+            return None
+        seeds[b] = seed
+        for key, slot in zip(members, wanted):
+            slots[slot] = key
+    return seeds, slots
+
+
+def build_hash(keys):
+    """Return (seeds, slots): per-bucket seeds and the key in each slot."""
+    if not keys:
+        return [0], [None]
+    # Fewer keys per bucket cost seed space but make every bucket easier to place
+    for keys_per_bucket in (4, 3, 2, 1):
+        result = place(keys, (len(keys) + keys_per_bucket - 1) // keys_per_bucket)
+        if result is not None:
+            return result
+    sys.exit("gen_pci_ids.py: no perfect hash found")
+
+
+def build_strings(names):
+    """Return (pool bytes, {name: offset}), sharing tails between names."""
+    encoded = {name: name.encode("utf-8") + b"\0" for name in set(names)}
+    # Sorted by reversed bytes, a name that is the tail of another comes
+    # right before the first name it is a tail of
+    order = sorted(encoded, key=lambda name: encoded[name][::-1])
+    pool = bytearray()
+    offsets = {}
+    for index in range(len(order) - 1, -1, -1):
+        name = order[index]
+        data = encoded[name]
+        if index + 1 < len(order):
+            longer = order[index + 1]
+            if encoded[longer].endswith(data):
+                offsets[name] = offsets[longer] + len(encoded[longer]) - len(data)
+                continue
+        offsets[name] = len(pool)
+        pool += data
+    return bytes(pool), offsets
+
+
+def c_string(data):
+    """Render pool bytes as C string literal lines."""
+    lines = []
+    line = ""
+    for byte in data:
+        if byte == 0:
+            line += "\\0"
+            lines.append(line)
+            line = ""
+            continue
+        char = chr(byte)
+        if char in "\\\"" or byte < 0x20 or byte >= 0x7F or char == "?":
+            line += f"\\{byte:03o}"
+        else:
+            line += char
+    if line:
+        lines.append(line)
+    return "\n".join(f'    "{line}"' for line in lines) or '    ""'
+
+
+def emit_table(out, name, entries, offsets):
+    keys = sorted(entries)
+    seeds, slots = build_hash(keys)
+
+    # Check every key lands on its own entry
+    for key in keys:
+        seed = seeds[pci_id_hash(key, 0) % len(seeds)]
+        assert slots[pci_id_hash(key, seed) % max(1, len(keys))] == key
+
+    out.write(f"static const uint16_t {name}_seeds[] = {{\n")
+    for i in range(0, len(seeds), 12):
+        out.write("    " + ", ".join(str(s) for s in seeds[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+    out.write(f"static const pci_id_entry_t {name}_entries[] = {{\n")
+    for key in slots:
+        if key is None:
+            out.write("    { 0, 0 },\n")
+        else:
+            out.write(f"    {{ 0x{key:08x}, {offsets[entries[key]]} }},\n")
+    out.write("};\n\n")
+    out.write(f"const pci_id_table_t {name} = {{\n"
+              f"    {len(keys)}, {len(seeds)}, {name}_seeds, {name}_entries\n}};\n\n")
+    return len(seeds) * 2 + len(slots) * 8
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_pci_ids.py PCI_IDS OUTPUT_C")
+    source, output = sys.argv[1], sys.argv[2]
+    vendors, devices, classes = parse(source)
+    pool, offsets = build_strings(list(vendors.values()) + list(devices.values())
+                                  + list(classes.values()))
+
+    with open(output, "w", encoding="ascii") as out:
+        out.write(f"/* Generated from {source} by tools/gen_pci_ids.py; do not edit */\n\n"
+                  '#include "pci_db.h"\n\n')
+        out.write(f"const char pci_id_strings[] =\n{c_string(pool)};\n\n")
+        table_bytes = 0
+        table_bytes += emit_table(out, "pci_vendor_ids", vendors, offsets)
+        table_bytes += emit_table(out, "pci_device_ids", devices, offsets)
+        table_bytes += emit_table(out, "pci_class_ids", classes, offsets)
+
+    print(f"PCI IDs: {len(vendors)} vendors, {len(devices)} devices, "
+          f"{len(classes)} classes; {table_bytes} bytes of hash tables, "
+          f"{len(pool)} bytes of names")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Turn the trace dump in a VibeOS serial log into a timeline.
+
+A kernel built with `make TRACE=1` writes its trace buffers to COM1
+between "# trace begin" and "# trace end" lines: a header with the TSC
+frequency, one "# trace event" line per event (id, name, argument
+names) and one "T <hex>" line per binary record. The records of all
+CPUs are merged by timestamp and printed one per line, with the time
+since the first record and since the previous one.
+
+Usage: trace_decode.py [SERIAL_LOG]   (reads stdin without an argument)
+"""
+
+import argparse
+import struct
+import sys
+
+# trace_record_t in kernel/trace.h
+RECORD = struct.Struct("<QHBB3I")
+
+
+def parse(lines):
+    """Return (tsc_khz, {event id: (name, [arg names])}, [records]) of the last dump."""
+    dump = None
+    for line in lines:
+        line = line.rstrip("\r\n")
+        if line.startswith("# trace begin"):
+            fields = dict(field.split("=", 1) for field in line.split()[3:])
+            if int(fields["record_size"]) != RECORD.size:
+                sys.exit(f"record size {fields['record_size']}, expected {RECORD.size}")
+            dump = (int(fields["tsc_khz"]), {}, [])
+        elif dump is None:
+            continue
+        elif line.startswith("# trace event "):
+            _, _, _, event, name, *args = line.split()
+            dump[1][int(event)] = (name, args[0].split(",") if args else [])
+        elif line.startswith("T "):
+            dump[2].append(RECORD.unpack(bytes.fromhex(line[2:])))
+    return dump
+
+
+def format_arg(value):
+    return str(value) if value < 4096 else f"{value:#010x}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", type=argparse.FileType("r"), default=sys.stdin)
+    args = parser.parse_args()
+
+    dump = parse(args.log)
+    if dump is None:
+        sys.exit("no trace dump found")
+    tsc_khz, events, records = dump
+    records.sort(key=lambda record: record[0])
+
+    def micros(cycles):
+        return cycles * 1000 / tsc_khz if tsc_khz else cycles
+
+    unit = "us" if tsc_khz else "cycles"
+    print(f"{'time (' + unit + ')':>14} {'delta':>10}  cpu  event")
+    start = previous = records[0][0] if records else 0
+    for timestamp, event, cpu, _, *values in records:
+        name, arg_names = events.get(event, (f"event{event}", []))
+        described = " ".join(f"{arg}={format_arg(value)}"
+                             for arg, value in zip(arg_names, values))
+        print(f"{micros(timestamp - start):14.3f} {micros(timestamp - previous):+10.3f}"
+              f"  cpu{cpu}  {name:<14} {described}")
+        previous = timestamp
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())